@@ -22,19 +22,67 @@
 
 const char *options_value[OPTIONS_SIZE] = {
     "-c", "--connect",
-    "-h", "--help"
+    "-h", "--help",
+    "-t", "--trace-out",
+    "-d", "--delay",
+    "-A", "--adaptive",
+    "-P", "--period",
+    "-f", "--fast",
+    "-w", "--watchdog",
+    "-r", "--read-only",
+    "-M", "--memory-period",
+    "-L", "--migrate-link",
+    "-l", "--local",
+    "-S", "--publish",
+    "-U", "--listen"
 };
 
 int options_count[OPTIONS_SIZE] = {
     1, 1,
-    0, 0
+    0, 0,
+    1, 1,
+    1, 1,
+    0, 0,
+    1, 1,
+    1, 1,
+    1, 1,
+    0, 0,
+    1, 1,
+    1, 1,
+    1, 1,
+    1, 1,
+    1, 1
 };
 
 void print_usage()
 {
     printf("Usage: virt-htop [option] -c|--connect <URL>\n");
+    printf("       virt-htop -c|--connect virt-htop+shm:///<NAME>\n");
+    printf("       virt-htop -c|--connect virt-htop+unix:///<PATH>[?filter=<TEXT>]\n");
     printf("--help -h:              Print this information\n");
     printf("--connect -c <URL>:     Connect to the <URL> node\n");
+    printf("--trace-out -t <FILE>:  Trace libvirt calls, write Chrome trace-event JSON\n"\
+           "                        to <FILE> and latency summary to <FILE>.summary\n");
+    printf("--delay -d <SECONDS>:   Refresh interval, fractions allowed (default 1.0)\n");
+    printf("--adaptive -A:          Stretch refresh interval while collection is slow\n");
+    printf("--period -P <LIST>:     Refresh periods of metric groups as GROUP=SECONDS[,...],\n"\
+           "                        groups: static, state, memory, cpu, io, agent, numa,\n"\
+           "                        vcpu, placement, perf\n"\
+           "                        (0 refreshes the group every tick)\n");
+    printf("--fast -f <SECONDS>:    Sampling interval of the fast lane (default 0.1)\n");
+    printf("--watchdog -w <SECONDS>: Deadline of per-domain calls, domains missing it\n"\
+           "                        are retried with backoff (default 1.0)\n");
+    printf("--read-only -r:         Monitoring only, no read-write connection is opened\n");
+    printf("--memory-period -M <SECONDS>: Turn on guest memory statistics with this period\n"\
+           "                        on running domains which report none\n");
+    printf("--migrate-link -L <MIB/S>[,<MS>]: Migration bandwidth and downtime budget\n"\
+           "                        the migration time is predicted for (default 1100,300)\n");
+    printf("--local -l <ROOT>:      Read CPU, disk and network counters of local domains\n"\
+           "                        from cgroups and /proc below <ROOT>, usually /\n");
+    printf("--publish -S <NAME>:    Collect without a screen and publish every snapshot\n"\
+           "                        to the shared memory segment <NAME> for viewers\n");
+    printf("--listen -U <PATH>:     Collect without a screen and stream the changes of\n"\
+           "                        every snapshot to viewers on the Unix socket <PATH>\n");
     printf("\n");
 }
 
@@ -53,7 +101,7 @@ char **parser_find_option(const char **begin, const char **end, options_enum opt
     const char **iter = begin;
     /* find option first */
     while (iter != end) {
-        int pos = strcmp(*begin, options_value[option]);
+        int pos = strcmp(*iter, options_value[option]);
 
         if (pos == 0) {
             /* If option doesn't have arguments */
@@ -26,14 +26,26 @@
  * Number of possible argument choices, 
  * size of the options_value and options_count arrays. 
  */
-#define OPTIONS_SIZE (4)
+#define OPTIONS_SIZE (28)
 
 /**
  * Used for indexing the options_value and options_count arrays 
  */
 typedef enum {
     CONNECT_SHORT, CONNECT_LONG,
-    HELP_SHORT, HELP_LONG
+    HELP_SHORT, HELP_LONG,
+    TRACE_OUT_SHORT, TRACE_OUT_LONG,
+    DELAY_SHORT, DELAY_LONG,
+    ADAPTIVE_SHORT, ADAPTIVE_LONG,
+    PERIOD_SHORT, PERIOD_LONG,
+    FAST_SHORT, FAST_LONG,
+    WATCHDOG_SHORT, WATCHDOG_LONG,
+    READ_ONLY_SHORT, READ_ONLY_LONG,
+    MEMORY_PERIOD_SHORT, MEMORY_PERIOD_LONG,
+    MIGRATE_LINK_SHORT, MIGRATE_LINK_LONG,
+    LOCAL_SHORT, LOCAL_LONG,
+    PUBLISH_SHORT, PUBLISH_LONG,
+    LISTEN_SHORT, LISTEN_LONG
 } options_enum;
 
 /**
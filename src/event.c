@@ -0,0 +1,232 @@
+/* This file contains the event loop sources the main loop sleeps on
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "event.h"
+#include "utils.h"
+#include "virt_event.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+/* Signals delivered through the signalfd instead of handlers */
+static void event_signals(sigset_t *set)
+{
+    sigemptyset(set);
+    sigaddset(set, SIGWINCH);
+    sigaddset(set, SIGTERM);
+    sigaddset(set, SIGINT);
+}
+
+int event_init(event_data *ev)
+{
+    ev->input_fd        = STDIN_FILENO;
+    ev->armed           = 0;
+    ev->wakeups         = 0;
+    ev->started         = time_monotonic_us();
+    ev->fds             = NULL;
+    ev->fds_capacity    = 0;
+    ev->watch           = NULL;
+    ev->watch_size      = 0;
+    ev->watch_capacity  = 0;
+    ev->signal_fd       = -1;
+
+    ev->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (ev->timer_fd < 0)
+        return -1;
+
+    sigset_t set;
+    event_signals(&set);
+    if (sigprocmask(SIG_BLOCK, &set, NULL) < 0) {
+        event_deinit(ev);
+        return -1;
+    }
+
+    ev->signal_fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (ev->signal_fd < 0) {
+        event_deinit(ev);
+        return -1;
+    }
+
+    return 0;
+}
+
+void event_deinit(event_data *ev)
+{
+    if (ev->timer_fd >= 0)
+        close(ev->timer_fd);
+    if (ev->signal_fd >= 0)
+        close(ev->signal_fd);
+    ev->timer_fd    = -1;
+    ev->signal_fd   = -1;
+
+    free(ev->fds);
+    ev->fds             = NULL;
+    ev->fds_capacity    = 0;
+
+    free(ev->watch);
+    ev->watch           = NULL;
+    ev->watch_size      = 0;
+    ev->watch_capacity  = 0;
+
+    sigset_t set;
+    event_signals(&set);
+    sigprocmask(SIG_UNBLOCK, &set, NULL);
+}
+
+/* Arm the one-shot timer for the deadline, 0 disarms it */
+static void event_arm(event_data *ev, unsigned long long deadline)
+{
+    if (deadline == ev->armed)
+        return;
+
+    struct itimerspec spec = { { 0, 0 }, { 0, 0 } };
+    spec.it_value.tv_sec    = deadline / 1000000;
+    spec.it_value.tv_nsec   = (deadline % 1000000) * 1000;
+    /* it_value of zero disarms the timer, which is exactly what deadline 0 means */
+    timerfd_settime(ev->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+    ev->armed = deadline;
+}
+
+/* Drain the signalfd and translate signals into event bits */
+static int event_read_signals(event_data *ev)
+{
+    int ready = 0;
+    struct signalfd_siginfo info;
+    while (read(ev->signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGWINCH)
+            ready |= EVENT_RESIZE;
+        else
+            ready |= EVENT_TERMINATE;
+    }
+    return ready;
+}
+
+void event_ignore_input(event_data *ev)
+{
+    ev->input_fd = -1;
+}
+
+void event_watch(event_data *ev, int fd, short events)
+{
+    for (size_t i = 0; i != ev->watch_size; ++i) {
+        if (ev->watch[i].fd == fd) {
+            ev->watch[i].events = events;
+            return;
+        }
+    }
+
+    if (ev->watch_size == ev->watch_capacity) {
+        size_t capacity = ev->watch_capacity ? 2 * ev->watch_capacity : 8;
+        struct pollfd *watch = realloc(ev->watch, capacity * sizeof(struct pollfd));
+        if (!watch)
+            return;
+        ev->watch           = watch;
+        ev->watch_capacity  = capacity;
+    }
+    ev->watch[ev->watch_size++] = (struct pollfd){ fd, events, 0 };
+}
+
+void event_unwatch(event_data *ev, int fd)
+{
+    for (size_t i = 0; i != ev->watch_size; ++i) {
+        if (ev->watch[i].fd == fd) {
+            ev->watch[i] = ev->watch[--ev->watch_size];
+            return;
+        }
+    }
+}
+
+short event_ready(const event_data *ev, int fd)
+{
+    for (size_t i = 0; i != ev->watch_size; ++i)
+        if (ev->watch[i].fd == fd)
+            return ev->watch[i].revents;
+    return 0;
+}
+
+int event_wait(event_data *ev, unsigned long long deadline)
+{
+    /* libvirt keepalives and other internal timeouts share the timer */
+    unsigned long long timeout = virt_event_next_timeout();
+    if (timeout && (!deadline || timeout < deadline))
+        deadline = timeout;
+    event_arm(ev, deadline);
+
+    size_t handle_size = virt_event_handle_size();
+    size_t size = EVENT_FD_SIZE + handle_size + ev->watch_size;
+    if (size > ev->fds_capacity) {
+        struct pollfd *fds = realloc(ev->fds, size * sizeof(struct pollfd));
+        if (!fds)
+            return EVENT_TERMINATE;
+        ev->fds             = fds;
+        ev->fds_capacity    = size;
+    }
+
+    ev->fds[EVENT_FD_INPUT]     = (struct pollfd){ ev->input_fd,  POLLIN, 0 };
+    ev->fds[EVENT_FD_TIMER]     = (struct pollfd){ ev->timer_fd,  POLLIN, 0 };
+    ev->fds[EVENT_FD_SIGNAL]    = (struct pollfd){ ev->signal_fd, POLLIN, 0 };
+    virt_event_fill(ev->fds + EVENT_FD_SIZE, handle_size);
+    for (size_t i = 0; i != ev->watch_size; ++i) {
+        ev->watch[i].revents = 0;
+        ev->fds[EVENT_FD_SIZE + handle_size + i] = ev->watch[i];
+    }
+
+    /* sleep until something actually happens */
+    if (poll(ev->fds, size, -1) < 0)
+        return errno == EINTR ? 0 : EVENT_TERMINATE;
+    ++ev->wakeups;
+
+    int ready = 0;
+    if (ev->fds[EVENT_FD_INPUT].revents & POLLIN)
+        ready |= EVENT_INPUT;
+    else if (ev->fds[EVENT_FD_INPUT].revents & (POLLHUP | POLLERR | POLLNVAL))
+        ready |= EVENT_TERMINATE;
+
+    if (ev->fds[EVENT_FD_TIMER].revents & POLLIN) {
+        uint64_t expirations = 0;
+        if (read(ev->timer_fd, &expirations, sizeof(expirations)) < 0)
+            expirations = 0;
+        /* one-shot, the next call arms it again */
+        ev->armed = 0;
+        ready |= EVENT_TIMER;
+    }
+
+    if (ev->fds[EVENT_FD_SIGNAL].revents & POLLIN)
+        ready |= event_read_signals(ev);
+
+    for (size_t i = 0; i != ev->watch_size; ++i) {
+        ev->watch[i].revents = ev->fds[EVENT_FD_SIZE + handle_size + i].revents;
+        if (ev->watch[i].revents)
+            ready |= EVENT_WATCH;
+    }
+
+    virt_event_dispatch_handles(ev->fds + EVENT_FD_SIZE, handle_size);
+    virt_event_dispatch_timeouts(time_monotonic_us());
+
+    return ready;
+}
+
+double event_wakeup_rate(const event_data *ev)
+{
+    unsigned long long elapsed = time_monotonic_us() - ev->started;
+    return elapsed ? ev->wakeups * 1000000.0 / elapsed : 0;
+}
@@ -0,0 +1,125 @@
+/* This file contains the event loop sources the main loop sleeps on
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file event.h
+ * This file contains the event sources of the main loop: terminal input,
+ * a timerfd armed for the nearest deadline, a signalfd for SIGWINCH, SIGTERM
+ * and SIGINT, file descriptors libvirt asked to watch and the sockets of the
+ * snapshot stream. The process sleeps in a single poll() over all of them
+ * until one becomes ready.
+ */
+#ifndef EVENT_H
+#define EVENT_H
+#include <stdlib.h>
+#include <poll.h>
+/** Number of own file descriptors polled in front of the libvirt ones */
+#define EVENT_FD_SIZE (3)
+
+/** Index of own file descriptors in the poll array */
+typedef enum {
+    EVENT_FD_INPUT,
+    EVENT_FD_TIMER,
+    EVENT_FD_SIGNAL
+} event_fd_enum;
+
+/** Bits of the mask returned by event_wait */
+typedef enum {
+    EVENT_INPUT     = 1,    /** Terminal input is ready */
+    EVENT_TIMER     = 2,    /** The deadline passed */
+    EVENT_RESIZE    = 4,    /** Terminal window changed size */
+    EVENT_TERMINATE = 8,    /** Termination was requested, or the terminal is gone */
+    EVENT_WATCH     = 16    /** A watched file descriptor is ready, see event_ready */
+} event_enum;
+
+/** Event sources of the main loop. */
+typedef struct {
+    int                 input_fd;       /** Terminal input, -1 if it is not polled */
+    int                 timer_fd;       /** timerfd on CLOCK_MONOTONIC */
+    int                 signal_fd;      /** signalfd of the blocked signals */
+    unsigned long long  armed;          /** Deadline the timer is armed for, 0 if disarmed */
+    struct pollfd       *fds;           /** Poll array, own file descriptors first */
+    struct pollfd       *watch;         /** Watched file descriptors with their last revents */
+    size_t              watch_size;     /** Number of watched file descriptors */
+    size_t              watch_capacity; /** Allocated entries of watch */
+    size_t              fds_capacity;   /** Allocated entries of fds */
+    unsigned long long  wakeups;        /** Number of times poll() returned */
+    unsigned long long  started;        /** Monotonic time the sources were created */
+} event_data;
+
+/**
+ * Block the handled signals and create the file descriptors.
+ * This function must be called before any thread is started,
+ * so that the signals are blocked in all of them.
+ * @param ev - event sources to be initialized
+ * @return 0 on success, -1 otherwise
+ */
+int event_init(event_data *ev);
+
+/**
+ * Close the file descriptors and unblock the signals.
+ * @param ev - event sources
+ */
+void event_deinit(event_data *ev);
+
+/**
+ * Stop polling the terminal, e.g. of a collector running in the background.
+ * @param ev - event sources
+ */
+void event_ignore_input(event_data *ev);
+
+/**
+ * Watch a file descriptor, or change the events it is watched for.
+ * @param ev     - event sources
+ * @param fd     - file descriptor to be polled
+ * @param events - poll events, e.g. POLLIN
+ */
+void event_watch(event_data *ev, int fd, short events);
+
+/**
+ * Stop watching a file descriptor, before it is closed.
+ * @param ev - event sources
+ * @param fd - watched file descriptor
+ */
+void event_unwatch(event_data *ev, int fd);
+
+/**
+ * Return what the last event_wait found on a watched file descriptor.
+ * @param ev - event sources
+ * @param fd - watched file descriptor
+ * @return poll revents, 0 if it is not watched or not ready
+ */
+short event_ready(const event_data *ev, int fd);
+
+/**
+ * Sleep until input, a signal, libvirt activity or the deadline.
+ * Ready libvirt handles and expired libvirt timeouts are dispatched here.
+ * @param ev       - event sources
+ * @param deadline - monotonic time in microseconds to wake up at, 0 for none
+ * @return mask of event_enum bits
+ */
+int event_wait(event_data *ev, unsigned long long deadline);
+
+/**
+ * Return average number of wakeups per second since event_init.
+ * @param ev - event sources
+ * @return wakeups per second
+ */
+double event_wakeup_rate(const event_data *ev);
+
+#endif /* EVENT_H */
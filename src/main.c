@@ -17,15 +17,41 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
-#include <time.h>
 #include "utils.h"
 #include "tui.h"
 #include "arguments.h"
+#include "virt_trace.h"
+#include "scheduler.h"
+#include "virt_record.h"
+#include "virt_lane.h"
+#include "tui_lane.h"
+#include "event.h"
+#include "virt_event.h"
+#include "virt_watchdog.h"
+#include "virt_health.h"
+#include "virt_command.h"
+#include "virt_errors.h"
+#include "virt_vcpu.h"
+#include "tui_pin.h"
+#include "virt_dirty.h"
+#include "virt_perf.h"
+#include "virt_local.h"
+#include "virt_snapshot.h"
+#include "virt_stream.h"
+#include <limits.h>
 #define LOG_FILE ("virt-htop.log")
 
-int main_loop(virt_data *virt, tui_data *tui)
+int main_loop(virt_data *virt, tui_data *tui, scheduler_data *sched, event_data *ev)
 {
     tui_mode current_mode = TUI_MODE_DOMAIN;
+    tui_pane pane = TUI_PANE_LANE;
+
+    /* the first screen counts as the first tick */
+    scheduler_tick_begin(sched);
+
+    /* collect only what fits the screen */
+    tui_plan[current_mode](tui, virt);
+    virt_health_check(virt);
 
     /* generate tui */
     tui_create[current_mode](tui, virt_get[current_mode](virt));
@@ -33,33 +59,111 @@ int main_loop(virt_data *virt, tui_data *tui)
     virt_node_data node_data = virt_get_node_data(virt);
     /* generate node panel */
     tui_create_node_panel(tui->node_data, &node_data);
+    tui_node_update_refresh_data(tui->node_data, sched, event_wakeup_rate(ev));
 
     tui_draw[current_mode](tui);
+    tui_draw_lane(virt->lane);
+
+    scheduler_tick_end(sched);
 
     /* this index always points to the current selected item */
     size_t index = 0;
-    /* prepare counter variable for drawing tui */
-    time_t refresh_counter = 0;
-    time(&refresh_counter);
+    /* selected domain row while another mode is shown */
+    size_t domain_index = 0;
+    /* domain the selection of the list rests on, it follows the domain when rows move */
+    unsigned char selected[VIR_UUID_BUFLEN];
+    int selected_known = FALSE;
+    tui_mode shown_mode = current_mode;
     int user_input = 0;
 
-    /* make input non-blocking
-       with expected timeout*/
-    timeout(TUI_INPUT_DELAY);
-
     keypad(tui->domain_data->domain_columns_win, TRUE);   /* allow special key input */
     int quit    = FALSE;
     int command = FALSE;
     while (quit != TRUE) {
-        /* if user pushed button */
-        if ((user_input = getch()) != ERR) {
+        /* sleep until input, a signal, libvirt activity, the next tick or lane sample */
+        unsigned long long deadline = sched->deadline;
+        if (virt->lane->enabled && virt->lane->sched.deadline < deadline)
+            deadline = virt->lane->sched.deadline;
+        int ready = event_wait(ev, deadline);
+
+        if (ready & EVENT_TERMINATE)
+            quit = TRUE;
+        if (ready & EVENT_RESIZE) {
+            tui_resize();
+            command = TRUE;
+        }
+
+        /* handle every key pushed since the last wakeup */
+        while ((ready & EVENT_INPUT) && quit != TRUE && (user_input = getch()) != ERR) {
             switch (user_input) {
                 case KEY_F(TUI_COMMAND_KEY_QUIT): case TUI_KEY_QUIT: {
                     quit = TRUE;
                     break;
                 }
                 case TUI_KEY_MODE_ONE: {
-                    current_mode = TUI_MODE_DOMAIN;
+                    command = TRUE;
+                    if (current_mode != TUI_MODE_DOMAIN) {
+                        /* back to the domain selected before leaving the list */
+                        tui_reset[current_mode](tui);
+                        current_mode = TUI_MODE_DOMAIN;
+                        index = domain_index;
+                    }
+                    break;
+                }
+                case TUI_KEY_MODE_TWO: {
+                    command = TRUE;
+                    if (current_mode == TUI_MODE_VCPU) {
+                        /* switch between the selected domain and all active domains */
+                        virt_vcpu_expand(virt, -1, !virt->vcpu->all);
+                    } else {
+                        if (current_mode == TUI_MODE_DOMAIN) {
+                            domain_index = tui_menu_index[current_mode](tui);
+                            selected_known = virt_domain_row_uuid(virt, domain_index, selected) == VIRT_ERROR_SUCCESS;
+                        }
+                        virt_vcpu_expand(virt, domain_index, FALSE);
+                        tui_reset[current_mode](tui);
+                        current_mode = TUI_MODE_VCPU;
+                    }
+                    index = 0;
+                    break;
+                }
+                case TUI_KEY_MODE_THREE: {
+                    command = TRUE;
+                    if (current_mode != TUI_MODE_STORAGE) {
+                        if (current_mode == TUI_MODE_DOMAIN) {
+                            domain_index = tui_menu_index[current_mode](tui);
+                            selected_known = virt_domain_row_uuid(virt, domain_index, selected) == VIRT_ERROR_SUCCESS;
+                        }
+                        tui_reset[current_mode](tui);
+                        current_mode = TUI_MODE_STORAGE;
+                        index = 0;
+                    }
+                    break;
+                }
+                case TUI_KEY_MODE_FOUR: {
+                    command = TRUE;
+                    if (current_mode != TUI_MODE_NETWORK) {
+                        if (current_mode == TUI_MODE_DOMAIN) {
+                            domain_index = tui_menu_index[current_mode](tui);
+                            selected_known = virt_domain_row_uuid(virt, domain_index, selected) == VIRT_ERROR_SUCCESS;
+                        }
+                        tui_reset[current_mode](tui);
+                        current_mode = TUI_MODE_NETWORK;
+                        index = 0;
+                    }
+                    break;
+                }
+                case TUI_KEY_MODE_FIVE: {
+                    command = TRUE;
+                    if (current_mode != TUI_MODE_JOBS) {
+                        if (current_mode == TUI_MODE_DOMAIN) {
+                            domain_index = tui_menu_index[current_mode](tui);
+                            selected_known = virt_domain_row_uuid(virt, domain_index, selected) == VIRT_ERROR_SUCCESS;
+                        }
+                        tui_reset[current_mode](tui);
+                        current_mode = TUI_MODE_JOBS;
+                        index = 0;
+                    }
                     break;
                 }
                 case KEY_DOWN: case TUI_KEY_LIST_DOWN: {
@@ -127,10 +231,125 @@ int main_loop(virt_data *virt, tui_data *tui)
                     virt_destroy[current_mode](virt, index);
                     break;
                 }
+                case TUI_KEY_FAST_LANE: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    virt_lane_toggle(virt->lane);
+                    break;
+                }
+                case TUI_KEY_FAST_LANE_PIN: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    virt_lane_pin(virt, virt_row[current_mode](virt, index));
+                    break;
+                }
+                case TUI_KEY_ERRORS: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    pane = pane == TUI_PANE_ERRORS ? TUI_PANE_LANE : TUI_PANE_ERRORS;
+                    break;
+                }
+                case TUI_KEY_PIN: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    /* storage and network rows, and jobs of gone domains, have no domain to pin */
+                    if (virt_row[current_mode](virt, index) >= 0)
+                        tui_pin_editor(virt, virt_row[current_mode](virt, index));
+                    break;
+                }
+                case TUI_KEY_BANDWIDTH: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    /* only block jobs have a bandwidth to limit */
+                    if (current_mode == TUI_MODE_JOBS)
+                        tui_jobs_throttle(virt, index);
+                    break;
+                }
+                case TUI_KEY_DIRTY: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    if (virt_row[current_mode](virt, index) >= 0)
+                        virt_dirty_request(virt, virt_row[current_mode](virt, index));
+                    break;
+                }
+                case TUI_KEY_DIRTY_ALL: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    virt_dirty_request_all(virt);
+                    break;
+                }
+                case TUI_KEY_SORT: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    virt_domain_next_sort();
+                    break;
+                }
+                case TUI_KEY_NUMA: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    pane = pane == TUI_PANE_NUMA ? TUI_PANE_LANE : TUI_PANE_NUMA;
+                    break;
+                }
+                case TUI_KEY_MEMORY: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    tui_toggle_memory_columns();
+                    break;
+                }
+                case TUI_KEY_PERF: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    tui_toggle_perf_columns();
+                    break;
+                }
+                case TUI_KEY_PERF_EVENTS: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    if (virt_row[current_mode](virt, index) >= 0)
+                        virt_perf_toggle(virt, virt_row[current_mode](virt, index));
+                    break;
+                }
+                case TUI_KEY_DETAIL: {
+                    command = TRUE;
+                    index = tui_menu_index[current_mode](tui);
+                    pane = pane == TUI_PANE_DETAIL ? TUI_PANE_LANE : TUI_PANE_DETAIL;
+                    break;
+                }
             }
         }
+        if (quit == TRUE)
+            break;
+
+        /* the lane follows the selection unless domains are pinned */
+        virt_lane_select(virt, virt_row[current_mode](virt, index));
+
+        /* sample the fast lane between the ticks, only its pane is redrawn */
+        if (virt->lane->enabled && scheduler_due(&virt->lane->sched)) {
+            virt_lane_sample(virt);
+            scheduler_advance(&virt->lane->sched);
+            if (pane == TUI_PANE_LANE) {
+                tui_draw_lane(virt->lane);
+                refresh();
+            }
+        }
+
         /* check if its time to refresh the screen */
-        if (command == TRUE || difftime(time(NULL), refresh_counter) >= TUI_REFRESH_TIME) {
+        int tick = scheduler_due(sched);
+        if (command == TRUE || tick) {
+            /* refreshes forced by commands are not part of the schedule */
+            if (tick)
+                scheduler_tick_begin(sched);
+
+            /* plan the fetch from what is on the screen right now */
+            tui_plan[current_mode](tui, virt);
+
+            /* the records on the screen are still those the selection was made in */
+            if (current_mode == TUI_MODE_DOMAIN && shown_mode == TUI_MODE_DOMAIN)
+                selected_known = virt_domain_row_uuid(virt, index, selected) == VIRT_ERROR_SUCCESS;
+
+            /* notice a lost connection, pick up a reconnected one */
+            virt_health_check(virt);
+
             /* clear the screen*/
             clear();
 
@@ -142,26 +361,265 @@ int main_loop(virt_data *virt, tui_data *tui)
             /* generate tui */
             tui_create[current_mode](tui, virt_get[current_mode](virt));
 
-            /* get data from node*/
+            /* sorting and listing move rows, commands must not hit another domain */
+            if (current_mode == TUI_MODE_DOMAIN && selected_known) {
+                int row = virt_domain_find_row(virt, selected);
+                if (row >= 0)
+                    index = row;
+            }
+            shown_mode = current_mode;
+
+            /* get data from node, its cells only while they are shown */
+            virt->node->numa = pane == TUI_PANE_NUMA;
             node_data = virt_get_node_data(virt);
             tui_create_node_panel(tui->node_data, &node_data);
+            tui_node_update_refresh_data(tui->node_data, sched, event_wakeup_rate(ev));
 
             tui_draw[current_mode](tui);
+            tui_draw_pane(pane, virt, virt_row[current_mode](virt, index));
 
             /* set index for each column */
             tui_menu_set_index[current_mode](tui, index);
 
             refresh();
 
-            /* restart the counter */
-            time(&refresh_counter);
+            if (tick)
+                scheduler_tick_end(sched);
             command = FALSE;
         }
-        wrefresh(tui->domain_data->domain_columns_win);
+        tui_refresh[current_mode](tui);
     }
     return 0;
 }
 
+/*
+ * Collect on schedule without a screen and publish every snapshot, until a
+ * signal asks to stop. Nothing is drawn, so all rows and columns are collected.
+ * @param virt    - pointer with virt data
+ * @param sched   - schedule of the refreshes
+ * @param ev      - event sources, terminal input is not polled
+ * @param segment - segment the snapshots are published to, if it was created
+ * @param server  - server the changes are streamed by, if it is listening
+ * @return 0 on success, 1 if the snapshot table cannot be allocated
+ */
+int collector_loop(virt_data *virt, scheduler_data *sched, event_data *ev,
+                   virt_snapshot_segment *segment, virt_stream_server *server)
+{
+    virt_snapshot_table *table = calloc(1, sizeof(virt_snapshot_table));
+    if (!table)
+        return 1;
+
+    int quit = FALSE;
+    while (quit != TRUE) {
+        if (scheduler_due(sched)) {
+            scheduler_tick_begin(sched);
+
+            /* notice a lost connection, pick up a reconnected one */
+            virt_health_check(virt);
+            virt_reset_all(virt);
+
+            virt_domain_data *data = virt_get_domain_data(virt);
+            virt_node_data node_data = virt_get_node_data(virt);
+            virt_snapshot_fill(table, data, &node_data);
+            if (segment->table)
+                virt_snapshot_publish(segment, table);
+            if (server->fd >= 0)
+                virt_stream_publish(server, table, ev);
+
+            virt_deinit_domain_data(data);
+            free(data);
+            virt_deinit_node_data(&node_data);
+
+            scheduler_tick_end(sched);
+        }
+
+        int ready = event_wait(ev, sched->deadline);
+        if (ready & EVENT_TERMINATE)
+            quit = TRUE;
+        /* clients come, subscribe and drain their queues between the ticks */
+        if (ready & EVENT_WATCH)
+            virt_stream_serve(server, ev);
+    }
+
+    free(table);
+    return 0;
+}
+
+/*
+ * Column mask of the domain columns on the screen, a stream sends only these.
+ * @param tui - pointer with TUI data
+ * @return mask of the shown domain data types
+ */
+static unsigned int viewer_columns(tui_data *tui)
+{
+    unsigned int columns = 0;
+    for (int i = 0; i != tui->domain_data->domain_column_size; ++i)
+        columns |= VIRT_STREAM_COLUMN_BIT(tui->domain_data->domain_type[i]);
+    return columns;
+}
+
+/*
+ * Show the snapshots of a collector without a libvirt connection. Only the
+ * domain list is shared, so the other modes and the commands are not there.
+ * Snapshots are read from shared memory, or streamed over a Unix socket with
+ * only the shown columns and the rows passing the filter of the URI.
+ * @param uri   - connection URI of the viewer
+ * @param tui   - pointer with TUI data
+ * @param sched - schedule of the refreshes
+ * @param ev    - event sources
+ * @return 0 on success, 1 if the snapshot tables cannot be allocated
+ */
+int viewer_loop(const char *uri, tui_data *tui, scheduler_data *sched, event_data *ev)
+{
+    virt_snapshot_segment segment;
+    virt_init_snapshot(&segment);
+    virt_stream_client client;
+    virt_init_stream_client(&client);
+
+    int stream = !strncmp(uri, VIRT_STREAM_UNIX_SCHEME, strlen(VIRT_STREAM_UNIX_SCHEME));
+    char *name = copy_str(uri + strlen(stream ? VIRT_STREAM_UNIX_SCHEME : VIRT_SNAPSHOT_SHM_SCHEME));
+    const char *filter = "";
+    char *query = stream ? strstr(name, VIRT_STREAM_FILTER_PARAM) : NULL;
+    if (query) {
+        *query = '\0';
+        filter = query + strlen(VIRT_STREAM_FILTER_PARAM);
+    }
+
+    /* a torn copy is dropped, the previous one stays on the screen */
+    virt_snapshot_table *shown = calloc(1, sizeof(virt_snapshot_table));
+    virt_snapshot_table *next  = calloc(1, sizeof(virt_snapshot_table));
+    if (!shown || !next) {
+        free(shown);
+        free(next);
+        free(name);
+        return 1;
+    }
+
+    size_t index = 0;
+    int user_input = 0;
+    int quit    = FALSE;
+    int command = TRUE;
+    while (quit != TRUE) {
+        int tick = scheduler_due(sched);
+        if (command == TRUE || tick) {
+            if (tick) {
+                scheduler_tick_begin(sched);
+
+                /* a restarted collector creates the segment or the socket anew */
+                if (stream && client.fd < 0)
+                    virt_stream_connect(&client, name, ev);
+                if (segment.table && virt_snapshot_age(segment.table) > VIRT_SNAPSHOT_STALE_AGE)
+                    virt_deinit_snapshot(&segment);
+                if (!stream && !segment.table)
+                    virt_snapshot_attach(&segment, name);
+
+                if (segment.table && virt_snapshot_read(&segment, next) == VIRT_ERROR_SUCCESS) {
+                    virt_snapshot_table *swap = shown;
+                    shown   = next;
+                    next    = swap;
+                }
+            }
+
+            clear();
+            tui_reset[TUI_MODE_DOMAIN](tui);
+            tui_reset_node(tui);
+
+            /* a stream changes its table only on a complete snapshot */
+            const virt_snapshot_table *view = client.table ? client.table : shown;
+            tui_create_domain(tui->domain_data, virt_snapshot_domain_data(view));
+            virt_node_data node_data = virt_snapshot_node_data(view, uri);
+            tui_create_node_panel(tui->node_data, &node_data);
+            tui_node_update_refresh_data(tui->node_data, sched, event_wakeup_rate(ev));
+
+            tui_draw[TUI_MODE_DOMAIN](tui);
+            tui_menu_set_index[TUI_MODE_DOMAIN](tui, index);
+            refresh();
+
+            /* subscribe anew once other columns are shown */
+            unsigned int columns = viewer_columns(tui) | VIRT_STREAM_REQUIRED_COLUMNS;
+            if (client.fd >= 0 && (!client.subscribed || client.columns != columns) &&
+                virt_stream_subscribe(&client, columns, filter, ev) != VIRT_ERROR_SUCCESS)
+                virt_deinit_stream_client(&client, ev);
+
+            if (tick)
+                scheduler_tick_end(sched);
+            command = FALSE;
+        }
+        tui_refresh[TUI_MODE_DOMAIN](tui);
+
+        int ready = event_wait(ev, sched->deadline);
+        if (ready & EVENT_TERMINATE)
+            quit = TRUE;
+        if ((ready & EVENT_WATCH) && client.fd >= 0) {
+            int received = virt_stream_receive(&client, ev);
+            if (received == VIRT_ERROR_FAILURE)
+                virt_deinit_stream_client(&client, ev);
+            else if (received)
+                command = TRUE;
+        }
+        if (ready & EVENT_RESIZE) {
+            tui_resize();
+            command = TRUE;
+        }
+
+        while ((ready & EVENT_INPUT) && quit != TRUE && (user_input = getch()) != ERR) {
+            switch (user_input) {
+                case KEY_F(TUI_COMMAND_KEY_QUIT): case TUI_KEY_QUIT: {
+                    quit = TRUE;
+                    break;
+                }
+                case KEY_DOWN: case TUI_KEY_LIST_DOWN: {
+                    command = TRUE;
+                    tui_menu_driver[TUI_MODE_DOMAIN](tui, REQ_DOWN_ITEM);
+                    index = tui_menu_index[TUI_MODE_DOMAIN](tui);
+                    break;
+                }
+                case KEY_UP: case TUI_KEY_LIST_UP: {
+                    command = TRUE;
+                    tui_menu_driver[TUI_MODE_DOMAIN](tui, REQ_UP_ITEM);
+                    index = tui_menu_index[TUI_MODE_DOMAIN](tui);
+                    break;
+                }
+                case KEY_NPAGE: {
+                    command = TRUE;
+                    tui_menu_driver[TUI_MODE_DOMAIN](tui, REQ_SCR_DLINE);
+                    index = tui_menu_index[TUI_MODE_DOMAIN](tui);
+                    break;
+                }
+                case KEY_PPAGE: {
+                    command = TRUE;
+                    tui_menu_driver[TUI_MODE_DOMAIN](tui, REQ_SCR_ULINE);
+                    index = tui_menu_index[TUI_MODE_DOMAIN](tui);
+                    break;
+                }
+                case KEY_F(TUI_COMMAND_KEY_HELP):
+                case TUI_KEY_COMMAND_HELP: {
+                    command = TRUE;
+                    tui_draw_help();
+                    break;
+                }
+                case TUI_KEY_MEMORY: {
+                    command = TRUE;
+                    tui_toggle_memory_columns();
+                    break;
+                }
+                case TUI_KEY_PERF: {
+                    command = TRUE;
+                    tui_toggle_perf_columns();
+                    break;
+                }
+            }
+        }
+    }
+
+    free(shown);
+    free(next);
+    free(name);
+    virt_deinit_snapshot(&segment);
+    virt_deinit_stream_client(&client, ev);
+    return 0;
+}
+
 int main(int argc, const char **argv)
 {
     openlog(LOG_FILE, LOG_PID, LOG_USER);
@@ -190,36 +648,265 @@ int main(int argc, const char **argv)
         return 1;
     }
     
+    /* get tracing arguments */
+    char **trace_args = parser_find_option(argv+1, argv+argc, TRACE_OUT_SHORT);
+    if (!trace_args)
+        trace_args = parser_find_option(argv+1, argv+argc, TRACE_OUT_LONG);
+
+    if (trace_args && virt_trace_init() != VIRT_ERROR_SUCCESS) {
+        fprintf(stderr, "Failed to initialize tracing\n");
+        return 1;
+    }
+
+    /* get refresh arguments */
+    double interval = TUI_REFRESH_TIME;
+    char **delay_args = parser_find_option(argv+1, argv+argc, DELAY_SHORT);
+    if (!delay_args)
+        delay_args = parser_find_option(argv+1, argv+argc, DELAY_LONG);
+    if (delay_args) {
+        int res = scheduler_parse_interval(delay_args[0], &interval);
+        free_pointer_char(delay_args, delay_args + options_count[DELAY_SHORT]);
+        if (res != 0) {
+            fprintf(stderr, "Invalid refresh interval, expected seconds between %.2f and %.0f\n",
+                    SCHEDULER_MIN_INTERVAL, SCHEDULER_MAX_INTERVAL);
+            return 1;
+        }
+    }
+
+    int adaptive =  parser_find_option(argv+1, argv+argc, ADAPTIVE_SHORT) != NULL ||
+                    parser_find_option(argv+1, argv+argc, ADAPTIVE_LONG)  != NULL;
+
+    /* get metric group refresh periods */
+    char **period_args = parser_find_option(argv+1, argv+argc, PERIOD_SHORT);
+    if (!period_args)
+        period_args = parser_find_option(argv+1, argv+argc, PERIOD_LONG);
+    if (period_args) {
+        int res = virt_parse_group_periods(period_args[0]);
+        free_pointer_char(period_args, period_args + options_count[PERIOD_SHORT]);
+        if (res != VIRT_ERROR_SUCCESS) {
+            fprintf(stderr, "Invalid refresh periods, expected GROUP=SECONDS[,...]\n");
+            return 1;
+        }
+    }
+
+    /* get fast lane arguments */
+    double fast_interval = VIRT_LANE_INTERVAL;
+    char **fast_args = parser_find_option(argv+1, argv+argc, FAST_SHORT);
+    if (!fast_args)
+        fast_args = parser_find_option(argv+1, argv+argc, FAST_LONG);
+    if (fast_args) {
+        int res = scheduler_parse_interval(fast_args[0], &fast_interval);
+        free_pointer_char(fast_args, fast_args + options_count[FAST_SHORT]);
+        if (res != 0) {
+            fprintf(stderr, "Invalid fast lane interval, expected seconds between %.2f and %.0f\n",
+                    SCHEDULER_MIN_INTERVAL, SCHEDULER_MAX_INTERVAL);
+            return 1;
+        }
+    }
+
+    /* get watchdog arguments */
+    double watchdog_timeout = VIRT_WATCHDOG_TIMEOUT;
+    char **watchdog_args = parser_find_option(argv+1, argv+argc, WATCHDOG_SHORT);
+    if (!watchdog_args)
+        watchdog_args = parser_find_option(argv+1, argv+argc, WATCHDOG_LONG);
+    if (watchdog_args) {
+        int res = scheduler_parse_interval(watchdog_args[0], &watchdog_timeout);
+        free_pointer_char(watchdog_args, watchdog_args + options_count[WATCHDOG_SHORT]);
+        if (res != 0) {
+            fprintf(stderr, "Invalid watchdog deadline, expected seconds between %.2f and %.0f\n",
+                    SCHEDULER_MIN_INTERVAL, SCHEDULER_MAX_INTERVAL);
+            return 1;
+        }
+    }
+
+    /* get guest memory statistics period */
+    char **memory_period_args = parser_find_option(argv+1, argv+argc, MEMORY_PERIOD_SHORT);
+    if (!memory_period_args)
+        memory_period_args = parser_find_option(argv+1, argv+argc, MEMORY_PERIOD_LONG);
+    if (memory_period_args) {
+        char *end = NULL;
+        long memory_period = strtol(memory_period_args[0], &end, 10);
+        int valid = end != memory_period_args[0] && *end == '\0' && memory_period > 0 && memory_period <= INT_MAX;
+        free_pointer_char(memory_period_args, memory_period_args + options_count[MEMORY_PERIOD_SHORT]);
+        if (!valid) {
+            fprintf(stderr, "Invalid memory statistics period, expected whole seconds > 0\n");
+            return 1;
+        }
+        virt_domain_set_memory_period((int)memory_period);
+    }
+
+    /* get the migration link the migration time is predicted for */
+    char **migrate_link_args = parser_find_option(argv+1, argv+argc, MIGRATE_LINK_SHORT);
+    if (!migrate_link_args)
+        migrate_link_args = parser_find_option(argv+1, argv+argc, MIGRATE_LINK_LONG);
+    if (migrate_link_args) {
+        char *end = NULL;
+        double bandwidth = strtod(migrate_link_args[0], &end);
+        double downtime = VIRT_DIRTY_DOWNTIME;
+        int valid = end != migrate_link_args[0] && bandwidth > 0.0;
+        if (valid && *end == ',') {
+            const char *begin = end + 1;
+            downtime = strtod(begin, &end);
+            valid = end != begin && downtime > 0.0;
+        }
+        valid = valid && *end == '\0';
+        free_pointer_char(migrate_link_args, migrate_link_args + options_count[MIGRATE_LINK_SHORT]);
+        if (!valid) {
+            fprintf(stderr, "Invalid migration link, expected MiB/s > 0 and optionally ,milliseconds > 0\n");
+            return 1;
+        }
+        virt_dirty_set_migration(bandwidth, downtime);
+    }
+
+    /* read the counters of local domains directly, libvirtd stays off the hot path */
+    char **local_args = parser_find_option(argv+1, argv+argc, LOCAL_SHORT);
+    if (!local_args)
+        local_args = parser_find_option(argv+1, argv+argc, LOCAL_LONG);
+    if (local_args) {
+        virt_local_set_root(local_args[0]);
+        free_pointer_char(local_args, local_args + options_count[LOCAL_SHORT]);
+    }
+
+    /* get the shared memory segment a collector publishes to */
+    char **publish_args = parser_find_option(argv+1, argv+argc, PUBLISH_SHORT);
+    if (!publish_args)
+        publish_args = parser_find_option(argv+1, argv+argc, PUBLISH_LONG);
+
+    /* get the Unix socket a collector streams its changes on */
+    char **listen_args = parser_find_option(argv+1, argv+argc, LISTEN_SHORT);
+    if (!listen_args)
+        listen_args = parser_find_option(argv+1, argv+argc, LISTEN_LONG);
+
+    int read_only = parser_find_option(argv+1, argv+argc, READ_ONLY_SHORT) != NULL ||
+                    parser_find_option(argv+1, argv+argc, READ_ONLY_LONG)  != NULL;
+
+    /* signals are blocked before libvirt may start any thread */
+    event_data ev;
+    if (event_init(&ev) != 0) {
+        fprintf(stderr, "Failed to set up event loop\n");
+        return 1;
+    }
+
+    /* viewers show the snapshots of a collector, libvirt is never set up */
+    if (!strncmp(conn_args[0], VIRT_SNAPSHOT_SHM_SCHEME, strlen(VIRT_SNAPSHOT_SHM_SCHEME)) ||
+        !strncmp(conn_args[0], VIRT_STREAM_UNIX_SCHEME, strlen(VIRT_STREAM_UNIX_SCHEME))) {
+        tui_init_global();
+        tui_data tui;
+        tui_init_all(&tui);
+        scheduler_data sched;
+        scheduler_init(&sched, interval, adaptive);
+
+        int res = viewer_loop(conn_args[0], &tui, &sched, &ev);
+
+        endwin();
+        if (res != 0)
+            fprintf(stderr, "Failed to allocate snapshot tables\n");
+        tui_deinit_all(&tui);
+        event_deinit(&ev);
+        free_pointer_char(conn_args, conn_args + options_count[CONNECT_SHORT]);
+        closelog();
+        return res;
+    }
+
+    /* errors are summarized in the background, before libvirt may report any */
+    if (virt_errors_init() != VIRT_ERROR_SUCCESS) {
+        fprintf(stderr, "Failed to start error reporting\n");
+        return 1;
+    }
+
     /* initialize libvirt */
     virt_setup();
+    virt_event_register();
+
+    /* workers inherit the blocked signals */
+    if (virt_watchdog_init(watchdog_timeout) != VIRT_ERROR_SUCCESS) {
+        fprintf(stderr, "Failed to start watchdog workers\n");
+        return 1;
+    }
     
     /* data associated with libvirt */
     virt_data virt;
     virt_init_all(&virt);
+    virt_lane_set_interval(virt.lane, fast_interval);
 
-    /* connect to the node */
-    virt.conn = virt_connect_node(conn_args);
+    /* statistics are collected over a read-only connection */
+    virt.conn = virt_connect_node(conn_args, 1);
 
     if (virt.conn == NULL) {
         fprintf(stderr, "Failed to open connection\n");
         return 1;
     }
+    virt_health_watch(&virt, conn_args[0]);
+
+    /* commands get their own connection, unprivileged users end up monitoring only */
+    virt_command_init(conn_args, read_only);
+
+    /* the schedule starts with the first screen */
+    scheduler_data sched;
+    scheduler_init(&sched, interval, adaptive);
+
+    int res = 0;
+    if (publish_args || listen_args) {
+        /* a collector publishes its snapshots instead of drawing them */
+        virt_snapshot_segment segment;
+        virt_init_snapshot(&segment);
+        if (publish_args) {
+            if (virt_snapshot_create(&segment, publish_args[0]) != VIRT_ERROR_SUCCESS) {
+                fprintf(stderr, "Failed to create shared memory segment %s\n", publish_args[0]);
+                return 1;
+            }
+            free_pointer_char(publish_args, publish_args + options_count[PUBLISH_SHORT]);
+        }
+        virt_stream_server server;
+        virt_init_stream_server(&server);
+        if (listen_args) {
+            if (virt_stream_listen(&server, listen_args[0], &ev) != VIRT_ERROR_SUCCESS) {
+                fprintf(stderr, "Failed to listen on socket %s\n", listen_args[0]);
+                return 1;
+            }
+            free_pointer_char(listen_args, listen_args + options_count[LISTEN_SHORT]);
+        }
+        event_ignore_input(&ev);
+
+        res = collector_loop(&virt, &sched, &ev, &segment, &server);
+        if (res != 0)
+            fprintf(stderr, "Failed to allocate snapshot table\n");
 
-    /* initialize ncurses library routines */
-    tui_init_global();
+        virt_deinit_stream_server(&server, &ev);
+        virt_deinit_snapshot(&segment);
+    } else {
+        /* initialize ncurses library routines */
+        tui_init_global();
 
-    /* data associated with TUI */
-    tui_data tui;
-    tui_init_all(&tui);
+        /* data associated with TUI */
+        tui_data tui;
+        tui_init_all(&tui);
 
-    int res = main_loop(&virt, &tui);
+        res = main_loop(&virt, &tui, &sched, &ev);
+
+        endwin();
+        tui_deinit_all(&tui);
+    }
 
     /* deinit data */
-    endwin();
-    tui_deinit_all(&tui);
+    virt_watchdog_deinit();
+    virt_command_deinit();
     virt_deinit_all(&virt);
+    virt_event_deinit();
+    virt_errors_deinit();
+    event_deinit(&ev);
     free_pointer_char(conn_args, conn_args + options_count[CONNECT_SHORT]);
 
+    /* export gathered libvirt call statistics */
+    if (trace_args) {
+        if (virt_trace_write(trace_args[0]) != VIRT_ERROR_SUCCESS) {
+            fprintf(stderr, "Failed to write trace to %s\n", trace_args[0]);
+            res = 1;
+        }
+        virt_trace_deinit();
+        free_pointer_char(trace_args, trace_args + options_count[TRACE_OUT_SHORT]);
+    }
+
     closelog();
 
     return res;
@@ -0,0 +1,124 @@
+/* This file contains the refresh scheduler driven by the monotonic clock
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "scheduler.h"
+#include "utils.h"
+#include "virt_trace.h"
+#include <math.h>
+
+void scheduler_init(scheduler_data *sched, double interval, int adaptive)
+{
+    sched->interval     = (unsigned long long)(interval * 1000000.0);
+    sched->current      = sched->interval;
+    sched->deadline     = time_monotonic_us();
+    sched->tick_begin   = 0;
+    sched->jitter       = 0;
+    sched->duration     = 0;
+    sched->ticks        = 0;
+    sched->overruns     = 0;
+    sched->adaptive     = adaptive;
+    sched->quiet_ticks  = 0;
+}
+
+int scheduler_due(const scheduler_data *sched)
+{
+    return time_monotonic_us() >= sched->deadline;
+}
+
+int scheduler_timeout(const scheduler_data *sched)
+{
+    unsigned long long now = time_monotonic_us();
+    if (now >= sched->deadline)
+        return 0;
+
+    return (int)((sched->deadline - now + 999) / 1000);
+}
+
+void scheduler_tick_begin(scheduler_data *sched)
+{
+    sched->tick_begin   = time_monotonic_us();
+    sched->jitter       = (long long)(sched->tick_begin - sched->deadline);
+}
+
+static void scheduler_adapt(scheduler_data *sched)
+{
+    double load = (double)sched->duration / sched->current;
+
+    if (load > SCHEDULER_ADAPTIVE_HIGH_LOAD) {
+        /* collection eats the interval, back off */
+        sched->quiet_ticks = 0;
+        sched->current *= 2;
+        if (sched->current > sched->interval * SCHEDULER_ADAPTIVE_MAX_FACTOR)
+            sched->current = sched->interval * SCHEDULER_ADAPTIVE_MAX_FACTOR;
+    } else if (load < SCHEDULER_ADAPTIVE_LOW_LOAD && sched->current > sched->interval) {
+        /* host is quiet again, speed up towards the configured interval */
+        if (++sched->quiet_ticks >= SCHEDULER_ADAPTIVE_QUIET_TICKS) {
+            sched->quiet_ticks = 0;
+            sched->current /= 2;
+            if (sched->current < sched->interval)
+                sched->current = sched->interval;
+        }
+    } else
+        sched->quiet_ticks = 0;
+}
+
+int scheduler_advance(scheduler_data *sched)
+{
+    unsigned long long now = time_monotonic_us();
+
+    /* keep deadlines on the grid, so collection time does not drift ticks */
+    sched->deadline += sched->current;
+
+    int overrun = sched->deadline <= now;
+    if (overrun) {
+        ++sched->overruns;
+        sched->deadline = now + sched->current;
+    }
+    return overrun;
+}
+
+void scheduler_tick_end(scheduler_data *sched)
+{
+    unsigned long long now = time_monotonic_us();
+    sched->duration = now - sched->tick_begin;
+    ++sched->ticks;
+
+    if (sched->adaptive)
+        scheduler_adapt(sched);
+
+    int overrun = scheduler_advance(sched);
+
+    virt_trace_tick(sched->tick_begin, sched->duration, sched->jitter, sched->current, overrun);
+}
+
+int scheduler_parse_interval(const char *str, double *interval)
+{
+    if (!str)
+        return -1;
+
+    char *end = NULL;
+    double value = strtod(str, &end);
+    /* the interval ends up in integer microseconds, which must not overflow */
+    if (end == str || *end != '\0' || !isfinite(value) ||
+        value < SCHEDULER_MIN_INTERVAL || value > SCHEDULER_MAX_INTERVAL)
+        return -1;
+
+    *interval = value;
+    return 0;
+}
@@ -0,0 +1,109 @@
+/* This file contains the refresh scheduler driven by the monotonic clock
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file scheduler.h
+ * This file contains the refresh scheduler driven by the monotonic clock.
+ * Ticks are placed on fixed deadlines (previous deadline + interval), so the
+ * time spent collecting data does not make the refresh rate drift.
+ */
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+/** Shortest accepted refresh interval in seconds */
+#define SCHEDULER_MIN_INTERVAL (0.01)
+/** Longest accepted refresh interval in seconds, one day */
+#define SCHEDULER_MAX_INTERVAL (86400.0)
+/** Adaptive mode backs off when collection takes more than this fraction of the interval */
+#define SCHEDULER_ADAPTIVE_HIGH_LOAD (0.5)
+/** Adaptive mode speeds up when collection takes less than this fraction of the interval */
+#define SCHEDULER_ADAPTIVE_LOW_LOAD (0.1)
+/** Number of consecutive quiet ticks before adaptive mode speeds up */
+#define SCHEDULER_ADAPTIVE_QUIET_TICKS (5)
+/** Adaptive mode never stretches the interval above configured interval times this factor */
+#define SCHEDULER_ADAPTIVE_MAX_FACTOR (16)
+
+/** Refresh schedule of the main loop, all times are in microseconds. */
+typedef struct {
+    unsigned long long  interval;       /** Configured refresh interval */
+    unsigned long long  current;        /** Interval in use, stretched by adaptive mode */
+    unsigned long long  deadline;       /** Monotonic time of the next tick */
+    unsigned long long  tick_begin;     /** Start of the tick in progress */
+    long long           jitter;         /** Lateness of the last tick relative to its deadline */
+    unsigned long long  duration;       /** Time the last tick took */
+    unsigned long long  ticks;          /** Number of ticks so far */
+    unsigned long long  overruns;       /** Number of ticks that missed the following deadline */
+    int                 adaptive;       /** Non zero if interval adapts to collection time */
+    int                 quiet_ticks;    /** Consecutive ticks below SCHEDULER_ADAPTIVE_LOW_LOAD */
+} scheduler_data;
+
+/**
+ * Set the scheduler up, the first tick is due immediately.
+ * @param sched    - scheduler to be initialized
+ * @param interval - refresh interval in seconds
+ * @param adaptive - non zero to enable adaptive mode
+ */
+void scheduler_init(scheduler_data *sched, double interval, int adaptive);
+
+/**
+ * Check whether the next tick is due.
+ * @param sched - scheduler
+ * @return TRUE (1) if the deadline has passed, FALSE (0) otherwise
+ */
+int scheduler_due(const scheduler_data *sched);
+
+/**
+ * Return time left until the next deadline.
+ * @param sched - scheduler
+ * @return milliseconds until the next tick, rounded up, 0 if already due
+ */
+int scheduler_timeout(const scheduler_data *sched);
+
+/**
+ * Mark the beginning of a tick and measure how late it started.
+ * @param sched - scheduler
+ * @see scheduler_tick_end
+ */
+void scheduler_tick_begin(scheduler_data *sched);
+
+/**
+ * Move the deadline forward by one interval without measuring the tick,
+ * used by schedules that are not traced, e.g. the fast lane.
+ * Deadlines already missed are skipped and counted as overrun.
+ * @param sched - scheduler
+ * @return TRUE (1) if deadlines were skipped, FALSE (0) otherwise
+ */
+int scheduler_advance(scheduler_data *sched);
+
+/**
+ * Mark the end of a tick, adapt the interval and move the deadline forward.
+ * Deadlines missed while the tick was running are skipped and counted as overrun.
+ * @param sched - scheduler
+ * @see scheduler_tick_begin
+ */
+void scheduler_tick_end(scheduler_data *sched);
+
+/**
+ * Parse refresh interval given in seconds.
+ * @param str      - string with the interval, e.g. "0.25"
+ * @param interval - filled with the parsed interval
+ * @return 0 on success, -1 if str is not a valid interval, or it is not finite
+ *         or outside of SCHEDULER_MIN_INTERVAL and SCHEDULER_MAX_INTERVAL
+ */
+int scheduler_parse_interval(const char *str, double *interval);
+
+#endif /* SCHEDULER_H */
@@ -19,8 +19,14 @@
  */
 #include "tui.h"
 #include "virt.h"
+#include "tui_lane.h"
+#include "tui_errors.h"
+#include "tui_numa.h"
+#include "tui_detail.h"
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
 
 const char *tui_command_panel_keys[TUI_COMMAND_PANEL_SIZE] = {
     "F1", "F2", "F3", "F4", "F5", "F6", "F7", "F8", "F9", "F10"
@@ -40,6 +46,11 @@ const char *tui_command_panel_text[TUI_COMMAND_PANEL_SIZE] = {
 };
 
 tui_help_keys_pair tui_help_keys[TUI_HELP_KEYS_SIZE] = {
+    {"          1:", " Domain list"},
+    {"          2:", " vCPUs of the selected domain, again for vCPUs of all active domains"},
+    {"          3:", " Storage pools and volumes"},
+    {"          4:", " Virtual networks, DHCP leases and vNICs"},
+    {"          5:", " Domain jobs, migration progress and ETA"},
     {"Arrows j  k:", " Scroll list"},
     {"      F1  ?:", " Show this help screen"},
     {"      F5  a:", " Toggle autostart option"},
@@ -47,6 +58,19 @@ tui_help_keys_pair tui_help_keys[TUI_HELP_KEYS_SIZE] = {
     {"      F7  p:", " Suspend"},
     {"      F8  r:", " Reboot"},
     {"      F9  d:", " Destroy"},
+    {"          f:", " Toggle fast lane sampling of the selected domain"},
+    {"          F:", " Pin, unpin the selected domain in the fast lane"},
+    {"          e:", " Show, hide the recent libvirt errors in place of the fast lane"},
+    {"          n:", " Show, hide the free memory of the NUMA cells in place of the fast lane"},
+    {"          i:", " Show, hide the disks and network interfaces of the selected domain in place of the fast lane"},
+    {"          m:", " Show, hide the guest memory columns: swap and fault rates, unused, available, usable"},
+    {"          c:", " Show, hide the perf columns: IPC, cache misses, L3 occupancy, memory bandwidth"},
+    {"          E:", " Enable, disable the perf events of the selected domain"},
+    {"          P:", " Edit the vCPU, emulator and iothread pinning of the selected domain"},
+    {"          b:", " Limit the bandwidth of the selected block job"},
+    {"          D:", " Measure the dirty page rate of the selected domain"},
+    {"          R:", " Measure the dirty page rate of all running domains, a few at a time"},
+    {"          o:", " Sort domains by dirty rate, by predicted migration time, or as listed"},
     {"      F10 q:", " Quit"}
 };
 
@@ -58,12 +82,15 @@ void tui_init_global()
     noecho();               /* no user input echoing */
     curs_set(0);            /* hide cursor */
     keypad(stdscr, TRUE);   /* allow special key input */
+    timeout(TUI_INPUT_DELAY); /* never block in getch, the main loop sleeps in poll */
 
     /* color pairs init */
     init_pair(TUI_COLOR_COMMAND_PANEL_KEY, COLOR_WHITE, COLOR_BLACK);
     init_pair(TUI_COLOR_COMMAND_PANEL_TEXT, COLOR_BLACK, COLOR_CYAN);
     init_pair(TUI_COLOR_COLUMN_HEADER_TEXT, COLOR_BLACK, COLOR_GREEN);
     init_pair(TUI_COLOR_HELP_KEY, COLOR_CYAN, COLOR_BLACK);
+    init_pair(TUI_COLOR_METER_USER, COLOR_GREEN, COLOR_BLACK);
+    init_pair(TUI_COLOR_METER_KERNEL, COLOR_RED, COLOR_BLACK);
 }
 
 void tui_init_all(tui_data *tui)
@@ -79,6 +106,30 @@ void tui_init_domain(tui_data *tui)
     tui_init_all_domain_columns(tui->domain_data);
 }
 
+void tui_init_vcpu(tui_data *tui)
+{
+    tui->vcpu_data      = malloc(sizeof(tui_vcpu_data));
+    tui_init_vcpu_columns(tui->vcpu_data);
+}
+
+void tui_init_storage(tui_data *tui)
+{
+    tui->storage_data   = malloc(sizeof(tui_storage_data));
+    tui_init_storage_columns(tui->storage_data);
+}
+
+void tui_init_network(tui_data *tui)
+{
+    tui->network_data   = malloc(sizeof(tui_network_data));
+    tui_init_network_columns(tui->network_data);
+}
+
+void tui_init_jobs(tui_data *tui)
+{
+    tui->jobs_data   = malloc(sizeof(tui_jobs_data));
+    tui_init_jobs_columns(tui->jobs_data);
+}
+
 void tui_init_node(tui_data *tui)
 {
     tui->node_data      = malloc(sizeof(tui_node_data));
@@ -104,6 +155,30 @@ void tui_deinit_domain(tui_data *tui)
     free(tui->domain_data);
 }
 
+void tui_deinit_vcpu(tui_data *tui)
+{
+    tui_deinit_vcpu_columns(tui->vcpu_data);
+    free(tui->vcpu_data);
+}
+
+void tui_deinit_storage(tui_data *tui)
+{
+    tui_deinit_storage_columns(tui->storage_data);
+    free(tui->storage_data);
+}
+
+void tui_deinit_network(tui_data *tui)
+{
+    tui_deinit_network_columns(tui->network_data);
+    free(tui->network_data);
+}
+
+void tui_deinit_jobs(tui_data *tui)
+{
+    tui_deinit_jobs_columns(tui->jobs_data);
+    free(tui->jobs_data);
+}
+
 void tui_reset_all(tui_data *tui)
 {
     tui_deinit_all(tui);
@@ -116,6 +191,30 @@ void tui_reset_domain(tui_data *tui)
     tui_init_domain(tui);
 }
 
+void tui_reset_vcpu(tui_data *tui)
+{
+    tui_deinit_vcpu(tui);
+    tui_init_vcpu(tui);
+}
+
+void tui_reset_storage(tui_data *tui)
+{
+    tui_deinit_storage(tui);
+    tui_init_storage(tui);
+}
+
+void tui_reset_network(tui_data *tui)
+{
+    tui_deinit_network(tui);
+    tui_init_network(tui);
+}
+
+void tui_reset_jobs(tui_data *tui)
+{
+    tui_deinit_jobs(tui);
+    tui_init_jobs(tui);
+}
+
 void tui_reset_node(tui_data *tui)
 {
     tui_deinit_node(tui);
@@ -127,6 +226,26 @@ void tui_create_domain_wrapper(tui_data *tui, virt_data *virt)
     tui_create_domain(tui->domain_data, virt);
 }
 
+void tui_create_vcpu_wrapper(tui_data *tui, virt_data *virt)
+{
+    tui_create_vcpu(tui->vcpu_data, virt);
+}
+
+void tui_create_storage_wrapper(tui_data *tui, virt_data *virt)
+{
+    tui_create_storage(tui->storage_data, virt);
+}
+
+void tui_create_network_wrapper(tui_data *tui, virt_data *virt)
+{
+    tui_create_network(tui->network_data, virt);
+}
+
+void tui_create_jobs_wrapper(tui_data *tui, virt_data *virt)
+{
+    tui_create_jobs(tui->jobs_data, virt);
+}
+
 void tui_draw_command_panel()
 {
     /* get current terminal size */
@@ -172,6 +291,14 @@ void tui_draw_domains(tui_data *tui)
     tui_draw_command_panel();
 }
 
+void tui_draw_vcpus(tui_data *tui)
+{
+    tui_draw_node_panel(tui->node_data);
+    tui_draw_vcpu_column_header();
+    tui_draw_vcpu_columns(tui->vcpu_data);
+    tui_draw_command_panel();
+}
+
 void tui_draw_help()
 {
     timeout(-1); /* make input blocking */
@@ -197,7 +324,32 @@ void tui_draw_help()
 
     getch();
     clear();
-    timeout(TUI_INPUT_DELAY); /* make input non-blocking with expected timeout */
+    timeout(TUI_INPUT_DELAY); /* make input non-blocking again */
+}
+
+void tui_draw_pane(tui_pane pane, virt_data *virt, int row)
+{
+    switch (pane) {
+        case TUI_PANE_LANE:
+            tui_draw_lane(virt->lane);
+            break;
+        case TUI_PANE_ERRORS:
+            tui_draw_errors();
+            break;
+        case TUI_PANE_NUMA:
+            tui_draw_numa(virt->node);
+            break;
+        case TUI_PANE_DETAIL:
+            tui_draw_detail(virt, row);
+            break;
+    }
+}
+
+void tui_resize()
+{
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0)
+        resizeterm(size.ws_row, size.ws_col);
 }
 
 void tui_menu_driver_domain(tui_data *tui, int type)
@@ -219,34 +371,239 @@ void tui_menu_set_index_domain(tui_data *tui, int index)
                                 tui->domain_data->domain_column[i]->items[index]);
 }
 
+void tui_draw_storage(tui_data *tui)
+{
+    tui_draw_node_panel(tui->node_data);
+    tui_draw_storage_column_header();
+    tui_draw_storage_columns(tui->storage_data);
+    tui_draw_command_panel();
+}
+
+void tui_draw_network(tui_data *tui)
+{
+    tui_draw_node_panel(tui->node_data);
+    tui_draw_network_column_header();
+    tui_draw_network_columns(tui->network_data);
+    tui_draw_command_panel();
+}
+
+void tui_draw_jobs(tui_data *tui)
+{
+    tui_draw_node_panel(tui->node_data);
+    tui_draw_jobs_column_header();
+    tui_draw_jobs_columns(tui->jobs_data);
+    tui_draw_command_panel();
+}
+
+void tui_plan_domain(tui_data *tui, virt_data *virt)
+{
+    tui_plan_domain_columns(tui->domain_data, virt->plan);
+}
+
+void tui_refresh_domain(tui_data *tui)
+{
+    if (tui->domain_data->domain_columns_win)
+        wrefresh(tui->domain_data->domain_columns_win);
+}
+
+void tui_menu_driver_vcpu(tui_data *tui, int type)
+{
+    for (int i = 0; i != TUI_VCPU_COLUMN_SIZE; ++i)
+        menu_driver(tui->vcpu_data->vcpu_column[i], type);
+}
+
+int tui_menu_index_vcpu(tui_data *tui)
+{
+    return item_index(current_item(tui->vcpu_data->vcpu_column[0]));
+}
+
+void tui_menu_set_index_vcpu(tui_data *tui, int index)
+{
+    /* the list may have become shorter since the index was taken */
+    if (index >= 0 && index < (int)tui->vcpu_data->vcpu_size - 1)
+        for (int i = 0; i != TUI_VCPU_COLUMN_SIZE; ++i)
+            set_current_item(   tui->vcpu_data->vcpu_column[i],
+                                tui->vcpu_data->vcpu_column[i]->items[index]);
+}
+
+void tui_plan_vcpu(tui_data *tui, virt_data *virt)
+{
+    tui_plan_vcpu_columns(tui->vcpu_data, virt);
+}
+
+void tui_refresh_vcpu(tui_data *tui)
+{
+    if (tui->vcpu_data->vcpu_columns_win)
+        wrefresh(tui->vcpu_data->vcpu_columns_win);
+}
+
+void tui_menu_driver_storage(tui_data *tui, int type)
+{
+    for (int i = 0; i != TUI_STORAGE_COLUMN_SIZE; ++i)
+        menu_driver(tui->storage_data->storage_column[i], type);
+}
+
+void tui_menu_driver_network(tui_data *tui, int type)
+{
+    for (int i = 0; i != TUI_NETWORK_COLUMN_SIZE; ++i)
+        menu_driver(tui->network_data->network_column[i], type);
+}
+
+void tui_menu_driver_jobs(tui_data *tui, int type)
+{
+    for (int i = 0; i != TUI_JOBS_COLUMN_SIZE; ++i)
+        menu_driver(tui->jobs_data->jobs_column[i], type);
+}
+
+int tui_menu_index_storage(tui_data *tui)
+{
+    return item_index(current_item(tui->storage_data->storage_column[0]));
+}
+
+int tui_menu_index_network(tui_data *tui)
+{
+    return item_index(current_item(tui->network_data->network_column[0]));
+}
+
+int tui_menu_index_jobs(tui_data *tui)
+{
+    return item_index(current_item(tui->jobs_data->jobs_column[0]));
+}
+
+void tui_menu_set_index_storage(tui_data *tui, int index)
+{
+    /* the list may have become shorter since the index was taken */
+    if (index >= 0 && index < (int)tui->storage_data->storage_size - 1)
+        for (int i = 0; i != TUI_STORAGE_COLUMN_SIZE; ++i)
+            set_current_item(   tui->storage_data->storage_column[i],
+                                tui->storage_data->storage_column[i]->items[index]);
+}
+
+void tui_menu_set_index_network(tui_data *tui, int index)
+{
+    /* the list may have become shorter since the index was taken */
+    if (index >= 0 && index < (int)tui->network_data->network_size - 1)
+        for (int i = 0; i != TUI_NETWORK_COLUMN_SIZE; ++i)
+            set_current_item(   tui->network_data->network_column[i],
+                                tui->network_data->network_column[i]->items[index]);
+}
+
+void tui_menu_set_index_jobs(tui_data *tui, int index)
+{
+    /* the list may have become shorter since the index was taken */
+    if (index >= 0 && index < (int)tui->jobs_data->jobs_size - 1)
+        for (int i = 0; i != TUI_JOBS_COLUMN_SIZE; ++i)
+            set_current_item(   tui->jobs_data->jobs_column[i],
+                                tui->jobs_data->jobs_column[i]->items[index]);
+}
+
+void tui_plan_storage(tui_data *tui, virt_data *virt)
+{
+}
+
+void tui_refresh_storage(tui_data *tui)
+{
+    if (tui->storage_data->storage_columns_win)
+        wrefresh(tui->storage_data->storage_columns_win);
+}
+
+void tui_plan_network(tui_data *tui, virt_data *virt)
+{
+}
+
+void tui_plan_jobs(tui_data *tui, virt_data *virt)
+{
+    tui_plan_jobs_columns(tui->jobs_data, virt);
+}
+
+void tui_refresh_network(tui_data *tui)
+{
+    if (tui->network_data->network_columns_win)
+        wrefresh(tui->network_data->network_columns_win);
+}
+
+void tui_refresh_jobs(tui_data *tui)
+{
+    if (tui->jobs_data->jobs_columns_win)
+        wrefresh(tui->jobs_data->jobs_columns_win);
+}
+
 tui_init_function tui_init[TUI_INIT_FUNCTION_SIZE] = {
     tui_init_domain,
+    tui_init_vcpu,
+    tui_init_storage,
+    tui_init_network,
+    tui_init_jobs
 };
 
 tui_deinit_function tui_deinit[TUI_DEINIT_FUNCTION_SIZE] = {
     tui_deinit_domain,
+    tui_deinit_vcpu,
+    tui_deinit_storage,
+    tui_deinit_network,
+    tui_deinit_jobs
 };
 
 tui_reset_function tui_reset[TUI_RESET_FUNCTION_SIZE] = {
     tui_reset_domain,
+    tui_reset_vcpu,
+    tui_reset_storage,
+    tui_reset_network,
+    tui_reset_jobs
 };
 
 tui_create_function tui_create[TUI_CREATE_FUNCTION_SIZE] = {
-    tui_create_domain_wrapper
+    tui_create_domain_wrapper,
+    tui_create_vcpu_wrapper,
+    tui_create_storage_wrapper,
+    tui_create_network_wrapper,
+    tui_create_jobs_wrapper
 };
 
 tui_draw_function tui_draw[TUI_DRAW_FUNCTION_SIZE] = {
-    tui_draw_domains
+    tui_draw_domains,
+    tui_draw_vcpus,
+    tui_draw_storage,
+    tui_draw_network,
+    tui_draw_jobs
 };
 
 tui_menu_driver_function tui_menu_driver[TUI_MENU_DRIVER_FUNCTION_SIZE] = {
-    tui_menu_driver_domain
+    tui_menu_driver_domain,
+    tui_menu_driver_vcpu,
+    tui_menu_driver_storage,
+    tui_menu_driver_network,
+    tui_menu_driver_jobs
 };
 
 tui_menu_index_function tui_menu_index[TUI_MENU_INDEX_FUNCTION_SIZE] = {
-    tui_menu_index_domain
+    tui_menu_index_domain,
+    tui_menu_index_vcpu,
+    tui_menu_index_storage,
+    tui_menu_index_network,
+    tui_menu_index_jobs
 };
 
 tui_menu_set_index_function tui_menu_set_index[TUI_MENU_SET_INDEX_FUNCTION_SIZE] = {
-    tui_menu_set_index_domain
+    tui_menu_set_index_domain,
+    tui_menu_set_index_vcpu,
+    tui_menu_set_index_storage,
+    tui_menu_set_index_network,
+    tui_menu_set_index_jobs
+};
+
+tui_plan_function tui_plan[TUI_PLAN_FUNCTION_SIZE] = {
+    tui_plan_domain,
+    tui_plan_vcpu,
+    tui_plan_storage,
+    tui_plan_network,
+    tui_plan_jobs
+};
+
+tui_refresh_function tui_refresh[TUI_REFRESH_FUNCTION_SIZE] = {
+    tui_refresh_domain,
+    tui_refresh_vcpu,
+    tui_refresh_storage,
+    tui_refresh_network,
+    tui_refresh_jobs
 };
@@ -27,32 +27,40 @@
 #include "virt_domain.h"
 #include "tui_node.h"
 #include "tui_domain.h"
-/** Input delay between keystrokes in milliseconds */
-#define TUI_INPUT_DELAY (50)
-/** Time between screen refresh in seconds */
+#include "tui_vcpu.h"
+#include "tui_storage.h"
+#include "tui_network.h"
+#include "tui_jobs.h"
+/** Input delay in milliseconds, input is read only after poll() reported it */
+#define TUI_INPUT_DELAY (0)
+/** Default time between screen refresh in seconds */
 #define TUI_REFRESH_TIME (1.0)
 /** Number of defined color pairs */
-#define COLORS_SIZE (4)
+#define COLORS_SIZE (6)
 /** Command panel's number of elements */
 #define TUI_COMMAND_PANEL_SIZE (10)
 /** Size of array containing pairs (key, desc) used in printing helpful information */
-#define TUI_HELP_KEYS_SIZE (8)
+#define TUI_HELP_KEYS_SIZE (26)
 /** Size of array containing function pointers to tui init functions */
-#define TUI_INIT_FUNCTION_SIZE (1)
+#define TUI_INIT_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to tui deinit functions */
-#define TUI_DEINIT_FUNCTION_SIZE (1)
+#define TUI_DEINIT_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to tui reset functions */
-#define TUI_RESET_FUNCTION_SIZE (1)
+#define TUI_RESET_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to tui create functions */
-#define TUI_CREATE_FUNCTION_SIZE (1)
+#define TUI_CREATE_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to tui draw functions */
-#define TUI_DRAW_FUNCTION_SIZE (1)
+#define TUI_DRAW_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to tui menu driver functions */
-#define TUI_MENU_DRIVER_FUNCTION_SIZE (1)
+#define TUI_MENU_DRIVER_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to tui menu index functions */
-#define TUI_MENU_INDEX_FUNCTION_SIZE (1)
+#define TUI_MENU_INDEX_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to tui menu set index functions */
-#define TUI_MENU_SET_INDEX_FUNCTION_SIZE (1)
+#define TUI_MENU_SET_INDEX_FUNCTION_SIZE (5)
+/** Size of array containing function pointers to tui plan functions */
+#define TUI_PLAN_FUNCTION_SIZE (5)
+/** Size of array containing function pointers to tui refresh functions */
+#define TUI_REFRESH_FUNCTION_SIZE (5)
 
 /** Represents F(N) keys used for calling command panel's buttons */
 typedef enum {
@@ -71,6 +79,10 @@ typedef enum {
 /** Represents keys used for manipulating TUI */
 typedef enum {
     TUI_KEY_MODE_ONE          = '1',
+    TUI_KEY_MODE_TWO          = '2',
+    TUI_KEY_MODE_THREE        = '3',
+    TUI_KEY_MODE_FOUR         = '4',
+    TUI_KEY_MODE_FIVE         = '5',
     TUI_KEY_LIST_DOWN         = 'j',
     TUI_KEY_LIST_UP           = 'k',
     TUI_KEY_COMMAND_HELP      = '?',
@@ -79,6 +91,19 @@ typedef enum {
     TUI_KEY_COMMAND_PAUSE     = 'p',
     TUI_KEY_COMMAND_REBOOT    = 'r',
     TUI_KEY_COMMAND_DESTROY   = 'd',
+    TUI_KEY_FAST_LANE         = 'f',
+    TUI_KEY_FAST_LANE_PIN     = 'F',
+    TUI_KEY_ERRORS            = 'e',
+    TUI_KEY_NUMA              = 'n',
+    TUI_KEY_DETAIL            = 'i',
+    TUI_KEY_MEMORY            = 'm',
+    TUI_KEY_PIN               = 'P',
+    TUI_KEY_BANDWIDTH         = 'b',
+    TUI_KEY_DIRTY             = 'D',
+    TUI_KEY_DIRTY_ALL         = 'R',
+    TUI_KEY_SORT              = 'o',
+    TUI_KEY_PERF              = 'c',
+    TUI_KEY_PERF_EVENTS       = 'E',
     TUI_KEY_QUIT              = 'q'
 } tui_keyboard_key_enum;
 
@@ -87,7 +112,9 @@ typedef enum {
     TUI_COLOR_COMMAND_PANEL_KEY = 1,    /** Command panel keys coloring */
     TUI_COLOR_COMMAND_PANEL_TEXT,       /** Command panel desc coloring */
     TUI_COLOR_COLUMN_HEADER_TEXT,       /** Column header text color */
-    TUI_COLOR_HELP_KEY                  /** Helpful information coloring */
+    TUI_COLOR_HELP_KEY,                 /** Helpful information coloring */
+    TUI_COLOR_METER_USER,               /** User time of the CPU meters */
+    TUI_COLOR_METER_KERNEL              /** Kernel time of the CPU meters */
 } tui_color_enum;
 
 /**
@@ -122,11 +149,23 @@ void tui_init_global();
 typedef struct tui_node_data tui_node_data;
 /** Forward declaration of tui_domain_data */
 typedef struct tui_domain_data tui_domain_data;
+/** Forward declaration of tui_vcpu_data */
+typedef struct tui_vcpu_data tui_vcpu_data;
+/** Forward declaration of tui_storage_data */
+typedef struct tui_storage_data tui_storage_data;
+/** Forward declaration of tui_network_data */
+typedef struct tui_network_data tui_network_data;
+/** Forward declaration of tui_jobs_data */
+typedef struct tui_jobs_data tui_jobs_data;
 
 /** Represents domain columns */
 typedef struct tui_data {
     tui_node_data   *node_data;
     tui_domain_data *domain_data;
+    tui_vcpu_data   *vcpu_data;
+    tui_storage_data *storage_data;
+    tui_network_data *network_data;
+    tui_jobs_data   *jobs_data;
 } tui_data;
 
 /**
@@ -141,6 +180,30 @@ void tui_init_all(tui_data *tui);
  */
 void tui_init_domain(tui_data *tui);
 
+/**
+ * Set tui vCPU object to default state.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_init_vcpu(tui_data *tui);
+
+/**
+ * Set tui storage object to default state.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_init_storage(tui_data *tui);
+
+/**
+ * Set tui network object to default state.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_init_network(tui_data *tui);
+
+/**
+ * Set tui job object to default state.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_init_jobs(tui_data *tui);
+
 /**
  * Set tui node object to default state.
  * @param tui - pointer to the tui_domain_data that draws on the screen
@@ -159,6 +222,30 @@ void tui_deinit_all(tui_data *tui);
  */
 void tui_deinit_domain(tui_data *tui);
 
+/**
+ * Deinitialize the tui vCPU object.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_deinit_vcpu(tui_data *tui);
+
+/**
+ * Deinitialize the tui storage object.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_deinit_storage(tui_data *tui);
+
+/**
+ * Deinitialize the tui network object.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_deinit_network(tui_data *tui);
+
+/**
+ * Deinitialize the tui job object.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_deinit_jobs(tui_data *tui);
+
 /**
  * Deinitialize the tui node object.
  * @param tui - pointer to the tui_data that draws on the screen
@@ -181,6 +268,38 @@ void tui_reset_all(tui_data *tui);
  */
 void tui_reset_domain(tui_data *tui);
 
+/**
+ * Deinitialize and set tui vCPU object to default state.
+ * @see tui_init_all
+ * @see tui_deinit_all
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_reset_vcpu(tui_data *tui);
+
+/**
+ * Deinitialize and set tui storage object to default state.
+ * @see tui_init_all
+ * @see tui_deinit_all
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_reset_storage(tui_data *tui);
+
+/**
+ * Deinitialize and set tui network object to default state.
+ * @see tui_init_all
+ * @see tui_deinit_all
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_reset_network(tui_data *tui);
+
+/**
+ * Deinitialize and set tui job object to default state.
+ * @see tui_init_all
+ * @see tui_deinit_all
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_reset_jobs(tui_data *tui);
+
 /**
  * Deinitialize and set tui node object to default state.
  * @see tui_init_all
@@ -197,6 +316,38 @@ void tui_reset_node(tui_data *tui);
  */
 void tui_create_domain_wrapper(tui_data *tui, virt_data *virt);
 
+/*
+ * Call tui_create_vcpu with tui->vcpu_data
+ * @param tui  - pointer to the tui_data that draws on the screen
+ * @param virt - virt vCPU data pointer
+ * @see tui_create_vcpu
+ */
+void tui_create_vcpu_wrapper(tui_data *tui, virt_data *virt);
+
+/*
+ * Call tui_create_storage with tui->storage_data
+ * @param tui  - pointer to the tui_data that draws on the screen
+ * @param virt - virt storage data pointer
+ * @see tui_create_storage
+ */
+void tui_create_storage_wrapper(tui_data *tui, virt_data *virt);
+
+/*
+ * Call tui_create_network with tui->network_data
+ * @param tui  - pointer to the tui_data that draws on the screen
+ * @param virt - virt network data pointer
+ * @see tui_create_network
+ */
+void tui_create_network_wrapper(tui_data *tui, virt_data *virt);
+
+/*
+ * Call tui_create_jobs with tui->jobs_data
+ * @param tui  - pointer to the tui_data that draws on the screen
+ * @param virt - virt jobs data pointer
+ * @see tui_create_jobs
+ */
+void tui_create_jobs_wrapper(tui_data *tui, virt_data *virt);
+
 /**
  * Draw command panel at the bottom of the screen.
  */
@@ -213,11 +364,57 @@ void tui_draw_all(tui_data *tui);
  */
 void tui_draw_domains(tui_data *tui);
 
+/**
+ * Draw the vCPU screen, header, vCPU list and command panel.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_draw_vcpus(tui_data *tui);
+
+/**
+ * Draw the storage screen, header, pool and volume list and command panel.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_draw_storage(tui_data *tui);
+
+/**
+ * Draw the network screen, header, network list and command panel.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_draw_network(tui_data *tui);
+
+/**
+ * Draw the job screen, header, job list and command panel.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_draw_jobs(tui_data *tui);
+
 /**
  * Draw the help screen
  */
 void tui_draw_help();
 
+/** Panes drawn in the right part of the header, one at a time */
+typedef enum {
+    TUI_PANE_LANE,      /** Fast lane sparklines */
+    TUI_PANE_ERRORS,    /** Recent libvirt errors */
+    TUI_PANE_NUMA,      /** Free memory of the host NUMA cells */
+    TUI_PANE_DETAIL     /** Devices of the selected domain */
+} tui_pane_enum;
+typedef tui_pane_enum tui_pane;
+
+/**
+ * Draw the pane in the right part of the header.
+ * @param pane - pane to draw
+ * @param virt - virt data with the lane samples and the node cache
+ * @param row  - row of the domain records selected, -1 if none
+ */
+void tui_draw_pane(tui_pane pane, virt_data *virt, int row);
+
+/**
+ * Resize the screen to the current terminal size, after SIGWINCH.
+ */
+void tui_resize();
+
 /**
  * Run request on domain menu.
  * @param tui   - pointer to the tui_data that draws on the screen
@@ -239,9 +436,165 @@ int tui_menu_index_domain(tui_data *tui);
  */
 void tui_menu_set_index_domain(tui_data *tui, int index);
 
+/**
+ * Fill the fetch plan from the visible domain columns and rows.
+ * @param tui  - pointer to the tui_data that draws on the screen
+ * @param virt - virt data pointer, its plan is updated
+ * @see tui_plan_domain_columns
+ */
+void tui_plan_domain(tui_data *tui, virt_data *virt);
+
+/**
+ * Copy the domain columns window to the screen.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_refresh_domain(tui_data *tui);
+
+/**
+ * Run request on vCPU menu.
+ * @param tui   - pointer to the tui_data that draws on the screen
+ * @param type  - ncurses menu library REQ type
+ */
+void tui_menu_driver_vcpu(tui_data *tui, int type);
+
+/**
+ * Return current index of vcpu_column
+ * @param tui - pointer to the tui_data that draws on the screen
+ * @return current vCPU row
+ */
+int tui_menu_index_vcpu(tui_data *tui);
+
+/**
+ * Set current index for each vCPU column
+ * @param tui   - pointer to the tui_data that draws on the screen
+ * @param index - current vCPU row
+ */
+void tui_menu_set_index_vcpu(tui_data *tui, int index);
+
+/**
+ * Fill the fetch plan from the visible vCPU columns and rows.
+ * @param tui  - pointer to the tui_data that draws on the screen
+ * @param virt - virt data pointer, its plan is updated
+ * @see tui_plan_vcpu_columns
+ */
+void tui_plan_vcpu(tui_data *tui, virt_data *virt);
+
+/**
+ * Copy the vCPU columns window to the screen.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_refresh_vcpu(tui_data *tui);
+
+/**
+ * Run request on storage menu.
+ * @param tui   - pointer to the tui_data that draws on the screen
+ * @param type  - ncurses menu library REQ type
+ */
+void tui_menu_driver_storage(tui_data *tui, int type);
+
+/**
+ * Run request on network menu.
+ * @param tui   - pointer to the tui_data that draws on the screen
+ * @param type  - ncurses menu library REQ type
+ */
+void tui_menu_driver_network(tui_data *tui, int type);
+
+/**
+ * Run request on job menu.
+ * @param tui   - pointer to the tui_data that draws on the screen
+ * @param type  - ncurses menu library REQ type
+ */
+void tui_menu_driver_jobs(tui_data *tui, int type);
+
+/**
+ * Return current index of storage_column
+ * @param tui - pointer to the tui_data that draws on the screen
+ * @return current storage row
+ */
+int tui_menu_index_storage(tui_data *tui);
+
+/**
+ * Return current index of network_column
+ * @param tui - pointer to the tui_data that draws on the screen
+ * @return current network row
+ */
+int tui_menu_index_network(tui_data *tui);
+
+/**
+ * Return current index of jobs_column
+ * @param tui - pointer to the tui_data that draws on the screen
+ * @return current job row
+ */
+int tui_menu_index_jobs(tui_data *tui);
+
+/**
+ * Set current index for each storage column
+ * @param tui   - pointer to the tui_data that draws on the screen
+ * @param index - current storage row
+ */
+void tui_menu_set_index_storage(tui_data *tui, int index);
+
+/**
+ * Set current index for each network column
+ * @param tui   - pointer to the tui_data that draws on the screen
+ * @param index - current network row
+ */
+void tui_menu_set_index_network(tui_data *tui, int index);
+
+/**
+ * Set current index for each job column
+ * @param tui   - pointer to the tui_data that draws on the screen
+ * @param index - current job row
+ */
+void tui_menu_set_index_jobs(tui_data *tui, int index);
+
+/**
+ * Storage rows collect no domain metrics, the fetch plan is left as it is.
+ * @param tui  - pointer to the tui_data that draws on the screen
+ * @param virt - virt data pointer
+ */
+void tui_plan_storage(tui_data *tui, virt_data *virt);
+
+/**
+ * Network rows collect no domain metrics, the fetch plan is left as it is.
+ * @param tui  - pointer to the tui_data that draws on the screen
+ * @param virt - virt data pointer
+ */
+void tui_plan_network(tui_data *tui, virt_data *virt);
+
+/**
+ * Fill the fetch plan for the job rows.
+ * @param tui  - pointer to the tui_data that draws on the screen
+ * @param virt - virt data pointer, its plan is updated
+ * @see tui_plan_jobs_columns
+ */
+void tui_plan_jobs(tui_data *tui, virt_data *virt);
+
+/**
+ * Copy the storage columns window to the screen.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_refresh_storage(tui_data *tui);
+
+/**
+ * Copy the network columns window to the screen.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_refresh_network(tui_data *tui);
+
+/**
+ * Copy the job columns window to the screen.
+ * @param tui - pointer to the tui_data that draws on the screen
+ */
+void tui_refresh_jobs(tui_data *tui);
+
 /** @see dui_draw */
 typedef enum {
     TUI_MODE_DOMAIN,
+    TUI_MODE_VCPU,
+    TUI_MODE_STORAGE,
+    TUI_MODE_NETWORK,
+    TUI_MODE_JOBS
 } tui_mode_enum;
 typedef tui_mode_enum tui_mode;
 
@@ -277,4 +630,12 @@ tui_menu_index_function tui_menu_index[TUI_MENU_INDEX_FUNCTION_SIZE];
 typedef void (*tui_menu_set_index_function)(tui_data *tui, int index);
 tui_menu_set_index_function tui_menu_set_index[TUI_MENU_SET_INDEX_FUNCTION_SIZE];
 
+/** tui plan functions */
+typedef void (*tui_plan_function)(tui_data *tui, virt_data *virt);
+tui_plan_function tui_plan[TUI_PLAN_FUNCTION_SIZE];
+
+/** tui refresh functions */
+typedef void (*tui_refresh_function)(tui_data *tui);
+tui_refresh_function tui_refresh[TUI_REFRESH_FUNCTION_SIZE];
+
 #endif /* TUI_H */
@@ -0,0 +1,99 @@
+/* This file contains routines to draw the domain detail pane
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tui_detail.h"
+#include "tui_domain.h"
+#include "virt_record.h"
+#include <stdio.h>
+
+/* Print the line of the pane cut to the width */
+static void tui_detail_line(int y, int x, int width, const char *buffer, int attr)
+{
+    char line[TUI_DETAIL_BUFFER_SIZE];
+    snprintf(line, sizeof(line), "%s", buffer);
+    line[width] = '\0';
+    attron(attr);
+    mvwaddstr(stdscr, y, x, line);
+    attroff(attr);
+}
+
+void tui_draw_detail(virt_data *virt, int row)
+{
+    int max_y = 0, max_x = 0;
+    getmaxyx(stdscr, max_y, max_x);
+
+    int x       = TUI_DETAIL_PANE_X;
+    int width   = max_x - x;
+    if (width < TUI_DETAIL_PANE_MIN_WIDTH || max_y < TUI_HEADER_HEIGHT)
+        return;
+    if (width > TUI_DETAIL_BUFFER_SIZE - 1)
+        width = TUI_DETAIL_BUFFER_SIZE - 1;
+
+    for (int y = 0; y != TUI_HEADER_HEIGHT - 1; ++y) {
+        move(y, x);
+        clrtoeol();
+    }
+
+    char buffer[TUI_DETAIL_BUFFER_SIZE];
+    if (row < 0 || row >= (int)virt->records->record_size) {
+        tui_detail_line(0, x, width, "Detail: no domain selected", A_BOLD);
+        return;
+    }
+
+    const virt_domain_record *record = virt->records->record + row;
+    const char *name = record->name ? record->name : VIRT_DOMAIN_UNKNOWN_DATA;
+    const virt_detail_model *model = virt_detail_get(virt, row);
+    if (!model) {
+        snprintf(buffer, sizeof(buffer), "%.64s: %s", name,
+                 record->hung_since ? "not answering, detail not known" : "detail not known");
+        tui_detail_line(0, x, width, buffer, A_BOLD);
+        return;
+    }
+
+    snprintf(buffer, sizeof(buffer), "%.64s: %d/%d vCPUs, %llu/%lluMB, %d disks, %d NICs",
+             name, model->vcpus, model->vcpus_max, model->current_memory / 1024,
+             model->memory / 1024, model->disk_size, model->nic_size);
+    tui_detail_line(0, x, width, buffer, A_BOLD);
+
+    /* the title takes the first line, the last one counts what does not fit */
+    int lines   = TUI_HEADER_HEIGHT - 2;
+    int devices = model->disk_size + model->nic_size;
+    int shown   = devices > lines ? lines - 1 : devices;
+
+    int y = 1;
+    for (int i = 0; i != shown; ++i) {
+        if (i < model->disk_size) {
+            const virt_detail_disk *disk = model->disk + i;
+            snprintf(buffer, sizeof(buffer), "%-5s %-6s %-6s %-6s %.160s",
+                     disk->target, disk->bus, disk->device, disk->format,
+                     disk->source ? disk->source : VIRT_DOMAIN_UNKNOWN_DATA);
+        } else {
+            const virt_detail_nic *nic = model->nic + i - model->disk_size;
+            snprintf(buffer, sizeof(buffer), "%-5s %-6s %-6s %s %.160s",
+                     nic->dev[0] ? nic->dev : VIRT_DOMAIN_UNKNOWN_DATA, nic->model, "nic",
+                     nic->mac, nic->source ? nic->source : VIRT_DOMAIN_UNKNOWN_DATA);
+        }
+        tui_detail_line(y++, x, width, buffer, A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+    }
+
+    if (shown != devices) {
+        snprintf(buffer, sizeof(buffer), "+%d more devices", devices - shown);
+        tui_detail_line(y, x, width, buffer, A_BOLD);
+    }
+}
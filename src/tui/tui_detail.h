@@ -0,0 +1,44 @@
+/* This file contains routines to draw the domain detail pane
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TUI_DETAIL_H
+#define TUI_DETAIL_H
+/** @file tui_detail.h 
+ * This file contains routines to draw the domain detail pane */
+#include "tui.h"
+#include "virt_detail.h"
+/** The pane takes the place of the fast lane pane */
+#define TUI_DETAIL_PANE_X (72)
+/** Narrowest pane worth drawing */
+#define TUI_DETAIL_PANE_MIN_WIDTH (40)
+/** Size of the buffer holding one line of the pane */
+#define TUI_DETAIL_BUFFER_SIZE (256)
+
+/**
+ * Draw vCPUs, memory, disks and network interfaces of the selected domain
+ * in the right part of the header, one line per device. Devices which do
+ * not fit are counted on the last line. The description of the domain is
+ * fetched only if it is not cached yet.
+ * Nothing is drawn while the screen is too narrow.
+ * @param virt - pointer with virt data
+ * @param row  - row of the domain records, -1 if no domain is selected
+ */
+void tui_draw_detail(virt_data *virt, int row);
+
+#endif /* TUI_DETAIL_H */
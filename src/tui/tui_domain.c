@@ -18,11 +18,18 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "tui_domain.h"
+#include "virt_plan.h"
 
 int tui_column_width[TUI_DOMAIN_COLUMN_SIZE] = {
-    4, 25, 12, 10, 7, 70
+    4, 25, 12, 10, 7, 7, 9, 9, 9, 9, 12, 24, 70, 9, 9, 9, 10, 11, 10, 11, 10, 13, 9, 6, 10, 8, 11, 9
 };
 
+/** Optional guest memory columns are shown, kept across refreshes */
+static int tui_domain_memory_columns = 0;
+
+/** Optional perf event columns are shown, kept across refreshes */
+static int tui_domain_perf_columns = 0;
+
 const char *tui_node_info_summary[TUI_NODE_INFO_SUMMARY_SIZE] = {
     "  domains:",
     "   active:",
@@ -38,7 +45,29 @@ const char *tui_column_header[TUI_DOMAIN_COLUMN_SIZE] = {
     "STATE",
     "AUTOSTART",
     "MEM(%)",
-    "REASON"
+    "CPU(%)",
+    "RD(KB/s)",
+    "WR(KB/s)",
+    "RX(KB/s)",
+    "TX(KB/s)",
+    "NUMA(M/C)",
+    "GUEST OS",
+    "REASON",
+    "SI(KB/s)",
+    "SO(KB/s)",
+    "MAJFLT/s",
+    "MINFLT/s",
+    "UNUSED(MB)",
+    "AVAIL(MB)",
+    "USABLE(MB)",
+    "STATS AGE",
+    "DIRTY(MiB/s)",
+    "MIGRATE",
+    "IPC",
+    "MISS(K/s)",
+    "L3(MiB)",
+    "MBM(MiB/s)",
+    "LOCAL(%)"
 };
 
 void tui_init_all_domain_columns(tui_domain_data *tui)
@@ -48,6 +77,7 @@ void tui_init_all_domain_columns(tui_domain_data *tui)
         tui->domain_data_item[i] = NULL;
         tui->domain_type[i] = i;
     }
+    tui->domain_column_size  = TUI_DOMAIN_COLUMN_SIZE - TUI_DOMAIN_MEMORY_COLUMN_SIZE - TUI_DOMAIN_PERF_COLUMN_SIZE;
     
     tui->domain_column       = NULL;
 
@@ -88,7 +118,8 @@ void tui_deinit_domain_columns(tui_domain_data *tui)
     }
     if (tui->domain_columns_win) {
         for (int i = 0; i != TUI_DOMAIN_COLUMN_SIZE; ++i) 
-            delwin(tui->domain_columns_sub_win[i]);
+            if (tui->domain_columns_sub_win[i])
+                delwin(tui->domain_columns_sub_win[i]);
         free(tui->domain_columns_sub_win);
         delwin(tui->domain_columns_win);
     }
@@ -102,18 +133,24 @@ void tui_draw_column_header(tui_data *tui)
 
     attron(COLOR_PAIR(TUI_COLOR_COLUMN_HEADER_TEXT));
 
+    int max_x = getmaxx(stdscr);
+
     /* first print n empty spaces where n is the width of i column,
      * then print i column header at (y, x) and move over the y*/
-    for (int i = 0; i != TUI_DOMAIN_COLUMN_SIZE; ++i) {
-        for (int j = 0; j != tui_column_width[tui->domain_data->domain_type[i]]; ++j)
+    for (int i = 0; i != tui->domain_data->domain_column_size && x < max_x; ++i) {
+        for (int j = 0; j != tui_column_width[tui->domain_data->domain_type[i]] && x + j < max_x; ++j)
             printw(" ");
+        /* the column the list is sorted by is underlined */
+        int sorted = (int)tui->domain_data->domain_type[i] == virt_domain_sort_type();
+        if (sorted)
+            attron(A_UNDERLINE);
         mvprintw(y, x, tui_column_header[tui->domain_data->domain_type[i]]);
+        if (sorted)
+            attroff(A_UNDERLINE);
         x += tui_column_width[tui->domain_data->domain_type[i]];
     }
 
     /* fill up the rest of the screen */
-    int max_x = 0;
-    getmaxyx(stdscr, y, max_x);
     getyx(stdscr, y, x);
     for (int i = 0; i != max_x - x; ++i)
         printw(" ");
@@ -137,15 +174,23 @@ void tui_draw_domain_columns(tui_domain_data *tui)
     int x = 0, y = 0;
     /* length between previous and next printable column */
     size_t total_column_width = 0;
-    getmaxyx(stdscr, x, y); y = 0;
-    for (int i = 0; i != TUI_DOMAIN_COLUMN_SIZE; ++i) {
+    getmaxyx(stdscr, x, y);
+    int max_width = y; y = 0;
+    for (int i = 0; i != tui->domain_column_size; ++i) {
+        /* columns past the right edge of the screen are not shown */
+        int width = tui_column_width[tui->domain_type[i]];
+        if ((int)total_column_width + width > max_width)
+            width = max_width - (int)total_column_width;
+        if (width <= 0)
+            break;
+
         set_menu_win(tui->domain_column[tui->domain_type[i]], tui->domain_columns_win);
 
         /* create subwindow that shows columns */
         tui->domain_columns_sub_win[tui->domain_type[i]] = 
             derwin( tui->domain_columns_win, 
                     x-TUI_HEADER_HEIGHT-1, 
-                    tui_column_width[tui->domain_type[i]], 
+                    width, 
                     y, 
                     total_column_width);
 
@@ -165,6 +210,38 @@ void tui_draw_domain_columns(tui_domain_data *tui)
     }
 }
 
+void tui_toggle_memory_columns()
+{
+    tui_domain_memory_columns = !tui_domain_memory_columns;
+}
+
+void tui_toggle_perf_columns()
+{
+    tui_domain_perf_columns = !tui_domain_perf_columns;
+}
+
+void tui_plan_domain_columns(tui_domain_data *tui, virt_plan_data *plan)
+{
+    int height = 0, width = 0;
+    getmaxyx(stdscr, height, width);
+
+    /* same columns as tui_draw_domain_columns, the rest is cut off by the screen edge */
+    virt_plan_clear_columns(plan);
+    int total_column_width = 0;
+    for (int i = 0; i != tui->domain_column_size && total_column_width < width; ++i) {
+        virt_plan_add_column(plan, (domain_type)tui->domain_type[i]);
+        total_column_width += tui_column_width[tui->domain_type[i]];
+    }
+
+    /* before the first screen is drawn the list starts at the top */
+    int top = 0;
+    if (tui->domain_column && tui->domain_column[0] && tui->domain_size > 1)
+        top = top_row(tui->domain_column[0]);
+    int rows = height - TUI_HEADER_HEIGHT - 1;
+
+    virt_plan_set_viewport(plan, top > 0 ? top : 0, rows > 0 ? rows : 0);
+}
+
 void tui_create_domain(tui_domain_data *tui, void *vdata)
 {
     virt_domain_data *data  = (virt_domain_data *)vdata;
@@ -180,34 +257,48 @@ void tui_create_domain(tui_domain_data *tui, void *vdata)
         tui->domain_data_item[i]    = tui_create_items(data->domain_data[i], data->domain_data[i] + tui->domain_size);
     }
 
-    /* create columns */
-    tui->domain_column[TUI_DOMAIN_COLUMN_ID]            = 
-        new_menu((ITEM **)tui->domain_data_item[tui->domain_type[VIRT_DOMAIN_DATA_TYPE_ID]]);
-    tui->domain_column[TUI_DOMAIN_COLUMN_NAME]          = 
-        new_menu((ITEM **)tui->domain_data_item[tui->domain_type[VIRT_DOMAIN_DATA_TYPE_NAME]]);
-    tui->domain_column[TUI_DOMAIN_COLUMN_STATE]         =
-        new_menu((ITEM **)tui->domain_data_item[tui->domain_type[VIRT_DOMAIN_DATA_TYPE_STATE]]);
-    tui->domain_column[TUI_DOMAIN_COLUMN_AUTOSTART]     =
-        new_menu((ITEM **)tui->domain_data_item[tui->domain_type[VIRT_DOMAIN_DATA_TYPE_AUTOSTART]]);
-    tui->domain_column[TUI_DOMAIN_COLUMN_MEMORY_PRC]    =
-        new_menu((ITEM **)tui->domain_data_item[tui->domain_type[VIRT_DOMAIN_DATA_TYPE_MEMORY_PRC]]);
-    tui->domain_column[TUI_DOMAIN_COLUMN_REASON]        =
-        new_menu((ITEM **)tui->domain_data_item[tui->domain_type[VIRT_DOMAIN_DATA_TYPE_REASON]]);
-
-    /* set up default order */
-    tui->domain_type[0] = TUI_DOMAIN_COLUMN_ID;
-    tui->domain_type[1] = TUI_DOMAIN_COLUMN_NAME;
-    tui->domain_type[2] = TUI_DOMAIN_COLUMN_STATE;
-    tui->domain_type[3] = TUI_DOMAIN_COLUMN_AUTOSTART;
-    tui->domain_type[4] = TUI_DOMAIN_COLUMN_MEMORY_PRC;
-    tui->domain_type[5] = TUI_DOMAIN_COLUMN_REASON;
+    /* create columns, column types match the virt data types */
+    for (int i = 0; i != TUI_DOMAIN_COLUMN_SIZE; ++i)
+        tui->domain_column[i] = new_menu((ITEM **)tui->domain_data_item[i]);
+
+    /* set up default order, the guest memory columns follow MEM(%) and the perf columns CPU(%) when shown */
+    int type = 0;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_ID;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_NAME;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_STATE;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_AUTOSTART;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_MEMORY_PRC;
+    if (tui_domain_memory_columns)
+        for (int i = 0; i != TUI_DOMAIN_MEMORY_COLUMN_SIZE; ++i)
+            tui->domain_type[type++] = TUI_DOMAIN_COLUMN_SWAP_IN + i;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_CPU_PRC;
+    if (tui_domain_perf_columns)
+        for (int i = 0; i != TUI_DOMAIN_PERF_COLUMN_SIZE; ++i)
+            tui->domain_type[type++] = TUI_DOMAIN_COLUMN_PERF_IPC + i;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_BLOCK_RD;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_BLOCK_WR;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_NET_RX;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_NET_TX;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_DIRTY_RATE;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_MIGRATE_TIME;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_NUMA;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_GUEST_OS;
+    tui->domain_type[type++] = TUI_DOMAIN_COLUMN_REASON;
+    tui->domain_column_size  = type;
+    /* hidden columns keep their menus, they are only not drawn */
+    if (!tui_domain_memory_columns)
+        for (int i = 0; i != TUI_DOMAIN_MEMORY_COLUMN_SIZE; ++i)
+            tui->domain_type[type++] = TUI_DOMAIN_COLUMN_SWAP_IN + i;
+    if (!tui_domain_perf_columns)
+        for (int i = 0; i != TUI_DOMAIN_PERF_COLUMN_SIZE; ++i)
+            tui->domain_type[type++] = TUI_DOMAIN_COLUMN_PERF_IPC + i;
 
     int x = 0, y = 0;
     getmaxyx(stdscr, x, y);
 
     /* create the window to be associated with the menu */
     tui->domain_columns_win = newwin(x-TUI_HEADER_HEIGHT-1, y, TUI_HEADER_HEIGHT, 0);
-    tui->domain_columns_sub_win = malloc(sizeof(WINDOW*) * TUI_DOMAIN_COLUMN_SIZE);
+    tui->domain_columns_sub_win = calloc(TUI_DOMAIN_COLUMN_SIZE, sizeof(WINDOW*));
     keypad(tui->domain_columns_win, TRUE);
 
     free(data);
@@ -23,7 +23,11 @@
  * This file contains routines to draw domain columns */
 #include "tui.h"
 /** Number of columns displayed in the middle of the screen */
-#define TUI_DOMAIN_COLUMN_SIZE (6)
+#define TUI_DOMAIN_COLUMN_SIZE (28)
+/** Number of optional guest memory columns, shown right after MEM(%) */
+#define TUI_DOMAIN_MEMORY_COLUMN_SIZE (8)
+/** Number of optional perf event columns, shown right after CPU(%) */
+#define TUI_DOMAIN_PERF_COLUMN_SIZE (5)
 /** This is used as a column item description for filling up the selection color */
 #define TUI_DOMAIN_COLUMN_SELECTOR ("                                ")
 /** Size of the upper side of the screen (header) */
@@ -41,7 +45,29 @@ typedef enum {
     TUI_DOMAIN_COLUMN_STATE,
     TUI_DOMAIN_COLUMN_AUTOSTART,
     TUI_DOMAIN_COLUMN_MEMORY_PRC,
-    TUI_DOMAIN_COLUMN_REASON
+    TUI_DOMAIN_COLUMN_CPU_PRC,
+    TUI_DOMAIN_COLUMN_BLOCK_RD,
+    TUI_DOMAIN_COLUMN_BLOCK_WR,
+    TUI_DOMAIN_COLUMN_NET_RX,
+    TUI_DOMAIN_COLUMN_NET_TX,
+    TUI_DOMAIN_COLUMN_NUMA,
+    TUI_DOMAIN_COLUMN_GUEST_OS,
+    TUI_DOMAIN_COLUMN_REASON,
+    TUI_DOMAIN_COLUMN_SWAP_IN,
+    TUI_DOMAIN_COLUMN_SWAP_OUT,
+    TUI_DOMAIN_COLUMN_MAJOR_FAULT,
+    TUI_DOMAIN_COLUMN_MINOR_FAULT,
+    TUI_DOMAIN_COLUMN_MEMORY_UNUSED,
+    TUI_DOMAIN_COLUMN_MEMORY_AVAILABLE,
+    TUI_DOMAIN_COLUMN_MEMORY_USABLE,
+    TUI_DOMAIN_COLUMN_MEMORY_AGE,
+    TUI_DOMAIN_COLUMN_DIRTY_RATE,
+    TUI_DOMAIN_COLUMN_MIGRATE_TIME,
+    TUI_DOMAIN_COLUMN_PERF_IPC,
+    TUI_DOMAIN_COLUMN_PERF_MISS_RATE,
+    TUI_DOMAIN_COLUMN_PERF_CACHE,
+    TUI_DOMAIN_COLUMN_PERF_BANDWIDTH,
+    TUI_DOMAIN_COLUMN_PERF_LOCAL
 } tui_domain_column_enum;
 
 /**
@@ -55,6 +81,7 @@ typedef struct tui_domain_data {
     WINDOW  *domain_columns_win;                            /** Holds domain_column */
     WINDOW  **domain_columns_sub_win;                       /** Pointer of subwindows holding columns */
     tui_domain_type domain_type[TUI_DOMAIN_COLUMN_SIZE];    /** Keeps track of domain index position */
+    int     domain_column_size;                             /** Number of shown columns, first in domain_type */
 
     char *domain_memory_size;   /** RAM size of all domains */
 
@@ -104,4 +131,22 @@ void tui_create_domain(tui_domain_data *tui, void *vdata);
  */
 void tui_draw_domain_columns(tui_domain_data *tui);
 
+/**
+ * Show or hide the optional guest memory columns, kept across refreshes.
+ */
+void tui_toggle_memory_columns();
+
+/**
+ * Show or hide the optional perf event columns, kept across refreshes.
+ */
+void tui_toggle_perf_columns();
+
+/**
+ * Tell the virt layer what the screen shows: columns which fit
+ * the screen width and rows of the current viewport.
+ * @param tui  - pointer to the tui_domain_data that draws on the screen
+ * @param plan - fetch plan of the next refresh
+ */
+void tui_plan_domain_columns(tui_domain_data *tui, virt_plan_data *plan);
+
 #endif /* TUI_DOMAIN_H */
@@ -0,0 +1,71 @@
+/* This file contains routines to draw the recent libvirt errors pane
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tui_errors.h"
+#include "tui_domain.h"
+#include "utils.h"
+#include <stdio.h>
+
+void tui_draw_errors()
+{
+    int max_y = 0, max_x = 0;
+    getmaxyx(stdscr, max_y, max_x);
+
+    int x       = TUI_ERRORS_PANE_X;
+    int width   = max_x - x;
+    if (width < TUI_ERRORS_PANE_MIN_WIDTH || max_y < TUI_HEADER_HEIGHT)
+        return;
+    if (width > TUI_ERRORS_BUFFER_SIZE - 1)
+        width = TUI_ERRORS_BUFFER_SIZE - 1;
+
+    for (int y = 0; y != TUI_HEADER_HEIGHT - 1; ++y) {
+        move(y, x);
+        clrtoeol();
+    }
+
+    /* the title takes the first line */
+    virt_error_entry entry[TUI_HEADER_HEIGHT - 2];
+    size_t size = virt_errors_recent(entry, TUI_HEADER_HEIGHT - 2);
+    unsigned long long now = time_monotonic_us();
+
+    char buffer[TUI_ERRORS_BUFFER_SIZE];
+    snprintf(buffer, sizeof(buffer), "Libvirt errors: %llu, most recent first",
+             virt_errors_total());
+    buffer[width] = '\0';
+    attron(A_BOLD);
+    mvwaddstr(stdscr, 0, x, buffer);
+    attroff(A_BOLD);
+
+    for (size_t i = 0; i != size; ++i) {
+        int len = snprintf(buffer, sizeof(buffer), "%6llux %5llus ",
+                           entry[i].count, (now - entry[i].last) / 1000000);
+        if (len > width)
+            len = width;
+        buffer[len] = '\0';
+        attron(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+        mvwaddstr(stdscr, i + 1, x, buffer);
+        attroff(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+
+        snprintf(buffer, sizeof(buffer), "%s%s%s: %s",
+                 virt_errors_api_name(entry[i].api), entry[i].domain[0] ? " " : "",
+                 entry[i].domain, entry[i].message);
+        buffer[width - len] = '\0';
+        waddstr(stdscr, buffer);
+    }
+}
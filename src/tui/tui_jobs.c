@@ -0,0 +1,205 @@
+/* This file contains routines to draw job columns
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tui_jobs.h"
+#include "virt_plan.h"
+
+int tui_jobs_column_width[TUI_JOBS_COLUMN_SIZE] = {
+    20, 16, 12, 8, 10, 10, 12, 13, 13, 6, 13, 9, 9
+};
+
+const char *tui_jobs_column_header[TUI_JOBS_COLUMN_SIZE] = {
+    "DOMAIN",
+    "JOB",
+    "STATE",
+    "PROG(%)",
+    "DONE(MiB)",
+    "LEFT(MiB)",
+    "RATE(MiB/s)",
+    "LIMIT(MiB/s)",
+    "DIRTY(MiB/s)",
+    "ITER",
+    "DOWNTIME(ms)",
+    "ELAPSED",
+    "ETA"
+};
+
+void tui_init_jobs_columns(tui_jobs_data *tui)
+{
+    for (int i = 0; i != TUI_JOBS_COLUMN_SIZE; ++i) {
+        tui->jobs_data[i] = NULL;
+        tui->jobs_data_item[i] = NULL;
+    }
+
+    tui->jobs_column             = NULL;
+    tui->jobs_columns_win        = NULL;
+    tui->jobs_columns_sub_win    = NULL;
+
+    tui->jobs_size = 0;
+}
+
+void tui_deinit_jobs_columns(tui_jobs_data *tui)
+{
+    /* free columns */
+    if (tui->jobs_column) {
+        for (int i = 0; i != TUI_JOBS_COLUMN_SIZE; ++i) {
+            if (tui->jobs_column[i]) {
+                unpost_menu(tui->jobs_column[i]);
+                free_menu(tui->jobs_column[i]);
+            }
+        }
+    }
+    free(tui->jobs_column);
+
+    /* free items and strings */
+    for (int i = 0; i != TUI_JOBS_COLUMN_SIZE; ++i) {
+        for (int j = 0; j != tui->jobs_size; ++j) {
+            if (tui->jobs_data_item[i][j])
+                free_item(tui->jobs_data_item[i][j]);
+            free(tui->jobs_data[i][j]);
+        }
+        free(tui->jobs_data_item[i]);
+        free(tui->jobs_data[i]);
+    }
+
+    if (tui->jobs_columns_win) {
+        for (int i = 0; i != TUI_JOBS_COLUMN_SIZE; ++i)
+            if (tui->jobs_columns_sub_win[i])
+                delwin(tui->jobs_columns_sub_win[i]);
+        free(tui->jobs_columns_sub_win);
+        delwin(tui->jobs_columns_win);
+    }
+}
+
+void tui_draw_jobs_column_header()
+{
+    int x   = 0;
+    int y   = TUI_HEADER_HEIGHT-1;
+    move(y, x);
+
+    attron(COLOR_PAIR(TUI_COLOR_COLUMN_HEADER_TEXT));
+
+    int max_x = getmaxx(stdscr);
+
+    /* first print n empty spaces where n is the width of i column,
+     * then print i column header at (y, x) and move over the y*/
+    for (int i = 0; i != TUI_JOBS_COLUMN_SIZE && x < max_x; ++i) {
+        for (int j = 0; j != tui_jobs_column_width[i] && x + j < max_x; ++j)
+            printw(" ");
+        mvprintw(y, x, tui_jobs_column_header[i]);
+        x += tui_jobs_column_width[i];
+    }
+
+    /* fill up the rest of the screen */
+    getyx(stdscr, y, x);
+    for (int i = 0; i < max_x - x; ++i)
+        printw(" ");
+    attroff(COLOR_PAIR(TUI_COLOR_COLUMN_HEADER_TEXT));
+}
+
+void tui_create_jobs(tui_jobs_data *tui, void *vdata)
+{
+    virt_jobs_data *data = (virt_jobs_data *)vdata;
+    /* last item counts as NULL */
+    tui->jobs_size = data->jobs_size;
+
+    tui->jobs_column = calloc(TUI_JOBS_COLUMN_SIZE, sizeof(MENU *));
+    for (int i = 0; i != TUI_JOBS_COLUMN_SIZE; ++i) {
+        tui->jobs_data[i]        = data->jobs_data[i];
+        tui->jobs_data_item[i]   = tui_create_items(data->jobs_data[i], data->jobs_data[i] + tui->jobs_size);
+        tui->jobs_column[i]      = new_menu(tui->jobs_data_item[i]);
+    }
+
+    int x = 0, y = 0;
+    getmaxyx(stdscr, x, y);
+
+    /* create the window to be associated with the menu */
+    tui->jobs_columns_win = newwin(x-TUI_HEADER_HEIGHT-1, y, TUI_HEADER_HEIGHT, 0);
+    tui->jobs_columns_sub_win = calloc(TUI_JOBS_COLUMN_SIZE, sizeof(WINDOW *));
+    keypad(tui->jobs_columns_win, TRUE);
+
+    free(data);
+}
+
+void tui_draw_jobs_columns(tui_jobs_data *tui)
+{
+    int height = 0, max_width = 0;
+    getmaxyx(stdscr, height, max_width);
+
+    int total_column_width = 0;
+    for (int i = 0; i != TUI_JOBS_COLUMN_SIZE; ++i) {
+        /* columns past the right edge of the screen are not shown */
+        int width = tui_jobs_column_width[i];
+        if (total_column_width + width > max_width)
+            width = max_width - total_column_width;
+        if (width <= 0 || !tui->jobs_column[i])
+            break;
+
+        set_menu_win(tui->jobs_column[i], tui->jobs_columns_win);
+        tui->jobs_columns_sub_win[i] = derwin(tui->jobs_columns_win, height-TUI_HEADER_HEIGHT-1,
+                                                 width, 0, total_column_width);
+
+        touchwin(tui->jobs_columns_win);
+        set_menu_sub(tui->jobs_column[i], tui->jobs_columns_sub_win[i]);
+        set_menu_format(tui->jobs_column[i], height-TUI_HEADER_HEIGHT-1, 1);
+        set_menu_mark(tui->jobs_column[i], NULL);
+
+        post_menu(tui->jobs_column[i]);
+
+        total_column_width += tui_jobs_column_width[i];
+    }
+}
+
+void tui_plan_jobs_columns(tui_jobs_data *tui, virt_data *virt)
+{
+    virt_plan_clear_columns(virt->plan);
+    virt_plan_set_viewport(virt->plan, 0, virt->records->record_size);
+}
+
+void tui_jobs_throttle(virt_data *virt, int index)
+{
+    const virt_jobs_job *job = virt_jobs_at(virt, index);
+    if (!job || !job->disk[0] || job->state != VIRT_JOBS_STATE_ACTIVE)
+        return;
+
+    int max_y = 0, max_x = 0;
+    getmaxyx(stdscr, max_y, max_x);
+
+    char prompt[TUI_JOBS_PROMPT_SIZE], input[TUI_JOBS_PROMPT_SIZE] = "";
+    snprintf(prompt, sizeof(prompt), "Bandwidth of %s on %s in MiB/s, 0 for unlimited: ", job->disk, job->name);
+    if (max_x < TUI_JOBS_PROMPT_SIZE)
+        prompt[max_x > 0 ? max_x : 0] = '\0';
+
+    timeout(-1); /* make input blocking */
+    move(max_y - 1, 0);
+    clrtoeol();
+    mvwaddstr(stdscr, max_y - 1, 0, prompt);
+    echo();
+    curs_set(1);
+    getnstr(input, sizeof(input) - 1);
+    curs_set(0);
+    noecho();
+    timeout(TUI_INPUT_DELAY); /* make input non-blocking again */
+
+    /* failures of the command are listed in the errors pane */
+    char *end = NULL;
+    double mib = strtod(input, &end);
+    if (input[0] && end != input && *end == '\0' && mib >= 0.0)
+        virt_jobs_throttle(virt, index, (unsigned long long)(mib * 1024.0 * 1024.0));
+}
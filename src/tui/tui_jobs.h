@@ -0,0 +1,112 @@
+/* This file contains routines to draw job columns
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TUI_JOBS_H
+#define TUI_JOBS_H
+/** @file tui_jobs.h 
+ * This file contains routines to draw job columns */
+#include "tui.h"
+#include "virt_jobs.h"
+/** Number of columns displayed in the jobs mode */
+#define TUI_JOBS_COLUMN_SIZE (13)
+/** Size of the bandwidth prompt and its input */
+#define TUI_JOBS_PROMPT_SIZE (128)
+
+/** Columns width */
+int tui_jobs_column_width[TUI_JOBS_COLUMN_SIZE];
+/** Column header strings printed right above the job columns. */
+const char *tui_jobs_column_header[TUI_JOBS_COLUMN_SIZE];
+
+/** Represents job column type, in the order of virt_jobs_data_type_enum */
+typedef enum {
+    TUI_JOBS_COLUMN_DOMAIN,
+    TUI_JOBS_COLUMN_OPERATION,
+    TUI_JOBS_COLUMN_STATE,
+    TUI_JOBS_COLUMN_PROGRESS,
+    TUI_JOBS_COLUMN_PROCESSED,
+    TUI_JOBS_COLUMN_REMAINING,
+    TUI_JOBS_COLUMN_RATE,
+    TUI_JOBS_COLUMN_LIMIT,
+    TUI_JOBS_COLUMN_DIRTY_RATE,
+    TUI_JOBS_COLUMN_ITERATION,
+    TUI_JOBS_COLUMN_DOWNTIME,
+    TUI_JOBS_COLUMN_ELAPSED,
+    TUI_JOBS_COLUMN_ETA
+} tui_jobs_column_enum;
+
+/**
+ * Struct that holds job rows.
+ */
+typedef struct tui_jobs_data {
+    char    **jobs_data[TUI_JOBS_COLUMN_SIZE];      /** Job data strings */
+    ITEM    **jobs_data_item[TUI_JOBS_COLUMN_SIZE]; /** Job column items */
+    MENU    **jobs_column;                          /** Holds job item objects */
+    WINDOW  *jobs_columns_win;                      /** Holds jobs_column */
+    WINDOW  **jobs_columns_sub_win;                 /** Subwindows holding columns */
+
+    size_t jobs_size;           /** Total number of job rows */
+} tui_jobs_data;
+
+/**
+ * Set job columns object to default state.
+ * @param tui - pointer to the tui_jobs_data that draws on the screen
+ */
+void tui_init_jobs_columns(tui_jobs_data *tui);
+
+/**
+ * Deinitialize the job columns object.
+ * @param tui - pointer to the tui_jobs_data that draws on the screen
+ */
+void tui_deinit_jobs_columns(tui_jobs_data *tui);
+
+/**
+ * Draw job column headers, right above the columns.
+ */
+void tui_draw_jobs_column_header();
+
+/**
+ * Create the menus of the job columns from the rendered job rows.
+ * @param tui   - pointer to the tui_jobs_data that draws on the screen
+ * @param vdata - pointer to virt_jobs_data, released by the function
+ */
+void tui_create_jobs(tui_jobs_data *tui, void *vdata);
+
+/**
+ * Attach the job columns which fit the screen to their subwindows.
+ * @param tui - pointer to the tui_jobs_data that draws on the screen
+ */
+void tui_draw_jobs_columns(tui_jobs_data *tui);
+
+/**
+ * Tell the virt layer what the screen shows: job rows need only the state
+ * of every domain to find the running ones, no metric groups are fetched.
+ * @param tui  - pointer to the tui_jobs_data that draws on the screen
+ * @param virt - virt data, its plan is updated
+ */
+void tui_plan_jobs_columns(tui_jobs_data *tui, virt_data *virt);
+
+/**
+ * Ask for a new bandwidth limit of the selected block job on the bottom line
+ * and queue it. Rows of domain jobs are left alone.
+ * @param virt  - virt data
+ * @param index - selected job row
+ */
+void tui_jobs_throttle(virt_data *virt, int index);
+
+#endif /* TUI_JOBS_H */
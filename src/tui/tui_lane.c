@@ -0,0 +1,118 @@
+/* This file contains the detail pane of the fast lane
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tui_lane.h"
+#include "utils.h"
+#include <stdio.h>
+
+const char *tui_lane_series_label[VIRT_LANE_SERIES_TYPE_SIZE] = {
+    "CPU(%)  ",
+    "RD(KB/s)",
+    "WR(KB/s)",
+    "RX(KB/s)",
+    "TX(KB/s)"
+};
+
+/* Return value of the sample in units of the pane */
+static double tui_lane_scaled(const virt_lane_domain *domain, virt_lane_series series, size_t age)
+{
+    double value = virt_lane_value(domain, series, age);
+    return series == VIRT_LANE_SERIES_CPU ? value : value / 1024.0;
+}
+
+/* Draw one series as a line of level characters scaled to its own maximum */
+static void tui_draw_lane_series(const virt_lane_domain *domain, virt_lane_series series,
+                                 int y, int x, int width)
+{
+    char buffer[TUI_LANE_BUFFER_SIZE];
+    int samples = width - TUI_LANE_VALUE_WIDTH;
+    if (samples > TUI_LANE_BUFFER_SIZE - 1)
+        samples = TUI_LANE_BUFFER_SIZE - 1;
+
+    double current = domain->series_size ? tui_lane_scaled(domain, series, 0) : 0;
+    snprintf(buffer, sizeof(buffer), "%s %9.1f ", tui_lane_series_label[series], current);
+    mvwaddstr(stdscr, y, x, buffer);
+
+    double max = 0;
+    for (int i = 0; i < samples && i < domain->series_size; ++i)
+        if (tui_lane_scaled(domain, series, i) > max)
+            max = tui_lane_scaled(domain, series, i);
+
+    int levels = strlen(TUI_LANE_LEVELS);
+    for (int i = 0; i != samples; ++i) {
+        size_t age = samples - 1 - i;
+        int level = 0;
+        if (age < domain->series_size && max > 0)
+            level = (int)(tui_lane_scaled(domain, series, age) / max * (levels - 1) + 0.5);
+        buffer[i] = TUI_LANE_LEVELS[level];
+    }
+    buffer[samples] = '\0';
+
+    attron(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+    waddstr(stdscr, buffer);
+    attroff(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+}
+
+void tui_draw_lane(const virt_lane_data *lane)
+{
+    int max_y = 0, max_x = 0;
+    getmaxyx(stdscr, max_y, max_x);
+
+    int x       = TUI_LANE_PANE_X;
+    int width   = max_x - x;
+    if (!lane->enabled || width < TUI_LANE_PANE_MIN_WIDTH || max_y < TUI_HEADER_HEIGHT)
+        return;
+
+    /* wipe the previous samples, the pane reaches the right edge */
+    for (int y = 0; y != TUI_HEADER_HEIGHT - 1; ++y) {
+        move(y, x);
+        clrtoeol();
+    }
+
+    char buffer[TUI_LANE_BUFFER_SIZE];
+    const virt_lane_domain *domain = virt_lane_shown(lane);
+    int pinned = virt_lane_pinned(lane);
+    int y = 0;
+
+    if (pinned)
+        snprintf(buffer, sizeof(buffer), "Fast lane %.0fms, pinned %d/%d: %s",
+                 lane->sched.interval / 1000.0, pinned, VIRT_LANE_SIZE,
+                 domain && domain->name ? domain->name : VIRT_DOMAIN_UNKNOWN_DATA);
+    else
+        snprintf(buffer, sizeof(buffer), "Fast lane %.0fms, following: %s",
+                 lane->sched.interval / 1000.0,
+                 domain && domain->name ? domain->name : VIRT_DOMAIN_UNKNOWN_DATA);
+    buffer[width < TUI_LANE_BUFFER_SIZE ? width : TUI_LANE_BUFFER_SIZE - 1] = '\0';
+    mvwaddstr(stdscr, y++, x, buffer);
+
+    if (!domain)
+        return;
+
+    tui_draw_lane_series(domain, VIRT_LANE_SERIES_CPU, y++, x, width);
+
+    /* latest usage of each vCPU */
+    int size = snprintf(buffer, sizeof(buffer), "vCPU(%%) ");
+    for (int i = 0; i != domain->vcpu_size && size < width && size < sizeof(buffer); ++i)
+        size += snprintf(buffer + size, sizeof(buffer) - size, " %5.1f", domain->vcpu_prc[i]);
+    buffer[width < TUI_LANE_BUFFER_SIZE ? width : TUI_LANE_BUFFER_SIZE - 1] = '\0';
+    mvwaddstr(stdscr, y++, x, buffer);
+
+    for (int i = VIRT_LANE_SERIES_BLOCK_RD; i != VIRT_LANE_SERIES_TYPE_SIZE; ++i)
+        tui_draw_lane_series(domain, i, y++, x, width);
+}
@@ -0,0 +1,48 @@
+/* This file contains the detail pane of the fast lane
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TUI_LANE_H
+#define TUI_LANE_H
+/** @file tui_lane.h 
+ * This file contains routines to draw the fast lane detail pane */
+#include "tui.h"
+#include "virt_lane.h"
+/** Header columns left to the node panel, the pane starts right of them */
+#define TUI_LANE_PANE_X (72)
+/** Narrowest pane worth drawing */
+#define TUI_LANE_PANE_MIN_WIDTH (40)
+/** Width of the label and the current value in front of the series */
+#define TUI_LANE_VALUE_WIDTH (20)
+/** Characters of the series from the lowest to the highest level */
+#define TUI_LANE_LEVELS (" .:-=+*#%@")
+/** Size of the buffer holding one line of the pane */
+#define TUI_LANE_BUFFER_SIZE (256)
+
+/** Labels of the series lines */
+const char *tui_lane_series_label[VIRT_LANE_SERIES_TYPE_SIZE];
+
+/**
+ * Draw the fast lane pane in the right part of the header,
+ * the series of the shown domain as one character per sample, newest on the right.
+ * Nothing is drawn while the lane is off or the screen is too narrow.
+ * @param lane - fast lane
+ */
+void tui_draw_lane(const virt_lane_data *lane);
+
+#endif /* TUI_LANE_H */
@@ -0,0 +1,162 @@
+/* This file contains routines to draw network columns
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tui_network.h"
+
+int tui_network_column_width[TUI_NETWORK_COLUMN_SIZE] = {
+    24, 10, 19, 16, 10, 12, 12, 20, 10
+};
+
+const char *tui_network_column_header[TUI_NETWORK_COLUMN_SIZE] = {
+    "NETWORK/IP",
+    "STATE",
+    "BRIDGE/MAC",
+    "DOMAIN",
+    "VNIC",
+    "RX(KiB/s)",
+    "TX(KiB/s)",
+    "HOSTNAME",
+    "EXPIRES"
+};
+
+void tui_init_network_columns(tui_network_data *tui)
+{
+    for (int i = 0; i != TUI_NETWORK_COLUMN_SIZE; ++i) {
+        tui->network_data[i] = NULL;
+        tui->network_data_item[i] = NULL;
+    }
+
+    tui->network_column             = NULL;
+    tui->network_columns_win        = NULL;
+    tui->network_columns_sub_win    = NULL;
+
+    tui->network_size = 0;
+}
+
+void tui_deinit_network_columns(tui_network_data *tui)
+{
+    /* free columns */
+    if (tui->network_column) {
+        for (int i = 0; i != TUI_NETWORK_COLUMN_SIZE; ++i) {
+            if (tui->network_column[i]) {
+                unpost_menu(tui->network_column[i]);
+                free_menu(tui->network_column[i]);
+            }
+        }
+    }
+    free(tui->network_column);
+
+    /* free items and strings */
+    for (int i = 0; i != TUI_NETWORK_COLUMN_SIZE; ++i) {
+        for (int j = 0; j != tui->network_size; ++j) {
+            if (tui->network_data_item[i][j])
+                free_item(tui->network_data_item[i][j]);
+            free(tui->network_data[i][j]);
+        }
+        free(tui->network_data_item[i]);
+        free(tui->network_data[i]);
+    }
+
+    if (tui->network_columns_win) {
+        for (int i = 0; i != TUI_NETWORK_COLUMN_SIZE; ++i)
+            if (tui->network_columns_sub_win[i])
+                delwin(tui->network_columns_sub_win[i]);
+        free(tui->network_columns_sub_win);
+        delwin(tui->network_columns_win);
+    }
+}
+
+void tui_draw_network_column_header()
+{
+    int x   = 0;
+    int y   = TUI_HEADER_HEIGHT-1;
+    move(y, x);
+
+    attron(COLOR_PAIR(TUI_COLOR_COLUMN_HEADER_TEXT));
+
+    int max_x = getmaxx(stdscr);
+
+    /* first print n empty spaces where n is the width of i column,
+     * then print i column header at (y, x) and move over the y*/
+    for (int i = 0; i != TUI_NETWORK_COLUMN_SIZE && x < max_x; ++i) {
+        for (int j = 0; j != tui_network_column_width[i] && x + j < max_x; ++j)
+            printw(" ");
+        mvprintw(y, x, tui_network_column_header[i]);
+        x += tui_network_column_width[i];
+    }
+
+    /* fill up the rest of the screen */
+    getyx(stdscr, y, x);
+    for (int i = 0; i < max_x - x; ++i)
+        printw(" ");
+    attroff(COLOR_PAIR(TUI_COLOR_COLUMN_HEADER_TEXT));
+}
+
+void tui_create_network(tui_network_data *tui, void *vdata)
+{
+    virt_network_data *data = (virt_network_data *)vdata;
+    /* last item counts as NULL */
+    tui->network_size = data->network_size;
+
+    tui->network_column = calloc(TUI_NETWORK_COLUMN_SIZE, sizeof(MENU *));
+    for (int i = 0; i != TUI_NETWORK_COLUMN_SIZE; ++i) {
+        tui->network_data[i]        = data->network_data[i];
+        tui->network_data_item[i]   = tui_create_items(data->network_data[i], data->network_data[i] + tui->network_size);
+        tui->network_column[i]      = new_menu(tui->network_data_item[i]);
+    }
+
+    int x = 0, y = 0;
+    getmaxyx(stdscr, x, y);
+
+    /* create the window to be associated with the menu */
+    tui->network_columns_win = newwin(x-TUI_HEADER_HEIGHT-1, y, TUI_HEADER_HEIGHT, 0);
+    tui->network_columns_sub_win = calloc(TUI_NETWORK_COLUMN_SIZE, sizeof(WINDOW *));
+    keypad(tui->network_columns_win, TRUE);
+
+    free(data);
+}
+
+void tui_draw_network_columns(tui_network_data *tui)
+{
+    int height = 0, max_width = 0;
+    getmaxyx(stdscr, height, max_width);
+
+    int total_column_width = 0;
+    for (int i = 0; i != TUI_NETWORK_COLUMN_SIZE; ++i) {
+        /* columns past the right edge of the screen are not shown */
+        int width = tui_network_column_width[i];
+        if (total_column_width + width > max_width)
+            width = max_width - total_column_width;
+        if (width <= 0 || !tui->network_column[i])
+            break;
+
+        set_menu_win(tui->network_column[i], tui->network_columns_win);
+        tui->network_columns_sub_win[i] = derwin(tui->network_columns_win, height-TUI_HEADER_HEIGHT-1,
+                                                 width, 0, total_column_width);
+
+        touchwin(tui->network_columns_win);
+        set_menu_sub(tui->network_column[i], tui->network_columns_sub_win[i]);
+        set_menu_format(tui->network_column[i], height-TUI_HEADER_HEIGHT-1, 1);
+        set_menu_mark(tui->network_column[i], NULL);
+
+        post_menu(tui->network_column[i]);
+
+        total_column_width += tui_network_column_width[i];
+    }
+}
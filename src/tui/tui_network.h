@@ -0,0 +1,90 @@
+/* This file contains routines to draw network columns
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TUI_NETWORK_H
+#define TUI_NETWORK_H
+/** @file tui_network.h 
+ * This file contains routines to draw network columns */
+#include "tui.h"
+#include "virt_network.h"
+/** Number of columns displayed in the network mode */
+#define TUI_NETWORK_COLUMN_SIZE (9)
+
+/** Columns width */
+int tui_network_column_width[TUI_NETWORK_COLUMN_SIZE];
+/** Column header strings printed right above the network columns. */
+const char *tui_network_column_header[TUI_NETWORK_COLUMN_SIZE];
+
+/** Represents network column type, in the order of virt_network_data_type_enum */
+typedef enum {
+    TUI_NETWORK_COLUMN_NAME,
+    TUI_NETWORK_COLUMN_STATE,
+    TUI_NETWORK_COLUMN_ADDRESS,
+    TUI_NETWORK_COLUMN_DOMAIN,
+    TUI_NETWORK_COLUMN_VNIC,
+    TUI_NETWORK_COLUMN_RX,
+    TUI_NETWORK_COLUMN_TX,
+    TUI_NETWORK_COLUMN_HOSTNAME,
+    TUI_NETWORK_COLUMN_EXPIRES
+} tui_network_column_enum;
+
+/**
+ * Struct that holds network rows.
+ */
+typedef struct tui_network_data {
+    char    **network_data[TUI_NETWORK_COLUMN_SIZE];        /** Network data strings */
+    ITEM    **network_data_item[TUI_NETWORK_COLUMN_SIZE];   /** Network column items */
+    MENU    **network_column;                               /** Holds network item objects */
+    WINDOW  *network_columns_win;                           /** Holds network_column */
+    WINDOW  **network_columns_sub_win;                      /** Subwindows holding columns */
+
+    size_t network_size;        /** Total number of network rows */
+} tui_network_data;
+
+/**
+ * Set network columns object to default state.
+ * @param tui - pointer to the tui_network_data that draws on the screen
+ */
+void tui_init_network_columns(tui_network_data *tui);
+
+/**
+ * Deinitialize the network columns object.
+ * @param tui - pointer to the tui_network_data that draws on the screen
+ */
+void tui_deinit_network_columns(tui_network_data *tui);
+
+/**
+ * Draw network column headers, right above the columns.
+ */
+void tui_draw_network_column_header();
+
+/**
+ * Create the menus of the network columns from the rendered network rows.
+ * @param tui   - pointer to the tui_network_data that draws on the screen
+ * @param vdata - pointer to virt_network_data, released by the function
+ */
+void tui_create_network(tui_network_data *tui, void *vdata);
+
+/**
+ * Attach the network columns which fit the screen to their subwindows.
+ * @param tui - pointer to the tui_network_data that draws on the screen
+ */
+void tui_draw_network_columns(tui_network_data *tui);
+
+#endif /* TUI_NETWORK_H */
@@ -18,13 +18,16 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "tui_node.h"
+#include "utils.h"
 
 const char *tui_node_info_type[TUI_NODE_INFO_SIZE] = {
     "Hostname:",
     "     URI:",
     " Version:",
     "  Memory:",
-    "  Memory:"
+    "  Memory:",
+    " Refresh:",
+    "     CPU:"
 };
 
 void tui_init_all_node_data(tui_node_data *tui)
@@ -33,6 +36,7 @@ void tui_init_all_node_data(tui_node_data *tui)
         tui->node_data[i] = NULL;
         tui->node_type[i] = i;
     }
+    tui->cache = NULL;
 }
 
 void tui_deinit_node_data(tui_node_data *tui)
@@ -61,6 +65,96 @@ void tui_create_node_panel(tui_node_data *tui, virt_node_data *data)
     tui->node_type[2] = TUI_NODE_INFO_LIB_VERSION;
     tui->node_type[3] = TUI_NODE_INFO_TOTAL_MEMORY;
     tui->node_type[4] = TUI_NODE_INFO_DOMAINS_MEMORY;
+
+    tui->cache = data->cache;
+}
+
+void tui_node_update_refresh_data(tui_node_data *tui, const scheduler_data *sched, double wakeups)
+{
+    char buffer[TUI_NODE_REFRESH_BUFFER_SIZE];
+
+    int size = snprintf(buffer, sizeof(buffer), "%.2fs", sched->current / 1000000.0);
+    if (sched->current != sched->interval)
+        size += snprintf(buffer + size, sizeof(buffer) - size, " (adaptive, set %.2fs)",
+                         sched->interval / 1000000.0);
+    snprintf(buffer + size, sizeof(buffer) - size, ", jitter %.1fms, overruns %llu, wakeups %.1f/s",
+             sched->jitter / 1000.0, sched->overruns, wakeups);
+
+    free(tui->node_data[TUI_NODE_INFO_REFRESH]);
+    tui->node_data[TUI_NODE_INFO_REFRESH] = copy_str(buffer);
+}
+
+/* Draw a CPU as an htop style bar, user time first, kernel time after it */
+static void tui_draw_node_cpu_bar(const virt_node_cpu *cpu, int index, int digits, int y, int x, int width)
+{
+    char text[TUI_NODE_CPU_BAR_TEXT_WIDTH + 1];
+    if (!cpu->online)
+        snprintf(text, sizeof(text), "%*s", TUI_NODE_CPU_BAR_TEXT_WIDTH, "off");
+    else if (cpu->samples > 1)
+        snprintf(text, sizeof(text), "%5.1f%%", cpu->user_prc + cpu->kernel_prc);
+    else
+        snprintf(text, sizeof(text), "%*s", TUI_NODE_CPU_BAR_TEXT_WIDTH, "-");
+
+    /* label, brackets and a space to the next bar */
+    int size    = width - digits - 3;
+    int user    = cpu->samples > 1 ? (int)(cpu->user_prc * size / 100.0 + 0.5) : 0;
+    int kernel  = cpu->samples > 1 ? (int)((cpu->user_prc + cpu->kernel_prc) * size / 100.0 + 0.5) - user : 0;
+    int text_at = size - TUI_NODE_CPU_BAR_TEXT_WIDTH;
+
+    move(y, x);
+    wprintw(stdscr, "%*d", digits, index);
+    attron(A_BOLD);
+    waddch(stdscr, '[');
+    attroff(A_BOLD);
+    for (int i = 0; i != size; ++i) {
+        if (i >= text_at)
+            waddch(stdscr, text[i - text_at] | A_BOLD);
+        else if (i < user)
+            waddch(stdscr, '|' | COLOR_PAIR(TUI_COLOR_METER_USER));
+        else if (i < user + kernel)
+            waddch(stdscr, '|' | COLOR_PAIR(TUI_COLOR_METER_KERNEL));
+        else
+            waddch(stdscr, ' ');
+    }
+    attron(A_BOLD);
+    waddch(stdscr, ']');
+    attroff(A_BOLD);
+}
+
+/* Draw the aggregate usage and the CPU bars, a character per CPU when bars do not fit */
+static void tui_draw_node_cpu(const virt_node_cache *cache, int y, int x)
+{
+    mvwaddstr(stdscr, y++, x, tui_node_info_type[TUI_NODE_INFO_CPU]);
+    attron(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+    waddch(stdscr, ' ');
+    waddstr(stdscr, cache->summary);
+    attroff(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+
+    /* the row above the domain columns is the last one of the panel */
+    int rows = TUI_HEADER_HEIGHT - 1 - y;
+    if (rows <= 0 || cache->cpu_size == 0)
+        return;
+
+    int columns = (cache->cpu_size + rows - 1) / rows;
+    int width   = TUI_NODE_PANEL_WIDTH / columns;
+    if (width >= TUI_NODE_CPU_BAR_MIN_WIDTH) {
+        int digits = snprintf(NULL, 0, "%d", cache->cpu_size - 1);
+        for (int i = 0; i != cache->cpu_size; ++i)
+            tui_draw_node_cpu_bar(cache->cpu + i, i, digits, y + i % rows, x + i / rows * width, width);
+        return;
+    }
+
+    int levels = strlen(TUI_NODE_CPU_LEVELS);
+    for (int i = 0; i != cache->cpu_size && i / TUI_NODE_PANEL_WIDTH < rows; ++i) {
+        const virt_node_cpu *cpu = cache->cpu + i;
+        chtype c = TUI_NODE_CPU_OFFLINE;
+        if (cpu->online) {
+            double usage = cpu->samples > 1 ? cpu->user_prc + cpu->kernel_prc : 0;
+            c = TUI_NODE_CPU_LEVELS[(int)(usage / 100.0 * (levels - 1) + 0.5)] |
+                COLOR_PAIR(cpu->kernel_prc > cpu->user_prc ? TUI_COLOR_METER_KERNEL : TUI_COLOR_METER_USER);
+        }
+        mvwaddch(stdscr, y + i / TUI_NODE_PANEL_WIDTH, x + i % TUI_NODE_PANEL_WIDTH, c | A_BOLD);
+    }
 }
 
 void tui_draw_node_panel(tui_node_data *tui)
@@ -99,4 +193,15 @@ void tui_draw_node_panel(tui_node_data *tui)
     waddstr(stdscr, tui->node_data[TUI_NODE_INFO_TOTAL_MEMORY]);
     waddstr(stdscr, "MB");
     attroff(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+
+    if (tui->node_data[TUI_NODE_INFO_REFRESH]) {
+        mvwaddstr(stdscr, y++, x, tui_node_info_type[TUI_NODE_INFO_REFRESH]);
+        attron(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+        waddch(stdscr, ' ');
+        waddstr(stdscr, tui->node_data[TUI_NODE_INFO_REFRESH]);
+        attroff(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+    }
+
+    if (tui->cache)
+        tui_draw_node_cpu(tui->cache, y, x);
 }
@@ -23,10 +23,23 @@
  * This file contains routines to draw terminal output using ncurses */
 #include "tui.h"
 #include "virt_node.h"
+#include "scheduler.h"
 /** Size of array containing strings of node info */
-#define TUI_NODE_INFO_SIZE (5)
+#define TUI_NODE_INFO_SIZE (7)
+/** Size of the buffer holding refresh schedule summary */
+#define TUI_NODE_REFRESH_BUFFER_SIZE (80)
 /** Size of array containing strings of node summary */
 #define TUI_NODE_INFO_SUMMARY_SIZE (6)
+/** Width of the node panel, the fast lane pane starts right of it */
+#define TUI_NODE_PANEL_WIDTH (71)
+/** Narrowest CPU bar, narrower ones are replaced by one character per CPU */
+#define TUI_NODE_CPU_BAR_MIN_WIDTH (14)
+/** Width of the usage printed inside a CPU bar */
+#define TUI_NODE_CPU_BAR_TEXT_WIDTH (6)
+/** Characters of a CPU from the lowest to the highest usage, when bars do not fit */
+#define TUI_NODE_CPU_LEVELS (" .:-=+*#%@")
+/** Character of an offline CPU, when bars do not fit */
+#define TUI_NODE_CPU_OFFLINE ('x')
 
 /** Represents node info type */
 typedef enum {
@@ -35,6 +48,8 @@ typedef enum {
     TUI_NODE_INFO_LIB_VERSION,
     TUI_NODE_INFO_TOTAL_MEMORY,
     TUI_NODE_INFO_DOMAINS_MEMORY,
+    TUI_NODE_INFO_REFRESH,
+    TUI_NODE_INFO_CPU,
 } tui_node_panel_enum;
 
 typedef tui_node_panel_enum tui_node_type;
@@ -51,6 +66,7 @@ const char *tui_node_info_summary[TUI_NODE_INFO_SUMMARY_SIZE];
 typedef struct tui_node_data {
     char            *node_data[TUI_NODE_INFO_SIZE]; /** Node data strings */
     tui_node_type   node_type[TUI_NODE_INFO_SIZE];  /** Keeps track of node info index position */
+    const virt_node_cache *cache;                   /** Host CPU meters, NULL if not shown */
 } tui_node_data;
 
 /**
@@ -80,7 +96,16 @@ void tui_create_node_panel(tui_node_data *tui, virt_node_data *data);
 void tui_node_update_memory_data(tui_node_data *tui, virt_domain_data *data);
 
 /**
- * Draw the node information at the top left side of the screen.
+ * Update refresh schedule summary (interval, jitter, overruns, wakeups) of tui_node_data object.
+ * @param tui     - pointer to the tui_node_data that draws on the screen
+ * @param sched   - refresh scheduler of the main loop
+ * @param wakeups - average wakeups of the main loop per second
+ */
+void tui_node_update_refresh_data(tui_node_data *tui, const scheduler_data *sched, double wakeups);
+
+/**
+ * Draw the node information at the top left side of the screen,
+ * followed by a bar of every host CPU when there is room for them.
  * @param tui - pointer to the tui_node_data that draws on the screen
  */
 void tui_draw_node_panel(tui_node_data *tui);
@@ -0,0 +1,89 @@
+/* This file contains routines to draw the NUMA cells pane
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tui_numa.h"
+#include "tui_domain.h"
+#include <stdio.h>
+
+/* Print a page size in KiB the way hugepages are usually named, e.g. 2M or 1G */
+static int tui_numa_page_size(char *buffer, size_t size, unsigned int kib)
+{
+    if (kib >= 1024 * 1024)
+        return snprintf(buffer, size, "%uG", kib / (1024 * 1024));
+    if (kib >= 1024)
+        return snprintf(buffer, size, "%uM", kib / 1024);
+    return snprintf(buffer, size, "%uK", kib);
+}
+
+void tui_draw_numa(const virt_node_cache *cache)
+{
+    int max_y = 0, max_x = 0;
+    getmaxyx(stdscr, max_y, max_x);
+
+    int x       = TUI_NUMA_PANE_X;
+    int width   = max_x - x;
+    if (width < TUI_NUMA_PANE_MIN_WIDTH || max_y < TUI_HEADER_HEIGHT)
+        return;
+    if (width > TUI_NUMA_BUFFER_SIZE - 1)
+        width = TUI_NUMA_BUFFER_SIZE - 1;
+
+    for (int y = 0; y != TUI_HEADER_HEIGHT - 1; ++y) {
+        move(y, x);
+        clrtoeol();
+    }
+
+    char buffer[TUI_NUMA_BUFFER_SIZE];
+    if (!cache->cell_size)
+        snprintf(buffer, sizeof(buffer), "NUMA: topology not reported");
+    else
+        snprintf(buffer, sizeof(buffer), "NUMA cells: free/total memory, free/total hugepages");
+    buffer[width] = '\0';
+    attron(A_BOLD);
+    mvwaddstr(stdscr, 0, x, buffer);
+    attroff(A_BOLD);
+
+    int y = 1;
+    for (int i = 0; i != cache->cell_size && y < TUI_HEADER_HEIGHT - 1; ++i) {
+        const virt_node_cell *cell = cache->cell + i;
+        if (!cell->present)
+            continue;
+
+        int len = 0;
+        if (cache->numa_sampled)
+            len = snprintf(buffer, sizeof(buffer), "%2d: %llu/%lluMB", i,
+                           cell->free / 1024 / 1024, cell->memory / 1024);
+        else
+            len = snprintf(buffer, sizeof(buffer), "%2d: %s/%lluMB", i,
+                           VIRT_DOMAIN_UNKNOWN_DATA, cell->memory / 1024);
+
+        /* the base page is the free memory already */
+        for (int j = 1; j < cache->page_size_count && len < sizeof(buffer); ++j) {
+            len += snprintf(buffer + len, sizeof(buffer) - len, ", ");
+            if (len < sizeof(buffer))
+                len += tui_numa_page_size(buffer + len, sizeof(buffer) - len, cache->page_size[j]);
+            if (len < sizeof(buffer))
+                len += snprintf(buffer + len, sizeof(buffer) - len, " %llu/%llu",
+                                cell->pages_free[j], cell->pages[j]);
+        }
+        buffer[width] = '\0';
+        attron(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+        mvwaddstr(stdscr, y++, x, buffer);
+        attroff(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+    }
+}
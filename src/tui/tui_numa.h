@@ -0,0 +1,41 @@
+/* This file contains routines to draw the NUMA cells pane
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TUI_NUMA_H
+#define TUI_NUMA_H
+/** @file tui_numa.h 
+ * This file contains routines to draw the NUMA cells pane */
+#include "tui.h"
+#include "virt_node.h"
+/** The pane takes the place of the fast lane pane */
+#define TUI_NUMA_PANE_X (72)
+/** Narrowest pane worth drawing */
+#define TUI_NUMA_PANE_MIN_WIDTH (40)
+/** Size of the buffer holding one line of the pane */
+#define TUI_NUMA_BUFFER_SIZE (256)
+
+/**
+ * Draw free memory and free pages of every NUMA cell in the right part
+ * of the header, one line per cell. Cells which do not fit are left out.
+ * Nothing is drawn while the screen is too narrow.
+ * @param cache - node cache with the sampled cells
+ */
+void tui_draw_numa(const virt_node_cache *cache);
+
+#endif /* TUI_NUMA_H */
@@ -0,0 +1,270 @@
+/* This file contains the interactive pinning editor
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tui_pin.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Name the thread of an entry, e.g. "vCPU 3" */
+static void tui_pin_thread_str(const virt_pin_entry *entry, char *buf, size_t size)
+{
+    switch (entry->target) {
+        case VIRT_PIN_TARGET_VCPU:
+            snprintf(buf, size, "vCPU %u", entry->id);
+            break;
+        case VIRT_PIN_TARGET_EMULATOR:
+            snprintf(buf, size, "emulator");
+            break;
+        case VIRT_PIN_TARGET_IOTHREAD:
+            snprintf(buf, size, "iothread %u", entry->id);
+            break;
+    }
+}
+
+/* Print host CPUs of a map and their cells */
+static void tui_pin_cpus_str(const unsigned char *cpumap, const virt_pin_editor *editor,
+                             const virt_node_cache *cache, char *cpus, char *nodes)
+{
+    virt_node_cpumap_str(cpumap, editor->cpus, cpus, TUI_PIN_LIST_SIZE);
+    if (!cpus[0])
+        snprintf(cpus, TUI_PIN_LIST_SIZE, "%s", VIRT_DOMAIN_UNKNOWN_DATA);
+    virt_node_cells_str(virt_node_cpumap_cells(cache, cpumap), nodes, TUI_PIN_NODES_SIZE);
+    if (!nodes[0])
+        snprintf(nodes, TUI_PIN_NODES_SIZE, "%s", VIRT_DOMAIN_UNKNOWN_DATA);
+}
+
+/* Draw a line cut to the screen width */
+static void tui_pin_line(int y, char *buffer, int max_x)
+{
+    if (max_x < TUI_PIN_BUFFER_SIZE)
+        buffer[max_x > 0 ? max_x : 0] = '\0';
+    mvwaddstr(stdscr, y, 0, buffer);
+}
+
+/* Draw the host CPUs of every cell, returns the next free line */
+static int tui_pin_draw_topology(const virt_pin_editor *editor, const virt_node_cache *cache,
+                                 int y, int max_x)
+{
+    char buffer[TUI_PIN_BUFFER_SIZE], cpus[TUI_PIN_LIST_SIZE];
+    attron(A_BOLD);
+    snprintf(buffer, sizeof(buffer), "Host topology");
+    tui_pin_line(y++, buffer, max_x);
+    attroff(A_BOLD);
+
+    if (!cache->cpu_cell || !cache->cell_size) {
+        unsigned char cpumap[VIRT_NODE_CPUMAP_LEN];
+        memset(cpumap, 0xff, sizeof(cpumap));
+        virt_node_cpumap_str(cpumap, editor->cpus, cpus, sizeof(cpus));
+        snprintf(buffer, sizeof(buffer), "  NUMA not reported, CPUs %s", cpus);
+        tui_pin_line(y++, buffer, max_x);
+        return y;
+    }
+
+    for (int cell = 0; cell != cache->cell_size; ++cell) {
+        if (!cache->cell[cell].present)
+            continue;
+        unsigned char cpumap[VIRT_NODE_CPUMAP_LEN] = { 0 };
+        for (int cpu = 0; cpu != cache->cpu_size && cpu < editor->cpus; ++cpu)
+            if (cache->cpu_cell[cpu] == cell)
+                VIR_USE_CPU(cpumap, cpu);
+        virt_node_cpumap_str(cpumap, editor->cpus, cpus, sizeof(cpus));
+        snprintf(buffer, sizeof(buffer), "  %s%d: CPUs %s, %lluMB", VIRT_PIN_NODE_PREFIX, cell,
+                 cpus[0] ? cpus : VIRT_DOMAIN_UNKNOWN_DATA, cache->cell[cell].memory / 1024);
+        tui_pin_line(y++, buffer, max_x);
+    }
+    return y;
+}
+
+/* Draw the summary of the current and the staged placement */
+static void tui_pin_draw_summary(const virt_pin_editor *editor, const virt_node_cache *cache,
+                                 int y, int max_x)
+{
+    virt_pin_summary before, after;
+    virt_pin_summarize(editor, cache, FALSE, &before);
+    virt_pin_summarize(editor, cache, TRUE, &after);
+
+    char buffer[TUI_PIN_BUFFER_SIZE], cells_before[TUI_PIN_NODES_SIZE], cells_after[TUI_PIN_NODES_SIZE];
+    virt_node_cells_str(before.vcpu_cells, cells_before, sizeof(cells_before));
+    virt_node_cells_str(after.vcpu_cells, cells_after, sizeof(cells_after));
+
+    attron(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+    snprintf(buffer, sizeof(buffer),
+             "Cross-node vCPUs: %d -> %d   vCPU nodes: %s -> %s   threads off vCPU nodes: %d -> %d",
+             before.cross_vcpu, after.cross_vcpu,
+             cells_before[0] ? cells_before : VIRT_DOMAIN_UNKNOWN_DATA,
+             cells_after[0] ? cells_after : VIRT_DOMAIN_UNKNOWN_DATA,
+             before.remote_threads, after.remote_threads);
+    tui_pin_line(y, buffer, max_x);
+    attroff(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+}
+
+/* Draw the whole editor, the list is scrolled to keep the selection visible */
+static void tui_pin_draw(const virt_pin_editor *editor, const virt_node_cache *cache,
+                         int selected, int *offset, const char *status)
+{
+    int max_y = 0, max_x = 0;
+    getmaxyx(stdscr, max_y, max_x);
+    clear();
+
+    char buffer[TUI_PIN_BUFFER_SIZE];
+    int y = 0;
+    attron(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+    snprintf(buffer, sizeof(buffer), "Pinning of %s", editor->name ? editor->name : "");
+    tui_pin_line(y++, buffer, max_x);
+    attroff(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+    snprintf(buffer, sizeof(buffer), "Enter: edit  u: undo  w: apply  j/k: select  q: return");
+    tui_pin_line(y++, buffer, max_x);
+    ++y;
+
+    y = tui_pin_draw_topology(editor, cache, y, max_x) + 1;
+
+    attron(COLOR_PAIR(TUI_COLOR_COLUMN_HEADER_TEXT));
+    snprintf(buffer, sizeof(buffer), "%-*s%-*s%-*s%-*s%-*s",
+             TUI_PIN_THREAD_WIDTH, "THREAD", TUI_PIN_CPUS_WIDTH, "PINNING", TUI_PIN_NODES_WIDTH, "NODES",
+             TUI_PIN_CPUS_WIDTH, "STAGED", TUI_PIN_NODES_WIDTH, "NODES");
+    tui_pin_line(y++, buffer, max_x);
+    attroff(COLOR_PAIR(TUI_COLOR_COLUMN_HEADER_TEXT));
+
+    /* the summary and the status line stay at the bottom */
+    int rows = max_y - y - 3;
+    if (rows < 1)
+        rows = 1;
+    if (selected < *offset)
+        *offset = selected;
+    if (selected >= *offset + rows)
+        *offset = selected - rows + 1;
+
+    for (int i = *offset; i < editor->entry_size && i < *offset + rows; ++i) {
+        const virt_pin_entry *entry = editor->entry + i;
+        char thread[32], cpus[TUI_PIN_LIST_SIZE], nodes[TUI_PIN_NODES_SIZE];
+        char staged[TUI_PIN_LIST_SIZE], staged_nodes[TUI_PIN_NODES_SIZE];
+        tui_pin_thread_str(entry, thread, sizeof(thread));
+        tui_pin_cpus_str(entry->cpumap, editor, cache, cpus, nodes);
+        if (entry->changed)
+            tui_pin_cpus_str(entry->staged, editor, cache, staged, staged_nodes);
+        else
+            staged[0] = staged_nodes[0] = '\0';
+
+        snprintf(buffer, sizeof(buffer), "%-*s%-*.*s%-*.*s%-*.*s%-*.*s",
+                 TUI_PIN_THREAD_WIDTH, thread,
+                 TUI_PIN_CPUS_WIDTH, TUI_PIN_CPUS_WIDTH - 1, cpus,
+                 TUI_PIN_NODES_WIDTH, TUI_PIN_NODES_WIDTH - 1, nodes,
+                 TUI_PIN_CPUS_WIDTH, TUI_PIN_CPUS_WIDTH - 1, staged,
+                 TUI_PIN_NODES_WIDTH, TUI_PIN_NODES_WIDTH - 1, staged_nodes);
+        if (i == selected)
+            attron(A_REVERSE);
+        tui_pin_line(y++, buffer, max_x);
+        if (i == selected)
+            attroff(A_REVERSE);
+    }
+
+    tui_pin_draw_summary(editor, cache, max_y - 2, max_x);
+    if (status) {
+        snprintf(buffer, sizeof(buffer), "%s", status);
+        tui_pin_line(max_y - 1, buffer, max_x);
+    }
+    refresh();
+}
+
+/* Ask for the new CPU list of the selected entry, returns the status to show */
+static const char *tui_pin_edit(virt_pin_editor *editor, const virt_node_cache *cache, int selected)
+{
+    int max_y = 0, max_x = 0;
+    getmaxyx(stdscr, max_y, max_x);
+
+    char thread[32], prompt[TUI_PIN_BUFFER_SIZE], input[TUI_PIN_INPUT_SIZE] = "";
+    tui_pin_thread_str(editor->entry + selected, thread, sizeof(thread));
+    snprintf(prompt, sizeof(prompt), "CPUs of %s (e.g. 0-3,8 or %s1): ", thread, VIRT_PIN_NODE_PREFIX);
+    move(max_y - 1, 0);
+    clrtoeol();
+    tui_pin_line(max_y - 1, prompt, max_x);
+
+    echo();
+    curs_set(1);
+    getnstr(input, sizeof(input) - 1);
+    curs_set(0);
+    noecho();
+
+    if (!input[0])
+        return NULL;
+    if (virt_pin_stage(editor, cache, selected, input) != VIRT_ERROR_SUCCESS)
+        return "No host CPU selected, pinning left unchanged";
+    return NULL;
+}
+
+void tui_pin_editor(virt_data *virt, int row)
+{
+    timeout(-1); /* make input blocking */
+
+    virt_pin_editor editor;
+    if (virt_pin_open(virt, row, &editor) != VIRT_ERROR_SUCCESS) {
+        clear();
+        attron(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+        mvwaddstr(stdscr, 0, 0, "Pinning of the domain could not be read, see the errors pane");
+        mvwaddstr(stdscr, 1, 0, "Press any key to return");
+        attroff(A_BOLD | COLOR_PAIR(TUI_COLOR_HELP_KEY));
+        getch();
+        clear();
+        timeout(TUI_INPUT_DELAY); /* make input non-blocking again */
+        return;
+    }
+
+    char applied[TUI_PIN_BUFFER_SIZE];
+    const char *status = NULL;
+    int selected = 0, offset = 0, quit = FALSE;
+    while (quit != TRUE) {
+        tui_pin_draw(&editor, virt->node, selected, &offset, status);
+        status = NULL;
+
+        switch (getch()) {
+            case KEY_DOWN: case TUI_KEY_LIST_DOWN:
+                if (selected + 1 < editor.entry_size)
+                    ++selected;
+                break;
+            case KEY_UP: case TUI_KEY_LIST_UP:
+                if (selected > 0)
+                    --selected;
+                break;
+            case KEY_ENTER: case TUI_PIN_KEY_EDIT:
+                status = tui_pin_edit(&editor, virt->node, selected);
+                break;
+            case TUI_PIN_KEY_UNDO:
+                virt_pin_unstage(&editor, selected);
+                break;
+            case TUI_PIN_KEY_APPLY: {
+                int queued = virt_pin_apply(&editor);
+                if (queued < 0) {
+                    status = "Monitoring only session, pinning cannot be changed";
+                } else {
+                    snprintf(applied, sizeof(applied), "Queued %d pinning change(s), failures are listed in the errors pane",
+                             queued);
+                    status = applied;
+                }
+                break;
+            }
+            case TUI_PIN_KEY_QUIT: case TUI_PIN_KEY_ESCAPE: case TUI_KEY_PIN:
+                quit = TRUE;
+                break;
+        }
+    }
+
+    virt_pin_close(&editor);
+    clear();
+    timeout(TUI_INPUT_DELAY); /* make input non-blocking again */
+}
@@ -0,0 +1,60 @@
+/* This file contains the interactive pinning editor
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TUI_PIN_H
+#define TUI_PIN_H
+/** @file tui_pin.h 
+ * This file contains the interactive pinning editor of a domain */
+#include "tui.h"
+#include "virt_pin.h"
+/** Width of the thread column */
+#define TUI_PIN_THREAD_WIDTH (14)
+/** Width of the pinning columns */
+#define TUI_PIN_CPUS_WIDTH (24)
+/** Width of the node columns */
+#define TUI_PIN_NODES_WIDTH (8)
+/** Size of the buffers holding a list of host CPUs */
+#define TUI_PIN_LIST_SIZE (128)
+/** Size of the buffers holding a list of NUMA cells */
+#define TUI_PIN_NODES_SIZE (32)
+/** Size of the buffer holding one line of the editor */
+#define TUI_PIN_BUFFER_SIZE (256)
+/** Size of the buffer holding the typed CPU list */
+#define TUI_PIN_INPUT_SIZE (64)
+
+/** Represents keys used inside the editor */
+typedef enum {
+    TUI_PIN_KEY_EDIT    = '\n',
+    TUI_PIN_KEY_UNDO    = 'u',
+    TUI_PIN_KEY_APPLY   = 'w',
+    TUI_PIN_KEY_QUIT    = 'q',
+    TUI_PIN_KEY_ESCAPE  = 27
+} tui_pin_key_enum;
+
+/**
+ * Show the pinning editor of a domain until the user leaves it.
+ * The host topology, the current and the staged pinning of the vCPUs,
+ * the emulator and the iothreads are shown together with a summary of the
+ * placement before and after the edits. Input is blocking while it is open.
+ * @param virt - virt data with the records and the host topology
+ * @param row  - row of the record of the domain
+ */
+void tui_pin_editor(virt_data *virt, int row);
+
+#endif /* TUI_PIN_H */
@@ -0,0 +1,161 @@
+/* This file contains routines to draw storage columns
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tui_storage.h"
+
+int tui_storage_column_width[TUI_STORAGE_COLUMN_SIZE] = {
+    32, 14, 14, 14, 14, 9, 14, 10
+};
+
+const char *tui_storage_column_header[TUI_STORAGE_COLUMN_SIZE] = {
+    "POOL/VOLUME",
+    "STATE/TYPE",
+    "CAPACITY(MB)",
+    "ALLOC(MB)",
+    "AVAIL(MB)",
+    "USED(%)",
+    "GROWTH(MB/h)",
+    "FULL IN"
+};
+
+void tui_init_storage_columns(tui_storage_data *tui)
+{
+    for (int i = 0; i != TUI_STORAGE_COLUMN_SIZE; ++i) {
+        tui->storage_data[i] = NULL;
+        tui->storage_data_item[i] = NULL;
+    }
+
+    tui->storage_column             = NULL;
+    tui->storage_columns_win        = NULL;
+    tui->storage_columns_sub_win    = NULL;
+
+    tui->storage_size = 0;
+}
+
+void tui_deinit_storage_columns(tui_storage_data *tui)
+{
+    /* free columns */
+    if (tui->storage_column) {
+        for (int i = 0; i != TUI_STORAGE_COLUMN_SIZE; ++i) {
+            if (tui->storage_column[i]) {
+                unpost_menu(tui->storage_column[i]);
+                free_menu(tui->storage_column[i]);
+            }
+        }
+    }
+    free(tui->storage_column);
+
+    /* free items and strings */
+    for (int i = 0; i != TUI_STORAGE_COLUMN_SIZE; ++i) {
+        for (int j = 0; j != tui->storage_size; ++j) {
+            if (tui->storage_data_item[i][j])
+                free_item(tui->storage_data_item[i][j]);
+            free(tui->storage_data[i][j]);
+        }
+        free(tui->storage_data_item[i]);
+        free(tui->storage_data[i]);
+    }
+
+    if (tui->storage_columns_win) {
+        for (int i = 0; i != TUI_STORAGE_COLUMN_SIZE; ++i)
+            if (tui->storage_columns_sub_win[i])
+                delwin(tui->storage_columns_sub_win[i]);
+        free(tui->storage_columns_sub_win);
+        delwin(tui->storage_columns_win);
+    }
+}
+
+void tui_draw_storage_column_header()
+{
+    int x   = 0;
+    int y   = TUI_HEADER_HEIGHT-1;
+    move(y, x);
+
+    attron(COLOR_PAIR(TUI_COLOR_COLUMN_HEADER_TEXT));
+
+    int max_x = getmaxx(stdscr);
+
+    /* first print n empty spaces where n is the width of i column,
+     * then print i column header at (y, x) and move over the y*/
+    for (int i = 0; i != TUI_STORAGE_COLUMN_SIZE && x < max_x; ++i) {
+        for (int j = 0; j != tui_storage_column_width[i] && x + j < max_x; ++j)
+            printw(" ");
+        mvprintw(y, x, tui_storage_column_header[i]);
+        x += tui_storage_column_width[i];
+    }
+
+    /* fill up the rest of the screen */
+    getyx(stdscr, y, x);
+    for (int i = 0; i < max_x - x; ++i)
+        printw(" ");
+    attroff(COLOR_PAIR(TUI_COLOR_COLUMN_HEADER_TEXT));
+}
+
+void tui_create_storage(tui_storage_data *tui, void *vdata)
+{
+    virt_storage_data *data = (virt_storage_data *)vdata;
+    /* last item counts as NULL */
+    tui->storage_size = data->storage_size;
+
+    tui->storage_column = calloc(TUI_STORAGE_COLUMN_SIZE, sizeof(MENU *));
+    for (int i = 0; i != TUI_STORAGE_COLUMN_SIZE; ++i) {
+        tui->storage_data[i]        = data->storage_data[i];
+        tui->storage_data_item[i]   = tui_create_items(data->storage_data[i], data->storage_data[i] + tui->storage_size);
+        tui->storage_column[i]      = new_menu(tui->storage_data_item[i]);
+    }
+
+    int x = 0, y = 0;
+    getmaxyx(stdscr, x, y);
+
+    /* create the window to be associated with the menu */
+    tui->storage_columns_win = newwin(x-TUI_HEADER_HEIGHT-1, y, TUI_HEADER_HEIGHT, 0);
+    tui->storage_columns_sub_win = calloc(TUI_STORAGE_COLUMN_SIZE, sizeof(WINDOW *));
+    keypad(tui->storage_columns_win, TRUE);
+
+    free(data);
+}
+
+void tui_draw_storage_columns(tui_storage_data *tui)
+{
+    int height = 0, max_width = 0;
+    getmaxyx(stdscr, height, max_width);
+
+    int total_column_width = 0;
+    for (int i = 0; i != TUI_STORAGE_COLUMN_SIZE; ++i) {
+        /* columns past the right edge of the screen are not shown */
+        int width = tui_storage_column_width[i];
+        if (total_column_width + width > max_width)
+            width = max_width - total_column_width;
+        if (width <= 0 || !tui->storage_column[i])
+            break;
+
+        set_menu_win(tui->storage_column[i], tui->storage_columns_win);
+        tui->storage_columns_sub_win[i] = derwin(tui->storage_columns_win, height-TUI_HEADER_HEIGHT-1,
+                                                 width, 0, total_column_width);
+
+        touchwin(tui->storage_columns_win);
+        set_menu_sub(tui->storage_column[i], tui->storage_columns_sub_win[i]);
+        set_menu_format(tui->storage_column[i], height-TUI_HEADER_HEIGHT-1, 1);
+        set_menu_mark(tui->storage_column[i], NULL);
+
+        post_menu(tui->storage_column[i]);
+
+        total_column_width += tui_storage_column_width[i];
+    }
+}
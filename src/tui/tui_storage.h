@@ -0,0 +1,89 @@
+/* This file contains routines to draw storage columns
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TUI_STORAGE_H
+#define TUI_STORAGE_H
+/** @file tui_storage.h 
+ * This file contains routines to draw storage columns */
+#include "tui.h"
+#include "virt_storage.h"
+/** Number of columns displayed in the storage mode */
+#define TUI_STORAGE_COLUMN_SIZE (8)
+
+/** Columns width */
+int tui_storage_column_width[TUI_STORAGE_COLUMN_SIZE];
+/** Column header strings printed right above the storage columns. */
+const char *tui_storage_column_header[TUI_STORAGE_COLUMN_SIZE];
+
+/** Represents storage column type, in the order of virt_storage_data_type_enum */
+typedef enum {
+    TUI_STORAGE_COLUMN_NAME,
+    TUI_STORAGE_COLUMN_STATE,
+    TUI_STORAGE_COLUMN_CAPACITY,
+    TUI_STORAGE_COLUMN_ALLOCATION,
+    TUI_STORAGE_COLUMN_AVAILABLE,
+    TUI_STORAGE_COLUMN_USED_PRC,
+    TUI_STORAGE_COLUMN_GROWTH,
+    TUI_STORAGE_COLUMN_FULL_IN
+} tui_storage_column_enum;
+
+/**
+ * Struct that holds storage rows.
+ */
+typedef struct tui_storage_data {
+    char    **storage_data[TUI_STORAGE_COLUMN_SIZE];        /** Storage data strings */
+    ITEM    **storage_data_item[TUI_STORAGE_COLUMN_SIZE];   /** Storage column items */
+    MENU    **storage_column;                               /** Holds storage item objects */
+    WINDOW  *storage_columns_win;                           /** Holds storage_column */
+    WINDOW  **storage_columns_sub_win;                      /** Subwindows holding columns */
+
+    size_t storage_size;        /** Total number of storage rows */
+} tui_storage_data;
+
+/**
+ * Set storage columns object to default state.
+ * @param tui - pointer to the tui_storage_data that draws on the screen
+ */
+void tui_init_storage_columns(tui_storage_data *tui);
+
+/**
+ * Deinitialize the storage columns object.
+ * @param tui - pointer to the tui_storage_data that draws on the screen
+ */
+void tui_deinit_storage_columns(tui_storage_data *tui);
+
+/**
+ * Draw storage column headers, right above the columns.
+ */
+void tui_draw_storage_column_header();
+
+/**
+ * Create the menus of the storage columns from the rendered storage rows.
+ * @param tui   - pointer to the tui_storage_data that draws on the screen
+ * @param vdata - pointer to virt_storage_data, released by the function
+ */
+void tui_create_storage(tui_storage_data *tui, void *vdata);
+
+/**
+ * Attach the storage columns which fit the screen to their subwindows.
+ * @param tui - pointer to the tui_storage_data that draws on the screen
+ */
+void tui_draw_storage_columns(tui_storage_data *tui);
+
+#endif /* TUI_STORAGE_H */
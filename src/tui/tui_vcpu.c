@@ -0,0 +1,195 @@
+/* This file contains routines to draw vCPU columns
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tui_vcpu.h"
+#include "virt_plan.h"
+
+int tui_vcpu_column_width[TUI_VCPU_COLUMN_SIZE] = {
+    25, 6, 10, 6, 8, 8, 8, 40
+};
+
+const char *tui_vcpu_column_header[TUI_VCPU_COLUMN_SIZE] = {
+    "DOMAIN",
+    "VCPU",
+    "STATE",
+    "CPU",
+    "TIME(%)",
+    "WAIT(%)",
+    "HALTED",
+    "PINNING"
+};
+
+void tui_init_vcpu_columns(tui_vcpu_data *tui)
+{
+    for (int i = 0; i != TUI_VCPU_COLUMN_SIZE; ++i) {
+        tui->vcpu_data[i] = NULL;
+        tui->vcpu_data_item[i] = NULL;
+    }
+
+    tui->vcpu_column            = NULL;
+    tui->vcpu_columns_win       = NULL;
+    tui->vcpu_columns_sub_win   = NULL;
+
+    tui->vcpu_size = 0;
+}
+
+void tui_deinit_vcpu_columns(tui_vcpu_data *tui)
+{
+    /* free columns */
+    if (tui->vcpu_column) {
+        for (int i = 0; i != TUI_VCPU_COLUMN_SIZE; ++i) {
+            if (tui->vcpu_column[i]) {
+                unpost_menu(tui->vcpu_column[i]);
+                free_menu(tui->vcpu_column[i]);
+            }
+        }
+    }
+    free(tui->vcpu_column);
+
+    /* free items and strings */
+    for (int i = 0; i != TUI_VCPU_COLUMN_SIZE; ++i) {
+        for (int j = 0; j != tui->vcpu_size; ++j) {
+            if (tui->vcpu_data_item[i][j])
+                free_item(tui->vcpu_data_item[i][j]);
+            free(tui->vcpu_data[i][j]);
+        }
+        free(tui->vcpu_data_item[i]);
+        free(tui->vcpu_data[i]);
+    }
+
+    if (tui->vcpu_columns_win) {
+        for (int i = 0; i != TUI_VCPU_COLUMN_SIZE; ++i)
+            if (tui->vcpu_columns_sub_win[i])
+                delwin(tui->vcpu_columns_sub_win[i]);
+        free(tui->vcpu_columns_sub_win);
+        delwin(tui->vcpu_columns_win);
+    }
+}
+
+void tui_draw_vcpu_column_header()
+{
+    int x   = 0;
+    int y   = TUI_HEADER_HEIGHT-1;
+    move(y, x);
+
+    attron(COLOR_PAIR(TUI_COLOR_COLUMN_HEADER_TEXT));
+
+    int max_x = getmaxx(stdscr);
+
+    /* first print n empty spaces where n is the width of i column,
+     * then print i column header at (y, x) and move over the y*/
+    for (int i = 0; i != TUI_VCPU_COLUMN_SIZE && x < max_x; ++i) {
+        for (int j = 0; j != tui_vcpu_column_width[i] && x + j < max_x; ++j)
+            printw(" ");
+        mvprintw(y, x, tui_vcpu_column_header[i]);
+        x += tui_vcpu_column_width[i];
+    }
+
+    /* fill up the rest of the screen */
+    getyx(stdscr, y, x);
+    for (int i = 0; i < max_x - x; ++i)
+        printw(" ");
+    attroff(COLOR_PAIR(TUI_COLOR_COLUMN_HEADER_TEXT));
+}
+
+void tui_create_vcpu(tui_vcpu_data *tui, void *vdata)
+{
+    virt_vcpu_data *data = (virt_vcpu_data *)vdata;
+    /* last item counts as NULL */
+    tui->vcpu_size = data->vcpu_size;
+
+    tui->vcpu_column = calloc(TUI_VCPU_COLUMN_SIZE, sizeof(MENU *));
+    for (int i = 0; i != TUI_VCPU_COLUMN_SIZE; ++i) {
+        tui->vcpu_data[i]       = data->vcpu_data[i];
+        tui->vcpu_data_item[i]  = tui_create_items(data->vcpu_data[i], data->vcpu_data[i] + tui->vcpu_size);
+        tui->vcpu_column[i]     = new_menu(tui->vcpu_data_item[i]);
+    }
+
+    int x = 0, y = 0;
+    getmaxyx(stdscr, x, y);
+
+    /* create the window to be associated with the menu */
+    tui->vcpu_columns_win = newwin(x-TUI_HEADER_HEIGHT-1, y, TUI_HEADER_HEIGHT, 0);
+    tui->vcpu_columns_sub_win = calloc(TUI_VCPU_COLUMN_SIZE, sizeof(WINDOW *));
+    keypad(tui->vcpu_columns_win, TRUE);
+
+    free(data);
+}
+
+void tui_draw_vcpu_columns(tui_vcpu_data *tui)
+{
+    int height = 0, max_width = 0;
+    getmaxyx(stdscr, height, max_width);
+
+    int total_column_width = 0;
+    for (int i = 0; i != TUI_VCPU_COLUMN_SIZE; ++i) {
+        /* columns past the right edge of the screen are not shown */
+        int width = tui_vcpu_column_width[i];
+        if (total_column_width + width > max_width)
+            width = max_width - total_column_width;
+        if (width <= 0 || !tui->vcpu_column[i])
+            break;
+
+        set_menu_win(tui->vcpu_column[i], tui->vcpu_columns_win);
+        tui->vcpu_columns_sub_win[i] = derwin(tui->vcpu_columns_win, height-TUI_HEADER_HEIGHT-1,
+                                              width, 0, total_column_width);
+
+        touchwin(tui->vcpu_columns_win);
+        set_menu_sub(tui->vcpu_column[i], tui->vcpu_columns_sub_win[i]);
+        set_menu_format(tui->vcpu_column[i], height-TUI_HEADER_HEIGHT-1, 1);
+        set_menu_mark(tui->vcpu_column[i], NULL);
+
+        post_menu(tui->vcpu_column[i]);
+
+        total_column_width += tui_vcpu_column_width[i];
+    }
+}
+
+void tui_plan_vcpu_columns(tui_vcpu_data *tui, virt_data *virt)
+{
+    int height = 0, width = 0;
+    getmaxyx(stdscr, height, width);
+
+    /* same columns as tui_draw_vcpu_columns, the rest is cut off by the screen edge */
+    virt_plan_clear_columns(virt->plan);
+    int total_column_width = 0;
+    for (int i = 0; i != TUI_VCPU_COLUMN_SIZE && total_column_width < width; ++i) {
+        virt_plan_add_groups(virt->plan, virt_vcpu_type_groups[i]);
+        total_column_width += tui_vcpu_column_width[i];
+    }
+
+    /* the window covers the domains of the first and the last visible vCPU row */
+    int top = 0;
+    if (tui->vcpu_column && tui->vcpu_column[0] && tui->vcpu_size > 1)
+        top = top_row(tui->vcpu_column[0]);
+    int rows = height - TUI_HEADER_HEIGHT - 1;
+    if (top < 0)
+        top = 0;
+    if (rows < 1)
+        rows = 1;
+
+    int first = virt_vcpu_row(virt, top);
+    int last  = virt_vcpu_row(virt, top + rows - 1);
+    if (last < 0)
+        last = virt_vcpu_row(virt, (int)virt->vcpu->row_size - 1);
+    if (first < 0)
+        virt_plan_set_viewport(virt->plan, 0, virt->records->record_size);
+    else
+        virt_plan_set_viewport(virt->plan, first, last - first + 1);
+}
@@ -0,0 +1,97 @@
+/* This file contains routines to draw vCPU columns
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TUI_VCPU_H
+#define TUI_VCPU_H
+/** @file tui_vcpu.h 
+ * This file contains routines to draw vCPU columns */
+#include "tui.h"
+#include "virt_vcpu.h"
+/** Number of columns displayed in the vCPU mode */
+#define TUI_VCPU_COLUMN_SIZE (8)
+
+/** Columns width */
+int tui_vcpu_column_width[TUI_VCPU_COLUMN_SIZE];
+/** Column header strings printed right above the vCPU columns. */
+const char *tui_vcpu_column_header[TUI_VCPU_COLUMN_SIZE];
+
+/** Represents vCPU column type, in the order of virt_vcpu_data_type_enum */
+typedef enum {
+    TUI_VCPU_COLUMN_DOMAIN,
+    TUI_VCPU_COLUMN_VCPU,
+    TUI_VCPU_COLUMN_STATE,
+    TUI_VCPU_COLUMN_CPU,
+    TUI_VCPU_COLUMN_TIME_PRC,
+    TUI_VCPU_COLUMN_WAIT_PRC,
+    TUI_VCPU_COLUMN_HALTED,
+    TUI_VCPU_COLUMN_PINNING
+} tui_vcpu_column_enum;
+
+/**
+ * Struct that holds vCPU rows.
+ */
+typedef struct tui_vcpu_data {
+    char    **vcpu_data[TUI_VCPU_COLUMN_SIZE];          /** vCPU data strings */
+    ITEM    **vcpu_data_item[TUI_VCPU_COLUMN_SIZE];     /** vCPU column items */
+    MENU    **vcpu_column;                              /** Holds vCPU item objects */
+    WINDOW  *vcpu_columns_win;                          /** Holds vcpu_column */
+    WINDOW  **vcpu_columns_sub_win;                     /** Subwindows holding columns */
+
+    size_t vcpu_size;           /** Total number of vCPU rows */
+} tui_vcpu_data;
+
+/**
+ * Set vCPU columns object to default state.
+ * @param tui - pointer to the tui_vcpu_data that draws on the screen
+ */
+void tui_init_vcpu_columns(tui_vcpu_data *tui);
+
+/**
+ * Deinitialize the vCPU columns object.
+ * @param tui - pointer to the tui_vcpu_data that draws on the screen
+ */
+void tui_deinit_vcpu_columns(tui_vcpu_data *tui);
+
+/**
+ * Draw vCPU column headers, right above the columns.
+ */
+void tui_draw_vcpu_column_header();
+
+/**
+ * Create the menus of the vCPU columns from the rendered vCPU rows.
+ * @param tui   - pointer to the tui_vcpu_data that draws on the screen
+ * @param vdata - pointer to virt_vcpu_data, released by the function
+ */
+void tui_create_vcpu(tui_vcpu_data *tui, void *vdata);
+
+/**
+ * Attach the vCPU columns which fit the screen to their subwindows.
+ * @param tui - pointer to the tui_vcpu_data that draws on the screen
+ */
+void tui_draw_vcpu_columns(tui_vcpu_data *tui);
+
+/**
+ * Tell the virt layer what the screen shows: groups of the columns which
+ * fit the screen width and domain rows of the visible vCPU rows.
+ * @param tui  - pointer to the tui_vcpu_data that draws on the screen
+ * @param virt - virt data, its plan is updated
+ */
+void tui_plan_vcpu_columns(tui_vcpu_data *tui, virt_data *virt);
+
+#endif /* TUI_VCPU_H */
@@ -18,6 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "utils.h"
+#include <time.h>
 #define NUMBER_BUFFER_SIZE 30
 
 char *number_to_str(void *x, const char *format, type_tag tag)
@@ -91,3 +92,57 @@ void free_pointer_char(char **begin, char **end)
     }
     free(begin);
 }
+
+unsigned long long time_monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+const char *xml_element(const char *begin, const char *end, const char *element)
+{
+    const char *p = strstr(begin, element);
+    return p && p < end ? p : NULL;
+}
+
+char *xml_attr(const char *tag, const char *end, const char *name)
+{
+    if (!tag)
+        return NULL;
+
+    const char *close = strchr(tag, '>');
+    size_t len = strlen(name);
+    for (const char *p = tag + 1; close && p < close && p < end; ++p) {
+        if (p[-1] == ' ' && strncmp(p, name, len) == 0 && p[len] == '=' &&
+            (p[len + 1] == '\'' || p[len + 1] == '"')) {
+            const char *value = p + len + 2;
+            const char *quote = strchr(value, p[len + 1]);
+            if (!quote)
+                return NULL;
+
+            char *copy = malloc(quote - value + 1);
+            if (!copy)
+                return NULL;
+            memcpy(copy, value, quote - value);
+            copy[quote - value] = '\0';
+            return copy;
+        }
+    }
+    return NULL;
+}
+
+int xml_text_ull(const char *tag, const char *end, unsigned long long *value)
+{
+    if (!tag)
+        return 0;
+
+    const char *close = strchr(tag, '>');
+    if (!close || close >= end || close[-1] == '/')
+        return 0;
+
+    char *stop = NULL;
+    *value = strtoull(close + 1, &stop, 10);
+    return stop != close + 1;
+}
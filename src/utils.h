@@ -90,4 +90,36 @@ char *copy_str(const char *str);
  */
 void free_pointer_char(char **begin, char **end);
 
+/**
+ * Read the monotonic clock, which is not affected by system time changes.
+ * @return current time in microseconds
+ */
+unsigned long long time_monotonic_us();
+
+/**
+ * Find the first element between begin and end of a XML document.
+ * @param begin   - where the search starts
+ * @param end     - where the search stops
+ * @param element - opening of the tag, e.g. "<mac "
+ * @return start of the element, NULL if there is none
+ */
+const char *xml_element(const char *begin, const char *end, const char *element);
+/**
+ * Copy the value of an attribute of the element starting at tag.
+ * Returned value must be freed by the user.
+ * @param tag  - start of the element, NULL is accepted
+ * @param end  - where the search stops
+ * @param name - name of the attribute
+ * @return copy of the value, NULL if the element has no such attribute
+ */
+char *xml_attr(const char *tag, const char *end, const char *name);
+/**
+ * Read the text of the element starting at tag as a number, e.g. <vcpu>4</vcpu>.
+ * @param tag   - start of the element, NULL is accepted
+ * @param end   - where the search stops
+ * @param value - filled with the number
+ * @return 1 if the number was read, 0 otherwise
+ */
+int xml_text_ull(const char *tag, const char *end, unsigned long long *value);
+
 #endif /* UTILS_H */
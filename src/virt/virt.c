@@ -21,16 +21,26 @@
 #include "virt.h"
 #include "virt_node.h"
 #include "virt_domain.h"
+#include "virt_trace.h"
+#include "virt_record.h"
+#include "virt_plan.h"
+#include "virt_lane.h"
+#include "virt_health.h"
+#include "virt_command.h"
+#include "virt_errors.h"
+#include "virt_vcpu.h"
+#include "virt_storage.h"
+#include "virt_network.h"
+#include "virt_jobs.h"
+#include "virt_detail.h"
 #include "utils.h"
 #include "tui.h"
 #include <stdio.h>
 
 void virt_error_function(void *userdata, virErrorPtr error)
 {
-    syslog(LOG_ERR, "Failure of libvirt library call:\n Code: %d, Domain: %d, Message: %s, Level: %d\n",
-                    error->code, error->domain, error->message, error->level);
-                     /* "str1: %s, str2: %s, str3: %s, int1: %d, int2: %d\n" */
-                    /* err->str1 err->str2 err->str3 err->int1 error->int2);*/
+    /* logged in rate limited summaries, never from the calling thread */
+    virt_errors_report(error);
 }
 
 void virt_setup()
@@ -42,6 +52,36 @@ void virt_init_all(virt_data *virt)
 {
     virt->domain        = NULL;
     virt->domain_size   = 0;
+
+    virt->records       = malloc(sizeof(virt_record_data));
+    virt_init_records(virt->records);
+
+    virt->plan          = malloc(sizeof(virt_plan_data));
+    virt_init_plan(virt->plan);
+
+    virt->lane          = malloc(sizeof(virt_lane_data));
+    virt_init_lane(virt->lane, VIRT_LANE_INTERVAL);
+
+    virt->health        = malloc(sizeof(virt_health_data));
+    virt_init_health(virt->health);
+
+    virt->node          = malloc(sizeof(virt_node_cache));
+    virt_init_node_cache(virt->node);
+
+    virt->vcpu          = malloc(sizeof(virt_vcpu_view));
+    virt_init_vcpu_view(virt->vcpu);
+
+    virt->storage       = malloc(sizeof(virt_storage_cache));
+    virt_init_storage_cache(virt->storage);
+
+    virt->network       = malloc(sizeof(virt_network_cache));
+    virt_init_network_cache(virt->network);
+
+    virt->jobs          = malloc(sizeof(virt_jobs_cache));
+    virt_init_jobs_cache(virt->jobs);
+
+    virt->detail        = malloc(sizeof(virt_detail_cache));
+    virt_init_detail_cache(virt->detail);
 }
 
 static void virt_free_domains(virt_data *virt)
@@ -56,80 +96,159 @@ void virt_deinit_all(virt_data *virt)
 {
     virt_free_domains(virt);
 
-    virConnectClose(virt->conn);
+    virt_deinit_records(virt->records);
+    free(virt->records);
+    free(virt->plan);
+
+    virt_deinit_lane(virt->lane);
+    free(virt->lane);
+
+    virt_health_unwatch(virt);
+    virt_network_unwatch(virt->network);
+    virt_jobs_unwatch(virt->jobs);
+    virt_detail_unwatch(virt->detail);
+    if (virt->conn)
+        virConnectClose(virt->conn);
+    virt_deinit_health(virt->health);
+    free(virt->health);
+
+    virt_deinit_node_cache(virt->node);
+    free(virt->node);
+
+    virt_deinit_vcpu_view(virt->vcpu);
+    free(virt->vcpu);
+
+    virt_deinit_storage_cache(virt->storage);
+    free(virt->storage);
+
+    virt_deinit_network_cache(virt->network);
+    free(virt->network);
+
+    virt_deinit_jobs_cache(virt->jobs);
+    free(virt->jobs);
+
+    virt_deinit_detail_cache(virt->detail);
+    free(virt->detail);
 }
 
 void virt_reset_all(virt_data *virt)
 {
     virt_free_domains(virt);
-    virt_init_all(virt);
+    virt->domain        = NULL;
+    virt->domain_size   = 0;
+}
+
+/*
+ * Queue the command for the domain of the row on the command connection.
+ * @param virt     - pointer with virt data
+ * @param index    - domain index, row of the domain records
+ * @param function - command to be run
+ */
+static void virt_domain_command(virt_data *virt, int index, virt_command_function function)
+{
+    if (index >= 0 && index < virt->records->record_size)
+        virt_command_submit(virt->records->record[index].uuid, function);
 }
 
 void virt_domain_autostart_wrapper(virt_data *virt, int index)
 {
-    if (virt->domain_size > 0)
-        virt_domain_autostart(virt->domain[index]);
+    virt_domain_command(virt, index, virt_domain_autostart);
 }
 
 void virt_domain_create_wrapper(virt_data *virt, int index)
 {
-    if (virt->domain_size > 0)
-        virt_domain_create(virt->domain[index]);
+    virt_domain_command(virt, index, virt_domain_create);
 }
 
 void virt_domain_pause_wrapper(virt_data *virt, int index)
 {
-    if (virt->domain_size > 0)
-        virt_domain_pause(virt->domain[index]);
+    virt_domain_command(virt, index, virt_domain_pause);
 }
 
 void virt_domain_reboot_wrapper(virt_data *virt, int index)
 {
-    if (virt->domain_size > 0)
-        virt_domain_reboot(virt->domain[index]);
+    virt_domain_command(virt, index, virt_domain_reboot);
 }
 
 void virt_domain_destroy_wrapper(virt_data *virt, int index)
 {
-    if (virt->domain_size > 0)
-        virt_domain_destroy(virt->domain[index]);
+    virt_domain_command(virt, index, virt_domain_destroy);
 }
 
-virConnectPtr virt_connect_node(char **conn_args)
+int virt_domain_row(virt_data *virt, int index)
+{
+    return index;
+}
+
+virConnectPtr virt_connect_node(char **conn_args, int read_only)
 {
     virConnectPtr conn = NULL;
 
     if (conn_args) {
+        unsigned long long trace = virt_trace_begin();
         /* check if system or session connection */
         if (strcmp(conn_args[0], CONNECTION_SYSTEM)  == 0 || 
             strcmp(conn_args[0], CONNECTION_SESSION) == 0)
-            conn = virConnectOpen(conn_args[0]);
+            conn = read_only ? virConnectOpenReadOnly(conn_args[0]) : virConnectOpen(conn_args[0]);
         else
-            conn = virConnectOpenAuth(conn_args[0], virConnectAuthPtrDefault, 0);
+            conn = virConnectOpenAuth(conn_args[0], virConnectAuthPtrDefault, read_only ? VIR_CONNECT_RO : 0);
+        virt_trace_end(VIRT_TRACE_API_CONNECT_OPEN, NULL, trace, conn == NULL);
     }
     return conn;
 }
 
 virt_get_function virt_get[VIRT_GET_FUNCTION_SIZE] = {
     virt_get_domain_data,
+    virt_get_vcpu_data,
+    virt_get_storage_data,
+    virt_get_network_data,
+    virt_get_jobs_data
 };
 
 virt_autostart_function virt_autostart[VIRT_AUTOSTART_FUNCTION_SIZE] = {
-    virt_domain_autostart_wrapper
+    virt_domain_autostart_wrapper,
+    virt_vcpu_autostart_wrapper,
+    virt_storage_no_command,
+    virt_network_no_command,
+    virt_jobs_autostart_wrapper
 };
 
 virt_create_function virt_create[VIRT_CREATE_FUNCTION_SIZE] = {
-    virt_domain_create_wrapper
+    virt_domain_create_wrapper,
+    virt_vcpu_create_wrapper,
+    virt_storage_no_command,
+    virt_network_no_command,
+    virt_jobs_create_wrapper
 };
 
 virt_pause_function virt_pause[VIRT_PAUSE_FUNCTION_SIZE] = {
-    virt_domain_pause_wrapper
+    virt_domain_pause_wrapper,
+    virt_vcpu_pause_wrapper,
+    virt_storage_no_command,
+    virt_network_no_command,
+    virt_jobs_pause_wrapper
 };
 
 virt_reboot_function virt_reboot[VIRT_REBOOT_FUNCTION_SIZE] = {
-    virt_domain_reboot_wrapper
+    virt_domain_reboot_wrapper,
+    virt_vcpu_reboot_wrapper,
+    virt_storage_no_command,
+    virt_network_no_command,
+    virt_jobs_reboot_wrapper
 };
 
 virt_destroy_function virt_destroy[VIRT_DESTROY_FUNCTION_SIZE] = {
-    virt_domain_destroy_wrapper
+    virt_domain_destroy_wrapper,
+    virt_vcpu_destroy_wrapper,
+    virt_storage_no_command,
+    virt_network_no_command,
+    virt_jobs_destroy_wrapper
+};
+
+virt_row_function virt_row[VIRT_ROW_FUNCTION_SIZE] = {
+    virt_domain_row,
+    virt_vcpu_row,
+    virt_storage_row,
+    virt_network_row,
+    virt_jobs_row
 };
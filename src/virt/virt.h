@@ -41,17 +41,19 @@
 /** Size of array containing function pointers to virt reset functions */
 #define VIRT_RESET_FUNCTION_SIZE (1)
 /** Size of array containing function pointers to virt get functions */
-#define VIRT_GET_FUNCTION_SIZE (1)
+#define VIRT_GET_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to virt autostart functions */
-#define VIRT_AUTOSTART_FUNCTION_SIZE (1)
+#define VIRT_AUTOSTART_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to virt create functions */
-#define VIRT_CREATE_FUNCTION_SIZE (1)
+#define VIRT_CREATE_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to virt pause functions */
-#define VIRT_PAUSE_FUNCTION_SIZE (1)
+#define VIRT_PAUSE_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to virt reboot functions */
-#define VIRT_REBOOT_FUNCTION_SIZE (1)
+#define VIRT_REBOOT_FUNCTION_SIZE (5)
 /** Size of array containing function pointers to virt destroy functions */
-#define VIRT_DESTROY_FUNCTION_SIZE (1)
+#define VIRT_DESTROY_FUNCTION_SIZE (5)
+/** Size of array containing function pointers to virt row functions */
+#define VIRT_ROW_FUNCTION_SIZE (5)
 
 /** List of virt errors */
 typedef enum {
@@ -68,15 +70,47 @@ void virt_setup();
 /**
  * Connect to target node
  * @param conn_args - Target domain URL with parameters
+ * @param read_only - TRUE (1) to open a read-only connection, e.g. for collecting statistics
  * @return valid virConnectPtr, NULL otherwise
  */
-virConnectPtr virt_connect_node(char **conn_args);
+virConnectPtr virt_connect_node(char **conn_args, int read_only);
+
+/** Forward declaration of virt_record_data */
+typedef struct virt_record_data virt_record_data;
+/** Forward declaration of virt_plan_data */
+typedef struct virt_plan_data virt_plan_data;
+/** Forward declaration of virt_lane_data */
+typedef struct virt_lane_data virt_lane_data;
+/** Forward declaration of virt_health_data */
+typedef struct virt_health_data virt_health_data;
+/** Forward declaration of virt_node_cache */
+typedef struct virt_node_cache virt_node_cache;
+/** Forward declaration of virt_vcpu_view */
+typedef struct virt_vcpu_view virt_vcpu_view;
+/** Forward declaration of virt_storage_cache */
+typedef struct virt_storage_cache virt_storage_cache;
+/** Forward declaration of virt_network_cache */
+typedef struct virt_network_cache virt_network_cache;
+/** Forward declaration of virt_jobs_cache */
+typedef struct virt_jobs_cache virt_jobs_cache;
+/** Forward declaration of virt_detail_cache */
+typedef struct virt_detail_cache virt_detail_cache;
 
 /** Handler to the libvirt's API. */
 typedef struct {
     virConnectPtr   conn;           /** Connection pointer to target node */
     virDomainPtr    *domain;        /** Pointer to existing domains */
     size_t          domain_size;    /** Total number of existing domains */
+    virt_record_data *records;      /** Persistent domain records, in row order */
+    virt_plan_data  *plan;          /** What the next refresh collects, filled by the screen */
+    virt_lane_data  *lane;          /** Fast lane sampling selected domains */
+    virt_health_data *health;       /** Connection state, conn is NULL while disconnected */
+    virt_node_cache *node;          /** Static node information and host CPU meters */
+    virt_vcpu_view  *vcpu;          /** Domains expanded into vCPU rows */
+    virt_storage_cache *storage;    /** Storage pools and volumes */
+    virt_network_cache *network;    /** Virtual networks, leases and the vNIC map */
+    virt_jobs_cache *jobs;          /** Domain jobs, migrations above all */
+    virt_detail_cache *detail;      /** Parsed domain descriptions of the detail pane */
 } virt_data;
 
 /**
@@ -94,7 +128,8 @@ void virt_init_all(virt_data *virt);
 void virt_deinit_all(virt_data *virt);
 
 /**
- * Deinitialize virt data first and then set it's data to default values.
+ * Release the domain listing of the last refresh.
+ * Persistent domain records are kept.
  * @param virt - Pointer with virt data
  * @see virt_deinit_all
  * @see virt_init_all
@@ -105,7 +140,7 @@ void virt_reset_all(virt_data *virt);
 /*
  * Call the virt_autostart_domain function through virt_autostart
  * @param virt  - pointer with virt data
- * @param index - domain index
+ * @param index - domain index, row of the domain records
  * @see virt_autostart_domain
  * @see virt_autostart
  */
@@ -147,6 +182,14 @@ void virt_domain_reboot_wrapper(virt_data *virt, int index);
  */
 void virt_domain_destroy_wrapper(virt_data *virt, int index);
 
+/*
+ * Return the domain row of a row of the domain list, which is the row itself
+ * @param virt  - pointer with virt data
+ * @param index - domain row
+ * @return domain row
+ */
+int virt_domain_row(virt_data *virt, int index);
+
 /** virt get functions */
 typedef void *(*virt_get_function)(virt_data *virt);
 virt_get_function virt_get[VIRT_GET_FUNCTION_SIZE];
@@ -171,4 +214,8 @@ virt_reboot_function virt_reboot[VIRT_REBOOT_FUNCTION_SIZE];
 typedef void (*virt_destroy_function)(virt_data *virt, int index);
 virt_destroy_function virt_destroy[VIRT_DESTROY_FUNCTION_SIZE];
 
+/** virt row functions, map a row of the mode to the domain row */
+typedef int (*virt_row_function)(virt_data *virt, int index);
+virt_row_function virt_row[VIRT_ROW_FUNCTION_SIZE];
+
 #endif /* VIRT_H */
@@ -0,0 +1,292 @@
+/* This file contains the lifecycle command queue on the read-write connection
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_command.h"
+#include "virt_trace.h"
+#include "utils.h"
+#include <pthread.h>
+
+/** Queued command */
+typedef struct virt_command {
+    struct virt_command         *next;
+    unsigned char               uuid[VIR_UUID_BUFLEN];
+    virt_command_function       function;
+    virt_command_arg_function   arg_function;   /** Run instead of function if set */
+    void                        *arg;           /** Copy of the arguments of arg_function */
+} virt_command;
+
+/** State of the command thread, guarded by lock */
+static struct {
+    pthread_mutex_t     lock;
+    pthread_cond_t      work;       /** Signaled when a command is queued or the thread stops */
+    pthread_cond_t      done;       /** Signaled when the thread exits */
+    virt_command        *head;      /** Queued commands, oldest first */
+    virt_command        *tail;
+    size_t              pending;    /** Queued and running commands */
+    virConnectPtr       conn;       /** Read-write connection, NULL in monitoring only sessions */
+    char                *uri;       /** URI used to reopen a dead connection */
+    int                 started;
+    int                 stop;
+} command = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER
+};
+
+/* Free a command together with its arguments */
+static void virt_command_free(virt_command *cmd)
+{
+    free(cmd->arg);
+    free(cmd);
+}
+
+/* Reopen the read-write connection if libvirt gave up on it, called by the command thread */
+static void virt_command_revive()
+{
+    pthread_mutex_lock(&command.lock);
+    virConnectPtr conn = command.conn;
+    if (conn)
+        virConnectRef(conn);
+    pthread_mutex_unlock(&command.lock);
+
+    if (conn && virConnectIsAlive(conn) != 0) {
+        virConnectClose(conn);
+        return;
+    }
+
+    char *conn_args[1] = { command.uri };
+    virConnectPtr fresh = virt_connect_node(conn_args, 0);
+
+    pthread_mutex_lock(&command.lock);
+    if (fresh) {
+        /* lookups in flight keep their own reference of the old one */
+        if (command.conn)
+            virConnectClose(command.conn);
+        command.conn = fresh;
+    }
+    pthread_mutex_unlock(&command.lock);
+
+    if (conn)
+        virConnectClose(conn);
+}
+
+/* Run a single command, called by the command thread */
+static void virt_command_run(const virt_command *cmd)
+{
+    pthread_mutex_lock(&command.lock);
+    virConnectPtr conn = command.conn;
+    if (conn)
+        virConnectRef(conn);
+    pthread_mutex_unlock(&command.lock);
+
+    if (!conn)
+        return;
+
+    unsigned long long trace = virt_trace_begin();
+    virDomainPtr domain = virDomainLookupByUUID(conn, cmd->uuid);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_LOOKUP_BY_UUID, NULL, trace, domain == NULL);
+
+    /* failures are reported through the libvirt error callback */
+    if (domain) {
+        if (cmd->arg_function)
+            cmd->arg_function(domain, cmd->arg);
+        else
+            cmd->function(domain);
+        virDomainFree(domain);
+    }
+    virConnectClose(conn);
+}
+
+static void *virt_command_thread(void *arg)
+{
+    pthread_mutex_lock(&command.lock);
+    for (;;) {
+        while (!command.stop && !command.head)
+            pthread_cond_wait(&command.work, &command.lock);
+        if (command.stop)
+            break;
+
+        virt_command *cmd = command.head;
+        command.head = cmd->next;
+        if (!command.head)
+            command.tail = NULL;
+        pthread_mutex_unlock(&command.lock);
+
+        virt_command_revive();
+        virt_command_run(cmd);
+        virt_command_free(cmd);
+
+        pthread_mutex_lock(&command.lock);
+        --command.pending;
+    }
+
+    command.started = 0;
+    pthread_cond_broadcast(&command.done);
+    pthread_mutex_unlock(&command.lock);
+    return NULL;
+}
+
+int virt_command_init(char **conn_args, int read_only)
+{
+    if (read_only || !conn_args)
+        return VIRT_ERROR_FAILURE;
+
+    virConnectPtr conn = virt_connect_node(conn_args, 0);
+    if (!conn)
+        return VIRT_ERROR_FAILURE;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    /* a slow command must not hold up the exit */
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    pthread_mutex_lock(&command.lock);
+    command.conn    = conn;
+    command.uri     = copy_str(conn_args[0]);
+    command.stop    = 0;
+
+    pthread_t thread;
+    command.started = pthread_create(&thread, &attr, virt_command_thread, NULL) == 0;
+    int started = command.started;
+    if (!started) {
+        virConnectClose(command.conn);
+        command.conn = NULL;
+    }
+    pthread_mutex_unlock(&command.lock);
+
+    pthread_attr_destroy(&attr);
+    return started ? VIRT_ERROR_SUCCESS : VIRT_ERROR_FAILURE;
+}
+
+void virt_command_deinit()
+{
+    pthread_mutex_lock(&command.lock);
+    while (command.head) {
+        virt_command *cmd = command.head;
+        command.head = cmd->next;
+        --command.pending;
+        virt_command_free(cmd);
+    }
+    command.tail = NULL;
+
+    command.stop = 1;
+    pthread_cond_broadcast(&command.work);
+
+    /* the connection is closed only if no command is using it */
+    if (command.pending == 0) {
+        while (command.started)
+            pthread_cond_wait(&command.done, &command.lock);
+        if (command.conn)
+            virConnectClose(command.conn);
+        command.conn = NULL;
+        free(command.uri);
+        command.uri = NULL;
+    }
+    pthread_mutex_unlock(&command.lock);
+}
+
+int virt_command_available()
+{
+    pthread_mutex_lock(&command.lock);
+    int available = command.started && command.conn != NULL;
+    pthread_mutex_unlock(&command.lock);
+    return available;
+}
+
+/* Append a command to the queue, it is freed if the command thread is not running */
+static int virt_command_queue(virt_command *cmd)
+{
+    pthread_mutex_lock(&command.lock);
+    if (!command.started || command.stop) {
+        pthread_mutex_unlock(&command.lock);
+        virt_command_free(cmd);
+        return VIRT_ERROR_FAILURE;
+    }
+
+    if (command.tail)
+        command.tail->next = cmd;
+    else
+        command.head = cmd;
+    command.tail = cmd;
+    ++command.pending;
+    pthread_cond_signal(&command.work);
+    pthread_mutex_unlock(&command.lock);
+
+    return VIRT_ERROR_SUCCESS;
+}
+
+int virt_command_submit(const unsigned char *uuid, virt_command_function function)
+{
+    virt_command *cmd = calloc(1, sizeof(virt_command));
+    if (!cmd)
+        return VIRT_ERROR_FAILURE;
+    memcpy(cmd->uuid, uuid, VIR_UUID_BUFLEN);
+    cmd->function = function;
+
+    return virt_command_queue(cmd);
+}
+
+int virt_command_submit_arg(const unsigned char *uuid, virt_command_arg_function function,
+                            const void *arg, size_t size)
+{
+    virt_command *cmd = calloc(1, sizeof(virt_command));
+    if (!cmd)
+        return VIRT_ERROR_FAILURE;
+    cmd->arg = malloc(size);
+    if (!cmd->arg) {
+        free(cmd);
+        return VIRT_ERROR_FAILURE;
+    }
+    memcpy(cmd->uuid, uuid, VIR_UUID_BUFLEN);
+    memcpy(cmd->arg, arg, size);
+    cmd->arg_function = function;
+
+    return virt_command_queue(cmd);
+}
+
+size_t virt_command_pending()
+{
+    pthread_mutex_lock(&command.lock);
+    size_t pending = command.pending;
+    pthread_mutex_unlock(&command.lock);
+    return pending;
+}
+
+virDomainPtr virt_command_lookup(virDomainPtr domain)
+{
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    if (virDomainGetUUID(domain, uuid) < 0)
+        return NULL;
+
+    pthread_mutex_lock(&command.lock);
+    virConnectPtr conn = command.conn;
+    if (conn)
+        virConnectRef(conn);
+    pthread_mutex_unlock(&command.lock);
+
+    if (!conn)
+        return NULL;
+
+    unsigned long long trace = virt_trace_begin();
+    virDomainPtr found = virDomainLookupByUUID(conn, uuid);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_LOOKUP_BY_UUID, NULL, trace, found == NULL);
+
+    virConnectClose(conn);
+    return found;
+}
@@ -0,0 +1,90 @@
+/* This file contains the lifecycle command queue on the read-write connection
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_command.h
+ * This file contains the lifecycle command queue. Statistics are collected
+ * over a read-only connection, commands go over a separate read-write
+ * connection and run one after another on a background thread, so polling
+ * continues at full rate while a slow destroy or create is in progress.
+ * Without the read-write connection the session is monitoring only.
+ */
+#ifndef VIRT_COMMAND_H
+#define VIRT_COMMAND_H
+#include "virt.h"
+
+/** Lifecycle command, e.g. virt_domain_destroy */
+typedef int (*virt_command_function)(virDomainPtr domain);
+
+/** Command with arguments, e.g. a new pinning of a vCPU */
+typedef int (*virt_command_arg_function)(virDomainPtr domain, const void *arg);
+
+/**
+ * Open the read-write connection and start the command thread.
+ * @param conn_args - Target domain URL with parameters
+ * @param read_only - TRUE (1) for a monitoring only session, nothing is opened
+ * @return VIRT_ERROR_SUCCESS if commands are available, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_command_init(char **conn_args, int read_only);
+
+/**
+ * Drop queued commands and stop the command thread.
+ * A command still running is left to finish on its own.
+ */
+void virt_command_deinit();
+
+/**
+ * Check whether commands can be run.
+ * @return TRUE (1) if the read-write connection is open, FALSE (0) in monitoring only sessions
+ */
+int virt_command_available();
+
+/**
+ * Queue a command for the domain.
+ * @param uuid     - domain to be commanded, looked up on the read-write connection
+ * @param function - command to be run
+ * @return VIRT_ERROR_SUCCESS if queued, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_command_submit(const unsigned char *uuid, virt_command_function function);
+
+/**
+ * Queue a command with arguments for the domain.
+ * @param uuid     - domain to be commanded, looked up on the read-write connection
+ * @param function - command to be run
+ * @param arg      - arguments of the command, copied into the queue
+ * @param size     - size of arg in bytes
+ * @return VIRT_ERROR_SUCCESS if queued, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_command_submit_arg(const unsigned char *uuid, virt_command_arg_function function,
+                            const void *arg, size_t size);
+
+/**
+ * Return number of queued and running commands.
+ * @return number of commands not finished yet
+ */
+size_t virt_command_pending();
+
+/**
+ * Look the domain up on the read-write connection, for the few
+ * queries libvirt refuses on read-only connections.
+ * @param domain - domain of the read-only connection
+ * @return referenced domain, NULL if not available
+ */
+virDomainPtr virt_command_lookup(virDomainPtr domain);
+
+#endif /* VIRT_COMMAND_H */
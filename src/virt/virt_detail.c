@@ -0,0 +1,281 @@
+/* This file contains the domain detail, a parsed model of the domain XML
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_detail.h"
+#include "virt_record.h"
+#include "virt_health.h"
+#include "virt_trace.h"
+#include "utils.h"
+#include <stdio.h>
+
+/** Callbacks, indecies of virt_detail_cache.callback */
+enum {
+    VIRT_DETAIL_CALLBACK_LIFECYCLE,
+    VIRT_DETAIL_CALLBACK_DEVICE_ADDED,
+    VIRT_DETAIL_CALLBACK_DEVICE_REMOVED
+};
+
+static void virt_detail_free_model(virt_detail_model *model)
+{
+    for (int i = 0; i != model->disk_size; ++i)
+        free(model->disk[i].source);
+    free(model->disk);
+    for (int i = 0; i != model->nic_size; ++i)
+        free(model->nic[i].source);
+    free(model->nic);
+}
+
+void virt_init_detail_cache(virt_detail_cache *cache)
+{
+    cache->model        = NULL;
+    cache->model_size   = 0;
+    cache->conn         = NULL;
+    for (int i = 0; i != VIRT_DETAIL_CALLBACK_SIZE; ++i)
+        cache->callback[i] = -1;
+}
+
+void virt_deinit_detail_cache(virt_detail_cache *cache)
+{
+    for (int i = 0; i != cache->model_size; ++i)
+        virt_detail_free_model(cache->model + i);
+    free(cache->model);
+}
+
+void virt_detail_invalidate(virt_detail_cache *cache)
+{
+    virt_detail_unwatch(cache);
+    virt_deinit_detail_cache(cache);
+    virt_init_detail_cache(cache);
+}
+
+void virt_detail_unwatch(virt_detail_cache *cache)
+{
+    if (!cache->conn)
+        return;
+
+    for (int i = 0; i != VIRT_DETAIL_CALLBACK_SIZE; ++i) {
+        if (cache->callback[i] >= 0)
+            virConnectDomainEventDeregisterAny(cache->conn, cache->callback[i]);
+        cache->callback[i] = -1;
+    }
+    cache->conn = NULL;
+}
+
+/* Drop the model of the domain, it is fetched again when the pane asks for it */
+static void virt_detail_drop(virt_detail_cache *cache, virDomainPtr domain)
+{
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    if (virDomainGetUUID(domain, uuid) < 0)
+        return;
+
+    for (int i = 0; i != cache->model_size; ++i) {
+        if (memcmp(cache->model[i].uuid, uuid, VIR_UUID_BUFLEN) == 0) {
+            virt_detail_free_model(cache->model + i);
+            cache->model[i] = cache->model[--cache->model_size];
+            return;
+        }
+    }
+}
+
+/* Events are dispatched by the main loop, the model is dropped right away */
+static int virt_detail_lifecycle(virConnectPtr conn, virDomainPtr domain, int event,
+                                 int detail, void *opaque)
+{
+    /* the live description changes with the definition and with the start and stop */
+    if (event == VIR_DOMAIN_EVENT_DEFINED || event == VIR_DOMAIN_EVENT_UNDEFINED ||
+        event == VIR_DOMAIN_EVENT_STARTED || event == VIR_DOMAIN_EVENT_STOPPED)
+        virt_detail_drop(opaque, domain);
+    return 0;
+}
+
+static void virt_detail_device(virConnectPtr conn, virDomainPtr domain,
+                               const char *alias, void *opaque)
+{
+    virt_detail_drop(opaque, domain);
+}
+
+/* Register the callbacks on conn, failed registrations stay at -1 */
+static void virt_detail_watch(virt_detail_cache *cache, virConnectPtr conn)
+{
+    cache->conn = conn;
+    cache->callback[VIRT_DETAIL_CALLBACK_LIFECYCLE] =
+        virConnectDomainEventRegisterAny(conn, NULL, VIR_DOMAIN_EVENT_ID_LIFECYCLE,
+                                         VIR_DOMAIN_EVENT_CALLBACK(virt_detail_lifecycle), cache, NULL);
+    cache->callback[VIRT_DETAIL_CALLBACK_DEVICE_ADDED] =
+        virConnectDomainEventRegisterAny(conn, NULL, VIR_DOMAIN_EVENT_ID_DEVICE_ADDED,
+                                         VIR_DOMAIN_EVENT_CALLBACK(virt_detail_device), cache, NULL);
+    cache->callback[VIRT_DETAIL_CALLBACK_DEVICE_REMOVED] =
+        virConnectDomainEventRegisterAny(conn, NULL, VIR_DOMAIN_EVENT_ID_DEVICE_REMOVED,
+                                         VIR_DOMAIN_EVENT_CALLBACK(virt_detail_device), cache, NULL);
+}
+
+/* Check whether every callback is registered */
+static int virt_detail_watching(const virt_detail_cache *cache)
+{
+    for (int i = 0; i != VIRT_DETAIL_CALLBACK_SIZE; ++i)
+        if (cache->callback[i] < 0)
+            return 0;
+    return 1;
+}
+
+/* Copy the attribute into a fixed size string, empty if the element has no such attribute */
+static void virt_detail_token(char *token, size_t size, const char *tag, const char *end, const char *name)
+{
+    char *value = xml_attr(tag, end, name);
+    snprintf(token, size, "%s", value ? value : "");
+    free(value);
+}
+
+/* Name what the disk is backed by, a file, a block device, a volume or a network disk */
+static char *virt_detail_disk_source(const char *disk, const char *end)
+{
+    const char *source = xml_element(disk, end, "<source ");
+    if (!source)
+        return NULL;
+
+    static const char *attr[] = { "file", "dev", "dir", "name" };
+    for (size_t i = 0; i != sizeof(attr) / sizeof(char *); ++i) {
+        char *value = xml_attr(source, end, attr[i]);
+        if (value)
+            return value;
+    }
+
+    char *pool      = xml_attr(source, end, "pool");
+    char *volume    = xml_attr(source, end, "volume");
+    char *value     = NULL;
+    if (pool && volume) {
+        value = malloc(strlen(pool) + strlen(volume) + 2);
+        sprintf(value, "%s/%s", pool, volume);
+    }
+    free(pool);
+    free(volume);
+    return value;
+}
+
+/* Parse the disks of the description into the model */
+static void virt_detail_parse_disks(virt_detail_model *model, const char *xml)
+{
+    const char *end = xml;
+    for (const char *p = strstr(xml, "<disk "); p; p = strstr(end, "<disk ")) {
+        end = strstr(p, "</disk>");
+        if (!end)
+            break;
+
+        model->disk = realloc(model->disk, (model->disk_size + 1) * sizeof(virt_detail_disk));
+        virt_detail_disk *disk = model->disk + model->disk_size++;
+
+        const char *target = xml_element(p, end, "<target ");
+        virt_detail_token(disk->target, sizeof(disk->target), target, end, "dev");
+        virt_detail_token(disk->bus, sizeof(disk->bus), target, end, "bus");
+        virt_detail_token(disk->type, sizeof(disk->type), p, end, "type");
+        virt_detail_token(disk->device, sizeof(disk->device), p, end, "device");
+        virt_detail_token(disk->format, sizeof(disk->format), xml_element(p, end, "<driver "), end, "type");
+        disk->source = virt_detail_disk_source(p, end);
+    }
+}
+
+/* Parse the network interfaces of the description into the model */
+static void virt_detail_parse_nics(virt_detail_model *model, const char *xml)
+{
+    const char *end = xml;
+    for (const char *p = strstr(xml, "<interface "); p; p = strstr(end, "<interface ")) {
+        end = strstr(p, "</interface>");
+        if (!end)
+            break;
+
+        model->nic = realloc(model->nic, (model->nic_size + 1) * sizeof(virt_detail_nic));
+        virt_detail_nic *nic = model->nic + model->nic_size++;
+
+        const char *source = xml_element(p, end, "<source ");
+        virt_detail_token(nic->mac, sizeof(nic->mac), xml_element(p, end, "<mac "), end, "address");
+        virt_detail_token(nic->model, sizeof(nic->model), xml_element(p, end, "<model "), end, "type");
+        virt_detail_token(nic->dev, sizeof(nic->dev), xml_element(p, end, "<target "), end, "dev");
+        nic->source = xml_attr(source, end, "network");
+        if (!nic->source)
+            nic->source = xml_attr(source, end, "bridge");
+    }
+}
+
+/* Parse the description, the memory is given in KiB by libvirt */
+static void virt_detail_parse(virt_detail_model *model, const char *xml)
+{
+    const char *end = xml + strlen(xml);
+
+    unsigned long long value = 0;
+    const char *vcpu = xml_element(xml, end, "<vcpu ");
+    if (!vcpu)
+        vcpu = xml_element(xml, end, "<vcpu>");
+    if (xml_text_ull(vcpu, end, &value))
+        model->vcpus_max = model->vcpus = (int)value;
+
+    char *current = xml_attr(vcpu, end, "current");
+    if (current)
+        model->vcpus = atoi(current);
+    free(current);
+
+    xml_text_ull(xml_element(xml, end, "<memory unit="), end, &model->memory);
+    if (!xml_text_ull(xml_element(xml, end, "<currentMemory unit="), end, &model->current_memory))
+        model->current_memory = model->memory;
+
+    virt_detail_parse_disks(model, xml);
+    virt_detail_parse_nics(model, xml);
+}
+
+const virt_detail_model *virt_detail_get(virt_data *virt, int row)
+{
+    if (row < 0 || row >= (int)virt->records->record_size || !virt_health_connected(virt))
+        return NULL;
+
+    virt_detail_cache *cache = virt->detail;
+    const virt_domain_record *record = virt->records->record + row;
+
+    if (cache->conn != virt->conn) {
+        virt_detail_unwatch(cache);
+        virt_detail_watch(cache, virt->conn);
+    }
+    /* without the events any model may be out of date, the open pane fetches on every refresh */
+    if (!virt_detail_watching(cache)) {
+        virt_deinit_detail_cache(cache);
+        cache->model        = NULL;
+        cache->model_size   = 0;
+    }
+
+    for (int i = 0; i != cache->model_size; ++i)
+        if (memcmp(cache->model[i].uuid, record->uuid, VIR_UUID_BUFLEN) == 0)
+            return cache->model + i;
+
+    /* hung domains are not asked, the description may wait for the domain */
+    if (!record->domain || record->hung_since)
+        return NULL;
+
+    unsigned long long trace = virt_trace_begin();
+    char *xml = virDomainGetXMLDesc(record->domain, 0);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_XML_DESC, record->domain, trace, xml == NULL);
+    if (!xml)
+        return NULL;
+
+    cache->model = realloc(cache->model, (cache->model_size + 1) * sizeof(virt_detail_model));
+    virt_detail_model *model = cache->model + cache->model_size++;
+    memset(model, 0, sizeof(virt_detail_model));
+    memcpy(model->uuid, record->uuid, VIR_UUID_BUFLEN);
+    virt_detail_parse(model, xml);
+    free(xml);
+
+    return model;
+}
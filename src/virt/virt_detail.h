@@ -0,0 +1,110 @@
+/* This file contains the domain detail, a parsed model of the domain XML
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_detail.h
+ * This file contains the domain detail shown by the detail pane. The XML
+ * description of a domain is fetched only when the pane asks for it, parsed
+ * once into a small model and cached by UUID. A model is dropped when a
+ * domain event says the description changed: the domain was defined,
+ * undefined, started or stopped, or a device was added or removed.
+ */
+#ifndef VIRT_DETAIL_H
+#define VIRT_DETAIL_H
+#include "virt.h"
+/** Number of event callbacks registered by the detail cache */
+#define VIRT_DETAIL_CALLBACK_SIZE (3)
+/** Size of the short strings of the model, device names, buses and formats */
+#define VIRT_DETAIL_TOKEN_SIZE (16)
+/** Size of the MAC address string */
+#define VIRT_DETAIL_MAC_SIZE (18)
+
+/** Disk of the model. */
+typedef struct {
+    char    type[VIRT_DETAIL_TOKEN_SIZE];       /** What backs the disk: file, block, network, volume, ... */
+    char    target[VIRT_DETAIL_TOKEN_SIZE];     /** Device name in the guest, e.g. vda */
+    char    bus[VIRT_DETAIL_TOKEN_SIZE];        /** e.g. virtio, sata */
+    char    device[VIRT_DETAIL_TOKEN_SIZE];     /** disk, cdrom or floppy */
+    char    format[VIRT_DETAIL_TOKEN_SIZE];     /** Driver type, e.g. qcow2, raw */
+    char    *source;                            /** File, device, volume or network name, NULL if empty */
+} virt_detail_disk;
+
+/** Network interface of the model. */
+typedef struct {
+    char    mac[VIRT_DETAIL_MAC_SIZE];
+    char    model[VIRT_DETAIL_TOKEN_SIZE];      /** e.g. virtio, e1000 */
+    char    dev[VIRT_DETAIL_TOKEN_SIZE];        /** Host device, empty while the domain is not running */
+    char    *source;                            /** Network or bridge, NULL if neither */
+} virt_detail_nic;
+
+/** Parsed description of a domain. */
+typedef struct {
+    unsigned char       uuid[VIR_UUID_BUFLEN];  /** Key of the cache */
+    int                 vcpus;                  /** Current vCPUs */
+    int                 vcpus_max;
+    unsigned long long  memory;                 /** Maximum memory in KiB */
+    unsigned long long  current_memory;         /** Memory at boot or current balloon target in KiB */
+    virt_detail_disk    *disk;
+    int                 disk_size;
+    virt_detail_nic     *nic;
+    int                 nic_size;
+} virt_detail_model;
+
+/** Models cached across refreshes. */
+typedef struct virt_detail_cache {
+    virt_detail_model   *model;             /** Models in the order they were fetched */
+    int                 model_size;
+    virConnectPtr       conn;               /** Connection the callbacks are registered on, NULL if none */
+    int                 callback[VIRT_DETAIL_CALLBACK_SIZE];    /** Callback identifiers, -1 if not registered */
+} virt_detail_cache;
+
+/**
+ * Set the cache to default state, nothing is cached.
+ * @param cache - cache to be initialized
+ */
+void virt_init_detail_cache(virt_detail_cache *cache);
+
+/**
+ * Release the cache with all models.
+ * The callbacks must have been deregistered by virt_detail_unwatch.
+ * @param cache - cache to be freed
+ */
+void virt_deinit_detail_cache(virt_detail_cache *cache);
+
+/**
+ * Drop the models of the previous connection.
+ * @param cache - cache to be invalidated
+ */
+void virt_detail_invalidate(virt_detail_cache *cache);
+
+/**
+ * Deregister the event callbacks, must be called before their connection is closed.
+ * @param cache - cache whose callbacks are deregistered
+ */
+void virt_detail_unwatch(virt_detail_cache *cache);
+
+/**
+ * Return the model of the domain, its description is fetched and parsed
+ * if it is not cached. Hung domains are not asked.
+ * @param virt - pointer with virt data
+ * @param row  - row of the domain records
+ * @return model of the domain, NULL if not known
+ */
+const virt_detail_model *virt_detail_get(virt_data *virt, int row);
+
+#endif /* VIRT_DETAIL_H */
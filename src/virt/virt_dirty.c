@@ -0,0 +1,160 @@
+/* This file contains the guest dirty page rate measurement
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_dirty.h"
+#include "virt_trace.h"
+#include "virt_command.h"
+#include "utils.h"
+#include <time.h>
+
+/** Migration bandwidth in MiB/s assumed by the prediction */
+static double virt_dirty_bandwidth = VIRT_DIRTY_BANDWIDTH;
+
+/** Downtime budget in seconds assumed by the prediction */
+static double virt_dirty_downtime = VIRT_DIRTY_DOWNTIME / 1000.0;
+
+void virt_dirty_set_migration(double bandwidth, double downtime)
+{
+    virt_dirty_bandwidth = bandwidth;
+    virt_dirty_downtime  = downtime / 1000.0;
+}
+
+int virt_dirty_request(virt_data *virt, int index)
+{
+    virt_record_data *records = virt->records;
+    if (index < 0 || (size_t)index >= records->record_size || !virt_command_available())
+        return VIRT_ERROR_FAILURE;
+
+    virt_domain_record *record = records->record + index;
+    if (record->id < 0)
+        return VIRT_ERROR_FAILURE;
+
+    /* a running measurement is not started again */
+    if (record->dirty_state == VIRT_DIRTY_STATE_IDLE)
+        record->dirty_state = VIRT_DIRTY_STATE_QUEUED;
+    return VIRT_ERROR_SUCCESS;
+}
+
+void virt_dirty_request_all(virt_data *virt)
+{
+    for (size_t i = 0; i != virt->records->record_size; ++i)
+        if (virt->records->record[i].state == VIR_DOMAIN_RUNNING)
+            virt_dirty_request(virt, (int)i);
+}
+
+/* Start the measurement of a domain, run on the command connection */
+static int virt_dirty_start_run(virDomainPtr domain, const void *arg)
+{
+    const int *seconds = arg;
+    unsigned long long trace = virt_trace_begin();
+    int res = virDomainStartDirtyRateCalc(domain, *seconds, 0);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_START_DIRTY_RATE_CALC, domain, trace, res < 0);
+    return res < 0 ? VIRT_ERROR_FAILURE : VIRT_ERROR_SUCCESS;
+}
+
+void virt_dirty_schedule(virt_data *virt)
+{
+    virt_record_data *records = virt->records;
+    unsigned long long now = time_monotonic_us();
+    unsigned long long timeout = (unsigned long long)((VIRT_DIRTY_CALC_PERIOD + VIRT_DIRTY_TIMEOUT) * 1000000.0);
+
+    /* a failed start never reports a result, its slot is freed after the timeout */
+    int running = 0;
+    for (size_t i = 0; i != records->record_size; ++i) {
+        virt_domain_record *record = records->record + i;
+        if (record->dirty_state == VIRT_DIRTY_STATE_IDLE)
+            continue;
+        if (record->id < 0 ||
+            (record->dirty_state == VIRT_DIRTY_STATE_MEASURING && now - record->dirty_started >= timeout))
+            record->dirty_state = VIRT_DIRTY_STATE_IDLE;
+        else if (record->dirty_state == VIRT_DIRTY_STATE_MEASURING)
+            ++running;
+    }
+
+    /* the queue is served in listing order */
+    int seconds = VIRT_DIRTY_CALC_PERIOD;
+    for (size_t i = 0; i != records->record_size && running < VIRT_DIRTY_CONCURRENCY; ++i) {
+        virt_domain_record *record = records->record + i;
+        if (record->dirty_state != VIRT_DIRTY_STATE_QUEUED)
+            continue;
+
+        if (virt_command_submit_arg(record->uuid, virt_dirty_start_run, &seconds, sizeof(seconds)) ==
+            VIRT_ERROR_SUCCESS) {
+            record->dirty_state     = VIRT_DIRTY_STATE_MEASURING;
+            record->dirty_started   = now;
+            ++running;
+        } else {
+            record->dirty_state     = VIRT_DIRTY_STATE_IDLE;
+        }
+    }
+}
+
+unsigned int virt_dirty_stats(const virt_domain_record *record, unsigned long long now)
+{
+    if (record->dirty_state != VIRT_DIRTY_STATE_MEASURING ||
+        now - record->dirty_started < VIRT_DIRTY_CALC_PERIOD * 1000000ULL)
+        return 0;
+    return VIR_DOMAIN_STATS_DIRTYRATE;
+}
+
+void virt_dirty_merge_stats(virt_domain_record *record, virTypedParameterPtr params, int nparams)
+{
+    int status = VIR_DOMAIN_DIRTYRATE_UNSTARTED;
+    long long start = 0, rate = 0;
+
+    if (record->dirty_state != VIRT_DIRTY_STATE_MEASURING ||
+        virTypedParamsGetInt(params, nparams, "dirtyrate.calc_status", &status) != 1 ||
+        status != VIR_DOMAIN_DIRTYRATE_MEASURED ||
+        virTypedParamsGetLLong(params, nparams, "dirtyrate.megabytes_per_second", &rate) != 1)
+        return;
+
+    /* until the new calculation runs the hypervisor still reports the previous one */
+    virTypedParamsGetLLong(params, nparams, "dirtyrate.calc_start_time", &start);
+    if (record->dirty_measured && start == record->dirty_calc_start)
+        return;
+
+    record->dirty_rate          = rate;
+    record->dirty_calc_start    = start;
+    record->dirty_measured      = (long long)time(NULL);
+    record->dirty_state         = VIRT_DIRTY_STATE_IDLE;
+}
+
+double virt_dirty_migration_time(const virt_domain_record *record)
+{
+    if (!record->dirty_measured || record->memory_actual == 0 || virt_dirty_bandwidth <= 0.0)
+        return -1.0;
+
+    double remaining = record->memory_actual / 1024.0;
+    double memory    = remaining;
+    double elapsed   = 0.0;
+    for (int i = 0; i != VIRT_DIRTY_PASSES; ++i) {
+        double pass = remaining / virt_dirty_bandwidth;
+        elapsed += pass;
+
+        /* the guest is paused for the last pass */
+        if (pass <= virt_dirty_downtime)
+            return elapsed;
+
+        /* a page dirtied twice is sent once */
+        remaining = record->dirty_rate * pass;
+        if (remaining > memory)
+            remaining = memory;
+    }
+    return -1.0;
+}
@@ -0,0 +1,111 @@
+/* This file contains the guest dirty page rate measurement
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_dirty.h
+ * This file contains the on-demand measurement of the guest dirty page rate.
+ * A measurement is started with virDomainStartDirtyRateCalc on the command
+ * connection, the hypervisor counts the dirtied pages for a few seconds and
+ * the result is read with the dirtyrate group of the bulk statistics. Only a
+ * few domains are measured at once, the other requested ones wait in the
+ * queue. The last rate is kept in the domain record and, together with the
+ * balloon size, predicts how long a pre-copy live migration would take.
+ */
+#ifndef VIRT_DIRTY_H
+#define VIRT_DIRTY_H
+#include "virt.h"
+#include "virt_record.h"
+/** Seconds the hypervisor counts dirtied pages for */
+#define VIRT_DIRTY_CALC_PERIOD (1)
+/** Most domains measured at the same time */
+#define VIRT_DIRTY_CONCURRENCY (4)
+/** Seconds past the calculation period after which an unanswered measurement is given up */
+#define VIRT_DIRTY_TIMEOUT (10.0)
+/** Seconds after which a measured rate is shown as stale */
+#define VIRT_DIRTY_STALE_AGE (600)
+/** Default migration bandwidth in MiB/s assumed by the prediction, roughly 10 Gbit/s */
+#define VIRT_DIRTY_BANDWIDTH (1100.0)
+/** Default downtime budget in milliseconds, the default of libvirt */
+#define VIRT_DIRTY_DOWNTIME (300.0)
+/** Most pre-copy passes before the migration is considered not converging */
+#define VIRT_DIRTY_PASSES (30)
+
+/**
+ * State of the dirty rate measurement of a domain.
+ * @see virt_domain_record
+ */
+typedef enum {
+    VIRT_DIRTY_STATE_IDLE,      /** Nothing requested, the last rate is kept */
+    VIRT_DIRTY_STATE_QUEUED,    /** Waiting for a free measurement slot */
+    VIRT_DIRTY_STATE_MEASURING  /** Started, the result is polled once the period passed */
+} virt_dirty_state_enum;
+
+/**
+ * Set the link the migration time is predicted for.
+ * @param bandwidth - migration bandwidth in MiB/s
+ * @param downtime  - downtime budget in milliseconds
+ */
+void virt_dirty_set_migration(double bandwidth, double downtime);
+
+/**
+ * Queue the dirty rate measurement of a running domain.
+ * @param virt  - pointer with virt data
+ * @param index - domain row
+ * @return VIRT_ERROR_SUCCESS if queued, VIRT_ERROR_FAILURE if inactive or read-only
+ */
+int virt_dirty_request(virt_data *virt, int index);
+
+/**
+ * Queue the dirty rate measurement of every running domain.
+ * @param virt - pointer with virt data
+ */
+void virt_dirty_request_all(virt_data *virt);
+
+/**
+ * Start queued measurements while slots are free and give up those which
+ * did not answer in time.
+ * @param virt - pointer with virt data
+ */
+void virt_dirty_schedule(virt_data *virt);
+
+/**
+ * Statistics group the record needs to read its running measurement.
+ * @param record - domain record
+ * @param now    - monotonic time in microseconds
+ * @return VIR_DOMAIN_STATS_DIRTYRATE if the result is due, 0 otherwise
+ */
+unsigned int virt_dirty_stats(const virt_domain_record *record, unsigned long long now);
+
+/**
+ * Merge the dirtyrate group of the bulk statistics, a result is taken only
+ * once the hypervisor reports a measurement newer than the last one.
+ * @param record  - domain record
+ * @param params  - typed parameters returned by libvirt
+ * @param nparams - number of parameters
+ */
+void virt_dirty_merge_stats(virt_domain_record *record, virTypedParameterPtr params, int nparams);
+
+/**
+ * Predict the time of a pre-copy migration: every pass sends what the
+ * previous one dirtied, until the rest fits in the downtime budget.
+ * @param record - domain record with a measured rate and balloon size
+ * @return seconds, -1 if the migration does not converge or is unknown
+ */
+double virt_dirty_migration_time(const virt_domain_record *record);
+
+#endif /* VIRT_DIRTY_H */
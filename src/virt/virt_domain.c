@@ -19,7 +19,29 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "virt_domain.h"
+#include "virt_trace.h"
+#include "virt_record.h"
+#include "virt_plan.h"
+#include "virt_watchdog.h"
+#include "virt_health.h"
+#include "virt_command.h"
+#include "virt_node.h"
+#include "virt_vcpu.h"
+#include "virt_dirty.h"
+#include "virt_perf.h"
+#include "virt_local.h"
 #include "utils.h"
+#include <time.h>
+#include <math.h>
+
+/** Bulk statistics skip domains busy with another job, cleared if libvirt rejects the flag */
+static int virt_domain_stats_nowait = 1;
+
+/** Guest statistics period in seconds asked for where it is off, 0 leaves the guests alone */
+static int virt_domain_memory_period = 0;
+
+/** Column the records are sorted by, -1 keeps the order of the listing */
+static int virt_domain_sort = -1;
 
 const char *virt_domain_state_text[VIRT_STATE_TEXT_SIZE] = {
     "unknown     ",
@@ -154,121 +176,1053 @@ void state_to_stats(virt_domain_data *data, int state)
     }
 }
 
-void virt_get_domain_state_data(virt_data *virt, virt_domain_data *data)
+const char *virt_domain_reason_text(int state, int reason)
 {
-    int state       = 0;
-    int reason      = 0;
-    for (int i = 0; i != virt->domain_size; ++i) {
-        virDomainGetState(virt->domain[i], &state, &reason, 0);
+    const char **reasons = NULL;
+    int size = 0;
 
-        data->domain_data[VIRT_DOMAIN_DATA_TYPE_STATE][i]    = copy_str(virt_domain_state_text[state]);
+    switch (state) {
+        case VIR_DOMAIN_NOSTATE:
+            reasons = virt_domain_nostate_reason;     size = VIRT_DOMAIN_NOSTATE_SIZE;     break;
+        case VIR_DOMAIN_RUNNING:
+            reasons = virt_domain_running_reason;     size = VIRT_DOMAIN_RUNNING_SIZE;     break;
+        case VIR_DOMAIN_BLOCKED:
+            reasons = virt_domain_blocked_reason;     size = VIRT_DOMAIN_BLOCKED_SIZE;     break;
+        case VIR_DOMAIN_PAUSED:
+            reasons = virt_domain_paused_reason;      size = VIRT_DOMAIN_PAUSED_SIZE;      break;
+        case VIR_DOMAIN_SHUTDOWN:
+            reasons = virt_domain_shutdown_reason;    size = VIRT_DOMAIN_SHUTDOWN_SIZE;    break;
+        case VIR_DOMAIN_SHUTOFF:
+            reasons = virt_domain_shutoff_reason;     size = VIRT_DOMAIN_SHUTOFF_SIZE;     break;
+        case VIR_DOMAIN_CRASHED:
+            reasons = virt_domain_crashed_reason;     size = VIRT_DOMAIN_CRASHED_SIZE;     break;
+        case VIR_DOMAIN_PMSUSPENDED:
+            reasons = virt_domain_pmsuspended_reason; size = VIRT_DOMAIN_PMSUSPENDED_SIZE; break;
+    }
 
-        switch (state) {
-            case VIR_DOMAIN_NOSTATE:     
-                data->domain_data[VIRT_DOMAIN_DATA_TYPE_REASON][i] = copy_str(virt_domain_nostate_reason[reason]);
-                break;
-            case VIR_DOMAIN_RUNNING:    
-                data->domain_data[VIRT_DOMAIN_DATA_TYPE_REASON][i] = copy_str(virt_domain_running_reason[reason]);
-                break;
-            case VIR_DOMAIN_BLOCKED:     
-                data->domain_data[VIRT_DOMAIN_DATA_TYPE_REASON][i] = copy_str(virt_domain_blocked_reason[reason]);
-                break;
-            case VIR_DOMAIN_PAUSED:      
-                data->domain_data[VIRT_DOMAIN_DATA_TYPE_REASON][i] = copy_str(virt_domain_paused_reason[reason]);
-                break;
-            case VIR_DOMAIN_SHUTDOWN:    
-                data->domain_data[VIRT_DOMAIN_DATA_TYPE_REASON][i] = copy_str(virt_domain_shutdown_reason[reason]);
-                break;
-            case VIR_DOMAIN_SHUTOFF:     
-                data->domain_data[VIRT_DOMAIN_DATA_TYPE_REASON][i] = copy_str(virt_domain_shutoff_reason[reason]);
+    /* newer libvirt may report reasons this table does not know yet */
+    if (!reasons || reason < 0 || reason >= size)
+        return VIRT_DOMAIN_UNKNOWN_DATA;
+    return reasons[reason];
+}
+
+/*
+ * Find the record of given domain, records are searched starting at hint
+ * since bulk statistics usually come back in the order they were requested.
+ * @param data   - domain records
+ * @param domain - domain to be found
+ * @param hint   - index to start the search at
+ * @return record of the domain, NULL if not found
+ */
+static virt_domain_record *virt_find_record(virt_record_data *data, virDomainPtr domain, size_t hint)
+{
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    if (virDomainGetUUID(domain, uuid) < 0)
+        return NULL;
+
+    for (size_t i = 0; i != data->record_size; ++i) {
+        virt_domain_record *record = data->record + (hint + i) % data->record_size;
+        if (memcmp(record->uuid, uuid, VIR_UUID_BUFLEN) == 0)
+            return record;
+    }
+    return NULL;
+}
+
+double virt_domain_rate(unsigned long long value, unsigned long long previous, unsigned long long elapsed_us)
+{
+    if (elapsed_us == 0 || value < previous)
+        return 0;
+    return (value - previous) * 1000000.0 / elapsed_us;
+}
+
+/* Check whether field looks like prefix<N>suffix, e.g. block.0.rd.bytes */
+static int virt_field_match(const char *field, const char *prefix, const char *suffix)
+{
+    size_t field_len    = strlen(field);
+    size_t prefix_len   = strlen(prefix);
+    size_t suffix_len   = strlen(suffix);
+
+    return field_len > prefix_len + suffix_len &&
+           strncmp(field, prefix, prefix_len) == 0 &&
+           strcmp(field + field_len - suffix_len, suffix) == 0;
+}
+
+void virt_domain_sum_io(virTypedParameterPtr params, int nparams,
+                        unsigned long long *rd, unsigned long long *wr,
+                        unsigned long long *rx, unsigned long long *tx)
+{
+    *rd = *wr = *rx = *tx = 0;
+    for (int i = 0; i != nparams; ++i) {
+        if (params[i].type != VIR_TYPED_PARAM_ULLONG)
+            continue;
+        if (virt_field_match(params[i].field, "block.", ".rd.bytes"))
+            *rd += params[i].value.ul;
+        else if (virt_field_match(params[i].field, "block.", ".wr.bytes"))
+            *wr += params[i].value.ul;
+        else if (virt_field_match(params[i].field, "net.", ".rx.bytes"))
+            *rx += params[i].value.ul;
+        else if (virt_field_match(params[i].field, "net.", ".tx.bytes"))
+            *tx += params[i].value.ul;
+    }
+}
+
+void virt_domain_merge_cpu(virt_domain_record *record, unsigned long long cpu_time, unsigned long long now)
+{
+    if (cpu_time && record->updated[VIRT_GROUP_CPU] && record->cpu_time)
+        record->cpu_prc = virt_domain_rate(cpu_time, record->cpu_time,
+                                    now - record->updated[VIRT_GROUP_CPU]) / 1e9 * 100.0;
+    else
+        record->cpu_prc = 0;
+    record->cpu_time = cpu_time;
+    record->updated[VIRT_GROUP_CPU] = now;
+}
+
+void virt_domain_merge_io(virt_domain_record *record, unsigned long long rd, unsigned long long wr,
+                          unsigned long long rx, unsigned long long tx, unsigned long long now)
+{
+    unsigned long long elapsed = record->updated[VIRT_GROUP_IO] ? now - record->updated[VIRT_GROUP_IO] : 0;
+    record->block_rd_rate   = virt_domain_rate(rd, record->block_rd_bytes, elapsed);
+    record->block_wr_rate   = virt_domain_rate(wr, record->block_wr_bytes, elapsed);
+    record->net_rx_rate     = virt_domain_rate(rx, record->net_rx_bytes, elapsed);
+    record->net_tx_rate     = virt_domain_rate(tx, record->net_tx_bytes, elapsed);
+    record->block_rd_bytes  = rd;
+    record->block_wr_bytes  = wr;
+    record->net_rx_bytes    = rx;
+    record->net_tx_bytes    = tx;
+    record->updated[VIRT_GROUP_IO] = now;
+}
+
+/*
+ * Merge one record of bulk statistics into the domain record.
+ * @param record - domain record to be updated
+ * @param params - typed parameters returned by libvirt
+ * @param nparams - number of parameters
+ * @param stats  - requested VIR_DOMAIN_STATS_* mask
+ * @param now    - monotonic time of the sample
+ */
+static void virt_merge_domain_stats(virt_domain_record *record, virTypedParameterPtr params,
+                                    int nparams, unsigned int stats, unsigned long long now)
+{
+    if (stats & VIR_DOMAIN_STATS_STATE) {
+        virTypedParamsGetInt(params, nparams, "state.state", &record->state);
+        virTypedParamsGetInt(params, nparams, "state.reason", &record->reason);
+        record->updated[VIRT_GROUP_STATE] = now;
+    }
+
+    if (stats & VIR_DOMAIN_STATS_CPU_TOTAL) {
+        unsigned long long cpu_time = 0;
+        /* inactive domains do not report cpu time */
+        virTypedParamsGetULLong(params, nparams, "cpu.time", &cpu_time);
+        virt_domain_merge_cpu(record, cpu_time, now);
+    }
+
+    if (stats & (VIR_DOMAIN_STATS_BLOCK | VIR_DOMAIN_STATS_INTERFACE)) {
+        unsigned long long rd = 0, wr = 0, rx = 0, tx = 0;
+        virt_domain_sum_io(params, nparams, &rd, &wr, &rx, &tx);
+        virt_domain_merge_io(record, rd, wr, rx, tx, now);
+    }
+
+    if (stats & VIR_DOMAIN_STATS_VCPU)
+        virt_vcpu_merge_stats(record, params, nparams, now);
+
+    if (stats & VIR_DOMAIN_STATS_DIRTYRATE)
+        virt_dirty_merge_stats(record, params, nparams);
+
+    if (stats & VIR_DOMAIN_STATS_PERF)
+        virt_perf_merge_stats(record, params, nparams, now);
+}
+
+void virt_domain_watchdog_run(virt_record_data *records, virt_watchdog_call call,
+                              const size_t *row, virt_watchdog_job **job, size_t size)
+{
+    /* the batch may run out of time, so every run of a call starts one row further */
+    static size_t start[VIRT_WATCHDOG_CALL_SIZE];
+    for (size_t i = 0; i != size; ++i) {
+        size_t k = (start[call] + i) % size;
+        job[k] = virt_watchdog_submit(records->record[row[k]].domain, call);
+    }
+    ++start[call];
+
+    virt_domain_watchdog_wait(records, row, job, size);
+}
+
+void virt_domain_watchdog_wait(virt_record_data *records, const size_t *row,
+                               virt_watchdog_job **job, size_t size)
+{
+    virt_watchdog_wait(job, size, virt_watchdog_deadline());
+
+    unsigned long long now = time_monotonic_us();
+    for (size_t i = 0; i != size; ++i) {
+        if (!job[i])
+            continue;
+
+        virt_domain_record *record = records->record + row[i];
+        switch (job[i]->outcome) {
+            case VIRT_WATCHDOG_OUTCOME_DONE:
+                virt_record_responded(record);
                 break;
-            case VIR_DOMAIN_CRASHED:     
-                data->domain_data[VIRT_DOMAIN_DATA_TYPE_REASON][i] = copy_str(virt_domain_crashed_reason[reason]);
+            case VIRT_WATCHDOG_OUTCOME_DROPPED:
+                /* the record stays stale and is asked again next tick */
+                virt_watchdog_release(job[i]);
+                job[i] = NULL;
                 break;
-            case VIR_DOMAIN_PMSUSPENDED: 
-                data->domain_data[VIRT_DOMAIN_DATA_TYPE_REASON][i] = copy_str(virt_domain_pmsuspended_reason[reason]);
+            case VIRT_WATCHDOG_OUTCOME_HUNG:
+                virt_record_hung(record, job[i], now);
+                job[i] = NULL;
                 break;
         }
     }
 }
 
-void virt_get_domain_memory_data(virt_data *virt, virt_domain_data *data)
-{
-    for (int i = 0; i != virt->domain_size; ++i) {
-        /* get all memory statistics for each guest */
-        virDomainMemoryStatStruct mem_stats[VIR_DOMAIN_MEMORY_STAT_NR];
-        int mem_count = virDomainMemoryStats(virt->domain[i], mem_stats, VIR_DOMAIN_MEMORY_STAT_NR, 0);
-
-        double mem_max  = 0;
-        double mem_curr = 0;
-        /*double mem_swap = 0;*/
-        if (mem_count > 0) {
-            for (int i = 0; i != mem_count; ++i) {
-                switch (mem_stats[i].tag) {
-                    case VIR_DOMAIN_MEMORY_STAT_SWAP_IN:        break;/*mem_swap    = mem_stats[i].val; break;*/
-                    case VIR_DOMAIN_MEMORY_STAT_SWAP_OUT:       break;
-                    case VIR_DOMAIN_MEMORY_STAT_MAJOR_FAULT:    break;
-                    case VIR_DOMAIN_MEMORY_STAT_MINOR_FAULT:    break;
-                    case VIR_DOMAIN_MEMORY_STAT_UNUSED:         break;
-                    case VIR_DOMAIN_MEMORY_STAT_AVAILABLE:      break;
-                    case VIR_DOMAIN_MEMORY_STAT_ACTUAL_BALLOON: mem_max     = mem_stats[i].val; break;
-                    case VIR_DOMAIN_MEMORY_STAT_RSS:            mem_curr    = mem_stats[i].val; break;
-                    case VIR_DOMAIN_MEMORY_STAT_USABLE:         break;
-                    case VIR_DOMAIN_MEMORY_STAT_LAST_UPDATE:    break;
-                }
+void virt_get_domain_static_data(virt_data *virt, unsigned int due)
+{
+    virt_record_data *records = virt->records;
+    unsigned long long now = time_monotonic_us();
+
+    size_t *row = calloc(records->record_size + 1, sizeof(size_t));
+    virt_watchdog_job **job = calloc(records->record_size + 1, sizeof(virt_watchdog_job *));
+    size_t size = 0;
+
+    for (size_t i = 0; i != records->record_size; ++i) {
+        virt_domain_record *record = records->record + i;
+
+        /* the name is known to the client without a round trip, every row gets one */
+        if (!record->name)
+            record->name = copy_str(virDomainGetName(record->domain));
+
+        if (!virt_plan_needs(virt->plan, records, i, VIRT_GROUP_STATIC, due))
+            continue;
+
+        free(record->name);
+        record->name = copy_str(virDomainGetName(record->domain));
+
+        if (virt_record_responsive(record, now))
+            row[size++] = i;
+    }
+
+    virt_domain_watchdog_run(records, VIRT_WATCHDOG_CALL_AUTOSTART, row, job, size);
+
+    now = time_monotonic_us();
+    for (size_t i = 0; i != size; ++i) {
+        if (!job[i])
+            continue;
+
+        virt_domain_record *record = records->record + row[i];
+        if (job[i]->res == 0)
+            record->autostart = job[i]->autostart;
+        record->updated[VIRT_GROUP_STATIC] = now;
+        virt_watchdog_release(job[i]);
+    }
+
+    free(job);
+    free(row);
+}
+
+/*
+ * Fetch bulk statistics of the listed domains and merge them into their records.
+ * @param records - domain records
+ * @param domain  - NULL terminated list of domains
+ * @param stats   - VIR_DOMAIN_STATS_* mask requested for all of them
+ */
+static void virt_fetch_domain_stats(virt_record_data *records, virDomainPtr *domain, unsigned int stats)
+{
+    virDomainStatsRecordPtr *stats_record = NULL;
+    unsigned int flags = virt_domain_stats_nowait ? VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT : 0;
+    unsigned long long trace = virt_trace_begin();
+    int count = virDomainListGetStats(domain, stats, &stats_record, flags);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_LIST_GET_STATS, NULL, trace, count < 0);
+
+    /* libvirt before 4.5 does not know the flag, hung domains are left out of the call instead */
+    if (count < 0 && flags) {
+        trace = virt_trace_begin();
+        count = virDomainListGetStats(domain, stats, &stats_record, 0);
+        virt_trace_end(VIRT_TRACE_API_DOMAIN_LIST_GET_STATS, NULL, trace, count < 0);
+        if (count >= 0)
+            virt_domain_stats_nowait = 0;
+    }
+
+    unsigned long long now = time_monotonic_us();
+    for (int i = 0; i < count; ++i) {
+        virt_domain_record *record = virt_find_record(records, stats_record[i]->dom, i);
+        if (record)
+            virt_merge_domain_stats(record, stats_record[i]->params, stats_record[i]->nparams, stats, now);
+    }
+
+    if (stats_record)
+        virDomainStatsRecordListFree(stats_record);
+}
+
+void virt_get_domain_stats_data(virt_data *virt, unsigned int due)
+{
+    virt_record_data *records = virt->records;
+    unsigned long long now = time_monotonic_us();
+
+    /* stats groups each record needs, rows outside of the window usually need fewer */
+    unsigned int *need = calloc(records->record_size + 1, sizeof(unsigned int));
+    for (size_t i = 0; i != records->record_size; ++i) {
+        /* without the nowait flag a hung domain would block the call for everyone */
+        if (!virt_domain_stats_nowait && records->record[i].hung_since)
+            continue;
+        if (virt_plan_needs(virt->plan, records, i, VIRT_GROUP_STATE, due))
+            need[i] |= VIR_DOMAIN_STATS_STATE;
+        if (virt_plan_needs(virt->plan, records, i, VIRT_GROUP_CPU, due))
+            need[i] |= VIR_DOMAIN_STATS_CPU_TOTAL;
+        if (virt_plan_needs(virt->plan, records, i, VIRT_GROUP_IO, due))
+            need[i] |= VIR_DOMAIN_STATS_BLOCK | VIR_DOMAIN_STATS_INTERFACE;
+        /* vCPUs of domains which are not expanded are never looked at */
+        if (virt_vcpu_shows(virt->vcpu, records->record + i) &&
+            virt_plan_needs(virt->plan, records, i, VIRT_GROUP_VCPU, due))
+            need[i] |= VIR_DOMAIN_STATS_VCPU;
+        if (virt_plan_needs(virt->plan, records, i, VIRT_GROUP_PERF, due))
+            need[i] |= VIR_DOMAIN_STATS_PERF;
+        /* counters of local domains are read from the cgroup, libvirt is not asked */
+        need[i] &= ~virt_local_collect(virt, i, need[i] & VIRT_LOCAL_STATS, now);
+        /* measurements are read wherever the row is, they were asked for */
+        need[i] |= virt_dirty_stats(records->record + i, now);
+    }
+
+    /* one call per distinct set of stats groups, so hidden rows do not pay for visible ones */
+    virDomainPtr *domain = calloc(records->record_size + 1, sizeof(virDomainPtr));
+    for (size_t i = 0; i != records->record_size; ++i) {
+        unsigned int stats = need[i];
+        if (!stats)
+            continue;
+
+        size_t domain_size = 0;
+        for (size_t j = i; j != records->record_size; ++j) {
+            if (need[j] == stats) {
+                domain[domain_size++] = records->record[j].domain;
+                need[j] = 0;
             }
         }
+        domain[domain_size] = NULL;
+
+        virt_fetch_domain_stats(records, domain, stats);
+    }
+
+    free(domain);
+    free(need);
+}
+
+/* Forget the balloon statistics, e.g. of a domain which is not running */
+static void virt_clear_memory_stats(virt_domain_record *record)
+{
+    record->memory_actual           = 0;
+    record->memory_rss              = 0;
+    record->memory_tags             = 0;
+    record->memory_swap_in_rate     = 0;
+    record->memory_swap_out_rate    = 0;
+    record->memory_major_fault_rate = 0;
+    record->memory_minor_fault_rate = 0;
+    record->memory_period_set       = 0;
+}
+
+/* Rate of a guest counter, 0 unless both samples reported it */
+static double virt_memory_rate(unsigned int tags, unsigned int prev_tags, int tag,
+                               unsigned long long value, unsigned long long previous,
+                               unsigned long long elapsed_us)
+{
+    if (!(tags & prev_tags & VIRT_MEMORY_TAG_BIT(tag)))
+        return 0;
+    return virt_domain_rate(value, previous, elapsed_us);
+}
+
+/* Merge balloon statistics into the record */
+static void virt_merge_memory_stats(virt_domain_record *record, const virDomainMemoryStatStruct *mem_stats,
+                                    int mem_count, unsigned long long now)
+{
+    unsigned int        prev_tags       = record->memory_tags;
+    unsigned long long  swap_in         = record->memory_swap_in;
+    unsigned long long  swap_out        = record->memory_swap_out;
+    unsigned long long  major_fault     = record->memory_major_fault;
+    unsigned long long  minor_fault     = record->memory_minor_fault;
+    unsigned long long  last_update     = record->memory_last_update;
+
+    record->memory_actual   = 0;
+    record->memory_rss      = 0;
+    record->memory_tags     = 0;
+    for (int j = 0; j < mem_count; ++j) {
+        switch (mem_stats[j].tag) {
+            case VIR_DOMAIN_MEMORY_STAT_SWAP_IN:        record->memory_swap_in      = mem_stats[j].val; break;
+            case VIR_DOMAIN_MEMORY_STAT_SWAP_OUT:       record->memory_swap_out     = mem_stats[j].val; break;
+            case VIR_DOMAIN_MEMORY_STAT_MAJOR_FAULT:    record->memory_major_fault  = mem_stats[j].val; break;
+            case VIR_DOMAIN_MEMORY_STAT_MINOR_FAULT:    record->memory_minor_fault  = mem_stats[j].val; break;
+            case VIR_DOMAIN_MEMORY_STAT_UNUSED:         record->memory_unused       = mem_stats[j].val; break;
+            case VIR_DOMAIN_MEMORY_STAT_AVAILABLE:      record->memory_available    = mem_stats[j].val; break;
+            case VIR_DOMAIN_MEMORY_STAT_ACTUAL_BALLOON: record->memory_actual       = mem_stats[j].val; break;
+            case VIR_DOMAIN_MEMORY_STAT_RSS:            record->memory_rss          = mem_stats[j].val; break;
+            case VIR_DOMAIN_MEMORY_STAT_USABLE:         record->memory_usable       = mem_stats[j].val; break;
+            case VIR_DOMAIN_MEMORY_STAT_LAST_UPDATE:    record->memory_last_update  = mem_stats[j].val; break;
+            default: continue;
+        }
+        record->memory_tags |= VIRT_MEMORY_TAG_BIT(mem_stats[j].tag);
+    }
+
+    /* the guest refreshes its counters once per stats period, its own
+     * timestamp tells how much time the change covers */
+    unsigned long long elapsed = 0;
+    unsigned int stamped = VIRT_MEMORY_TAG_BIT(VIR_DOMAIN_MEMORY_STAT_LAST_UPDATE);
+    if (record->memory_tags & prev_tags & stamped) {
+        /* same guest sample as before, the rates still hold */
+        if (record->memory_last_update == last_update)
+            return;
+        if (record->memory_last_update > last_update)
+            elapsed = (record->memory_last_update - last_update) * 1000000ULL;
+    } else if (record->updated[VIRT_GROUP_MEMORY]) {
+        elapsed = now - record->updated[VIRT_GROUP_MEMORY];
+    }
+
+    unsigned int tags = record->memory_tags;
+    record->memory_swap_in_rate     = virt_memory_rate(tags, prev_tags, VIR_DOMAIN_MEMORY_STAT_SWAP_IN,
+                                                       record->memory_swap_in, swap_in, elapsed);
+    record->memory_swap_out_rate    = virt_memory_rate(tags, prev_tags, VIR_DOMAIN_MEMORY_STAT_SWAP_OUT,
+                                                       record->memory_swap_out, swap_out, elapsed);
+    record->memory_major_fault_rate = virt_memory_rate(tags, prev_tags, VIR_DOMAIN_MEMORY_STAT_MAJOR_FAULT,
+                                                       record->memory_major_fault, major_fault, elapsed);
+    record->memory_minor_fault_rate = virt_memory_rate(tags, prev_tags, VIR_DOMAIN_MEMORY_STAT_MINOR_FAULT,
+                                                       record->memory_minor_fault, minor_fault, elapsed);
+}
+
+/* Turn on the guest statistics of a running domain, run on the command connection */
+static int virt_domain_memory_period_run(virDomainPtr domain, const void *arg)
+{
+    const int *period = arg;
+    unsigned long long trace = virt_trace_begin();
+    int res = virDomainSetMemoryStatsPeriod(domain, *period, VIR_DOMAIN_AFFECT_LIVE);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_SET_MEMORY_STATS_PERIOD, domain, trace, res < 0);
+    return res < 0 ? VIRT_ERROR_FAILURE : VIRT_ERROR_SUCCESS;
+}
+
+void virt_domain_set_memory_period(int period)
+{
+    virt_domain_memory_period = period;
+}
+
+void virt_domain_next_sort()
+{
+    if (virt_domain_sort < 0)
+        virt_domain_sort = VIRT_DOMAIN_DATA_TYPE_DIRTY_RATE;
+    else if (virt_domain_sort == VIRT_DOMAIN_DATA_TYPE_DIRTY_RATE)
+        virt_domain_sort = VIRT_DOMAIN_DATA_TYPE_MIGRATE_TIME;
+    else
+        virt_domain_sort = -1;
+}
+
+int virt_domain_sort_type()
+{
+    return virt_domain_sort;
+}
+
+int virt_domain_row_uuid(virt_data *virt, size_t row, unsigned char *uuid)
+{
+    if (row >= virt->records->record_size)
+        return VIRT_ERROR_FAILURE;
+
+    memcpy(uuid, virt->records->record[row].uuid, VIR_UUID_BUFLEN);
+    return VIRT_ERROR_SUCCESS;
+}
+
+int virt_domain_find_row(virt_data *virt, const unsigned char *uuid)
+{
+    for (size_t i = 0; i != virt->records->record_size; ++i)
+        if (memcmp(virt->records->record[i].uuid, uuid, VIR_UUID_BUFLEN) == 0)
+            return (int)i;
+    return -1;
+}
+
+/** Sort key of a record and its position in the listing. */
+typedef struct {
+    double  key;
+    size_t  index;
+} virt_domain_sort_entry;
+
+/* Descending by key, domains with equal keys keep the order of the listing */
+static int virt_domain_sort_compare(const void *lhs, const void *rhs)
+{
+    const virt_domain_sort_entry *l = lhs, *r = rhs;
+    if (l->key != r->key)
+        return l->key < r->key ? 1 : -1;
+    return l->index < r->index ? -1 : l->index > r->index;
+}
+
+/* Sort key of the current column, domains which were not measured go last */
+static double virt_domain_sort_key(const virt_domain_record *record)
+{
+    if (record->id < 0 || !record->dirty_measured)
+        return -1.0;
+    if (virt_domain_sort == VIRT_DOMAIN_DATA_TYPE_DIRTY_RATE)
+        return (double)record->dirty_rate;
+    if (record->memory_actual == 0)
+        return -1.0;
+
+    /* migrations which never converge come first */
+    double time = virt_dirty_migration_time(record);
+    return time < 0.0 ? HUGE_VAL : time;
+}
+
+/*
+ * Reorder the records by the sort column, rows and records stay the same thing.
+ * @param records - records in listing order
+ */
+static void virt_domain_sort_records(virt_record_data *records)
+{
+    if (virt_domain_sort < 0 || records->record_size < 2)
+        return;
+
+    virt_domain_sort_entry *entry = calloc(records->record_size, sizeof(virt_domain_sort_entry));
+    for (size_t i = 0; i != records->record_size; ++i) {
+        entry[i].key    = virt_domain_sort_key(records->record + i);
+        entry[i].index  = i;
+    }
+    qsort(entry, records->record_size, sizeof(virt_domain_sort_entry), virt_domain_sort_compare);
+
+    virt_domain_record *record = calloc(records->record_size + 1, sizeof(virt_domain_record));
+    for (size_t i = 0; i != records->record_size; ++i)
+        record[i] = records->record[entry[i].index];
+
+    free(records->record);
+    records->record = record;
+    free(entry);
+}
+
+void virt_get_domain_memory_data(virt_data *virt, unsigned int due)
+{
+    virt_record_data *records = virt->records;
+    unsigned long long now = time_monotonic_us();
+
+    size_t *row = calloc(records->record_size + 1, sizeof(size_t));
+    virt_watchdog_job **job = calloc(records->record_size + 1, sizeof(virt_watchdog_job *));
+    size_t size = 0;
+
+    for (size_t i = 0; i != records->record_size; ++i) {
+        virt_domain_record *record = records->record + i;
+        if (!virt_plan_needs(virt->plan, records, i, VIRT_GROUP_MEMORY, due))
+            continue;
+
+        /* inactive domains have no balloon */
+        if (record->id < 0) {
+            virt_clear_memory_stats(record);
+            record->updated[VIRT_GROUP_MEMORY] = now;
+            continue;
+        }
+
+        /* a wedged monitor blocks this call, hung domains keep their last values */
+        if (virt_record_responsive(record, now))
+            row[size++] = i;
+    }
+
+    /* get all memory statistics for each guest */
+    virt_domain_watchdog_run(records, VIRT_WATCHDOG_CALL_MEMORY_STATS, row, job, size);
+
+    now = time_monotonic_us();
+    for (size_t i = 0; i != size; ++i) {
+        if (!job[i])
+            continue;
+
+        virt_domain_record *record = records->record + row[i];
+        virt_merge_memory_stats(record, job[i]->memory, job[i]->res, now);
+        record->updated[VIRT_GROUP_MEMORY] = now;
+
+        /* without a stats period the guest reports the balloon size and RSS only,
+         * the period is asked for once per run of the domain */
+        if (job[i]->res >= 0 && virt_domain_memory_period > 0 && !record->memory_period_set &&
+            !(record->memory_tags & VIRT_MEMORY_TAG_BIT(VIR_DOMAIN_MEMORY_STAT_LAST_UPDATE)) &&
+            virt_command_available()) {
+            record->memory_period_set = 1;
+            virt_command_submit_arg(record->uuid, virt_domain_memory_period_run,
+                                    &virt_domain_memory_period, sizeof(virt_domain_memory_period));
+        }
+        virt_watchdog_release(job[i]);
+    }
+
+    free(job);
+    free(row);
+}
+
+void virt_get_domain_agent_data(virt_data *virt, unsigned int due)
+{
+    virt_record_data *records = virt->records;
+    unsigned long long now = time_monotonic_us();
+
+    size_t *row = calloc(records->record_size + 1, sizeof(size_t));
+    virt_watchdog_job **job = calloc(records->record_size + 1, sizeof(virt_watchdog_job *));
+    size_t size = 0;
+
+    for (size_t i = 0; i != records->record_size; ++i) {
+        virt_domain_record *record = records->record + i;
+        if (!virt_plan_needs(virt->plan, records, i, VIRT_GROUP_AGENT, due))
+            continue;
+
+        /* only a running guest can answer, keep the last answer otherwise,
+         * monitoring only sessions cannot ask the agent at all */
+        if (record->state != VIR_DOMAIN_RUNNING || !virt_command_available()) {
+            record->updated[VIRT_GROUP_AGENT] = now;
+            continue;
+        }
+
+        if (virt_record_responsive(record, now))
+            row[size++] = i;
+    }
+
+    virt_domain_watchdog_run(records, VIRT_WATCHDOG_CALL_GUEST_INFO, row, job, size);
+
+    now = time_monotonic_us();
+    for (size_t i = 0; i != size; ++i) {
+        if (!job[i])
+            continue;
+
+        virt_domain_record *record = records->record + row[i];
+        record->updated[VIRT_GROUP_AGENT] = now;
+
+        if (job[i]->res >= 0) {
+            const char *os = NULL;
+            if (virTypedParamsGetString(job[i]->params, job[i]->nparams, "os.pretty-name", &os) != 1)
+                virTypedParamsGetString(job[i]->params, job[i]->nparams, "os.name", &os);
+
+            free(record->guest_os);
+            record->guest_os = copy_str(os);
+        }
+        virt_watchdog_release(job[i]);
+    }
+
+    free(job);
+    free(row);
+}
+
+void virt_get_domain_numa_data(virt_data *virt, unsigned int due)
+{
+    virt_record_data *records = virt->records;
+    unsigned long long now = time_monotonic_us();
+
+    size_t *row = calloc(records->record_size + 1, sizeof(size_t));
+    virt_watchdog_job **job = calloc(records->record_size + 1, sizeof(virt_watchdog_job *));
+    size_t size = 0;
+
+    for (size_t i = 0; i != records->record_size; ++i) {
+        virt_domain_record *record = records->record + i;
+        if (!virt_plan_needs(virt->plan, records, i, VIRT_GROUP_NUMA, due))
+            continue;
+
+        if (virt_record_responsive(record, now))
+            row[size++] = i;
+    }
+
+    virt_domain_watchdog_run(records, VIRT_WATCHDOG_CALL_NUMA, row, job, size);
+
+    now = time_monotonic_us();
+    for (size_t i = 0; i != size; ++i) {
+        if (!job[i])
+            continue;
+
+        virt_domain_record *record = records->record + row[i];
+        if (job[i]->res >= 0) {
+            const char *nodeset = NULL;
+            virTypedParamsGetString(job[i]->params, job[i]->nparams, VIR_DOMAIN_NUMA_NODESET, &nodeset);
+
+            free(record->numa_nodeset);
+            record->numa_nodeset = nodeset && nodeset[0] ? copy_str(nodeset) : NULL;
+            memcpy(record->numa_cpumap, job[i]->cpumap, VIRT_NODE_CPUMAP_LEN);
+            record->updated[VIRT_GROUP_NUMA] = now;
+        }
+        virt_watchdog_release(job[i]);
+    }
+
+    free(job);
+    free(row);
+}
+
+void virt_get_domain_placement_data(virt_data *virt, unsigned int due)
+{
+    virt_record_data *records = virt->records;
+    unsigned long long now = time_monotonic_us();
+
+    size_t *row = calloc(records->record_size + 1, sizeof(size_t));
+    virt_watchdog_job **job = calloc(records->record_size + 1, sizeof(virt_watchdog_job *));
+    size_t size = 0;
+
+    for (size_t i = 0; i != records->record_size; ++i) {
+        virt_domain_record *record = records->record + i;
+        if (!virt_vcpu_shows(virt->vcpu, record) ||
+            !virt_plan_needs(virt->plan, records, i, VIRT_GROUP_PLACEMENT, due))
+            continue;
+
+        /* only running vCPUs are placed on a host CPU */
+        if (record->id < 0) {
+            record->updated[VIRT_GROUP_PLACEMENT] = now;
+            continue;
+        }
+
+        if (virt_record_responsive(record, now))
+            row[size++] = i;
+    }
+
+    virt_domain_watchdog_run(records, VIRT_WATCHDOG_CALL_PLACEMENT, row, job, size);
+
+    now = time_monotonic_us();
+    for (size_t i = 0; i != size; ++i) {
+        if (!job[i])
+            continue;
+
+        virt_domain_record *record = records->record + row[i];
+        if (job[i]->res >= 0) {
+            virt_vcpu_reserve(record, job[i]->vcpu_size);
+            for (int j = 0; j != job[i]->vcpu_size; ++j) {
+                record->vcpu[j].cpu = job[i]->vcpu_cpu[j];
+                memcpy(record->vcpu[j].pin, job[i]->vcpu_pin + j * VIRT_NODE_CPUMAP_LEN, VIRT_NODE_CPUMAP_LEN);
+            }
+            record->updated[VIRT_GROUP_PLACEMENT] = now;
+        }
+        virt_watchdog_release(job[i]);
+    }
+
+    free(job);
+    free(row);
+}
+
+/* Parse a nodeset such as "0-1,3" into a mask of cells, cells above 63 are ignored */
+static unsigned long long virt_nodeset_mask(const char *nodeset)
+{
+    unsigned long long mask = 0;
+    while (nodeset && *nodeset) {
+        char *end = NULL;
+        long first = strtol(nodeset, &end, 10);
+        if (end == nodeset)
+            break;
+        long last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        for (long cell = first; cell <= last && cell < 64; ++cell)
+            if (cell >= 0)
+                mask |= 1ULL << cell;
+        nodeset = *end == ',' ? end + 1 : end;
+        if (*end != ',')
+            break;
+    }
+    return mask;
+}
+
+/*
+ * Describe the home cells of the domain as memory/cpu, e.g. "0/0-1!".
+ * Memory cells come from numatune, "-" if the memory is not bound, CPU cells
+ * are the cells of the host CPUs the vCPUs are pinned to. The mark flags
+ * vCPUs running on cells the memory is not bound to.
+ */
+static char *virt_numa_str(const virt_domain_record *record, const virt_node_cache *cache)
+{
+    if (!cache->cpu_cell)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+
+    unsigned long long cpu_cells = virt_node_cpumap_cells(cache, record->numa_cpumap);
+    unsigned long long memory_cells = virt_nodeset_mask(record->numa_nodeset);
+
+    char memory[32], cpu[32], buf[72];
+    virt_node_cells_str(memory_cells, memory, sizeof(memory));
+    virt_node_cells_str(cpu_cells, cpu, sizeof(cpu));
+    snprintf(buf, sizeof(buf), "%s/%s%s", memory_cells ? memory : VIRT_DOMAIN_UNKNOWN_DATA,
+             cpu_cells ? cpu : VIRT_DOMAIN_UNKNOWN_DATA,
+             memory_cells && (cpu_cells & ~memory_cells) ? VIRT_DOMAIN_NUMA_REMOTE_MARK : "");
+    return copy_str(buf);
+}
+
+/* Format rate in bytes per second as KiB per second */
+static char *virt_rate_to_str(double rate)
+{
+    return double_to_str(rate / 1024.0);
+}
+
+/* Guest memory statistic, unknown unless the guest reported it */
+static char *virt_memory_stat_str(const virt_domain_record *record, int tag, double value, int stale)
+{
+    if (record->id < 0 || !(record->memory_tags & VIRT_MEMORY_TAG_BIT(tag)))
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    return virt_domain_stale_str(double_to_str(value), stale);
+}
+
+/* Age of the guest statistics, the guest clock is assumed to follow the host */
+static char *virt_memory_age_str(const virt_domain_record *record, int stale)
+{
+    if (record->id < 0 || !(record->memory_tags & VIRT_MEMORY_TAG_BIT(VIR_DOMAIN_MEMORY_STAT_LAST_UPDATE)))
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+
+    char buf[32];
+    unsigned long long now = (unsigned long long)time(NULL);
+    snprintf(buf, sizeof(buf), "%llus", now > record->memory_last_update ? now - record->memory_last_update : 0);
+    return virt_domain_stale_str(copy_str(buf), stale);
+}
+
+/* Share of memory in use, as the guest sees it if it reports so, RSS of the balloon otherwise */
+static double virt_memory_prc(const virt_domain_record *record)
+{
+    unsigned int guest = VIRT_MEMORY_TAG_BIT(VIR_DOMAIN_MEMORY_STAT_AVAILABLE) |
+                         VIRT_MEMORY_TAG_BIT(VIR_DOMAIN_MEMORY_STAT_USABLE);
+    if ((record->memory_tags & guest) == guest && record->memory_available > 0 &&
+        record->memory_usable <= record->memory_available)
+        return (record->memory_available - record->memory_usable) * 100.0 / record->memory_available;
+    return record->memory_rss * 100.0 / record->memory_actual;
+}
+
+/* Last measured dirty rate, the state of a measurement which has no result yet */
+static char *virt_dirty_rate_str(const virt_domain_record *record)
+{
+    if (record->id < 0)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    if (!record->dirty_measured)
+        return copy_str(record->dirty_state == VIRT_DIRTY_STATE_QUEUED    ? "queued" :
+                        record->dirty_state == VIRT_DIRTY_STATE_MEASURING ? "measuring" :
+                                                                            VIRT_DOMAIN_UNKNOWN_DATA);
+
+    /* an old rate says little about the guest now */
+    int stale = (long long)time(NULL) - record->dirty_measured > VIRT_DIRTY_STALE_AGE;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%lld%s", record->dirty_rate,
+             record->dirty_state != VIRT_DIRTY_STATE_IDLE ? "..." : "");
+    return virt_domain_stale_str(copy_str(buf), stale);
+}
+
+/* Predicted migration time, e.g. "1m05s", "never" if it does not converge */
+static char *virt_migrate_time_str(const virt_domain_record *record, int stale)
+{
+    if (record->id < 0 || !record->dirty_measured || record->memory_actual == 0)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+
+    double time = virt_dirty_migration_time(record);
+    if (time < 0.0)
+        return virt_domain_stale_str(copy_str("never"), stale);
+
+    char buf[32];
+    unsigned long long seconds = (unsigned long long)(time + 0.5);
+    snprintf(buf, sizeof(buf), "%llum%02llus", seconds / 60, seconds % 60);
+    return virt_domain_stale_str(copy_str(buf), stale);
+}
+
+/* Perf value of a domain reporting the event, unknown otherwise */
+static char *virt_perf_str(const virt_domain_record *record, int event, double value, int stale)
+{
+    if (record->id < 0 || !(record->perf_events & VIRT_PERF_EVENT_BIT(event)) || value < 0.0)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    return virt_domain_stale_str(double_to_str(value), stale);
+}
+
+/* Local share of the memory bandwidth */
+static double virt_perf_local_prc(const virt_domain_record *record)
+{
+    unsigned long long total = record->perf_value[VIRT_PERF_EVENT_MBMT];
+    if (!(record->perf_events & VIRT_PERF_EVENT_BIT(VIRT_PERF_EVENT_MBMT)) || total == 0)
+        return -1.0;
+    return record->perf_value[VIRT_PERF_EVENT_MBML] * 100.0 / total;
+}
+
+/* Describe how long a hung domain has not been answering */
+static char *virt_hung_str(const virt_domain_record *record, unsigned long long now)
+{
+    char buf[64];
+    unsigned long long silent = (now - record->hung_since) / 1000000;
+
+    if (record->stuck)
+        snprintf(buf, sizeof(buf), "hung for %llus, call still blocked", silent);
+    else
+        snprintf(buf, sizeof(buf), "hung for %llus, retry in %llus", silent,
+                 record->retry_at > now ? (record->retry_at - now + 999999) / 1000000 : 0);
+    return copy_str(buf);
+}
+
+char *virt_domain_stale_str(char *str, int stale)
+{
+    if (!stale || !str)
+        return str;
+
+    size_t mark_len = strlen(VIRT_DOMAIN_STALE_MARK);
+    size_t str_len  = strlen(str);
+    char *marked = malloc(mark_len + str_len + 1);
+    memcpy(marked, VIRT_DOMAIN_STALE_MARK, mark_len);
+    memcpy(marked + mark_len, str, str_len + 1);
+    free(str);
+    return marked;
+}
+
+void virt_render_domain_data(virt_data *virt, virt_domain_data *data)
+{
+    virt_record_data *records = virt->records;
+    unsigned long long now = time_monotonic_us();
+
+    /* the last snapshot stays on the screen while disconnected, all of it is stale */
+    int offline = !virt_health_connected(virt);
+
+    for (size_t i = 0; i != records->record_size; ++i) {
+        virt_domain_record *record = records->record + i;
+        int active = record->id >= 0;
+
+        int stale_static    = offline || virt_plan_stale(records, i, VIRT_GROUP_STATIC);
+        int stale_state     = offline || virt_plan_stale(records, i, VIRT_GROUP_STATE);
+        int stale_memory    = offline || virt_plan_stale(records, i, VIRT_GROUP_MEMORY);
+        int stale_cpu       = offline || virt_plan_stale(records, i, VIRT_GROUP_CPU);
+        int stale_io        = offline || virt_plan_stale(records, i, VIRT_GROUP_IO);
+        int stale_agent     = offline || virt_plan_stale(records, i, VIRT_GROUP_AGENT);
+        int stale_numa      = offline || virt_plan_stale(records, i, VIRT_GROUP_NUMA);
+        int stale_perf      = offline || virt_plan_stale(records, i, VIRT_GROUP_PERF);
+
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_ID][i]         = active ? int_to_str(record->id) :
+                                                                          copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_NAME][i]       = copy_str(record->name ? record->name :
+                                                                          VIRT_DOMAIN_UNKNOWN_DATA);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_STATE][i]      = virt_domain_stale_str(copy_str(
+                                                                          record->state >= 0 && record->state < VIRT_DOMAIN_LAST ?
+                                                                          virt_domain_state_text[record->state] :
+                                                                          virt_domain_state_text[VIRT_DOMAIN_NOSTATE]), stale_state);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_REASON][i]     = record->hung_since ? virt_hung_str(record, now) :
+                                                                 copy_str(virt_domain_reason_text(record->state, record->reason));
+
+        if (record->updated[VIRT_GROUP_STATIC])
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_AUTOSTART][i] = virt_domain_stale_str(copy_str(record->autostart ? "yes" : "no"),
+                                                                                   stale_static);
+        else
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_AUTOSTART][i] = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+
         /* calculate memory usage % for each guest */
-        double mem_usage_prc = 0;
-        if (mem_max > 0) {
-            mem_usage_prc = ((mem_curr) * 100) / mem_max;
-            data->domain_data[VIRT_DOMAIN_DATA_TYPE_MEMORY_PRC][i] = double_to_str(mem_usage_prc);
-        } else
+        if (record->memory_actual > 0)
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_MEMORY_PRC][i] = virt_domain_stale_str(double_to_str(virt_memory_prc(record)),
+                                                                                    stale_memory);
+        else
             data->domain_data[VIRT_DOMAIN_DATA_TYPE_MEMORY_PRC][i] = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+
+        /* swap in KiB/s, faults per second, sizes in MiB */
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_SWAP_IN][i]          = virt_memory_stat_str(record, VIR_DOMAIN_MEMORY_STAT_SWAP_IN,
+                                                                        record->memory_swap_in_rate, stale_memory);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_SWAP_OUT][i]         = virt_memory_stat_str(record, VIR_DOMAIN_MEMORY_STAT_SWAP_OUT,
+                                                                        record->memory_swap_out_rate, stale_memory);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_MAJOR_FAULT][i]      = virt_memory_stat_str(record, VIR_DOMAIN_MEMORY_STAT_MAJOR_FAULT,
+                                                                        record->memory_major_fault_rate, stale_memory);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_MINOR_FAULT][i]      = virt_memory_stat_str(record, VIR_DOMAIN_MEMORY_STAT_MINOR_FAULT,
+                                                                        record->memory_minor_fault_rate, stale_memory);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_MEMORY_UNUSED][i]    = virt_memory_stat_str(record, VIR_DOMAIN_MEMORY_STAT_UNUSED,
+                                                                        record->memory_unused / 1024.0, stale_memory);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_MEMORY_AVAILABLE][i] = virt_memory_stat_str(record, VIR_DOMAIN_MEMORY_STAT_AVAILABLE,
+                                                                        record->memory_available / 1024.0, stale_memory);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_MEMORY_USABLE][i]    = virt_memory_stat_str(record, VIR_DOMAIN_MEMORY_STAT_USABLE,
+                                                                        record->memory_usable / 1024.0, stale_memory);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_MEMORY_AGE][i]       = virt_memory_age_str(record, stale_memory);
+
+        /* dirty rate in MiB/s, "..." while a new measurement runs */
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_DIRTY_RATE][i]       = virt_dirty_rate_str(record);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_MIGRATE_TIME][i]     = virt_migrate_time_str(record, stale_memory);
+
+        /* misses in thousands per second, occupancy in MiB, bandwidth in MiB/s */
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_PERF_IPC][i]         = virt_perf_str(record, VIRT_PERF_EVENT_INSTRUCTIONS,
+                                                                        record->perf_ipc, stale_perf);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_PERF_MISS_RATE][i]   = virt_perf_str(record, VIRT_PERF_EVENT_CACHE_MISSES,
+                                                                        record->perf_miss_rate < 0.0 ? -1.0 :
+                                                                        record->perf_miss_rate / 1000.0, stale_perf);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_PERF_CACHE][i]       = virt_perf_str(record, VIRT_PERF_EVENT_CMT,
+                                                                        record->perf_value[VIRT_PERF_EVENT_CMT] / 1048576.0, stale_perf);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_PERF_BANDWIDTH][i]   = virt_perf_str(record, VIRT_PERF_EVENT_MBMT,
+                                                                        record->perf_value[VIRT_PERF_EVENT_MBMT] / 1048576.0, stale_perf);
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_PERF_LOCAL][i]       = virt_perf_str(record, VIRT_PERF_EVENT_MBML,
+                                                                        virt_perf_local_prc(record), stale_perf);
+
+        if (active && record->updated[VIRT_GROUP_CPU])
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_CPU_PRC][i]    = virt_domain_stale_str(double_to_str(record->cpu_prc), stale_cpu);
+        else
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_CPU_PRC][i]    = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+
+        if (active && record->updated[VIRT_GROUP_IO]) {
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_BLOCK_RD][i]   = virt_domain_stale_str(virt_rate_to_str(record->block_rd_rate), stale_io);
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_BLOCK_WR][i]   = virt_domain_stale_str(virt_rate_to_str(record->block_wr_rate), stale_io);
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_NET_RX][i]     = virt_domain_stale_str(virt_rate_to_str(record->net_rx_rate), stale_io);
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_NET_TX][i]     = virt_domain_stale_str(virt_rate_to_str(record->net_tx_rate), stale_io);
+        } else {
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_BLOCK_RD][i]   = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_BLOCK_WR][i]   = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_NET_RX][i]     = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_NET_TX][i]     = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+        }
+
+        if (record->updated[VIRT_GROUP_NUMA])
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_NUMA][i]   = virt_domain_stale_str(virt_numa_str(record, virt->node), stale_numa);
+        else
+            data->domain_data[VIRT_DOMAIN_DATA_TYPE_NUMA][i]   = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+
+        data->domain_data[VIRT_DOMAIN_DATA_TYPE_GUEST_OS][i]   = record->guest_os ?
+                                                                 virt_domain_stale_str(copy_str(record->guest_os), stale_agent) :
+                                                                 copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
     }
 }
 
-void *virt_get_domain_data(virt_data *virt)
+void virt_refresh_domain_records(virt_data *virt)
 {
     /* get defined domains */
-    virt->domain_size = virConnectListAllDomains(virt->conn, &virt->domain, 0);
-
-    virt_domain_data *data = malloc(sizeof(virt_domain_data));
-    virt_init_domain_data(data);
+    virDomainPtr *domain = NULL;
+    int domain_size = -1;
+    if (virt_health_connected(virt)) {
+        unsigned long long trace = virt_trace_begin();
+        domain_size = virConnectListAllDomains(virt->conn, &domain, 0);
+        virt_trace_end(VIRT_TRACE_API_CONNECT_LIST_ALL_DOMAINS, NULL, trace, domain_size < 0);
+        if (domain_size < 0)
+            virt_health_failed(virt);
+    }
 
-    if (virt->domain_size < 0)
-        return data;
+    /* on failure keep showing the records of the last successful listing */
+    if (domain_size >= 0) {
+        virt->domain        = domain;
+        virt->domain_size   = domain_size;
+        virt_sync_records(virt->records, virt->domain, virt->domain_size);
+        virt_domain_sort_records(virt->records);
 
-    data->domain_size = virt->domain_size;
+        /* fetch only the metric groups which are due */
+        unsigned int due = virt_records_due(virt->records, time_monotonic_us());
+        virt_get_domain_static_data(virt, due);
+        virt_get_domain_stats_data(virt, due);
+        virt_get_domain_memory_data(virt, due);
+        virt_get_domain_agent_data(virt, due);
+        virt_get_domain_numa_data(virt, due);
+        virt_get_domain_placement_data(virt, due);
+        virt_dirty_schedule(virt);
+    }
+}
 
-    /* get libvirt data */
-    for (int i = 0; i != VIRT_DOMAIN_DATA_TYPE_SIZE; ++i) 
-        data->domain_data[i] = calloc(virt->domain_size+1, sizeof(char *));
+void *virt_get_domain_data(virt_data *virt)
+{
+    virt_refresh_domain_records(virt);
 
-    int autostart   = 0;
-    int id          = 0;
-    int type        = 0;
+    virt_domain_data *data = malloc(sizeof(virt_domain_data));
+    virt_init_domain_data(data);
 
-    /* get state info data */
-    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_STATE;
-    virt_get_domain_state_data(virt, data);
+    data->domain_size = virt->records->record_size;
 
-    /* get memory info data */
-    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_MEMORY_PRC;
-    virt_get_domain_memory_data(virt, data);
+    /* last item counts as NULL */
+    for (int i = 0; i != VIRT_DOMAIN_DATA_TYPE_SIZE; ++i)
+        data->domain_data[i] = calloc(data->domain_size + 1, sizeof(char *));
 
+    int type = 0;
     data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_ID;
     data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_NAME;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_STATE;
     data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_AUTOSTART;
-    for (int i = 0; i != virt->domain_size; ++i) {
-        id = virDomainGetID(virt->domain[i]);
-        data->domain_data[VIRT_DOMAIN_DATA_TYPE_ID][i]       = id > 0 ? int_to_str(id) : copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
-
-        data->domain_data[VIRT_DOMAIN_DATA_TYPE_NAME][i]     = copy_str(virDomainGetName(virt->domain[i]));
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_MEMORY_PRC;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_CPU_PRC;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_BLOCK_RD;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_BLOCK_WR;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_NET_RX;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_NET_TX;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_NUMA;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_GUEST_OS;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_REASON;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_SWAP_IN;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_SWAP_OUT;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_MAJOR_FAULT;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_MINOR_FAULT;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_MEMORY_UNUSED;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_MEMORY_AVAILABLE;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_MEMORY_USABLE;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_MEMORY_AGE;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_DIRTY_RATE;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_MIGRATE_TIME;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_PERF_IPC;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_PERF_MISS_RATE;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_PERF_CACHE;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_PERF_BANDWIDTH;
+    data->domain_type[type++] = VIRT_DOMAIN_DATA_TYPE_PERF_LOCAL;
 
-        virDomainGetAutostart(virt->domain[i], &autostart);
-        data->domain_data[VIRT_DOMAIN_DATA_TYPE_AUTOSTART][i] = copy_str(autostart ? "yes" : "no" );
-    }
+    virt_render_domain_data(virt, data);
     ++data->domain_size;
 
     return data;
@@ -277,31 +1231,57 @@ void *virt_get_domain_data(virt_data *virt)
 int virt_domain_autostart(virDomainPtr domain)
 {
     int autostart = 0;
-    if (virDomainGetAutostart(domain, &autostart))
+    unsigned long long trace = virt_trace_begin();
+    int res = virDomainGetAutostart(domain, &autostart);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_AUTOSTART, domain, trace, res < 0);
+    if (res)
         return VIRT_ERROR_FAILURE;
 
-    if (autostart) {
-        if (virDomainSetAutostart(domain, 0))
-            return VIRT_ERROR_FAILURE;
-    } else
-        if (virDomainSetAutostart(domain, 1))
-            return VIRT_ERROR_FAILURE;
+    trace = virt_trace_begin();
+    res = virDomainSetAutostart(domain, autostart ? 0 : 1);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_SET_AUTOSTART, domain, trace, res < 0);
+    if (res)
+        return VIRT_ERROR_FAILURE;
 
     return VIRT_ERROR_SUCCESS;
 }
 
+/*
+ * Query domain's state through the tracing layer.
+ * @param domain - Pointer to target domain
+ * @param state  - Filled with the state of the domain
+ * @return result of virDomainGetState
+ */
+static int virt_domain_traced_state(virDomainPtr domain, int *state)
+{
+    unsigned long long trace = virt_trace_begin();
+    int res = virDomainGetState(domain, state, NULL, 0);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_STATE, domain, trace, res < 0);
+    return res;
+}
+
 int virt_domain_create(virDomainPtr domain)
 {
     int state   = VIR_DOMAIN_NOSTATE;
-    if (virDomainGetState(domain, &state, NULL, 0) < 0)
+    if (virt_domain_traced_state(domain, &state) < 0)
         return VIRT_ERROR_FAILURE;
 
-    if (state == VIR_DOMAIN_SHUTOFF)
-        if (virDomainCreate(domain))
+    unsigned long long trace = 0;
+    int res = 0;
+    if (state == VIR_DOMAIN_SHUTOFF) {
+        trace = virt_trace_begin();
+        res = virDomainCreate(domain);
+        virt_trace_end(VIRT_TRACE_API_DOMAIN_CREATE, domain, trace, res < 0);
+        if (res)
             return VIRT_ERROR_FAILURE;
-    if (state == VIR_DOMAIN_PAUSED)
-        if (virDomainResume(domain))
+    }
+    if (state == VIR_DOMAIN_PAUSED) {
+        trace = virt_trace_begin();
+        res = virDomainResume(domain);
+        virt_trace_end(VIRT_TRACE_API_DOMAIN_RESUME, domain, trace, res < 0);
+        if (res)
             return VIRT_ERROR_FAILURE;
+    }
 
     return VIRT_ERROR_SUCCESS;
 }
@@ -309,12 +1289,16 @@ int virt_domain_create(virDomainPtr domain)
 int virt_domain_pause(virDomainPtr domain)
 {
     int state = VIR_DOMAIN_NOSTATE;
-    if (virDomainGetState(domain, &state, NULL, 0) < 0)
+    if (virt_domain_traced_state(domain, &state) < 0)
         return VIRT_ERROR_FAILURE;
 
-    if (state == VIR_DOMAIN_RUNNING)
-        if (virDomainSuspend(domain))
+    if (state == VIR_DOMAIN_RUNNING) {
+        unsigned long long trace = virt_trace_begin();
+        int res = virDomainSuspend(domain);
+        virt_trace_end(VIRT_TRACE_API_DOMAIN_SUSPEND, domain, trace, res < 0);
+        if (res)
             return VIRT_ERROR_FAILURE;
+    }
 
     return VIRT_ERROR_SUCCESS;
 }
@@ -322,12 +1306,16 @@ int virt_domain_pause(virDomainPtr domain)
 int virt_domain_reboot(virDomainPtr domain)
 {
     int state = VIR_DOMAIN_NOSTATE;
-    if (virDomainGetState(domain, &state, NULL, 0) < 0)
+    if (virt_domain_traced_state(domain, &state) < 0)
         return VIRT_ERROR_FAILURE;
 
-    if (state == VIR_DOMAIN_RUNNING)
-        if (virDomainReboot(domain, VIR_DOMAIN_REBOOT_DEFAULT))
+    if (state == VIR_DOMAIN_RUNNING) {
+        unsigned long long trace = virt_trace_begin();
+        int res = virDomainReboot(domain, VIR_DOMAIN_REBOOT_DEFAULT);
+        virt_trace_end(VIRT_TRACE_API_DOMAIN_REBOOT, domain, trace, res < 0);
+        if (res)
             return VIRT_ERROR_FAILURE;
+    }
 
     return VIRT_ERROR_SUCCESS;
 }
@@ -335,12 +1323,16 @@ int virt_domain_reboot(virDomainPtr domain)
 int virt_domain_destroy(virDomainPtr domain)
 {
     int state = VIR_DOMAIN_NOSTATE;
-    if (virDomainGetState(domain, &state, NULL, 0) < 0)
+    if (virt_domain_traced_state(domain, &state) < 0)
         return VIRT_ERROR_FAILURE;
 
-    if (state == VIR_DOMAIN_RUNNING)
-        if (virDomainDestroy(domain))
+    if (state == VIR_DOMAIN_RUNNING) {
+        unsigned long long trace = virt_trace_begin();
+        int res = virDomainDestroy(domain);
+        virt_trace_end(VIRT_TRACE_API_DOMAIN_DESTROY, domain, trace, res < 0);
+        if (res)
             return VIRT_ERROR_FAILURE;
+    }
 
     return VIRT_ERROR_SUCCESS;
 }
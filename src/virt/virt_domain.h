@@ -21,14 +21,20 @@
 #ifndef VIRT_DOMAIN_H
 #define VIRT_DOMAIN_H
 #include "virt.h"
+#include "virt_watchdog.h"
+#include "virt_record.h"
 /** Number of possible domain data types */
-#define VIRT_DOMAIN_DATA_TYPE_SIZE (6)
+#define VIRT_DOMAIN_DATA_TYPE_SIZE (28)
 /** Number of possible domain states */
 #define VIRT_STATE_TEXT_SIZE (9)
 /** Number of domain statistics */
 #define VIRT_DOMAIN_STATS (5)
 /** String for unknown data display */
 #define VIRT_DOMAIN_UNKNOWN_DATA ("-")
+/** Prefix of values which missed their last refresh, e.g. rows outside of the viewport */
+#define VIRT_DOMAIN_STALE_MARK ("~")
+/** Suffix of the NUMA placement when vCPUs may run away from the memory */
+#define VIRT_DOMAIN_NUMA_REMOTE_MARK ("!")
 /** @see virt_domain_nostate_reason */
 #define VIRT_DOMAIN_NOSTATE_SIZE        (1)
 /** @see virt_domain_running_reason */
@@ -56,7 +62,29 @@ typedef enum {
     VIRT_DOMAIN_DATA_TYPE_STATE,
     VIRT_DOMAIN_DATA_TYPE_AUTOSTART,
     VIRT_DOMAIN_DATA_TYPE_MEMORY_PRC,
-    VIRT_DOMAIN_DATA_TYPE_REASON
+    VIRT_DOMAIN_DATA_TYPE_CPU_PRC,
+    VIRT_DOMAIN_DATA_TYPE_BLOCK_RD,
+    VIRT_DOMAIN_DATA_TYPE_BLOCK_WR,
+    VIRT_DOMAIN_DATA_TYPE_NET_RX,
+    VIRT_DOMAIN_DATA_TYPE_NET_TX,
+    VIRT_DOMAIN_DATA_TYPE_NUMA,
+    VIRT_DOMAIN_DATA_TYPE_GUEST_OS,
+    VIRT_DOMAIN_DATA_TYPE_REASON,
+    VIRT_DOMAIN_DATA_TYPE_SWAP_IN,
+    VIRT_DOMAIN_DATA_TYPE_SWAP_OUT,
+    VIRT_DOMAIN_DATA_TYPE_MAJOR_FAULT,
+    VIRT_DOMAIN_DATA_TYPE_MINOR_FAULT,
+    VIRT_DOMAIN_DATA_TYPE_MEMORY_UNUSED,
+    VIRT_DOMAIN_DATA_TYPE_MEMORY_AVAILABLE,
+    VIRT_DOMAIN_DATA_TYPE_MEMORY_USABLE,
+    VIRT_DOMAIN_DATA_TYPE_MEMORY_AGE,
+    VIRT_DOMAIN_DATA_TYPE_DIRTY_RATE,
+    VIRT_DOMAIN_DATA_TYPE_MIGRATE_TIME,
+    VIRT_DOMAIN_DATA_TYPE_PERF_IPC,
+    VIRT_DOMAIN_DATA_TYPE_PERF_MISS_RATE,
+    VIRT_DOMAIN_DATA_TYPE_PERF_CACHE,
+    VIRT_DOMAIN_DATA_TYPE_PERF_BANDWIDTH,
+    VIRT_DOMAIN_DATA_TYPE_PERF_LOCAL
 } virt_domain_data_type_enum;
 
 /** @see virt_domain_data_type_enum */
@@ -152,27 +180,200 @@ void virt_deinit_domain_data(virt_domain_data *data);
 void virt_reset_domain_data(virt_domain_data *data);
 
 /**
- * Gather all the information about domains states.
+ * Return description of domain's state reason.
+ * @param state  - state of the domain
+ * @param reason - reason of the state
+ * @return reason string, VIRT_DOMAIN_UNKNOWN_DATA if the reason is not known
+ */
+const char *virt_domain_reason_text(int state, int reason);
+
+/**
+ * Return change of a counter per second, counters that went backwards restart the rate.
+ * @param value      - current value of the counter
+ * @param previous   - value of the counter at the previous sample
+ * @param elapsed_us - microseconds between the samples
+ * @return change per second, 0 if unknown
+ */
+double virt_domain_rate(unsigned long long value, unsigned long long previous, unsigned long long elapsed_us);
+
+/**
+ * Sum byte counters of all disks and interfaces in one record of bulk statistics.
+ * @param params  - typed parameters returned by virDomainListGetStats
+ * @param nparams - number of parameters
+ * @param rd      - filled with bytes read from all disks
+ * @param wr      - filled with bytes written to all disks
+ * @param rx      - filled with bytes received by all interfaces
+ * @param tx      - filled with bytes transmitted by all interfaces
+ */
+void virt_domain_sum_io(virTypedParameterPtr params, int nparams,
+                        unsigned long long *rd, unsigned long long *wr,
+                        unsigned long long *rx, unsigned long long *tx);
+
+/**
+ * Merge a CPU time sample, from the bulk statistics or the local fast path.
+ * @param record   - domain record
+ * @param cpu_time - CPU time in nanoseconds, 0 if not reported
+ * @param now      - monotonic time of the sample
+ */
+void virt_domain_merge_cpu(virt_domain_record *record, unsigned long long cpu_time, unsigned long long now);
+
+/**
+ * Merge an I/O sample, from the bulk statistics or the local fast path.
+ * @param record - domain record
+ * @param rd     - bytes read from all disks
+ * @param wr     - bytes written to all disks
+ * @param rx     - bytes received by all interfaces
+ * @param tx     - bytes transmitted by all interfaces
+ * @param now    - monotonic time of the sample
+ */
+void virt_domain_merge_io(virt_domain_record *record, unsigned long long rd, unsigned long long wr,
+                          unsigned long long rx, unsigned long long tx, unsigned long long now);
+
+/**
+ * Refresh names and autostart flags of records planned for VIRT_GROUP_STATIC.
  * @param virt - Handler to the libvirt connection
- * @param data - Object to be filled with domains states data.
- * @return object filled with domain states data, NULL otherwise
+ * @param due  - mask of due metric groups
  */
-void virt_get_domain_state_data(virt_data *virt, virt_domain_data *data);
+void virt_get_domain_static_data(virt_data *virt, unsigned int due);
 
 /**
- * Gather all the information about domains memory.
+ * Refresh state, CPU and I/O groups of records planned for them,
+ * with one bulk statistics call per distinct set of groups.
  * @param virt - Handler to the libvirt connection
- * @param data - Object to be filled with domains memory data.
- * @return object filled with domain memory data, NULL otherwise
+ * @param due  - mask of due metric groups
  */
-void virt_get_domain_memory_data(virt_data *virt, virt_domain_data *data);
+void virt_get_domain_stats_data(virt_data *virt, unsigned int due);
 
 /**
- * Gather all the information about domains.
+ * Run the call for the listed rows through the watchdog and wait for them.
+ * Rows whose call missed its deadline are marked hung and their job slot is
+ * cleared, so are slots of calls which never ran. Remaining jobs finished in
+ * time and are to be released by the caller. Every run submits from another
+ * row, so the same rows are not the ones left over whenever a batch runs out
+ * of time.
+ * @param records - domain records
+ * @param call    - per-domain call
+ * @param row     - rows of the records to be called
+ * @param job     - filled with the jobs, one per row
+ * @param size    - number of rows
+ */
+void virt_domain_watchdog_run(virt_record_data *records, virt_watchdog_call call,
+                              const size_t *row, virt_watchdog_job **job, size_t size);
+
+/**
+ * Wait for jobs already submitted for the listed rows, as virt_domain_watchdog_run
+ * does for calls which need more than the domain.
+ * @param records - domain records
+ * @param row     - rows of the records the jobs were submitted for
+ * @param job     - jobs, one per row, NULL entries are skipped
+ * @param size    - number of rows
+ */
+void virt_domain_watchdog_wait(virt_record_data *records, const size_t *row,
+                               virt_watchdog_job **job, size_t size);
+
+/**
+ * Refresh balloon memory statistics of records planned for VIRT_GROUP_MEMORY.
+ * Swap and fault rates are derived from consecutive guest samples. Running
+ * domains which report no guest statistics get the period set with
+ * virt_domain_set_memory_period, once per run, on the command connection.
  * @param virt - Handler to the libvirt connection
- * @return object filled with domain data, NULL otherwise
+ * @param due  - mask of due metric groups
+ */
+void virt_get_domain_memory_data(virt_data *virt, unsigned int due);
+
+/**
+ * Set the guest statistics period asked for where the guest reports none.
+ * @param period - seconds, 0 leaves the period of every guest alone
+ */
+void virt_domain_set_memory_period(int period);
+
+/**
+ * Switch the order of the domain list: listing order, dirty rate, predicted
+ * migration time, both descending, and back to the listing order.
+ */
+void virt_domain_next_sort();
+
+/**
+ * Column the domain list is sorted by.
+ * @return VIRT_DOMAIN_DATA_TYPE_* value, -1 for the listing order
+ */
+int virt_domain_sort_type();
+
+/**
+ * Get the UUID of the domain on a row of the list, the selection is kept on
+ * it while rows are sorted anew or domains come and go.
+ * @param virt - pointer with virt data
+ * @param row  - row of the domain list
+ * @param uuid - filled with the UUID of the domain
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE if there is no such row
+ */
+int virt_domain_row_uuid(virt_data *virt, size_t row, unsigned char *uuid);
+
+/**
+ * Find the row of a domain in the list.
+ * @param virt - pointer with virt data
+ * @param uuid - UUID of the domain
+ * @return row of the domain, -1 if it is not listed
+ */
+int virt_domain_find_row(virt_data *virt, const unsigned char *uuid);
+
+/**
+ * Refresh guest agent data of records planned for VIRT_GROUP_AGENT.
+ * @param virt - Handler to the libvirt connection
+ * @param due  - mask of due metric groups
+ */
+void virt_get_domain_agent_data(virt_data *virt, unsigned int due);
+
+/**
+ * Refresh memory nodes and vCPU pinning of records planned for VIRT_GROUP_NUMA.
+ * @param virt - Handler to the libvirt connection
+ * @param due  - mask of due metric groups
+ */
+void virt_get_domain_numa_data(virt_data *virt, unsigned int due);
+
+/**
+ * Refresh host CPU and pinning of the vCPUs of expanded records planned for VIRT_GROUP_PLACEMENT.
+ * @param virt - Handler to the libvirt connection
+ * @param due  - mask of due metric groups
+ * @see virt_vcpu_shows
+ */
+void virt_get_domain_placement_data(virt_data *virt, unsigned int due);
+
+/**
+ * Prefix the value with VIRT_DOMAIN_STALE_MARK if it is stale.
+ * @param str   - value, the function takes its ownership
+ * @param stale - TRUE (1) if the value missed its last refresh
+ * @return marked value
+ */
+char *virt_domain_stale_str(char *str, int stale);
+
+/**
+ * Convert domain records into strings displayed in domain columns.
+ * @param virt - Handler to the libvirt connection
+ * @param data - Object to be filled with domains data, arrays must be allocated
+ */
+void virt_render_domain_data(virt_data *virt, virt_domain_data *data);
+
+/**
+ * List domains and refresh the metric groups which are due.
+ * On a failed listing the records of the last successful one are kept.
+ * Records follow the order of the listing unless the list is sorted,
+ * requested dirty rate measurements are started afterwards.
+ * @param virt - Handler to the libvirt connection
+ * @see virt_get_domain_static_data
+ * @see virt_get_domain_stats_data
  * @see virt_get_domain_memory_data
- * @see virt_get_domain_state_data
+ * @see virt_get_domain_agent_data
+ * @see virt_get_domain_numa_data
+ * @see virt_get_domain_placement_data
+ */
+void virt_refresh_domain_records(virt_data *virt);
+
+/**
+ * Refresh the domain records and render all of them.
+ * @param virt - Handler to the libvirt connection
+ * @return object filled with domain data, NULL otherwise
+ * @see virt_refresh_domain_records
  */
 void *virt_get_domain_data(virt_data *virt);
 
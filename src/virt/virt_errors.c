@@ -0,0 +1,243 @@
+/* This file contains the aggregation of libvirt errors
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_errors.h"
+#include "utils.h"
+#include <pthread.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+
+/** Table of distinct errors and the summary thread state, guarded by lock */
+static struct {
+    pthread_mutex_t     lock;
+    pthread_cond_t      wake;       /** Signaled when the thread has to stop, monotonic clock */
+    int                 started;    /** Summary thread is running */
+    int                 stop;       /** Summary thread has to exit */
+    virt_error_entry    entry[VIRT_ERRORS_SIZE];
+    size_t              size;       /** Used entries */
+    unsigned long long  total;      /** Errors since start */
+    unsigned long long  evicted;    /** Errors not summarized yet whose entry was evicted */
+} errors = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/** Set while the thread is inside a traced libvirt call */
+static __thread int virt_errors_in_call;
+
+const char *virt_errors_api_name(int api)
+{
+    return api >= 0 && api < VIRT_TRACE_API_SIZE ? virt_trace_api_name[api] : "other";
+}
+
+/* Find the entry of the error or take over a free or the least recent one, called with the lock held */
+static virt_error_entry *virt_errors_entry(int code, int api, const char *domain)
+{
+    virt_error_entry *oldest = NULL;
+    for (size_t i = 0; i != errors.size; ++i) {
+        virt_error_entry *entry = errors.entry + i;
+        if (entry->code == code && entry->api == api && strcmp(entry->domain, domain) == 0)
+            return entry;
+        if (!oldest || entry->last < oldest->last)
+            oldest = entry;
+    }
+
+    virt_error_entry *entry = errors.size < VIRT_ERRORS_SIZE ? errors.entry + errors.size++ : oldest;
+    errors.evicted += entry->pending;
+    memset(entry, 0, sizeof(*entry));
+    entry->code = code;
+    entry->api  = api;
+    snprintf(entry->domain, sizeof(entry->domain), "%s", domain);
+    return entry;
+}
+
+static void virt_errors_record(int code, int api, const char *domain, const char *message)
+{
+    unsigned long long now = time_monotonic_us();
+
+    pthread_mutex_lock(&errors.lock);
+    virt_error_entry *entry = virt_errors_entry(code, api, domain ? domain : "");
+    snprintf(entry->message, sizeof(entry->message), "%s", message ? message : "no message");
+    if (!entry->count)
+        entry->first = now;
+    entry->last = now;
+    ++entry->count;
+    ++entry->pending;
+    ++errors.total;
+    pthread_mutex_unlock(&errors.lock);
+}
+
+void virt_errors_enter()
+{
+    virt_errors_in_call = 1;
+}
+
+void virt_errors_leave(virt_trace_api api, virDomainPtr domain, int failed)
+{
+    virt_errors_in_call = 0;
+    if (!failed)
+        return;
+
+    /* the last error is thread local, virDomainGetName does not make a remote call */
+    virErrorPtr error = virGetLastError();
+    virt_errors_record(error ? error->code : VIR_ERR_OK, api,
+                       domain ? virDomainGetName(domain) : NULL,
+                       error ? error->message : NULL);
+}
+
+void virt_errors_report(virErrorPtr error)
+{
+    if (virt_errors_in_call || !error)
+        return;
+    virt_errors_record(error->code, VIRT_ERRORS_API_OTHER, NULL, error->message);
+}
+
+/* Order entries by the latest occurrence, most recent first */
+static int virt_errors_compare_recent(const void *a, const void *b)
+{
+    const virt_error_entry *x = a, *y = b;
+    return (x->last < y->last) - (x->last > y->last);
+}
+
+size_t virt_errors_recent(virt_error_entry *entry, size_t size)
+{
+    pthread_mutex_lock(&errors.lock);
+    if (size > errors.size)
+        size = errors.size;
+    virt_error_entry copy[VIRT_ERRORS_SIZE];
+    memcpy(copy, errors.entry, errors.size * sizeof(*copy));
+    size_t copy_size = errors.size;
+    pthread_mutex_unlock(&errors.lock);
+
+    qsort(copy, copy_size, sizeof(*copy), virt_errors_compare_recent);
+    memcpy(entry, copy, size * sizeof(*entry));
+    return size;
+}
+
+unsigned long long virt_errors_total()
+{
+    pthread_mutex_lock(&errors.lock);
+    unsigned long long total = errors.total;
+    pthread_mutex_unlock(&errors.lock);
+    return total;
+}
+
+/* Order entries by the occurrences not summarized yet, most frequent first */
+static int virt_errors_compare_pending(const void *a, const void *b)
+{
+    const virt_error_entry *x = a, *y = b;
+    return (x->pending < y->pending) - (x->pending > y->pending);
+}
+
+/* Write the errors seen since the previous summary, syslog is called without the lock */
+static void virt_errors_summarize()
+{
+    char line[VIRT_ERRORS_SUMMARY_LINES + 1][VIRT_ERRORS_LINE_SIZE];
+    virt_error_entry pending[VIRT_ERRORS_SIZE];
+    size_t pending_size = 0;
+    unsigned long long count = 0;
+
+    pthread_mutex_lock(&errors.lock);
+    for (size_t i = 0; i != errors.size; ++i) {
+        if (!errors.entry[i].pending)
+            continue;
+        pending[pending_size++] = errors.entry[i];
+        count += errors.entry[i].pending;
+        errors.entry[i].pending = 0;
+    }
+    unsigned long long evicted = errors.evicted;
+    errors.evicted = 0;
+    pthread_mutex_unlock(&errors.lock);
+
+    if (!count && !evicted)
+        return;
+
+    qsort(pending, pending_size, sizeof(*pending), virt_errors_compare_pending);
+
+    size_t lines = 0;
+    snprintf(line[lines++], VIRT_ERRORS_LINE_SIZE,
+             "%llu libvirt errors of %zu kinds in the last %.0fs%s",
+             count + evicted, pending_size, VIRT_ERRORS_INTERVAL,
+             pending_size > VIRT_ERRORS_SUMMARY_LINES ? ", most frequent:" : ":");
+    for (size_t i = 0; i != pending_size && i != VIRT_ERRORS_SUMMARY_LINES; ++i)
+        snprintf(line[lines++], VIRT_ERRORS_LINE_SIZE, "%llux code %d in %s%s%s: %s",
+                 pending[i].pending, pending[i].code, virt_errors_api_name(pending[i].api),
+                 pending[i].domain[0] ? " on " : "", pending[i].domain, pending[i].message);
+
+    for (size_t i = 0; i != lines; ++i)
+        syslog(LOG_ERR, "%s", line[i]);
+}
+
+static void *virt_errors_thread(void *arg)
+{
+    pthread_mutex_lock(&errors.lock);
+    while (!errors.stop) {
+        unsigned long long deadline = time_monotonic_us() + (unsigned long long)(VIRT_ERRORS_INTERVAL * 1000000);
+        struct timespec until;
+        until.tv_sec    = deadline / 1000000;
+        until.tv_nsec   = (deadline % 1000000) * 1000;
+        while (!errors.stop && pthread_cond_timedwait(&errors.wake, &errors.lock, &until) != ETIMEDOUT)
+            ;
+        if (errors.stop)
+            break;
+
+        pthread_mutex_unlock(&errors.lock);
+        virt_errors_summarize();
+        pthread_mutex_lock(&errors.lock);
+    }
+    errors.started = 0;
+    pthread_mutex_unlock(&errors.lock);
+    return NULL;
+}
+
+int virt_errors_init()
+{
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    int res = pthread_cond_init(&errors.wake, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    if (res != 0)
+        return VIRT_ERROR_FAILURE;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    /* a blocked syslog must not hold up the exit */
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    pthread_mutex_lock(&errors.lock);
+    errors.stop = 0;
+    pthread_t thread;
+    errors.started = pthread_create(&thread, &attr, virt_errors_thread, NULL) == 0;
+    int started = errors.started;
+    pthread_mutex_unlock(&errors.lock);
+
+    pthread_attr_destroy(&attr);
+    return started ? VIRT_ERROR_SUCCESS : VIRT_ERROR_FAILURE;
+}
+
+void virt_errors_deinit()
+{
+    pthread_mutex_lock(&errors.lock);
+    errors.stop = 1;
+    pthread_cond_broadcast(&errors.wake);
+    pthread_mutex_unlock(&errors.lock);
+
+    virt_errors_summarize();
+}
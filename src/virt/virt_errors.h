@@ -0,0 +1,113 @@
+/* This file contains the aggregation of libvirt errors
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_errors.h
+ * This file contains the aggregation of libvirt errors. Failed calls are
+ * deduplicated by (error code, domain, API) into a small fixed table that
+ * the TUI shows as the recent errors pane. A background thread writes a
+ * summary of the errors seen since the previous one to syslog once per
+ * interval, so a flapping guest neither floods the log nor stalls the
+ * refresh on a slow syslog.
+ */
+#ifndef VIRT_ERRORS_H
+#define VIRT_ERRORS_H
+#include "virt.h"
+#include "virt_trace.h"
+/** Number of distinct errors kept, the least recent one is evicted first */
+#define VIRT_ERRORS_SIZE (32)
+/** Seconds between two syslog summaries */
+#define VIRT_ERRORS_INTERVAL (10.0)
+/** Most distinct errors listed by a single summary */
+#define VIRT_ERRORS_SUMMARY_LINES (8)
+/** Size of a single summary line */
+#define VIRT_ERRORS_LINE_SIZE (512)
+/** Size of the stored error message */
+#define VIRT_ERRORS_MESSAGE_SIZE (256)
+/** Size of the stored domain name */
+#define VIRT_ERRORS_DOMAIN_SIZE (64)
+/** API of errors raised outside of a traced call, e.g. by the event loop */
+#define VIRT_ERRORS_API_OTHER (VIRT_TRACE_API_SIZE)
+
+/** Distinct error, identified by (code, domain, api). */
+typedef struct {
+    int                 code;                               /** virErrorNumber */
+    int                 api;                                /** virt_trace_api or VIRT_ERRORS_API_OTHER */
+    char                domain[VIRT_ERRORS_DOMAIN_SIZE];    /** Domain name, empty for node calls */
+    char                message[VIRT_ERRORS_MESSAGE_SIZE];  /** Latest message */
+    unsigned long long  count;                              /** Occurrences since start */
+    unsigned long long  pending;                            /** Occurrences not summarized yet */
+    unsigned long long  first;                              /** Monotonic time of the first occurrence */
+    unsigned long long  last;                               /** Monotonic time of the latest occurrence */
+} virt_error_entry;
+
+/**
+ * Start the thread writing the summaries.
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_errors_init();
+
+/** Stop the summary thread and write the errors not summarized yet. */
+void virt_errors_deinit();
+
+/**
+ * Mark the calling thread as inside a libvirt call, errors raised
+ * until virt_errors_leave are attributed to that call.
+ * @see virt_errors_leave
+ */
+void virt_errors_enter();
+
+/**
+ * Mark the end of a libvirt call, a failed call records the last libvirt
+ * error of the calling thread.
+ * @param api    - called libvirt entry point
+ * @param domain - domain the call was made for, NULL for node calls
+ * @param failed - non zero if the call returned an error
+ * @see virt_errors_enter
+ */
+void virt_errors_leave(virt_trace_api api, virDomainPtr domain, int failed);
+
+/**
+ * Record an error passed to the libvirt error callback, errors raised
+ * inside a libvirt call are left to virt_errors_leave.
+ * @param error - reported error
+ */
+void virt_errors_report(virErrorPtr error);
+
+/**
+ * Copy the distinct errors, the most recent first.
+ * @param entry - output array
+ * @param size  - size of the output array
+ * @return number of copied errors
+ */
+size_t virt_errors_recent(virt_error_entry *entry, size_t size);
+
+/**
+ * Return the number of errors recorded since start.
+ * @return number of errors
+ */
+unsigned long long virt_errors_total();
+
+/**
+ * Return printable name of the API of an error.
+ * @param api - virt_trace_api or VIRT_ERRORS_API_OTHER
+ * @return name of the API
+ */
+const char *virt_errors_api_name(int api);
+
+#endif /* VIRT_ERRORS_H */
@@ -0,0 +1,377 @@
+/* This file contains the libvirt event loop implementation driven by the main loop
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_event.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+/** Guards handles and timeouts, libvirt changes them from watchdog workers as well */
+static pthread_mutex_t      virt_event_lock             = PTHREAD_MUTEX_INITIALIZER;
+/** Thread running the loop, other threads wake it up after a change */
+static pthread_t            virt_event_loop_thread;
+/** Interrupts poll() of the loop, -1 if not available */
+static int                  virt_event_wake_fd          = -1;
+
+/** Watched file descriptors */
+static virt_event_handle    *virt_event_handles         = NULL;
+static size_t               virt_event_handles_size     = 0;
+static int                  virt_event_next_watch       = 1;
+
+/** Pending timeouts */
+static virt_event_timeout   *virt_event_timeouts        = NULL;
+static size_t               virt_event_timeouts_size    = 0;
+static int                  virt_event_next_timer       = 1;
+
+/* Convert VIR_EVENT_HANDLE_* mask to poll() events */
+static short virt_event_to_poll(int events)
+{
+    short poll_events = 0;
+    if (events & VIR_EVENT_HANDLE_READABLE)
+        poll_events |= POLLIN;
+    if (events & VIR_EVENT_HANDLE_WRITABLE)
+        poll_events |= POLLOUT;
+    return poll_events;
+}
+
+/* Convert poll() revents to VIR_EVENT_HANDLE_* mask */
+static int virt_event_from_poll(short revents)
+{
+    int events = 0;
+    if (revents & POLLIN)
+        events |= VIR_EVENT_HANDLE_READABLE;
+    if (revents & POLLOUT)
+        events |= VIR_EVENT_HANDLE_WRITABLE;
+    if (revents & (POLLERR | POLLNVAL))
+        events |= VIR_EVENT_HANDLE_ERROR;
+    if (revents & POLLHUP)
+        events |= VIR_EVENT_HANDLE_HANGUP;
+    return events;
+}
+
+/* Interrupt poll() of the loop if changed from another thread, called with the lock held */
+static void virt_event_wake()
+{
+    if (virt_event_wake_fd < 0 || pthread_equal(pthread_self(), virt_event_loop_thread))
+        return;
+
+    uint64_t one = 1;
+    if (write(virt_event_wake_fd, &one, sizeof(one)) < 0)
+        return;
+}
+
+static int virt_event_add_handle(int fd, int events, virEventHandleCallback cb,
+                                 void *opaque, virFreeCallback ff)
+{
+    pthread_mutex_lock(&virt_event_lock);
+    virt_event_handle *handles = realloc(virt_event_handles,
+                                         (virt_event_handles_size + 1) * sizeof(virt_event_handle));
+    if (!handles) {
+        pthread_mutex_unlock(&virt_event_lock);
+        return -1;
+    }
+    virt_event_handles = handles;
+
+    virt_event_handle *handle = virt_event_handles + virt_event_handles_size++;
+    handle->watch   = virt_event_next_watch++;
+    handle->fd      = fd;
+    handle->events  = events;
+    handle->cb      = cb;
+    handle->opaque  = opaque;
+    handle->ff      = ff;
+    handle->deleted = 0;
+    int watch = handle->watch;
+
+    virt_event_wake();
+    pthread_mutex_unlock(&virt_event_lock);
+    return watch;
+}
+
+static virt_event_handle *virt_event_find_handle(int watch)
+{
+    for (size_t i = 0; i != virt_event_handles_size; ++i)
+        if (virt_event_handles[i].watch == watch && !virt_event_handles[i].deleted)
+            return virt_event_handles + i;
+    return NULL;
+}
+
+static void virt_event_update_handle(int watch, int events)
+{
+    pthread_mutex_lock(&virt_event_lock);
+    virt_event_handle *handle = virt_event_find_handle(watch);
+    if (handle) {
+        handle->events = events;
+        virt_event_wake();
+    }
+    pthread_mutex_unlock(&virt_event_lock);
+}
+
+static int virt_event_remove_handle(int watch)
+{
+    pthread_mutex_lock(&virt_event_lock);
+    virt_event_handle *handle = virt_event_find_handle(watch);
+    if (!handle) {
+        pthread_mutex_unlock(&virt_event_lock);
+        return -1;
+    }
+
+    /* the callback may be running, free it after the dispatch */
+    handle->deleted = 1;
+    virt_event_wake();
+    pthread_mutex_unlock(&virt_event_lock);
+    return 0;
+}
+
+static int virt_event_add_timeout(int frequency, virEventTimeoutCallback cb,
+                                  void *opaque, virFreeCallback ff)
+{
+    pthread_mutex_lock(&virt_event_lock);
+    virt_event_timeout *timeouts = realloc(virt_event_timeouts,
+                                           (virt_event_timeouts_size + 1) * sizeof(virt_event_timeout));
+    if (!timeouts) {
+        pthread_mutex_unlock(&virt_event_lock);
+        return -1;
+    }
+    virt_event_timeouts = timeouts;
+
+    virt_event_timeout *timeout = virt_event_timeouts + virt_event_timeouts_size++;
+    timeout->timer      = virt_event_next_timer++;
+    timeout->frequency  = frequency;
+    timeout->expires    = time_monotonic_us() + (frequency > 0 ? frequency * 1000ULL : 0);
+    timeout->cb         = cb;
+    timeout->opaque     = opaque;
+    timeout->ff         = ff;
+    timeout->deleted    = 0;
+    int timer = timeout->timer;
+
+    virt_event_wake();
+    pthread_mutex_unlock(&virt_event_lock);
+    return timer;
+}
+
+static virt_event_timeout *virt_event_find_timeout(int timer)
+{
+    for (size_t i = 0; i != virt_event_timeouts_size; ++i)
+        if (virt_event_timeouts[i].timer == timer && !virt_event_timeouts[i].deleted)
+            return virt_event_timeouts + i;
+    return NULL;
+}
+
+static void virt_event_update_timeout(int timer, int frequency)
+{
+    pthread_mutex_lock(&virt_event_lock);
+    virt_event_timeout *timeout = virt_event_find_timeout(timer);
+    if (timeout) {
+        timeout->frequency  = frequency;
+        timeout->expires    = time_monotonic_us() + (frequency > 0 ? frequency * 1000ULL : 0);
+        virt_event_wake();
+    }
+    pthread_mutex_unlock(&virt_event_lock);
+}
+
+static int virt_event_remove_timeout(int timer)
+{
+    pthread_mutex_lock(&virt_event_lock);
+    virt_event_timeout *timeout = virt_event_find_timeout(timer);
+    if (!timeout) {
+        pthread_mutex_unlock(&virt_event_lock);
+        return -1;
+    }
+
+    timeout->deleted = 1;
+    virt_event_wake();
+    pthread_mutex_unlock(&virt_event_lock);
+    return 0;
+}
+
+/** Free callback of a removed handle or timeout */
+typedef struct {
+    virFreeCallback ff;
+    void            *opaque;
+} virt_event_release;
+
+/* Free handles and timeouts removed while their callbacks could run, called with the lock held */
+static void virt_event_cleanup()
+{
+    size_t release_size = 0;
+    virt_event_release *release = malloc((virt_event_handles_size + virt_event_timeouts_size + 1) *
+                                         sizeof(virt_event_release));
+
+    size_t size = 0;
+    for (size_t i = 0; i != virt_event_handles_size; ++i) {
+        if (virt_event_handles[i].deleted) {
+            if (virt_event_handles[i].ff && release)
+                release[release_size++] = (virt_event_release){ virt_event_handles[i].ff,
+                                                                virt_event_handles[i].opaque };
+        } else
+            virt_event_handles[size++] = virt_event_handles[i];
+    }
+    virt_event_handles_size = size;
+
+    size = 0;
+    for (size_t i = 0; i != virt_event_timeouts_size; ++i) {
+        if (virt_event_timeouts[i].deleted) {
+            if (virt_event_timeouts[i].ff && release)
+                release[release_size++] = (virt_event_release){ virt_event_timeouts[i].ff,
+                                                                virt_event_timeouts[i].opaque };
+        } else
+            virt_event_timeouts[size++] = virt_event_timeouts[i];
+    }
+    virt_event_timeouts_size = size;
+
+    /* free callbacks may call back into libvirt, which may take the lock */
+    pthread_mutex_unlock(&virt_event_lock);
+    for (size_t i = 0; i != release_size; ++i)
+        release[i].ff(release[i].opaque);
+    free(release);
+    pthread_mutex_lock(&virt_event_lock);
+}
+
+void virt_event_register()
+{
+    virt_event_loop_thread  = pthread_self();
+    virt_event_wake_fd      = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    virEventRegisterImpl(virt_event_add_handle, virt_event_update_handle, virt_event_remove_handle,
+                         virt_event_add_timeout, virt_event_update_timeout, virt_event_remove_timeout);
+}
+
+void virt_event_deinit()
+{
+    pthread_mutex_lock(&virt_event_lock);
+    for (size_t i = 0; i != virt_event_handles_size; ++i)
+        virt_event_handles[i].deleted = 1;
+    for (size_t i = 0; i != virt_event_timeouts_size; ++i)
+        virt_event_timeouts[i].deleted = 1;
+    virt_event_cleanup();
+
+    free(virt_event_handles);
+    free(virt_event_timeouts);
+    virt_event_handles = NULL;
+    virt_event_timeouts = NULL;
+    virt_event_handles_size = 0;
+    virt_event_timeouts_size = 0;
+
+    if (virt_event_wake_fd >= 0)
+        close(virt_event_wake_fd);
+    virt_event_wake_fd = -1;
+    pthread_mutex_unlock(&virt_event_lock);
+}
+
+size_t virt_event_handle_size()
+{
+    pthread_mutex_lock(&virt_event_lock);
+    size_t size = VIRT_EVENT_WAKE_SIZE + virt_event_handles_size;
+    pthread_mutex_unlock(&virt_event_lock);
+    return size;
+}
+
+void virt_event_fill(struct pollfd *fds, size_t size)
+{
+    if (size < VIRT_EVENT_WAKE_SIZE)
+        return;
+
+    /* the wake up entry goes first */
+    fds[0] = (struct pollfd){ virt_event_wake_fd, POLLIN, 0 };
+    ++fds;
+    size -= VIRT_EVENT_WAKE_SIZE;
+
+    pthread_mutex_lock(&virt_event_lock);
+    for (size_t i = 0; i != size; ++i) {
+        /* only the loop thread shrinks the array, this is merely defensive */
+        if (i >= virt_event_handles_size) {
+            fds[i] = (struct pollfd){ -1, 0, 0 };
+            continue;
+        }
+        fds[i].fd       = virt_event_handles[i].deleted ? -1 : virt_event_handles[i].fd;
+        fds[i].events   = virt_event_to_poll(virt_event_handles[i].events);
+        fds[i].revents  = 0;
+    }
+    pthread_mutex_unlock(&virt_event_lock);
+}
+
+void virt_event_dispatch_handles(const struct pollfd *fds, size_t size)
+{
+    if (size < VIRT_EVENT_WAKE_SIZE)
+        return;
+
+    if (fds[0].revents & POLLIN) {
+        uint64_t count = 0;
+        if (read(virt_event_wake_fd, &count, sizeof(count)) < 0)
+            count = 0;
+    }
+    ++fds;
+    size -= VIRT_EVENT_WAKE_SIZE;
+
+    pthread_mutex_lock(&virt_event_lock);
+    /* callbacks may add handles, those wait for the next poll */
+    for (size_t i = 0; i != size && i != virt_event_handles_size; ++i) {
+        if (virt_event_handles[i].deleted || !fds[i].revents)
+            continue;
+
+        /* entries are only compacted by the loop thread, the index stays valid */
+        virt_event_handle handle = virt_event_handles[i];
+        pthread_mutex_unlock(&virt_event_lock);
+        handle.cb(handle.watch, handle.fd, virt_event_from_poll(fds[i].revents), handle.opaque);
+        pthread_mutex_lock(&virt_event_lock);
+    }
+    virt_event_cleanup();
+    pthread_mutex_unlock(&virt_event_lock);
+}
+
+unsigned long long virt_event_next_timeout()
+{
+    unsigned long long next = 0;
+
+    pthread_mutex_lock(&virt_event_lock);
+    for (size_t i = 0; i != virt_event_timeouts_size; ++i) {
+        const virt_event_timeout *timeout = virt_event_timeouts + i;
+        if (timeout->deleted || timeout->frequency < 0)
+            continue;
+        if (next == 0 || timeout->expires < next)
+            next = timeout->expires;
+    }
+    pthread_mutex_unlock(&virt_event_lock);
+    return next;
+}
+
+void virt_event_dispatch_timeouts(unsigned long long now)
+{
+    pthread_mutex_lock(&virt_event_lock);
+    size_t size = virt_event_timeouts_size;
+    for (size_t i = 0; i != size; ++i) {
+        virt_event_timeout *timeout = virt_event_timeouts + i;
+        if (timeout->deleted || timeout->frequency < 0 || timeout->expires > now)
+            continue;
+
+        timeout->expires = now + timeout->frequency * 1000ULL;
+
+        /* the callback may realloc the array, do not touch timeout afterwards */
+        virEventTimeoutCallback cb = timeout->cb;
+        int timer = timeout->timer;
+        void *opaque = timeout->opaque;
+        pthread_mutex_unlock(&virt_event_lock);
+        cb(timer, opaque);
+        pthread_mutex_lock(&virt_event_lock);
+    }
+    virt_event_cleanup();
+    pthread_mutex_unlock(&virt_event_lock);
+}
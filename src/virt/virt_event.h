@@ -0,0 +1,101 @@
+/* This file contains the libvirt event loop implementation driven by the main loop
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_event.h
+ * This file contains the libvirt event loop implementation. libvirt asks it
+ * to watch file descriptors and run timeouts, which the main loop then polls
+ * together with its own sources, so the process sleeps in a single poll()
+ * until something actually happens.
+ */
+#ifndef VIRT_EVENT_H
+#define VIRT_EVENT_H
+#include "virt.h"
+#include <poll.h>
+/** Number of pollfd entries used by the loop itself, the wake up descriptor */
+#define VIRT_EVENT_WAKE_SIZE (1)
+
+/** File descriptor watched on behalf of libvirt */
+typedef struct {
+    int                     watch;      /** Identifier given to libvirt */
+    int                     fd;         /** Watched file descriptor */
+    int                     events;     /** VIR_EVENT_HANDLE_* mask to watch for */
+    virEventHandleCallback  cb;         /** Called when events happen */
+    void                    *opaque;    /** Argument of cb and ff */
+    virFreeCallback         ff;         /** Frees opaque once the handle is removed */
+    int                     deleted;    /** Removed, freed after the dispatch */
+} virt_event_handle;
+
+/** Timeout run on behalf of libvirt */
+typedef struct {
+    int                     timer;      /** Identifier given to libvirt */
+    int                     frequency;  /** Period in milliseconds, 0 every iteration, -1 disabled */
+    unsigned long long      expires;    /** Monotonic time of the next run in microseconds */
+    virEventTimeoutCallback cb;         /** Called when the timeout expires */
+    void                    *opaque;    /** Argument of cb and ff */
+    virFreeCallback         ff;         /** Frees opaque once the timeout is removed */
+    int                     deleted;    /** Removed, freed after the dispatch */
+} virt_event_timeout;
+
+/**
+ * Register the implementation with libvirt,
+ * this function must be called before connecting,
+ * from the thread which runs the loop.
+ * Libvirt may change handles and timeouts from any thread,
+ * the loop is woken up to pick the change up.
+ */
+void virt_event_register();
+
+/**
+ * Release all handles and timeouts.
+ */
+void virt_event_deinit();
+
+/**
+ * Return number of watched file descriptors, including the wake up descriptor.
+ * @return number of pollfd entries virt_event_fill fills
+ */
+size_t virt_event_handle_size();
+
+/**
+ * Fill pollfd entries with watched file descriptors.
+ * @param fds  - array of entries
+ * @param size - number of entries, as returned by virt_event_handle_size
+ */
+void virt_event_fill(struct pollfd *fds, size_t size);
+
+/**
+ * Run callbacks of handles whose file descriptors are ready.
+ * @param fds  - entries filled by virt_event_fill and returned by poll()
+ * @param size - number of entries
+ */
+void virt_event_dispatch_handles(const struct pollfd *fds, size_t size);
+
+/**
+ * Return time of the nearest enabled timeout.
+ * @return monotonic time in microseconds, 0 if no timeout is enabled
+ */
+unsigned long long virt_event_next_timeout();
+
+/**
+ * Run callbacks of expired timeouts.
+ * @param now - monotonic time in microseconds
+ */
+void virt_event_dispatch_timeouts(unsigned long long now);
+
+#endif /* VIRT_EVENT_H */
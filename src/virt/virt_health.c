@@ -0,0 +1,297 @@
+/* This file contains the connection health watch and background reconnection
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_health.h"
+#include "virt_record.h"
+#include "virt_storage.h"
+#include "virt_network.h"
+#include "virt_jobs.h"
+#include "virt_detail.h"
+#include "utils.h"
+#include <pthread.h>
+
+/** Reconnection running in a background thread, shared with the thread */
+typedef struct {
+    char            *uri;       /** Node to be opened */
+    virConnectPtr   conn;       /** Opened connection, NULL on failure */
+    int             done;       /** Thread finished */
+    int             refs;       /** Main loop and thread references */
+} virt_health_attempt;
+
+/** State shared with the close callback and the reconnection thread, guarded by lock */
+static struct {
+    pthread_mutex_t     lock;
+    int                 closed;     /** Close callback fired */
+    int                 reason;     /** Reason passed to the close callback */
+    virt_health_attempt *attempt;   /** Reconnection in progress, NULL if none */
+} health_state = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/* Drop a reference of the attempt, called with the lock held, returns TRUE if it has to be freed */
+static int virt_health_attempt_unref(virt_health_attempt *attempt)
+{
+    return --attempt->refs == 0;
+}
+
+static void virt_health_attempt_free(virt_health_attempt *attempt)
+{
+    if (attempt->conn)
+        virConnectClose(attempt->conn);
+    free(attempt->uri);
+    free(attempt);
+}
+
+/* Called by libvirt from whichever thread noticed the connection closing */
+static void virt_health_closed(virConnectPtr conn, int reason, void *opaque)
+{
+    pthread_mutex_lock(&health_state.lock);
+    health_state.closed = 1;
+    health_state.reason = reason;
+    pthread_mutex_unlock(&health_state.lock);
+}
+
+static void *virt_health_connect(void *arg)
+{
+    virt_health_attempt *attempt = arg;
+
+    /* opening may block for long, e.g. on an unreachable SSH host */
+    char *conn_args[1] = { attempt->uri };
+    virConnectPtr conn = virt_connect_node(conn_args, 1);
+
+    pthread_mutex_lock(&health_state.lock);
+    attempt->conn = conn;
+    attempt->done = 1;
+    int drop = virt_health_attempt_unref(attempt);
+    pthread_mutex_unlock(&health_state.lock);
+
+    if (drop)
+        virt_health_attempt_free(attempt);
+    return NULL;
+}
+
+/* Start a background reconnection */
+static void virt_health_start_attempt(virt_health_data *health)
+{
+    virt_health_attempt *attempt = calloc(1, sizeof(virt_health_attempt));
+    if (!attempt)
+        return;
+    attempt->uri    = copy_str(health->uri);
+    attempt->refs   = 2;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, virt_health_connect, attempt) != 0) {
+        free(attempt->uri);
+        free(attempt);
+    } else {
+        pthread_mutex_lock(&health_state.lock);
+        health_state.attempt = attempt;
+        pthread_mutex_unlock(&health_state.lock);
+    }
+
+    pthread_attr_destroy(&attr);
+}
+
+/*
+ * Take the result of a finished reconnection.
+ * @param conn - filled with the opened connection, NULL if the attempt failed
+ * @return TRUE (1) if an attempt finished, FALSE (0) if none is running or it is still running
+ */
+static int virt_health_take_attempt(virConnectPtr *conn)
+{
+    pthread_mutex_lock(&health_state.lock);
+    virt_health_attempt *attempt = health_state.attempt;
+    if (!attempt || !attempt->done) {
+        pthread_mutex_unlock(&health_state.lock);
+        return 0;
+    }
+
+    *conn = attempt->conn;
+    attempt->conn = NULL;
+    health_state.attempt = NULL;
+    int drop = virt_health_attempt_unref(attempt);
+    pthread_mutex_unlock(&health_state.lock);
+
+    if (drop)
+        virt_health_attempt_free(attempt);
+    return 1;
+}
+
+/* Check whether a reconnection is running */
+static int virt_health_attempt_running()
+{
+    pthread_mutex_lock(&health_state.lock);
+    int running = health_state.attempt != NULL;
+    pthread_mutex_unlock(&health_state.lock);
+    return running;
+}
+
+/* Enable keepalive probes and the close callback on virt->conn */
+static void virt_health_arm(virt_data *virt)
+{
+    pthread_mutex_lock(&health_state.lock);
+    health_state.closed = 0;
+    pthread_mutex_unlock(&health_state.lock);
+
+    /* probes need the event loop, a remote side without keepalive support returns 1 */
+    virConnectSetKeepAlive(virt->conn, VIRT_HEALTH_KEEPALIVE_INTERVAL, VIRT_HEALTH_KEEPALIVE_COUNT);
+    virConnectRegisterCloseCallback(virt->conn, virt_health_closed, NULL, NULL);
+    virt->health->connected = 1;
+}
+
+/* Close the dead connection and schedule the first reconnection */
+static void virt_health_lost(virt_data *virt, int reason, unsigned long long now)
+{
+    virt_health_data *health = virt->health;
+
+    virt_health_unwatch(virt);
+    virt_network_unwatch(virt->network);
+    virt_jobs_unwatch(virt->jobs);
+    virt_detail_unwatch(virt->detail);
+    virConnectClose(virt->conn);
+    virt->conn = NULL;
+
+    health->connected   = 0;
+    health->reason      = reason;
+    health->lost_at     = now;
+    health->retry_at    = now;
+    health->retry_delay = VIRT_HEALTH_RETRY_MIN;
+}
+
+void virt_init_health(virt_health_data *health)
+{
+    health->uri         = NULL;
+    health->connected   = 0;
+    health->reason      = VIR_CONNECT_CLOSE_REASON_ERROR;
+    health->lost_at     = 0;
+    health->retry_at    = 0;
+    health->retry_delay = 0;
+    health->reconnects  = 0;
+    virt_init_node_data(&health->node);
+}
+
+void virt_deinit_health(virt_health_data *health)
+{
+    /* a running attempt frees itself once it returns */
+    pthread_mutex_lock(&health_state.lock);
+    virt_health_attempt *attempt = health_state.attempt;
+    health_state.attempt = NULL;
+    int drop = attempt && virt_health_attempt_unref(attempt);
+    pthread_mutex_unlock(&health_state.lock);
+    if (drop)
+        virt_health_attempt_free(attempt);
+
+    free(health->uri);
+    virt_deinit_node_data(&health->node);
+    virt_init_health(health);
+}
+
+void virt_health_watch(virt_data *virt, const char *uri)
+{
+    free(virt->health->uri);
+    virt->health->uri = copy_str(uri);
+    virt_health_arm(virt);
+}
+
+void virt_health_unwatch(virt_data *virt)
+{
+    if (virt->conn && virt->health->connected)
+        virConnectUnregisterCloseCallback(virt->conn, virt_health_closed);
+}
+
+int virt_health_check(virt_data *virt)
+{
+    virt_health_data *health = virt->health;
+    unsigned long long now = time_monotonic_us();
+
+    if (health->connected) {
+        pthread_mutex_lock(&health_state.lock);
+        int closed = health_state.closed;
+        int reason = health_state.reason;
+        pthread_mutex_unlock(&health_state.lock);
+
+        if (!closed)
+            return 1;
+        virt_health_lost(virt, reason, now);
+    }
+
+    virConnectPtr conn = NULL;
+    if (virt_health_take_attempt(&conn)) {
+        if (conn) {
+            virt->conn = conn;
+            virt_health_arm(virt);
+            ++health->reconnects;
+
+            /* records are kept, every group is due so the next refresh revalidates them */
+            for (int i = 0; i != VIRT_GROUP_SIZE; ++i)
+                virt->records->fetched[i] = 0;
+
+            /* the node may have been replaced, e.g. a different host behind the same URI */
+            virt_node_invalidate(virt->node);
+            virt_storage_invalidate(virt->storage);
+            virt_network_invalidate(virt->network);
+            virt_jobs_invalidate(virt->jobs);
+            virt_detail_invalidate(virt->detail);
+            return 1;
+        }
+
+        health->retry_delay = health->retry_delay * 2.0 < VIRT_HEALTH_RETRY_MAX ?
+                              health->retry_delay * 2.0 : VIRT_HEALTH_RETRY_MAX;
+        health->retry_at    = now + (unsigned long long)(health->retry_delay * 1000000.0);
+    }
+
+    if (now >= health->retry_at && !virt_health_attempt_running())
+        virt_health_start_attempt(health);
+
+    return 0;
+}
+
+void virt_health_failed(virt_data *virt)
+{
+    /* a call failing on a live connection is just a failed call */
+    if (virt->health->connected && virConnectIsAlive(virt->conn) == 0)
+        virt_health_lost(virt, VIR_CONNECT_CLOSE_REASON_ERROR, time_monotonic_us());
+}
+
+int virt_health_connected(const virt_data *virt)
+{
+    return virt->health->connected;
+}
+
+void virt_health_status(const virt_data *virt, char *buf)
+{
+    const virt_health_data *health = virt->health;
+    unsigned long long now = time_monotonic_us();
+
+    if (health->connected) {
+        buf[0] = '\0';
+        return;
+    }
+
+    unsigned long long down = (now - health->lost_at) / 1000000;
+    if (virt_health_attempt_running())
+        snprintf(buf, VIRT_HEALTH_STATUS_BUFFER_SIZE, "disconnected %llus, reconnecting", down);
+    else
+        snprintf(buf, VIRT_HEALTH_STATUS_BUFFER_SIZE, "disconnected %llus, retry in %llus", down,
+                 health->retry_at > now ? (health->retry_at - now + 999999) / 1000000 : 0);
+}
@@ -0,0 +1,110 @@
+/* This file contains the connection health watch and background reconnection
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_health.h
+ * This file contains the connection health watch. Keepalive probes and a
+ * close callback detect a dead connection, e.g. after libvirtd restarts or
+ * an SSH tunnel drops. While disconnected no calls are made, the last
+ * snapshot stays on the screen marked as such, and the node is opened again
+ * in the background with exponential backoff. Domain records survive the
+ * outage and are revalidated by the first refresh after reconnecting.
+ */
+#ifndef VIRT_HEALTH_H
+#define VIRT_HEALTH_H
+#include "virt.h"
+#include "virt_node.h"
+/** Seconds between keepalive probes */
+#define VIRT_HEALTH_KEEPALIVE_INTERVAL (5)
+/** Number of unanswered probes after which the connection is closed */
+#define VIRT_HEALTH_KEEPALIVE_COUNT (3)
+/** First reconnection delay in seconds */
+#define VIRT_HEALTH_RETRY_MIN (1.0)
+/** Longest reconnection delay in seconds */
+#define VIRT_HEALTH_RETRY_MAX (30.0)
+/** Size of the buffer describing the connection state */
+#define VIRT_HEALTH_STATUS_BUFFER_SIZE (256)
+
+/** Connection state, owned by the main loop. */
+typedef struct virt_health_data {
+    char                *uri;           /** URI the node was opened with, reused for reconnecting */
+    int                 connected;      /** Connection is usable */
+    int                 reason;         /** VIR_CONNECT_CLOSE_REASON_* of the last loss */
+    unsigned long long  lost_at;        /** Monotonic time the connection was lost */
+    unsigned long long  retry_at;       /** Monotonic time of the next reconnection attempt */
+    double              retry_delay;    /** Current reconnection delay in seconds */
+    unsigned long long  reconnects;     /** Number of successful reconnections */
+    virt_node_data      node;           /** Last node panel, shown while disconnected */
+} virt_health_data;
+
+/**
+ * Set health object to default state.
+ * @param health - object to be initialized
+ */
+void virt_init_health(virt_health_data *health);
+
+/**
+ * Release health object, a reconnection attempt still running is abandoned.
+ * @param health - object to be freed
+ */
+void virt_deinit_health(virt_health_data *health);
+
+/**
+ * Start watching the freshly opened connection: enable keepalive
+ * probes and register the close callback.
+ * @param virt - pointer with virt data, virt->conn must be open
+ * @param uri  - URI the connection was opened with
+ */
+void virt_health_watch(virt_data *virt, const char *uri);
+
+/**
+ * Stop watching the connection before it is closed.
+ * @param virt - pointer with virt data
+ */
+void virt_health_unwatch(virt_data *virt);
+
+/**
+ * Drive the connection state, called once per refresh.
+ * A lost connection is closed and reopened in the background, once a new
+ * connection is open all metric groups are scheduled for revalidation.
+ * @param virt - pointer with virt data
+ * @return TRUE (1) if the connection is usable, FALSE (0) otherwise
+ */
+int virt_health_check(virt_data *virt);
+
+/**
+ * Report a failed call, the connection is marked lost if it is no longer alive.
+ * @param virt - pointer with virt data
+ */
+void virt_health_failed(virt_data *virt);
+
+/**
+ * Check whether the connection is usable.
+ * @param virt - pointer with virt data
+ * @return TRUE (1) if connected, FALSE (0) otherwise
+ */
+int virt_health_connected(const virt_data *virt);
+
+/**
+ * Describe the connection state, e.g. "disconnected 12s, retry in 4s".
+ * @param virt - pointer with virt data
+ * @param buf  - buffer of at least VIRT_HEALTH_STATUS_BUFFER_SIZE bytes
+ */
+void virt_health_status(const virt_data *virt, char *buf);
+
+#endif /* VIRT_HEALTH_H */
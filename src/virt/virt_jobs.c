@@ -0,0 +1,785 @@
+/* This file contains the jobs mode, migrations and other domain jobs
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_jobs.h"
+#include "virt_domain.h"
+#include "virt_record.h"
+#include "virt_health.h"
+#include "virt_watchdog.h"
+#include "virt_command.h"
+#include "virt_trace.h"
+#include "utils.h"
+#include <stdio.h>
+
+/** Callbacks, indecies of virt_jobs_cache.callback */
+enum {
+    VIRT_JOBS_CALLBACK_ITERATION,
+    VIRT_JOBS_CALLBACK_COMPLETED,
+    VIRT_JOBS_CALLBACK_BLOCK_JOB
+};
+
+/** Page size assumed when the job does not report it */
+#define VIRT_JOBS_PAGE_SIZE (4096ULL)
+/** Number of known job operations */
+#define VIRT_JOBS_OPERATION_SIZE (11)
+/** Number of known block job types */
+#define VIRT_JOBS_BLOCK_TYPE_SIZE (7)
+
+const char *virt_jobs_field_name[VIRT_JOBS_FIELD_SIZE] = {
+    VIR_DOMAIN_JOB_DATA_PROCESSED,
+    VIR_DOMAIN_JOB_DATA_REMAINING,
+    VIR_DOMAIN_JOB_DATA_TOTAL,
+    VIR_DOMAIN_JOB_MEMORY_REMAINING,
+    VIR_DOMAIN_JOB_MEMORY_BPS,
+    VIR_DOMAIN_JOB_MEMORY_DIRTY_RATE,
+    VIR_DOMAIN_JOB_MEMORY_PAGE_SIZE,
+    VIR_DOMAIN_JOB_MEMORY_ITERATION,
+    VIR_DOMAIN_JOB_DOWNTIME,
+    VIR_DOMAIN_JOB_TIME_ELAPSED,
+    VIR_DOMAIN_JOB_TIME_REMAINING
+};
+
+/** Job operations, in the order of virDomainJobOperation */
+static const char *virt_jobs_operation_text[VIRT_JOBS_OPERATION_SIZE] = {
+    "job",
+    "start",
+    "save",
+    "restore",
+    "migrate in",
+    "migrate out",
+    "snapshot",
+    "revert",
+    "dump",
+    "backup",
+    "snap delete"
+};
+
+/** Block job types, in the order of virDomainBlockJobType */
+static const char *virt_jobs_block_type_text[VIRT_JOBS_BLOCK_TYPE_SIZE] = {
+    "block",
+    "pull",
+    "migrate",
+    "copy",
+    "commit",
+    "commit",
+    "backup"
+};
+
+/** Job states, in the order of virt_jobs_state_enum */
+static const char *virt_jobs_state_text[] = {
+    "active",
+    "completed",
+    "ended",
+    "failed",
+    "cancelled"
+};
+
+/** Arguments of virt_jobs_set_speed */
+typedef struct {
+    char            disk[VIRT_DETAIL_TOKEN_SIZE];
+    unsigned long   bandwidth;      /** Bytes per second, 0 for unlimited */
+} virt_jobs_speed_command;
+
+#define VIRT_JOBS_FIELD_BIT(field) (1u << (field))
+
+void virt_init_jobs_cache(virt_jobs_cache *cache)
+{
+    cache->job          = NULL;
+    cache->job_size     = 0;
+    cache->pending      = NULL;
+    cache->pending_size = 0;
+    cache->scanned      = 0;
+    cache->row_size     = 0;
+    cache->conn         = NULL;
+    for (int i = 0; i != VIRT_JOBS_CALLBACK_SIZE; ++i)
+        cache->callback[i] = -1;
+}
+
+void virt_deinit_jobs_cache(virt_jobs_cache *cache)
+{
+    for (int i = 0; i != cache->job_size; ++i)
+        free(cache->job[i].name);
+    free(cache->job);
+    free(cache->pending);
+}
+
+void virt_jobs_invalidate(virt_jobs_cache *cache)
+{
+    virt_jobs_unwatch(cache);
+    virt_deinit_jobs_cache(cache);
+    virt_init_jobs_cache(cache);
+}
+
+void virt_jobs_unwatch(virt_jobs_cache *cache)
+{
+    if (!cache->conn)
+        return;
+
+    for (int i = 0; i != VIRT_JOBS_CALLBACK_SIZE; ++i) {
+        if (cache->callback[i] >= 0)
+            virConnectDomainEventDeregisterAny(cache->conn, cache->callback[i]);
+        cache->callback[i] = -1;
+    }
+    cache->conn = NULL;
+}
+
+/* Find the job of the domain, disk is empty for the domain job */
+static virt_jobs_job *virt_jobs_find(virt_jobs_cache *cache, const unsigned char *uuid, const char *disk)
+{
+    for (int i = 0; i != cache->job_size; ++i)
+        if (memcmp(cache->job[i].uuid, uuid, VIR_UUID_BUFLEN) == 0 && strcmp(cache->job[i].disk, disk) == 0)
+            return cache->job + i;
+    return NULL;
+}
+
+/* Find the job of the domain or its disk, a finished job makes room for the new one */
+static virt_jobs_job *virt_jobs_add(virt_jobs_cache *cache, virDomainPtr domain, const unsigned char *uuid,
+                                    const char *disk)
+{
+    virt_jobs_job *job = virt_jobs_find(cache, uuid, disk);
+    if (job && job->state == VIRT_JOBS_STATE_ACTIVE)
+        return job;
+
+    if (!job) {
+        cache->job = realloc(cache->job, (cache->job_size + 1) * sizeof(virt_jobs_job));
+        job = cache->job + cache->job_size++;
+    } else {
+        free(job->name);
+    }
+
+    memset(job, 0, sizeof(virt_jobs_job));
+    memcpy(job->uuid, uuid, VIR_UUID_BUFLEN);
+    snprintf(job->disk, sizeof(job->disk), "%s", disk);
+    const char *name = virDomainGetName(domain);
+    job->name   = copy_str(name ? name : VIRT_DOMAIN_UNKNOWN_DATA);
+    job->state  = VIRT_JOBS_STATE_ACTIVE;
+    return job;
+}
+
+/* Derive the transfer rate from the data processed since the previous poll */
+static void virt_jobs_update_rate(virt_jobs_job *job, unsigned int known, unsigned long long processed,
+                                  unsigned long long now)
+{
+    unsigned int processed_bit = VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_DATA_PROCESSED);
+    if (known & job->known & processed_bit)
+        job->rate = virt_domain_rate(job->value[VIRT_JOBS_FIELD_DATA_PROCESSED], processed,
+                                     job->polled ? now - job->polled : 0);
+    job->polled = now;
+}
+
+/* Take over the stats of a poll or of the completion event */
+static void virt_jobs_merge(virt_jobs_job *job, int type, virTypedParameterPtr params, int nparams,
+                            unsigned long long now)
+{
+    unsigned int        known       = job->known;
+    unsigned long long  processed   = job->value[VIRT_JOBS_FIELD_DATA_PROCESSED];
+    unsigned long long  iteration   = job->value[VIRT_JOBS_FIELD_MEMORY_ITERATION];
+
+    job->type   = type;
+    job->known  = 0;
+    for (int i = 0; i != VIRT_JOBS_FIELD_SIZE; ++i)
+        if (virTypedParamsGetULLong(params, nparams, virt_jobs_field_name[i], job->value + i) == 1)
+            job->known |= VIRT_JOBS_FIELD_BIT(i);
+    virTypedParamsGetInt(params, nparams, VIR_DOMAIN_JOB_OPERATION, &job->operation);
+
+    virt_jobs_update_rate(job, known, processed, now);
+
+    /* remaining memory is compared once per iteration, within one it only shrinks */
+    unsigned int iteration_bits = VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_MEMORY_ITERATION) |
+                                  VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_MEMORY_REMAINING);
+    if ((job->known & iteration_bits) == iteration_bits &&
+        (!(known & iteration_bits) || job->value[VIRT_JOBS_FIELD_MEMORY_ITERATION] != iteration)) {
+        unsigned long long remaining = job->value[VIRT_JOBS_FIELD_MEMORY_REMAINING];
+        /* the first pass sends all of memory, later ones only what was dirtied meanwhile */
+        if ((known & iteration_bits) == iteration_bits && iteration >= 1 &&
+            job->value[VIRT_JOBS_FIELD_MEMORY_ITERATION] > iteration)
+            job->growing = remaining >= job->iteration_remaining;
+        job->iteration_remaining = remaining;
+    }
+}
+
+/* Take over a poll of the block job, cur and end count bytes with every known driver */
+static void virt_jobs_merge_block(virt_jobs_job *job, const virDomainBlockJobInfo *info, unsigned long long now)
+{
+    unsigned int        known       = job->known;
+    unsigned long long  processed   = job->value[VIRT_JOBS_FIELD_DATA_PROCESSED];
+
+    if (!job->started)
+        job->started = now;
+    job->type       = info->type;
+    job->bandwidth  = info->bandwidth;
+    job->value[VIRT_JOBS_FIELD_DATA_PROCESSED]  = info->cur;
+    job->value[VIRT_JOBS_FIELD_DATA_TOTAL]      = info->end;
+    job->value[VIRT_JOBS_FIELD_DATA_REMAINING]  = info->end > info->cur ? info->end - info->cur : 0;
+    job->value[VIRT_JOBS_FIELD_TIME_ELAPSED]    = (now - job->started) / 1000;
+    job->known = VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_DATA_PROCESSED) |
+                 VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_DATA_TOTAL) |
+                 VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_DATA_REMAINING) |
+                 VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_TIME_ELAPSED);
+    virt_jobs_update_rate(job, known, processed, now);
+
+    /* a mirror stays in sync until it is pivoted or cancelled */
+    if ((info->type == VIR_DOMAIN_BLOCK_JOB_TYPE_COPY || info->type == VIR_DOMAIN_BLOCK_JOB_TYPE_ACTIVE_COMMIT) &&
+        info->end && info->cur == info->end)
+        job->ready = 1;
+}
+
+/* Remember the domain, its job is polled on the next refresh */
+static void virt_jobs_queue(virt_jobs_cache *cache, virDomainPtr domain)
+{
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    if (virDomainGetUUID(domain, uuid) < 0)
+        return;
+
+    for (int i = 0; i != cache->pending_size; ++i)
+        if (memcmp(cache->pending[i], uuid, VIR_UUID_BUFLEN) == 0)
+            return;
+
+    cache->pending = realloc(cache->pending, (cache->pending_size + 1) * sizeof(*cache->pending));
+    memcpy(cache->pending[cache->pending_size++], uuid, VIR_UUID_BUFLEN);
+}
+
+static int virt_jobs_pending(const virt_jobs_cache *cache, const unsigned char *uuid)
+{
+    for (int i = 0; i != cache->pending_size; ++i)
+        if (memcmp(cache->pending[i], uuid, VIR_UUID_BUFLEN) == 0)
+            return 1;
+    return 0;
+}
+
+/* Events are dispatched by the main loop, the callbacks only take notes */
+static void virt_jobs_iteration(virConnectPtr conn, virDomainPtr domain, int iteration, void *opaque)
+{
+    virt_jobs_queue(opaque, domain);
+}
+
+/* The final stats come with the event, the job is gone from the domain by now */
+static void virt_jobs_completed(virConnectPtr conn, virDomainPtr domain, virTypedParameterPtr params,
+                                int nparams, void *opaque)
+{
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    if (virDomainGetUUID(domain, uuid) < 0)
+        return;
+
+    unsigned long long now = time_monotonic_us();
+    virt_jobs_job *job = virt_jobs_add(opaque, domain, uuid, "");
+    virt_jobs_merge(job, VIR_DOMAIN_JOB_COMPLETED, params, nparams, now);
+    job->state      = VIRT_JOBS_STATE_COMPLETED;
+    job->finished   = now;
+}
+
+/* Block job events name the disk by its target, jobs which came and went between scans are listed too */
+static void virt_jobs_block_job(virConnectPtr conn, virDomainPtr domain, const char *disk, int type, int status,
+                                void *opaque)
+{
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    if (!disk || virDomainGetUUID(domain, uuid) < 0)
+        return;
+
+    virt_jobs_job *job = virt_jobs_find(opaque, uuid, disk);
+    if (status == VIR_DOMAIN_BLOCK_JOB_READY) {
+        if (job && job->state == VIRT_JOBS_STATE_ACTIVE)
+            job->ready = 1;
+        return;
+    }
+
+    /* a poll may have seen the job go away before the event came */
+    if (job && job->state != VIRT_JOBS_STATE_ACTIVE && job->state != VIRT_JOBS_STATE_GONE)
+        return;
+    if (!job) {
+        job = virt_jobs_add(opaque, domain, uuid, disk);
+        job->type = type;
+    }
+
+    switch (status) {
+        case VIR_DOMAIN_BLOCK_JOB_COMPLETED:
+            job->state = VIRT_JOBS_STATE_COMPLETED;
+            break;
+        case VIR_DOMAIN_BLOCK_JOB_FAILED:
+            job->state = VIRT_JOBS_STATE_FAILED;
+            break;
+        default:
+            job->state = VIRT_JOBS_STATE_CANCELLED;
+            break;
+    }
+    job->finished = time_monotonic_us();
+}
+
+/* Register the callbacks on conn, failed registrations stay at -1 */
+static void virt_jobs_watch(virt_jobs_cache *cache, virConnectPtr conn)
+{
+    cache->conn = conn;
+    cache->callback[VIRT_JOBS_CALLBACK_ITERATION] =
+        virConnectDomainEventRegisterAny(conn, NULL, VIR_DOMAIN_EVENT_ID_MIGRATION_ITERATION,
+                                         VIR_DOMAIN_EVENT_CALLBACK(virt_jobs_iteration), cache, NULL);
+    cache->callback[VIRT_JOBS_CALLBACK_COMPLETED] =
+        virConnectDomainEventRegisterAny(conn, NULL, VIR_DOMAIN_EVENT_ID_JOB_COMPLETED,
+                                         VIR_DOMAIN_EVENT_CALLBACK(virt_jobs_completed), cache, NULL);
+    cache->callback[VIRT_JOBS_CALLBACK_BLOCK_JOB] =
+        virConnectDomainEventRegisterAny(conn, NULL, VIR_DOMAIN_EVENT_ID_BLOCK_JOB_2,
+                                         VIR_DOMAIN_EVENT_CALLBACK(virt_jobs_block_job), cache, NULL);
+}
+
+/* Mark the job finished, it stays listed for a while with its last stats */
+static void virt_jobs_finish(virt_jobs_job *job, unsigned long long now)
+{
+    if (job->state != VIRT_JOBS_STATE_ACTIVE)
+        return;
+    job->state      = VIRT_JOBS_STATE_GONE;
+    job->finished   = now;
+}
+
+/* Find the row of the domain among the records, -1 if it is gone */
+static int virt_jobs_record_row(const virt_record_data *records, const unsigned char *uuid)
+{
+    for (size_t i = 0; i != records->record_size; ++i)
+        if (memcmp(records->record[i].uuid, uuid, VIR_UUID_BUFLEN) == 0)
+            return (int)i;
+    return -1;
+}
+
+/* Forget jobs which finished long enough ago */
+static void virt_jobs_expire(virt_jobs_cache *cache, unsigned long long now)
+{
+    int kept = 0;
+    for (int i = 0; i != cache->job_size; ++i) {
+        virt_jobs_job *job = cache->job + i;
+        if (job->state != VIRT_JOBS_STATE_ACTIVE &&
+            now - job->finished >= (unsigned long long)(VIRT_JOBS_KEEP_PERIOD * 1000000.0)) {
+            free(job->name);
+            continue;
+        }
+        cache->job[kept++] = *job;
+    }
+    cache->job_size = kept;
+}
+
+/* Check whether the domain of the row runs and answers */
+static int virt_jobs_askable(virt_domain_record *record, unsigned long long now)
+{
+    /* hung domains keep their last stats */
+    return record->id >= 0 && virt_record_responsive(record, now);
+}
+
+/*
+ * Check the running domains for a domain job when the scan is due, then poll
+ * the stats of every known job and of the domains named by iteration events.
+ */
+static void virt_jobs_refresh_domain(virt_jobs_cache *cache, virt_record_data *records, int scan)
+{
+    unsigned long long now = time_monotonic_us();
+
+    size_t *info_row  = calloc(records->record_size + 1, sizeof(size_t));
+    size_t *stats_row = calloc(records->record_size + 1, sizeof(size_t));
+    virt_watchdog_job **info_job  = calloc(records->record_size + 1, sizeof(virt_watchdog_job *));
+    virt_watchdog_job **stats_job = calloc(records->record_size + 1, sizeof(virt_watchdog_job *));
+    size_t info_size = 0, stats_size = 0;
+
+    for (size_t i = 0; i != records->record_size; ++i) {
+        virt_domain_record *record = records->record + i;
+        if (!virt_jobs_askable(record, now))
+            continue;
+
+        virt_jobs_job *job = virt_jobs_find(cache, record->uuid, "");
+        if ((job && job->state == VIRT_JOBS_STATE_ACTIVE) || virt_jobs_pending(cache, record->uuid))
+            stats_row[stats_size++] = i;
+        else if (scan)
+            info_row[info_size++] = i;
+    }
+
+    /* the cheap check, domains with a job are polled right away */
+    virt_domain_watchdog_run(records, VIRT_WATCHDOG_CALL_JOB_INFO, info_row, info_job, info_size);
+    for (size_t i = 0; i != info_size; ++i) {
+        if (!info_job[i])
+            continue;
+        if (info_job[i]->res == 0 && info_job[i]->job_info.type != VIR_DOMAIN_JOB_NONE)
+            stats_row[stats_size++] = info_row[i];
+        virt_watchdog_release(info_job[i]);
+    }
+
+    virt_domain_watchdog_run(records, VIRT_WATCHDOG_CALL_JOB_STATS, stats_row, stats_job, stats_size);
+    now = time_monotonic_us();
+    for (size_t i = 0; i != stats_size; ++i) {
+        if (!stats_job[i])
+            continue;
+
+        virt_domain_record *record = records->record + stats_row[i];
+        virt_jobs_job *job = virt_jobs_find(cache, record->uuid, "");
+        if (stats_job[i]->res == 0) {
+            if (stats_job[i]->job_type == VIR_DOMAIN_JOB_NONE) {
+                if (job)
+                    virt_jobs_finish(job, now);
+            } else {
+                job = virt_jobs_add(cache, record->domain, record->uuid, "");
+                virt_jobs_merge(job, stats_job[i]->job_type, stats_job[i]->params, stats_job[i]->nparams, now);
+            }
+        }
+        virt_watchdog_release(stats_job[i]);
+    }
+
+    free(stats_job);
+    free(info_job);
+    free(stats_row);
+    free(info_row);
+}
+
+/* Collect the disks of the domain to be asked for a block job, returns their number */
+static int virt_jobs_block_disks(virt_data *virt, size_t row, int scan, char ***disk)
+{
+    virt_jobs_cache *cache = virt->jobs;
+    const virt_domain_record *record = virt->records->record + row;
+    int size = 0;
+
+    *disk = NULL;
+    if (scan) {
+        /* the description is cached, it is fetched again only when the domain changed */
+        const virt_detail_model *model = virt_detail_get(virt, (int)row);
+        for (int i = 0; model && i != model->disk_size; ++i) {
+            const virt_detail_disk *d = model->disk + i;
+            /* removable media never run block jobs */
+            if (!d->target[0] || !d->source || strcmp(d->device, "cdrom") == 0 || strcmp(d->device, "floppy") == 0)
+                continue;
+            *disk = realloc(*disk, (size + 1) * sizeof(char *));
+            (*disk)[size++] = copy_str(d->target);
+        }
+        return size;
+    }
+
+    for (int i = 0; i != cache->job_size; ++i) {
+        const virt_jobs_job *job = cache->job + i;
+        if (!job->disk[0] || job->state != VIRT_JOBS_STATE_ACTIVE ||
+            memcmp(job->uuid, record->uuid, VIR_UUID_BUFLEN) != 0)
+            continue;
+        *disk = realloc(*disk, (size + 1) * sizeof(char *));
+        (*disk)[size++] = copy_str(job->disk);
+    }
+    return size;
+}
+
+/*
+ * Ask every disk of the running domains for a block job when the scan is due,
+ * otherwise only the disks with a known block job.
+ */
+static void virt_jobs_refresh_block(virt_data *virt, int scan)
+{
+    virt_jobs_cache *cache = virt->jobs;
+    virt_record_data *records = virt->records;
+    unsigned long long now = time_monotonic_us();
+
+    size_t *row = calloc(records->record_size + 1, sizeof(size_t));
+    virt_watchdog_job **job = calloc(records->record_size + 1, sizeof(virt_watchdog_job *));
+    size_t size = 0;
+
+    for (size_t i = 0; i != records->record_size; ++i) {
+        virt_domain_record *record = records->record + i;
+        if (!virt_jobs_askable(record, now))
+            continue;
+
+        char **disk = NULL;
+        int disk_size = virt_jobs_block_disks(virt, i, scan, &disk);
+        if (disk_size) {
+            row[size] = i;
+            job[size++] = virt_watchdog_submit_disks(record->domain, VIRT_WATCHDOG_CALL_BLOCK_JOB_INFO,
+                                                     disk, disk_size);
+        }
+        free_pointer_char(disk, disk + disk_size);
+    }
+
+    virt_domain_watchdog_wait(records, row, job, size);
+    now = time_monotonic_us();
+    for (size_t i = 0; i != size; ++i) {
+        if (!job[i])
+            continue;
+
+        virt_domain_record *record = records->record + row[i];
+        for (int j = 0; j != job[i]->disk_size; ++j) {
+            virt_jobs_job *block = virt_jobs_find(cache, record->uuid, job[i]->disk[j]);
+            if (job[i]->block_res[j] > 0) {
+                block = virt_jobs_add(cache, record->domain, record->uuid, job[i]->disk[j]);
+                virt_jobs_merge_block(block, job[i]->block_job + j, now);
+            } else if (job[i]->block_res[j] == 0 && block) {
+                /* the event telling how it ended may still come */
+                virt_jobs_finish(block, now);
+            }
+        }
+        virt_watchdog_release(job[i]);
+    }
+
+    free(job);
+    free(row);
+}
+
+/* Check the running domains for jobs and poll the known ones */
+static void virt_jobs_refresh(virt_data *virt)
+{
+    virt_jobs_cache *cache = virt->jobs;
+    virt_refresh_domain_records(virt);
+    if (!virt_health_connected(virt))
+        return;
+
+    /* callbacks go first, so no iteration is missed after the scan */
+    if (cache->conn != virt->conn) {
+        virt_jobs_unwatch(cache);
+        virt_jobs_watch(cache, virt->conn);
+    }
+
+    virt_record_data *records = virt->records;
+    unsigned long long now = time_monotonic_us();
+    int scan = !cache->scanned ||
+               now - cache->scanned >= (unsigned long long)(VIRT_JOBS_SCAN_PERIOD * 1000000.0);
+
+    virt_jobs_refresh_domain(cache, records, scan);
+    virt_jobs_refresh_block(virt, scan);
+
+    /* jobs of domains which stopped or are gone, e.g. migrated away */
+    now = time_monotonic_us();
+    for (int i = 0; i != cache->job_size; ++i) {
+        int row = virt_jobs_record_row(records, cache->job[i].uuid);
+        if (row < 0 || records->record[row].id < 0)
+            virt_jobs_finish(cache->job + i, now);
+    }
+
+    if (scan)
+        cache->scanned = now;
+    cache->pending_size = 0;
+    virt_jobs_expire(cache, now);
+}
+
+/* Check whether the migration does not converge */
+static int virt_jobs_diverging(const virt_jobs_job *job)
+{
+    if (job->state != VIRT_JOBS_STATE_ACTIVE)
+        return 0;
+    if (job->growing)
+        return 1;
+
+    /* the guest dirties memory faster than it is sent */
+    unsigned int rate_bits = VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_MEMORY_DIRTY_RATE) |
+                             VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_MEMORY_BPS) |
+                             VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_MEMORY_ITERATION);
+    if ((job->known & rate_bits) != rate_bits || job->value[VIRT_JOBS_FIELD_MEMORY_ITERATION] < 2)
+        return 0;
+    unsigned long long page = job->known & VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_MEMORY_PAGE_SIZE) ?
+                              job->value[VIRT_JOBS_FIELD_MEMORY_PAGE_SIZE] : VIRT_JOBS_PAGE_SIZE;
+    return job->value[VIRT_JOBS_FIELD_MEMORY_DIRTY_RATE] * page >= job->value[VIRT_JOBS_FIELD_MEMORY_BPS];
+}
+
+/* Transfer rate in bytes per second, as reported or derived from the processed data */
+static double virt_jobs_rate(const virt_jobs_job *job)
+{
+    if (job->known & VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_MEMORY_BPS))
+        return job->value[VIRT_JOBS_FIELD_MEMORY_BPS];
+    return job->rate;
+}
+
+/* Format a field of the job, unknown if the job did not report it */
+static char *virt_jobs_field_str(const virt_jobs_job *job, virt_jobs_field_enum field, double value, int stale)
+{
+    if (!(job->known & VIRT_JOBS_FIELD_BIT(field)))
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    return virt_domain_stale_str(double_to_str(value), stale);
+}
+
+/* Format a duration in milliseconds, e.g. "12m05s" */
+static char *virt_jobs_duration_str(unsigned long long ms, int stale)
+{
+    char buf[32];
+    unsigned long long seconds = ms / 1000;
+    if (seconds >= 3600)
+        snprintf(buf, sizeof(buf), "%lluh%02llum", seconds / 3600, seconds % 3600 / 60);
+    else
+        snprintf(buf, sizeof(buf), "%llum%02llus", seconds / 60, seconds % 60);
+    return virt_domain_stale_str(copy_str(buf), stale);
+}
+
+/* Estimate the time left, as reported or from the remaining data and the rate */
+static char *virt_jobs_eta_str(const virt_jobs_job *job, int stale)
+{
+    if (job->state != VIRT_JOBS_STATE_ACTIVE)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    if ((job->known & VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_TIME_REMAINING)) &&
+        job->value[VIRT_JOBS_FIELD_TIME_REMAINING] > 0)
+        return virt_jobs_duration_str(job->value[VIRT_JOBS_FIELD_TIME_REMAINING], stale);
+    if (virt_jobs_diverging(job))
+        return virt_domain_stale_str(copy_str("never"), stale);
+
+    double rate = virt_jobs_rate(job);
+    if (!(job->known & VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_DATA_REMAINING)) || rate <= 0)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    return virt_jobs_duration_str((unsigned long long)(job->value[VIRT_JOBS_FIELD_DATA_REMAINING] / rate * 1000.0),
+                                  stale);
+}
+
+/* Name the job, block jobs with their disk, e.g. "copy vda" */
+static char *virt_jobs_operation_str(const virt_jobs_job *job)
+{
+    if (!job->disk[0]) {
+        int operation = job->operation >= 0 && job->operation < VIRT_JOBS_OPERATION_SIZE ? job->operation : 0;
+        return copy_str(virt_jobs_operation_text[operation]);
+    }
+
+    char buf[64];
+    int type = job->type >= 0 && job->type < VIRT_JOBS_BLOCK_TYPE_SIZE ? job->type : 0;
+    snprintf(buf, sizeof(buf), "%s %s", virt_jobs_block_type_text[type], job->disk);
+    return copy_str(buf);
+}
+
+/* Share of the data processed, as far as the job knows its total */
+static char *virt_jobs_progress_str(const virt_jobs_job *job, int stale)
+{
+    unsigned int total_bits = VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_DATA_PROCESSED) |
+                              VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_DATA_TOTAL);
+    if ((job->known & total_bits) != total_bits || !job->value[VIRT_JOBS_FIELD_DATA_TOTAL])
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+
+    double prc = 100.0 * job->value[VIRT_JOBS_FIELD_DATA_PROCESSED] / job->value[VIRT_JOBS_FIELD_DATA_TOTAL];
+    return virt_domain_stale_str(double_to_str(prc < 100.0 ? prc : 100.0), stale);
+}
+
+/* Bandwidth limit of a block job, domain jobs have none */
+static char *virt_jobs_limit_str(const virt_jobs_job *job, int stale)
+{
+    if (!job->disk[0] || job->state != VIRT_JOBS_STATE_ACTIVE)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    if (!job->bandwidth)
+        return virt_domain_stale_str(copy_str("none"), stale);
+    return virt_domain_stale_str(double_to_str(job->bandwidth / (1024.0 * 1024.0)), stale);
+}
+
+static void virt_jobs_render_row(virt_jobs_data *data, size_t row, const virt_jobs_job *job, int stale)
+{
+    const double mib = 1024.0 * 1024.0;
+    const char *state = virt_jobs_diverging(job) ? VIRT_JOBS_DIVERGING :
+                        job->state == VIRT_JOBS_STATE_ACTIVE && job->ready ? "ready" :
+                        virt_jobs_state_text[job->state];
+
+    unsigned long long page = job->known & VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_MEMORY_PAGE_SIZE) ?
+                              job->value[VIRT_JOBS_FIELD_MEMORY_PAGE_SIZE] : VIRT_JOBS_PAGE_SIZE;
+    double rate = virt_jobs_rate(job);
+
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_DOMAIN][row]        = copy_str(job->name);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_OPERATION][row]     = virt_jobs_operation_str(job);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_STATE][row]         = virt_domain_stale_str(copy_str(state), stale);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_PROGRESS][row]      = virt_jobs_progress_str(job, stale);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_PROCESSED][row]     = virt_jobs_field_str(job, VIRT_JOBS_FIELD_DATA_PROCESSED,
+                                                                job->value[VIRT_JOBS_FIELD_DATA_PROCESSED] / mib, stale);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_REMAINING][row]     = virt_jobs_field_str(job, VIRT_JOBS_FIELD_DATA_REMAINING,
+                                                                job->value[VIRT_JOBS_FIELD_DATA_REMAINING] / mib, stale);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_RATE][row]          = job->state == VIRT_JOBS_STATE_ACTIVE && rate > 0 ?
+                                                              virt_domain_stale_str(double_to_str(rate / mib), stale) :
+                                                              copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_LIMIT][row]         = virt_jobs_limit_str(job, stale);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_DIRTY_RATE][row]    = virt_jobs_field_str(job, VIRT_JOBS_FIELD_MEMORY_DIRTY_RATE,
+                                                                job->value[VIRT_JOBS_FIELD_MEMORY_DIRTY_RATE] * page / mib,
+                                                                stale);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_ITERATION][row]     = job->known & VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_MEMORY_ITERATION) ?
+                                                              virt_domain_stale_str(ul_to_str(job->value[VIRT_JOBS_FIELD_MEMORY_ITERATION]),
+                                                                                    stale) :
+                                                              copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_DOWNTIME][row]      = job->known & VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_DOWNTIME) ?
+                                                              virt_domain_stale_str(ul_to_str(job->value[VIRT_JOBS_FIELD_DOWNTIME]),
+                                                                                    stale) :
+                                                              copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_ELAPSED][row]       = job->known & VIRT_JOBS_FIELD_BIT(VIRT_JOBS_FIELD_TIME_ELAPSED) ?
+                                                              virt_jobs_duration_str(job->value[VIRT_JOBS_FIELD_TIME_ELAPSED], stale) :
+                                                              copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->jobs_data[VIRT_JOBS_DATA_TYPE_ETA][row]           = virt_jobs_eta_str(job, stale);
+}
+
+int virt_jobs_row(virt_data *virt, int index)
+{
+    if (index < 0 || (size_t)index >= virt->jobs->row_size)
+        return -1;
+    /* finished jobs may outlive their domain */
+    return virt_jobs_record_row(virt->records, virt->jobs->job[index].uuid);
+}
+
+void *virt_get_jobs_data(virt_data *virt)
+{
+    virt_jobs_refresh(virt);
+
+    virt_jobs_cache *cache = virt->jobs;
+    int stale = !virt_health_connected(virt);
+
+    virt_jobs_data *data = malloc(sizeof(virt_jobs_data));
+    data->jobs_size = cache->job_size;
+    /* last item counts as NULL */
+    for (int i = 0; i != VIRT_JOBS_DATA_TYPE_SIZE; ++i)
+        data->jobs_data[i] = calloc(cache->job_size + 1, sizeof(char *));
+
+    for (int i = 0; i != cache->job_size; ++i)
+        virt_jobs_render_row(data, i, cache->job + i, stale);
+    cache->row_size = cache->job_size;
+    ++data->jobs_size;
+
+    return data;
+}
+
+const virt_jobs_job *virt_jobs_at(virt_data *virt, int index)
+{
+    if (index < 0 || (size_t)index >= virt->jobs->row_size)
+        return NULL;
+    return virt->jobs->job + index;
+}
+
+/* Run on the command connection, the bandwidth is given in bytes */
+static int virt_jobs_set_speed(virDomainPtr domain, const void *arg)
+{
+    const virt_jobs_speed_command *cmd = arg;
+    unsigned long long trace = virt_trace_begin();
+    int res = virDomainBlockJobSetSpeed(domain, cmd->disk, cmd->bandwidth, VIR_DOMAIN_BLOCK_JOB_SPEED_BANDWIDTH_BYTES);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_BLOCK_JOB_SET_SPEED, domain, trace, res < 0);
+    return res < 0 ? VIRT_ERROR_FAILURE : VIRT_ERROR_SUCCESS;
+}
+
+int virt_jobs_throttle(virt_data *virt, int index, unsigned long long bandwidth)
+{
+    const virt_jobs_job *job = virt_jobs_at(virt, index);
+    if (!job || !job->disk[0] || job->state != VIRT_JOBS_STATE_ACTIVE || !virt_command_available())
+        return VIRT_ERROR_FAILURE;
+
+    virt_jobs_speed_command cmd = { .bandwidth = bandwidth };
+    snprintf(cmd.disk, sizeof(cmd.disk), "%s", job->disk);
+    return virt_command_submit_arg(job->uuid, virt_jobs_set_speed, &cmd, sizeof(cmd));
+}
+
+void virt_jobs_autostart_wrapper(virt_data *virt, int index)
+{
+    virt_domain_autostart_wrapper(virt, virt_jobs_row(virt, index));
+}
+
+void virt_jobs_create_wrapper(virt_data *virt, int index)
+{
+    virt_domain_create_wrapper(virt, virt_jobs_row(virt, index));
+}
+
+void virt_jobs_pause_wrapper(virt_data *virt, int index)
+{
+    virt_domain_pause_wrapper(virt, virt_jobs_row(virt, index));
+}
+
+void virt_jobs_reboot_wrapper(virt_data *virt, int index)
+{
+    virt_domain_reboot_wrapper(virt, virt_jobs_row(virt, index));
+}
+
+void virt_jobs_destroy_wrapper(virt_data *virt, int index)
+{
+    virt_domain_destroy_wrapper(virt, virt_jobs_row(virt, index));
+}
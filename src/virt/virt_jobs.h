@@ -0,0 +1,239 @@
+/* This file contains the jobs mode, migrations and other domain jobs
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_jobs.h
+ * This file contains the jobs mode. Running domains are checked for a job
+ * with virDomainGetJobInfo every few seconds, which the daemon answers from
+ * its own bookkeeping for domains without one, so idle domains cost a
+ * single cheap call. Domains with a job, or named by a migration iteration
+ * event, get virDomainGetJobStats on every refresh. Migrations whose
+ * remaining memory does not shrink from one iteration to the next, or whose
+ * guest dirties memory faster than it is sent, are marked as not converging.
+ * Block jobs, copies, commits and pulls, are listed per disk. The disks of
+ * running domains are taken from their cached descriptions and asked with
+ * virDomainGetBlockJobInfo on the same scan, disks with a job on every
+ * refresh. Block job events report the end of a job and a mirror getting
+ * ready. The bandwidth of a block job can be limited in place.
+ */
+#ifndef VIRT_JOBS_H
+#define VIRT_JOBS_H
+#include "virt.h"
+#include "virt_detail.h"
+/** Number of possible job data types */
+#define VIRT_JOBS_DATA_TYPE_SIZE (13)
+/** Seconds after which running domains without a known job are checked again */
+#define VIRT_JOBS_SCAN_PERIOD (5.0)
+/** Seconds a finished job stays listed */
+#define VIRT_JOBS_KEEP_PERIOD (60.0)
+/** Number of event callbacks registered by the jobs mode */
+#define VIRT_JOBS_CALLBACK_SIZE (3)
+/** State shown for migrations which do not converge */
+#define VIRT_JOBS_DIVERGING ("diverging!")
+
+/**
+ * Indecies of the virt_jobs_data array.
+ * @see virt_jobs_data
+ */
+typedef enum {
+    VIRT_JOBS_DATA_TYPE_DOMAIN,
+    VIRT_JOBS_DATA_TYPE_OPERATION,
+    VIRT_JOBS_DATA_TYPE_STATE,
+    VIRT_JOBS_DATA_TYPE_PROGRESS,
+    VIRT_JOBS_DATA_TYPE_PROCESSED,
+    VIRT_JOBS_DATA_TYPE_REMAINING,
+    VIRT_JOBS_DATA_TYPE_RATE,
+    VIRT_JOBS_DATA_TYPE_LIMIT,
+    VIRT_JOBS_DATA_TYPE_DIRTY_RATE,
+    VIRT_JOBS_DATA_TYPE_ITERATION,
+    VIRT_JOBS_DATA_TYPE_DOWNTIME,
+    VIRT_JOBS_DATA_TYPE_ELAPSED,
+    VIRT_JOBS_DATA_TYPE_ETA
+} virt_jobs_data_type_enum;
+
+/** @see virt_jobs_data_type_enum */
+typedef virt_jobs_data_type_enum jobs_type;
+
+/** Structure holding data of all job rows */
+typedef struct {
+    /** Arrays containing various job data */
+    char **jobs_data[VIRT_JOBS_DATA_TYPE_SIZE];
+    /** Number of job rows */
+    size_t jobs_size;
+} virt_jobs_data;
+
+/**
+ * Typed parameters of virDomainGetJobStats kept by the job.
+ * @see virt_jobs_field_name
+ */
+typedef enum {
+    VIRT_JOBS_FIELD_DATA_PROCESSED,
+    VIRT_JOBS_FIELD_DATA_REMAINING,
+    VIRT_JOBS_FIELD_DATA_TOTAL,
+    VIRT_JOBS_FIELD_MEMORY_REMAINING,
+    VIRT_JOBS_FIELD_MEMORY_BPS,
+    VIRT_JOBS_FIELD_MEMORY_DIRTY_RATE,
+    VIRT_JOBS_FIELD_MEMORY_PAGE_SIZE,
+    VIRT_JOBS_FIELD_MEMORY_ITERATION,
+    VIRT_JOBS_FIELD_DOWNTIME,
+    VIRT_JOBS_FIELD_TIME_ELAPSED,
+    VIRT_JOBS_FIELD_TIME_REMAINING,
+    VIRT_JOBS_FIELD_SIZE
+} virt_jobs_field_enum;
+
+/** Names of the typed parameters, in the order of virt_jobs_field_enum */
+const char *virt_jobs_field_name[VIRT_JOBS_FIELD_SIZE];
+
+/** Progress of a job */
+typedef enum {
+    VIRT_JOBS_STATE_ACTIVE,         /** Running, stats are polled */
+    VIRT_JOBS_STATE_COMPLETED,      /** Completion event came with the final stats */
+    VIRT_JOBS_STATE_GONE,           /** Job disappeared without a completion event, failed or cancelled */
+    VIRT_JOBS_STATE_FAILED,         /** Block job event reported a failure */
+    VIRT_JOBS_STATE_CANCELLED       /** Block job event reported a cancellation */
+} virt_jobs_state_enum;
+
+/** Domain or block job cached across refreshes. */
+typedef struct {
+    unsigned char       uuid[VIR_UUID_BUFLEN];          /** Key of the job with disk */
+    char                disk[VIRT_DETAIL_TOKEN_SIZE];   /** Target of a block job, empty for the domain job */
+    virt_jobs_state_enum state;
+    int                 type;                           /** virDomainJobType of the last poll,
+                                                            virDomainBlockJobType of a block job */
+    int                 operation;                      /** virDomainJobOperation, 0 if unknown */
+    unsigned long long  value[VIRT_JOBS_FIELD_SIZE];    /** Values of the last poll, bytes and milliseconds */
+    unsigned int        known;                          /** Bit of each field the last poll reported */
+    double              rate;                           /** Bytes per second from consecutive polls,
+                                                            used if the job reports no memory_bps */
+    unsigned long long  iteration_remaining;            /** Memory remaining when the current iteration began */
+    int                 growing;                        /** Memory remaining did not shrink over the last iteration */
+    int                 ready;                          /** Mirror of a block job is in sync, waits to be pivoted */
+    unsigned long long  bandwidth;                      /** Bandwidth limit of a block job in bytes per second,
+                                                            0 if unlimited */
+    unsigned long long  started;                        /** Monotonic time the block job was found */
+    char                *name;                          /** Name of the domain, kept once the domain is gone */
+    unsigned long long  polled;                         /** Monotonic time of the last poll, 0 if never */
+    unsigned long long  finished;                       /** Monotonic time the job was seen finished */
+} virt_jobs_job;
+
+/** Jobs cached across refreshes. */
+typedef struct virt_jobs_cache {
+    virt_jobs_job       *job;               /** Jobs in the order they were found */
+    int                 job_size;
+    unsigned char       (*pending)[VIR_UUID_BUFLEN];    /** Domains named by iteration events since the last refresh */
+    int                 pending_size;
+    unsigned long long  scanned;            /** Monotonic time of the last check of all running domains */
+    size_t              row_size;           /** Number of job rows of the last rendering */
+    virConnectPtr       conn;               /** Connection the callbacks are registered on, NULL if none */
+    int                 callback[VIRT_JOBS_CALLBACK_SIZE];  /** Callback identifiers, -1 if not registered */
+} virt_jobs_cache;
+
+/**
+ * Set the cache to default state, no jobs are known.
+ * @param cache - cache to be initialized
+ */
+void virt_init_jobs_cache(virt_jobs_cache *cache);
+
+/**
+ * Release the cache with all jobs.
+ * The callbacks must have been deregistered by virt_jobs_unwatch.
+ * @param cache - cache to be freed
+ */
+void virt_deinit_jobs_cache(virt_jobs_cache *cache);
+
+/**
+ * Drop jobs of the previous connection, running domains are checked again.
+ * @param cache - cache to be invalidated
+ */
+void virt_jobs_invalidate(virt_jobs_cache *cache);
+
+/**
+ * Deregister the event callbacks, must be called before their connection is closed.
+ * @param cache - cache whose callbacks are deregistered
+ */
+void virt_jobs_unwatch(virt_jobs_cache *cache);
+
+/**
+ * Return domain row of the job row.
+ * @param virt  - pointer with virt data
+ * @param index - job row
+ * @return row of virt->records, -1 if there is none
+ */
+int virt_jobs_row(virt_data *virt, int index);
+
+/**
+ * Check running domains for jobs, poll the known ones and render the job rows.
+ * @param virt - Handler to the libvirt connection
+ * @return object filled with job data
+ */
+void *virt_get_jobs_data(virt_data *virt);
+
+/**
+ * Return the job of the row.
+ * @param virt  - pointer with virt data
+ * @param index - job row
+ * @return job, NULL if there is none, valid until the next refresh
+ */
+const virt_jobs_job *virt_jobs_at(virt_data *virt, int index);
+
+/**
+ * Queue a new bandwidth limit of the block job of the row on the command connection.
+ * @param virt      - pointer with virt data
+ * @param index     - job row
+ * @param bandwidth - limit in bytes per second, 0 for unlimited
+ * @return VIRT_ERROR_SUCCESS if queued, VIRT_ERROR_FAILURE if the row is no
+ * active block job or the session is monitoring only
+ */
+int virt_jobs_throttle(virt_data *virt, int index, unsigned long long bandwidth);
+
+/*
+ * Call the virt_autostart_domain function for the domain of the job row
+ * @param virt  - pointer with virt data
+ * @param index - job row
+ */
+void virt_jobs_autostart_wrapper(virt_data *virt, int index);
+
+/*
+ * Call the virt_create_domain function for the domain of the job row
+ * @param virt  - pointer with virt data
+ * @param index - job row
+ */
+void virt_jobs_create_wrapper(virt_data *virt, int index);
+
+/*
+ * Call the virt_pause_domain function for the domain of the job row
+ * @param virt  - pointer with virt data
+ * @param index - job row
+ */
+void virt_jobs_pause_wrapper(virt_data *virt, int index);
+
+/*
+ * Call the virt_reboot_domain function for the domain of the job row
+ * @param virt  - pointer with virt data
+ * @param index - job row
+ */
+void virt_jobs_reboot_wrapper(virt_data *virt, int index);
+
+/*
+ * Call the virt_destroy_domain function for the domain of the job row
+ * @param virt  - pointer with virt data
+ * @param index - job row
+ */
+void virt_jobs_destroy_wrapper(virt_data *virt, int index);
+
+#endif /* VIRT_JOBS_H */
@@ -0,0 +1,276 @@
+/* This file contains the fast lane sampling selected domains at a high rate
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_lane.h"
+#include "virt_health.h"
+#include "virt_record.h"
+#include "virt_domain.h"
+#include "virt_trace.h"
+#include "utils.h"
+#include <stdio.h>
+
+/* Release the domain of the slot and make the slot free */
+static void virt_lane_clear(virt_lane_domain *domain)
+{
+    free(domain->name);
+    memset(domain, 0, sizeof(virt_lane_domain));
+}
+
+/* Put the domain of the record into the slot, with an empty series */
+static void virt_lane_set(virt_lane_domain *domain, const virt_domain_record *record, size_t row, int pinned)
+{
+    virt_lane_clear(domain);
+    domain->used    = 1;
+    domain->pinned  = pinned;
+    domain->row     = row;
+    domain->name    = copy_str(record->name);
+    memcpy(domain->uuid, record->uuid, VIR_UUID_BUFLEN);
+}
+
+/* Find the slot of the domain, NULL if the domain is not in the lane */
+static virt_lane_domain *virt_lane_find(virt_lane_data *lane, const unsigned char *uuid)
+{
+    for (int i = 0; i != VIRT_LANE_SIZE; ++i)
+        if (lane->domain[i].used && memcmp(lane->domain[i].uuid, uuid, VIR_UUID_BUFLEN) == 0)
+            return lane->domain + i;
+    return NULL;
+}
+
+/* Find the record of the slot, starting at the row of the last lookup */
+static virt_domain_record *virt_lane_record(virt_record_data *records, virt_lane_domain *domain)
+{
+    for (size_t i = 0; i != records->record_size; ++i) {
+        size_t row = (domain->row + i) % records->record_size;
+        if (memcmp(records->record[row].uuid, domain->uuid, VIR_UUID_BUFLEN) == 0) {
+            domain->row = row;
+            return records->record + row;
+        }
+    }
+    return NULL;
+}
+
+void virt_init_lane(virt_lane_data *lane, double interval)
+{
+    lane->enabled       = 0;
+    lane->has_selected  = 0;
+    memset(lane->selected, 0, VIR_UUID_BUFLEN);
+    memset(lane->domain, 0, sizeof(lane->domain));
+    scheduler_init(&lane->sched, interval, 0);
+}
+
+void virt_lane_set_interval(virt_lane_data *lane, double interval)
+{
+    scheduler_init(&lane->sched, interval, 0);
+}
+
+void virt_deinit_lane(virt_lane_data *lane)
+{
+    for (int i = 0; i != VIRT_LANE_SIZE; ++i)
+        virt_lane_clear(lane->domain + i);
+}
+
+void virt_lane_toggle(virt_lane_data *lane)
+{
+    lane->enabled = !lane->enabled;
+
+    if (lane->enabled)
+        lane->sched.deadline = time_monotonic_us();
+    else
+        virt_deinit_lane(lane);
+}
+
+int virt_lane_pinned(const virt_lane_data *lane)
+{
+    int pinned = 0;
+    for (int i = 0; i != VIRT_LANE_SIZE; ++i)
+        pinned += lane->domain[i].used && lane->domain[i].pinned;
+    return pinned;
+}
+
+void virt_lane_select(virt_data *virt, int row)
+{
+    virt_lane_data *lane = virt->lane;
+    if (row < 0 || row >= virt->records->record_size)
+        return;
+
+    virt_domain_record *record = virt->records->record + row;
+    memcpy(lane->selected, record->uuid, VIR_UUID_BUFLEN);
+    lane->has_selected = 1;
+
+    /* pinned domains take the lane over from the selection */
+    if (!lane->enabled || virt_lane_pinned(lane))
+        return;
+
+    if (lane->domain[0].used && memcmp(lane->domain[0].uuid, record->uuid, VIR_UUID_BUFLEN) == 0)
+        return;
+
+    virt_lane_set(lane->domain, record, row, 0);
+}
+
+int virt_lane_pin(virt_data *virt, int row)
+{
+    virt_lane_data *lane = virt->lane;
+    if (row < 0 || row >= virt->records->record_size)
+        return VIRT_ERROR_FAILURE;
+
+    virt_domain_record *record = virt->records->record + row;
+    virt_lane_domain *domain = virt_lane_find(lane, record->uuid);
+    if (domain && domain->pinned) {
+        virt_lane_clear(domain);
+        return VIRT_ERROR_SUCCESS;
+    }
+
+    /* the first pin replaces the followed selection */
+    for (int i = 0; i != VIRT_LANE_SIZE; ++i)
+        if (!lane->domain[i].pinned)
+            virt_lane_clear(lane->domain + i);
+
+    for (int i = 0; i != VIRT_LANE_SIZE; ++i) {
+        if (!lane->domain[i].used) {
+            virt_lane_set(lane->domain + i, record, row, 1);
+            if (!lane->enabled) {
+                lane->enabled = 1;
+                lane->sched.deadline = time_monotonic_us();
+            }
+            return VIRT_ERROR_SUCCESS;
+        }
+    }
+
+    return VIRT_ERROR_FAILURE;
+}
+
+/*
+ * Merge one record of bulk statistics into the series of the lane domain.
+ * @param domain  - lane domain to be updated
+ * @param params  - typed parameters returned by libvirt
+ * @param nparams - number of parameters
+ * @param now     - monotonic time of the sample
+ */
+static void virt_lane_merge(virt_lane_domain *domain, virTypedParameterPtr params, int nparams,
+                            unsigned long long now)
+{
+    unsigned long long counter[VIRT_LANE_SERIES_TYPE_SIZE] = { 0 };
+    virTypedParamsGetULLong(params, nparams, "cpu.time", counter + VIRT_LANE_SERIES_CPU);
+    virt_domain_sum_io(params, nparams,
+                       counter + VIRT_LANE_SERIES_BLOCK_RD, counter + VIRT_LANE_SERIES_BLOCK_WR,
+                       counter + VIRT_LANE_SERIES_NET_RX, counter + VIRT_LANE_SERIES_NET_TX);
+
+    unsigned long long elapsed = domain->sampled ? now - domain->sampled : 0;
+
+    /* rates need two samples, the first one only sets the counters */
+    if (domain->sampled) {
+        for (int i = 0; i != VIRT_LANE_SERIES_TYPE_SIZE; ++i)
+            domain->series[i][domain->series_head] = virt_domain_rate(counter[i], domain->counter[i], elapsed);
+        /* cpu time is in nanoseconds */
+        domain->series[VIRT_LANE_SERIES_CPU][domain->series_head] *= 100.0 / 1e9;
+
+        domain->series_head = (domain->series_head + 1) % VIRT_LANE_SERIES_SIZE;
+        if (domain->series_size < VIRT_LANE_SERIES_SIZE)
+            ++domain->series_size;
+    }
+
+    unsigned int vcpu_size = 0;
+    virTypedParamsGetUInt(params, nparams, "vcpu.current", &vcpu_size);
+    if (vcpu_size > VIRT_LANE_VCPU_SIZE)
+        vcpu_size = VIRT_LANE_VCPU_SIZE;
+
+    for (int i = 0; i < (int)vcpu_size; ++i) {
+        char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+        unsigned long long time = 0;
+        snprintf(field, sizeof(field), "vcpu.%d.time", i);
+        virTypedParamsGetULLong(params, nparams, field, &time);
+
+        domain->vcpu_prc[i] = domain->sampled && i < domain->vcpu_size ?
+                              virt_domain_rate(time, domain->vcpu_time[i], elapsed) * 100.0 / 1e9 : 0;
+        domain->vcpu_time[i] = time;
+    }
+    domain->vcpu_size = vcpu_size;
+
+    memcpy(domain->counter, counter, sizeof(counter));
+    domain->sampled = now;
+}
+
+void virt_lane_sample(virt_data *virt)
+{
+    virt_lane_data *lane = virt->lane;
+    if (!virt_health_connected(virt))
+        return;
+
+    /* only lane domains are asked, the rest of the host is left alone */
+    virDomainPtr domain[VIRT_LANE_SIZE + 1];
+    size_t domain_size = 0;
+    for (int i = 0; i != VIRT_LANE_SIZE; ++i) {
+        if (!lane->domain[i].used)
+            continue;
+
+        virt_domain_record *record = virt_lane_record(virt->records, lane->domain + i);
+        if (!record) {
+            /* the domain is gone */
+            virt_lane_clear(lane->domain + i);
+            continue;
+        }
+        /* a hung domain would hold the sampling call past the next sample */
+        if (record->id >= 0 && !record->hung_since)
+            domain[domain_size++] = record->domain;
+    }
+    domain[domain_size] = NULL;
+
+    if (domain_size == 0)
+        return;
+
+    virDomainStatsRecordPtr *stats_record = NULL;
+    unsigned long long trace = virt_trace_begin();
+    int count = virDomainListGetStats(domain, VIRT_LANE_STATS, &stats_record, 0);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_LIST_GET_STATS, NULL, trace, count < 0);
+
+    unsigned long long now = time_monotonic_us();
+    for (int i = 0; i < count; ++i) {
+        unsigned char uuid[VIR_UUID_BUFLEN];
+        if (virDomainGetUUID(stats_record[i]->dom, uuid) < 0)
+            continue;
+
+        virt_lane_domain *lane_domain = virt_lane_find(lane, uuid);
+        if (lane_domain)
+            virt_lane_merge(lane_domain, stats_record[i]->params, stats_record[i]->nparams, now);
+    }
+
+    if (stats_record)
+        virDomainStatsRecordListFree(stats_record);
+}
+
+const virt_lane_domain *virt_lane_shown(const virt_lane_data *lane)
+{
+    const virt_lane_domain *first = NULL;
+    for (int i = 0; i != VIRT_LANE_SIZE; ++i) {
+        const virt_lane_domain *domain = lane->domain + i;
+        if (!domain->used)
+            continue;
+        if (lane->has_selected && memcmp(domain->uuid, lane->selected, VIR_UUID_BUFLEN) == 0)
+            return domain;
+        if (!first)
+            first = domain;
+    }
+    return first;
+}
+
+double virt_lane_value(const virt_lane_domain *domain, virt_lane_series series, size_t age)
+{
+    size_t index = (domain->series_head + VIRT_LANE_SERIES_SIZE - 1 - age) % VIRT_LANE_SERIES_SIZE;
+    return domain->series[series][index];
+}
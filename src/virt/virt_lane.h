@@ -0,0 +1,156 @@
+/* This file contains the fast lane sampling selected domains at a high rate
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_lane.h
+ * This file contains the fast lane. Domains in the lane, the selected one or
+ * a pinned set, are sampled on their own schedule, much faster than the
+ * refresh of the table. Only lane domains are part of the sampling call, so
+ * the load on the other domains does not change.
+ */
+#ifndef VIRT_LANE_H
+#define VIRT_LANE_H
+#include "virt.h"
+#include "scheduler.h"
+/** Maximum number of domains in the lane */
+#define VIRT_LANE_SIZE (4)
+/** Number of samples kept per domain */
+#define VIRT_LANE_SERIES_SIZE (256)
+/** Maximum number of vCPUs sampled per domain */
+#define VIRT_LANE_VCPU_SIZE (16)
+/** Default sampling interval in seconds */
+#define VIRT_LANE_INTERVAL (0.1)
+/** Statistics groups requested for lane domains */
+#define VIRT_LANE_STATS (VIR_DOMAIN_STATS_CPU_TOTAL | VIR_DOMAIN_STATS_VCPU | \
+                         VIR_DOMAIN_STATS_BLOCK | VIR_DOMAIN_STATS_INTERFACE)
+
+/** Series kept for every lane domain */
+typedef enum {
+    VIRT_LANE_SERIES_CPU,       /** CPU usage in % */
+    VIRT_LANE_SERIES_BLOCK_RD,  /** Bytes read per second */
+    VIRT_LANE_SERIES_BLOCK_WR,  /** Bytes written per second */
+    VIRT_LANE_SERIES_NET_RX,    /** Bytes received per second */
+    VIRT_LANE_SERIES_NET_TX,    /** Bytes transmitted per second */
+    VIRT_LANE_SERIES_TYPE_SIZE
+} virt_lane_series_enum;
+
+/** @see virt_lane_series_enum */
+typedef virt_lane_series_enum virt_lane_series;
+
+/** Fine grained samples of one domain. */
+typedef struct {
+    int                 used;                           /** Slot holds a domain */
+    int                 pinned;                         /** Domain stays in the lane regardless of selection */
+    unsigned char       uuid[VIR_UUID_BUFLEN];          /** Domain of the slot */
+    size_t              row;                            /** Row of the record at the last lookup, search hint */
+    char                *name;                          /** Domain name shown in the pane */
+
+    unsigned long long  sampled;                        /** Monotonic time of the last sample, 0 if none */
+    unsigned long long  counter[VIRT_LANE_SERIES_TYPE_SIZE];    /** Raw counters of the last sample */
+    unsigned long long  vcpu_time[VIRT_LANE_VCPU_SIZE]; /** Raw vCPU times of the last sample */
+    double              vcpu_prc[VIRT_LANE_VCPU_SIZE];  /** vCPU usage in % since the previous sample */
+    int                 vcpu_size;                      /** Number of sampled vCPUs */
+
+    double              series[VIRT_LANE_SERIES_TYPE_SIZE][VIRT_LANE_SERIES_SIZE];  /** Ring buffers of rates */
+    size_t              series_head;                    /** Index of the next sample */
+    size_t              series_size;                    /** Number of valid samples */
+} virt_lane_domain;
+
+/** State of the fast lane. */
+typedef struct virt_lane_data {
+    int                 enabled;                        /** Lane is sampling */
+    scheduler_data      sched;                          /** Sampling schedule */
+    unsigned char       selected[VIR_UUID_BUFLEN];      /** Domain under the cursor */
+    int                 has_selected;                   /** selected holds a domain */
+    virt_lane_domain    domain[VIRT_LANE_SIZE];         /** Domains in the lane */
+} virt_lane_data;
+
+/**
+ * Set lane to default state, disabled.
+ * @param lane     - lane to be initialized
+ * @param interval - sampling interval in seconds
+ */
+void virt_init_lane(virt_lane_data *lane, double interval);
+
+/**
+ * Change the sampling interval, the next sample is due immediately.
+ * @param lane     - fast lane
+ * @param interval - sampling interval in seconds
+ */
+void virt_lane_set_interval(virt_lane_data *lane, double interval);
+
+/**
+ * Release all lane data.
+ * @param lane - lane to be freed
+ */
+void virt_deinit_lane(virt_lane_data *lane);
+
+/**
+ * Turn the lane on or off, turning it off drops all domains.
+ * @param lane - fast lane
+ */
+void virt_lane_toggle(virt_lane_data *lane);
+
+/**
+ * Follow the domain under the cursor. Without pinned domains the lane
+ * samples the selected one, its series restarts when selection changes.
+ * @param virt - virt data, its lane is updated
+ * @param row  - row of the selected domain record
+ */
+void virt_lane_select(virt_data *virt, int row);
+
+/**
+ * Pin the domain into the lane or unpin it if it is pinned already,
+ * pinning turns the lane on.
+ * @param virt - virt data, its lane is updated
+ * @param row  - row of the domain record
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE if the lane is full
+ */
+int virt_lane_pin(virt_data *virt, int row);
+
+/**
+ * Sample all lane domains with a single bulk statistics call.
+ * @param virt - virt data, its lane is updated
+ */
+void virt_lane_sample(virt_data *virt);
+
+/**
+ * Return lane domain to be shown, the selected one if it is in the lane,
+ * otherwise the first one.
+ * @param lane - fast lane
+ * @return lane domain, NULL if the lane is empty
+ */
+const virt_lane_domain *virt_lane_shown(const virt_lane_data *lane);
+
+/**
+ * Return sample of a series, 0 is the newest one.
+ * @param domain - lane domain
+ * @param series - series type
+ * @param age    - number of samples back in time, less than series_size
+ * @return value of the sample
+ */
+double virt_lane_value(const virt_lane_domain *domain, virt_lane_series series, size_t age);
+
+/**
+ * Return number of pinned domains.
+ * @param lane - fast lane
+ * @return number of pinned domains
+ */
+int virt_lane_pinned(const virt_lane_data *lane);
+
+#endif /* VIRT_LANE_H */
@@ -0,0 +1,442 @@
+/* This file contains the local fast path of the domain counters
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_local.h"
+#include "virt_domain.h"
+#include "virt_detail.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/** Longest command line of a qemu process compared with the UUID */
+#define VIRT_LOCAL_CMDLINE_SIZE (65536)
+
+/**
+ * Counter files of a domain kept open across refreshes.
+ * @see virt_local_entry
+ */
+typedef enum {
+    VIRT_LOCAL_FILE_CPU,        /** cpu.stat of the cgroup */
+    VIRT_LOCAL_FILE_MEMORY,     /** memory.current of the cgroup */
+    VIRT_LOCAL_FILE_IO,         /** io.stat of the cgroup */
+    VIRT_LOCAL_FILE_STATUS,     /** /proc/<pid>/status of the qemu process */
+    VIRT_LOCAL_FILE_SIZE
+} virt_local_file_enum;
+
+/** Open counter files of one run of a domain. */
+struct virt_local_entry {
+    int                 id;                         /** Domain ID the files were opened for */
+    int                 pid;                        /** qemu process, 0 if not mapped */
+    int                 fd[VIRT_LOCAL_FILE_SIZE];   /** Descriptors by virt_local_file_enum, -1 if closed */
+    int                 rx[VIRT_LOCAL_NIC_SIZE];    /** Bytes received by the guest, sent by the host device */
+    int                 tx[VIRT_LOCAL_NIC_SIZE];    /** Bytes sent by the guest, received by the host device */
+    int                 nic_size;                   /** Interfaces read locally, -1 if they stay on libvirt */
+    unsigned long long  retry_at;                   /** Monotonic time a failed mapping is tried again */
+};
+
+/** Directory /proc, /run and /sys are found in, without the trailing slash */
+static char virt_local_root[VIRT_LOCAL_PATH_SIZE];
+
+/** The fast path was enabled */
+static int virt_local_enabled = 0;
+
+void virt_local_set_root(const char *root)
+{
+    size_t size = strlen(root);
+    while (size && root[size - 1] == '/')
+        --size;
+    if (size >= VIRT_LOCAL_PATH_SIZE)
+        size = VIRT_LOCAL_PATH_SIZE - 1;
+    memcpy(virt_local_root, root, size);
+    virt_local_root[size] = '\0';
+    virt_local_enabled = 1;
+}
+
+/* Close all files of the entry, it stays allocated */
+static void virt_local_close(virt_local_entry *entry)
+{
+    for (int i = 0; i != VIRT_LOCAL_FILE_SIZE; ++i) {
+        if (entry->fd[i] >= 0)
+            close(entry->fd[i]);
+        entry->fd[i] = -1;
+    }
+    for (int i = 0; i < entry->nic_size; ++i) {
+        if (entry->rx[i] >= 0)
+            close(entry->rx[i]);
+        if (entry->tx[i] >= 0)
+            close(entry->tx[i]);
+    }
+    entry->pid      = 0;
+    entry->nic_size = -1;
+}
+
+void virt_local_release(virt_local_entry *entry)
+{
+    if (!entry)
+        return;
+    virt_local_close(entry);
+    free(entry);
+}
+
+/* Open a file below the root, the format gives the path relative to it, -1 if it does not exist */
+static int virt_local_open(const char *format, ...)
+{
+    char relative[VIRT_LOCAL_PATH_SIZE], path[VIRT_LOCAL_PATH_SIZE];
+    va_list args;
+    va_start(args, format);
+    int size = vsnprintf(relative, sizeof(relative), format, args);
+    va_end(args);
+    if (size < 0 || size >= (int)sizeof(relative))
+        return -1;
+
+    size = snprintf(path, sizeof(path), "%s/%s", virt_local_root, relative);
+    if (size < 0 || size >= (int)sizeof(path))
+        return -1;
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/*
+ * Read a whole file from its start, the descriptor stays open.
+ * @param fd     - file to be read
+ * @param buffer - filled with the NUL terminated content
+ * @param size   - size of the buffer
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+static int virt_local_read(int fd, char *buffer, size_t size)
+{
+    ssize_t count = pread(fd, buffer, size - 1, 0);
+    if (count < 0)
+        return VIRT_ERROR_FAILURE;
+    buffer[count] = '\0';
+    return VIRT_ERROR_SUCCESS;
+}
+
+/* Read a file with a single number, e.g. memory.current */
+static int virt_local_read_ull(int fd, unsigned long long *value)
+{
+    char buffer[64];
+    if (virt_local_read(fd, buffer, sizeof(buffer)) != VIRT_ERROR_SUCCESS)
+        return VIRT_ERROR_FAILURE;
+    char *end = NULL;
+    *value = strtoull(buffer, &end, 10);
+    return end == buffer ? VIRT_ERROR_FAILURE : VIRT_ERROR_SUCCESS;
+}
+
+/* Find the value of a "key value" line, e.g. usage_usec of cpu.stat or VmRSS: of status */
+static int virt_local_key(const char *buffer, const char *key, unsigned long long *value)
+{
+    size_t size = strlen(key);
+    for (const char *line = buffer; line && *line; line = strchr(line, '\n'), line = line ? line + 1 : NULL) {
+        if (strncmp(line, key, size))
+            continue;
+        char *end = NULL;
+        *value = strtoull(line + size, &end, 10);
+        return end == line + size ? VIRT_ERROR_FAILURE : VIRT_ERROR_SUCCESS;
+    }
+    return VIRT_ERROR_FAILURE;
+}
+
+/* Sum all key=value fields of io.stat, one line per device */
+static unsigned long long virt_local_sum(const char *buffer, const char *key)
+{
+    unsigned long long sum = 0;
+    size_t size = strlen(key);
+    for (const char *field = strstr(buffer, key); field; field = strstr(field + size, key))
+        sum += strtoull(field + size, NULL, 10);
+    return sum;
+}
+
+/* Read the pid file libvirt keeps for a running domain */
+static int virt_local_pid(const char *name)
+{
+    int fd = virt_local_open("%s/%s.pid", VIRT_LOCAL_PID_DIR, name);
+    if (fd < 0)
+        return 0;
+    unsigned long long pid = 0;
+    int res = virt_local_read_ull(fd, &pid);
+    close(fd);
+    return res == VIRT_ERROR_SUCCESS ? (int)pid : 0;
+}
+
+/* Check the process was started for the domain, a pid file may outlive its process,
+ * return TRUE (1) if the UUID is one of its arguments, FALSE (0) otherwise */
+static int virt_local_owns(const char *pid, const unsigned char *uuid)
+{
+    char uuid_str[VIR_UUID_STRING_BUFLEN];
+    snprintf(uuid_str, sizeof(uuid_str),
+             "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+             uuid[0], uuid[1], uuid[2], uuid[3], uuid[4], uuid[5], uuid[6], uuid[7],
+             uuid[8], uuid[9], uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
+
+    int fd = virt_local_open("proc/%s/cmdline", pid);
+    if (fd < 0)
+        return 0;
+    char *cmdline = calloc(VIRT_LOCAL_CMDLINE_SIZE, sizeof(char));
+    ssize_t size = read(fd, cmdline, VIRT_LOCAL_CMDLINE_SIZE - 1);
+    close(fd);
+
+    /* arguments are separated by NUL characters */
+    int owns = 0;
+    for (ssize_t i = 0; i < size; i += strlen(cmdline + i) + 1) {
+        if (!strcmp(cmdline + i, uuid_str)) {
+            owns = 1;
+            break;
+        }
+    }
+    free(cmdline);
+    return owns;
+}
+
+/*
+ * Find the cgroup of the domain from the unified hierarchy line of the qemu
+ * process. The process lives in the emulator group below the scope of the
+ * domain, the counters of the scope cover the vCPU threads too.
+ * @param pid    - qemu process
+ * @param cgroup - filled with the path of the scope
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+static int virt_local_cgroup(const char *pid, char *cgroup)
+{
+    int fd = virt_local_open("proc/%s/cgroup", pid);
+    if (fd < 0)
+        return VIRT_ERROR_FAILURE;
+    char buffer[VIRT_LOCAL_BUFFER_SIZE];
+    int res = virt_local_read(fd, buffer, sizeof(buffer));
+    close(fd);
+    if (res != VIRT_ERROR_SUCCESS)
+        return VIRT_ERROR_FAILURE;
+
+    const char *line = strstr(buffer, "0::/");
+    if (!line || (line != buffer && line[-1] != '\n'))
+        return VIRT_ERROR_FAILURE;
+    line += strlen("0::");
+    size_t size = strcspn(line, "\n");
+    if (size >= VIRT_LOCAL_PATH_SIZE)
+        return VIRT_ERROR_FAILURE;
+    memcpy(cgroup, line, size);
+    cgroup[size] = '\0';
+
+    const char *suffix[] = { "/emulator", "/libvirt" };
+    for (size_t i = 0; i != sizeof(suffix) / sizeof(suffix[0]); ++i) {
+        size_t length = strlen(suffix[i]);
+        if (size > length && !strcmp(cgroup + size - length, suffix[i]))
+            cgroup[size -= length] = '\0';
+    }
+    return VIRT_ERROR_SUCCESS;
+}
+
+/*
+ * Check that io.stat of the cgroup counts the guest disks: qemu reads files
+ * and block devices through the host, but talks to network disks, e.g. rbd,
+ * gluster or iscsi, itself and nothing of them shows up there.
+ * @param model - parsed description of the domain
+ * @return TRUE (1) if every disk with a source is a local file or block device, FALSE (0) otherwise
+ */
+static int virt_local_disks(const virt_detail_model *model)
+{
+    for (int i = 0; i != model->disk_size; ++i) {
+        const virt_detail_disk *disk = model->disk + i;
+        if (disk->source && strcmp(disk->type, "file") && strcmp(disk->type, "block"))
+            return 0;
+    }
+    return 1;
+}
+
+/* Open the byte counters of the host devices of all interfaces, -1 if any is
+ * missing or the disks cannot be read locally, I/O then stays on libvirt */
+static int virt_local_map_io(virt_data *virt, int row, virt_local_entry *entry)
+{
+    const virt_detail_model *model = virt_detail_get(virt, row);
+    if (!model || model->nic_size > VIRT_LOCAL_NIC_SIZE || !virt_local_disks(model))
+        return -1;
+
+    int size = 0;
+    for (; size != model->nic_size; ++size) {
+        const char *dev = model->nic[size].dev;
+        entry->rx[size] = dev[0] ? virt_local_open("%s/%s/statistics/tx_bytes",
+                                                   VIRT_LOCAL_NET_DIR, dev) : -1;
+        entry->tx[size] = dev[0] ? virt_local_open("%s/%s/statistics/rx_bytes",
+                                                   VIRT_LOCAL_NET_DIR, dev) : -1;
+        if (entry->rx[size] < 0 || entry->tx[size] < 0)
+            break;
+    }
+    if (size == model->nic_size)
+        return size;
+
+    /* a device without counters, e.g. vhost-user, keeps all interfaces on libvirt */
+    for (int i = 0; i <= size; ++i) {
+        if (entry->rx[i] >= 0)
+            close(entry->rx[i]);
+        if (entry->tx[i] >= 0)
+            close(entry->tx[i]);
+    }
+    return -1;
+}
+
+/*
+ * Find the qemu process and the cgroup of a running domain and open its counters.
+ * @param virt  - pointer with virt data
+ * @param row   - row of the domain records
+ * @param entry - closed entry to be filled
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+static int virt_local_map(virt_data *virt, int row, virt_local_entry *entry)
+{
+    const virt_domain_record *record = virt->records->record + row;
+    if (!record->name)
+        return VIRT_ERROR_FAILURE;
+
+    char pid[32], cgroup[VIRT_LOCAL_PATH_SIZE];
+    snprintf(pid, sizeof(pid), "%d", virt_local_pid(record->name));
+    if (!strcmp(pid, "0") || !virt_local_owns(pid, record->uuid) ||
+        virt_local_cgroup(pid, cgroup) != VIRT_ERROR_SUCCESS)
+        return VIRT_ERROR_FAILURE;
+
+    entry->fd[VIRT_LOCAL_FILE_CPU]      = virt_local_open("%s%s/cpu.stat", VIRT_LOCAL_CGROUP_DIR, cgroup);
+    entry->fd[VIRT_LOCAL_FILE_MEMORY]   = virt_local_open("%s%s/memory.current", VIRT_LOCAL_CGROUP_DIR, cgroup);
+    entry->fd[VIRT_LOCAL_FILE_IO]       = virt_local_open("%s%s/io.stat", VIRT_LOCAL_CGROUP_DIR, cgroup);
+    entry->fd[VIRT_LOCAL_FILE_STATUS]   = virt_local_open("proc/%s/status", pid);
+    entry->pid = atoi(pid);
+    if (entry->fd[VIRT_LOCAL_FILE_CPU] < 0) {
+        virt_local_close(entry);
+        return VIRT_ERROR_FAILURE;
+    }
+
+    entry->nic_size = entry->fd[VIRT_LOCAL_FILE_IO] >= 0 ? virt_local_map_io(virt, row, entry) : -1;
+    return VIRT_ERROR_SUCCESS;
+}
+
+/*
+ * Read the open counters into the record.
+ * @param entry  - mapped entry
+ * @param record - domain record
+ * @param stats  - VIRT_LOCAL_STATS groups to be read
+ * @param now    - monotonic time of the sample
+ * @param read   - filled with the groups which were read
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE if a file failed
+ */
+static int virt_local_read_stats(virt_local_entry *entry, virt_domain_record *record,
+                                 unsigned int stats, unsigned long long now, unsigned int *read)
+{
+    char buffer[VIRT_LOCAL_BUFFER_SIZE];
+    *read = 0;
+
+    if (stats & VIR_DOMAIN_STATS_CPU_TOTAL) {
+        unsigned long long usage = 0;
+        if (virt_local_read(entry->fd[VIRT_LOCAL_FILE_CPU], buffer, sizeof(buffer)) != VIRT_ERROR_SUCCESS ||
+            virt_local_key(buffer, "usage_usec ", &usage) != VIRT_ERROR_SUCCESS)
+            return VIRT_ERROR_FAILURE;
+        virt_domain_merge_cpu(record, usage * 1000ULL, now);
+        *read |= VIR_DOMAIN_STATS_CPU_TOTAL;
+
+        /* the resident size comes along, fresher than the balloon statistics */
+        unsigned long long rss = 0;
+        if (entry->fd[VIRT_LOCAL_FILE_STATUS] >= 0 &&
+            virt_local_read(entry->fd[VIRT_LOCAL_FILE_STATUS], buffer, sizeof(buffer)) == VIRT_ERROR_SUCCESS &&
+            virt_local_key(buffer, "VmRSS:", &rss) == VIRT_ERROR_SUCCESS)
+            record->memory_rss = rss;
+        else if (entry->fd[VIRT_LOCAL_FILE_MEMORY] >= 0 &&
+                 virt_local_read_ull(entry->fd[VIRT_LOCAL_FILE_MEMORY], &rss) == VIRT_ERROR_SUCCESS)
+            record->memory_rss = rss / 1024;
+    }
+
+    if ((stats & (VIR_DOMAIN_STATS_BLOCK | VIR_DOMAIN_STATS_INTERFACE)) && entry->nic_size >= 0) {
+        if (virt_local_read(entry->fd[VIRT_LOCAL_FILE_IO], buffer, sizeof(buffer)) != VIRT_ERROR_SUCCESS)
+            return VIRT_ERROR_FAILURE;
+        unsigned long long rd = virt_local_sum(buffer, "rbytes=");
+        unsigned long long wr = virt_local_sum(buffer, "wbytes=");
+
+        unsigned long long rx = 0, tx = 0;
+        for (int i = 0; i != entry->nic_size; ++i) {
+            unsigned long long nic_rx = 0, nic_tx = 0;
+            if (virt_local_read_ull(entry->rx[i], &nic_rx) != VIRT_ERROR_SUCCESS ||
+                virt_local_read_ull(entry->tx[i], &nic_tx) != VIRT_ERROR_SUCCESS)
+                return VIRT_ERROR_FAILURE;
+            rx += nic_rx;
+            tx += nic_tx;
+        }
+        virt_domain_merge_io(record, rd, wr, rx, tx, now);
+        *read |= VIR_DOMAIN_STATS_BLOCK | VIR_DOMAIN_STATS_INTERFACE;
+    }
+    return VIRT_ERROR_SUCCESS;
+}
+
+/* The counters change their source, rates start over instead of jumping */
+static void virt_local_switch(virt_domain_record *record)
+{
+    record->updated[VIRT_GROUP_CPU] = 0;
+    record->updated[VIRT_GROUP_IO]  = 0;
+}
+
+unsigned int virt_local_collect(virt_data *virt, int row, unsigned int stats, unsigned long long now)
+{
+    if (!virt_local_enabled || !stats)
+        return 0;
+
+    virt_domain_record *record = virt->records->record + row;
+    virt_local_entry *entry = record->local;
+
+    /* inactive domains report nothing, libvirt tells that cheaply */
+    if (record->id < 0) {
+        if (entry && entry->pid)
+            virt_local_switch(record);
+        virt_local_release(entry);
+        record->local = NULL;
+        return 0;
+    }
+
+    if (!entry) {
+        entry = record->local = calloc(1, sizeof(virt_local_entry));
+        for (int i = 0; i != VIRT_LOCAL_FILE_SIZE; ++i)
+            entry->fd[i] = -1;
+        entry->nic_size = -1;
+        entry->id = -1;
+    }
+
+    /* a restarted domain has a new process and cgroup */
+    if (entry->id != record->id) {
+        if (entry->pid)
+            virt_local_switch(record);
+        virt_local_close(entry);
+        entry->id = record->id;
+        entry->retry_at = 0;
+    }
+
+    if (!entry->pid) {
+        if (now < entry->retry_at)
+            return 0;
+        if (virt_local_map(virt, row, entry) != VIRT_ERROR_SUCCESS) {
+            entry->retry_at = now + (unsigned long long)(VIRT_LOCAL_RETRY * 1e6);
+            return 0;
+        }
+        virt_local_switch(record);
+    }
+
+    unsigned int read = 0;
+    if (virt_local_read_stats(entry, record, stats, now, &read) != VIRT_ERROR_SUCCESS) {
+        /* e.g. the process exited before the event arrived, libvirt answers this time */
+        virt_local_close(entry);
+        virt_local_switch(record);
+        entry->retry_at = now + (unsigned long long)(VIRT_LOCAL_RETRY * 1e6);
+        return 0;
+    }
+    return read;
+}
@@ -0,0 +1,75 @@
+/* This file contains the local fast path of the domain counters
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_local.h
+ * This file contains the local fast path of the domain counters. When the
+ * monitor runs on the host of the domains, CPU time, disk and network bytes
+ * and the resident size are read straight from the cgroup of the domain,
+ * /proc of its qemu process and the statistics of its host interfaces,
+ * without a round trip to libvirtd. A domain is mapped once per run, the
+ * files stay open and are read with pread on every refresh. Domains which
+ * cannot be mapped, e.g. of a remote connection, and files which fail to
+ * read fall back to the bulk statistics of libvirt. Disk and network bytes
+ * stay on libvirt unless every disk is a local file or block device, the
+ * host does not see the I/O of network disks.
+ */
+#ifndef VIRT_LOCAL_H
+#define VIRT_LOCAL_H
+#include "virt.h"
+#include "virt_record.h"
+/** Longest path of a counter file */
+#define VIRT_LOCAL_PATH_SIZE (512)
+/** Largest counter file read in one go */
+#define VIRT_LOCAL_BUFFER_SIZE (4096)
+/** Most interfaces of a domain read locally, domains with more stay on libvirt */
+#define VIRT_LOCAL_NIC_SIZE (8)
+/** Directory of the qemu pid files, relative to the root */
+#define VIRT_LOCAL_PID_DIR ("run/libvirt/qemu")
+/** Mount point of the unified cgroup hierarchy, relative to the root */
+#define VIRT_LOCAL_CGROUP_DIR ("sys/fs/cgroup")
+/** Directory of the host network devices, relative to the root */
+#define VIRT_LOCAL_NET_DIR ("sys/class/net")
+/** Seconds after which a domain which failed to map is tried again */
+#define VIRT_LOCAL_RETRY (30.0)
+/** Bulk statistics groups the fast path can stand in for */
+#define VIRT_LOCAL_STATS (VIR_DOMAIN_STATS_CPU_TOTAL | VIR_DOMAIN_STATS_BLOCK | VIR_DOMAIN_STATS_INTERFACE)
+
+/**
+ * Enable the fast path, it is disabled by default.
+ * @param root - directory /proc, /run and /sys are found in, "/" on the host itself
+ */
+void virt_local_set_root(const char *root);
+
+/**
+ * Read the counters of a domain locally, mapping it first if needed.
+ * @param virt  - pointer with virt data
+ * @param row   - row of the domain records
+ * @param stats - VIRT_LOCAL_STATS groups the domain needs
+ * @param now   - monotonic time of the sample
+ * @return groups which were read and need not be asked from libvirt
+ */
+unsigned int virt_local_collect(virt_data *virt, int row, unsigned int stats, unsigned long long now);
+
+/**
+ * Close the files of a domain, e.g. of a record which is freed.
+ * @param entry - files of the domain, may be NULL
+ */
+void virt_local_release(virt_local_entry *entry);
+
+#endif /* VIRT_LOCAL_H */
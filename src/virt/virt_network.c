@@ -0,0 +1,765 @@
+/* This file contains the network mode, virtual networks, their leases and vNICs
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_network.h"
+#include "virt_domain.h"
+#include "virt_health.h"
+#include "virt_trace.h"
+#include "utils.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <time.h>
+
+/** Callbacks, indecies of virt_network_cache.callback */
+enum {
+    VIRT_NETWORK_CALLBACK_LIFECYCLE,
+    VIRT_NETWORK_CALLBACK_DEVICE_ADDED,
+    VIRT_NETWORK_CALLBACK_DEVICE_REMOVED,
+    VIRT_NETWORK_CALLBACK_NETWORK
+};
+
+static void virt_network_free_leases(virt_network_net *net)
+{
+    for (int i = 0; i != net->lease_size; ++i) {
+        free(net->lease[i].mac);
+        free(net->lease[i].ip);
+        free(net->lease[i].hostname);
+    }
+    free(net->lease);
+    net->lease      = NULL;
+    net->lease_size = 0;
+    net->leased     = 0;
+}
+
+static void virt_network_free_net(virt_network_net *net)
+{
+    virt_network_free_leases(net);
+    free(net->name);
+    free(net->bridge);
+    if (net->net)
+        virNetworkFree(net->net);
+}
+
+static void virt_network_free_vnic(virt_network_vnic *vnic)
+{
+    free(vnic->mac);
+    free(vnic->domain);
+    free(vnic->dev);
+    free(vnic->source);
+}
+
+static void virt_network_free_map(virt_network_cache *cache)
+{
+    for (int i = 0; i != cache->vnic_size; ++i)
+        virt_network_free_vnic(cache->vnic + i);
+    free(cache->vnic);
+    cache->vnic         = NULL;
+    cache->vnic_size    = 0;
+    cache->mapped       = 0;
+}
+
+void virt_init_network_cache(virt_network_cache *cache)
+{
+    cache->net          = NULL;
+    cache->net_size     = 0;
+    cache->net_dirty    = 1;
+    cache->vnic         = NULL;
+    cache->vnic_size    = 0;
+    cache->mapped       = 0;
+    cache->pending      = NULL;
+    cache->pending_size = 0;
+    cache->conn         = NULL;
+    for (int i = 0; i != VIRT_NETWORK_CALLBACK_SIZE; ++i)
+        cache->callback[i] = -1;
+}
+
+void virt_deinit_network_cache(virt_network_cache *cache)
+{
+    for (int i = 0; i != cache->net_size; ++i)
+        virt_network_free_net(cache->net + i);
+    free(cache->net);
+    virt_network_free_map(cache);
+    free(cache->pending);
+}
+
+void virt_network_invalidate(virt_network_cache *cache)
+{
+    virt_network_unwatch(cache);
+    virt_deinit_network_cache(cache);
+    virt_init_network_cache(cache);
+}
+
+void virt_network_unwatch(virt_network_cache *cache)
+{
+    if (!cache->conn)
+        return;
+
+    for (int i = 0; i != VIRT_NETWORK_CALLBACK_SIZE; ++i) {
+        if (cache->callback[i] < 0)
+            continue;
+        if (i == VIRT_NETWORK_CALLBACK_NETWORK)
+            virConnectNetworkEventDeregisterAny(cache->conn, cache->callback[i]);
+        else
+            virConnectDomainEventDeregisterAny(cache->conn, cache->callback[i]);
+        cache->callback[i] = -1;
+    }
+    cache->conn = NULL;
+}
+
+/* Remember the domain, its vNICs are described again on the next refresh */
+static void virt_network_queue(virt_network_cache *cache, virDomainPtr domain)
+{
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    if (virDomainGetUUID(domain, uuid) < 0)
+        return;
+
+    for (int i = 0; i != cache->pending_size; ++i)
+        if (memcmp(cache->pending[i], uuid, VIR_UUID_BUFLEN) == 0)
+            return;
+
+    cache->pending = realloc(cache->pending, (cache->pending_size + 1) * sizeof(*cache->pending));
+    memcpy(cache->pending[cache->pending_size++], uuid, VIR_UUID_BUFLEN);
+}
+
+/* Events are dispatched by the main loop, the callbacks only take notes */
+static int virt_network_domain_lifecycle(virConnectPtr conn, virDomainPtr domain, int event,
+                                         int detail, void *opaque)
+{
+    /* interfaces change with the definition, host devices with the start and stop */
+    if (event == VIR_DOMAIN_EVENT_DEFINED || event == VIR_DOMAIN_EVENT_UNDEFINED ||
+        event == VIR_DOMAIN_EVENT_STARTED || event == VIR_DOMAIN_EVENT_STOPPED)
+        virt_network_queue(opaque, domain);
+    return 0;
+}
+
+static void virt_network_domain_device(virConnectPtr conn, virDomainPtr domain,
+                                       const char *alias, void *opaque)
+{
+    virt_network_queue(opaque, domain);
+}
+
+static void virt_network_lifecycle(virConnectPtr conn, virNetworkPtr net, int event,
+                                   int detail, void *opaque)
+{
+    ((virt_network_cache *)opaque)->net_dirty = 1;
+}
+
+/* Register the callbacks on conn, failed registrations stay at -1 */
+static void virt_network_watch(virt_network_cache *cache, virConnectPtr conn)
+{
+    cache->conn = conn;
+    cache->callback[VIRT_NETWORK_CALLBACK_LIFECYCLE] =
+        virConnectDomainEventRegisterAny(conn, NULL, VIR_DOMAIN_EVENT_ID_LIFECYCLE,
+                                         VIR_DOMAIN_EVENT_CALLBACK(virt_network_domain_lifecycle), cache, NULL);
+    cache->callback[VIRT_NETWORK_CALLBACK_DEVICE_ADDED] =
+        virConnectDomainEventRegisterAny(conn, NULL, VIR_DOMAIN_EVENT_ID_DEVICE_ADDED,
+                                         VIR_DOMAIN_EVENT_CALLBACK(virt_network_domain_device), cache, NULL);
+    cache->callback[VIRT_NETWORK_CALLBACK_DEVICE_REMOVED] =
+        virConnectDomainEventRegisterAny(conn, NULL, VIR_DOMAIN_EVENT_ID_DEVICE_REMOVED,
+                                         VIR_DOMAIN_EVENT_CALLBACK(virt_network_domain_device), cache, NULL);
+    cache->callback[VIRT_NETWORK_CALLBACK_NETWORK] =
+        virConnectNetworkEventRegisterAny(conn, NULL, VIR_NETWORK_EVENT_ID_LIFECYCLE,
+                                          VIR_NETWORK_EVENT_CALLBACK(virt_network_lifecycle), cache, NULL);
+}
+
+/* Check whether every callback is registered, otherwise the map may go out of date */
+static int virt_network_watching(const virt_network_cache *cache)
+{
+    for (int i = 0; i != VIRT_NETWORK_CALLBACK_SIZE; ++i)
+        if (cache->callback[i] < 0)
+            return 0;
+    return 1;
+}
+
+static int virt_network_net_cmp(const void *a, const void *b)
+{
+    return strcmp(((const virt_network_net *)a)->name, ((const virt_network_net *)b)->name);
+}
+
+static int virt_network_lease_cmp(const void *a, const void *b)
+{
+    return strcmp(((const virt_network_lease *)a)->mac, ((const virt_network_lease *)b)->mac);
+}
+
+static int virt_network_vnic_cmp(const void *a, const void *b)
+{
+    return strcmp(((const virt_network_vnic *)a)->mac, ((const virt_network_vnic *)b)->mac);
+}
+
+/* Order vNICs by domain and host device, the order of the interface statistics lookup */
+static int virt_network_vnic_dev_cmp(const void *a, const void *b)
+{
+    const virt_network_vnic *x = *(const virt_network_vnic * const *)a;
+    const virt_network_vnic *y = *(const virt_network_vnic * const *)b;
+    int res = memcmp(x->uuid, y->uuid, VIR_UUID_BUFLEN);
+    return res ? res : strcmp(x->dev, y->dev);
+}
+
+static int virt_str_equal(const char *a, const char *b)
+{
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+/* Copy the MAC address in lower case, libvirt does not insist on the case */
+static char *virt_network_mac_copy(const char *mac)
+{
+    char *copy = copy_str(mac);
+    for (char *p = copy; p && *p; ++p)
+        *p = tolower((unsigned char)*p);
+    return copy;
+}
+
+/*
+ * Append the vNICs of the domain to the map, the map is to be sorted by the caller.
+ * The live description names the host devices of a running domain.
+ */
+static void virt_network_scan_domain(virt_network_cache *cache, virDomainPtr domain)
+{
+    unsigned long long trace = virt_trace_begin();
+    char *xml = virDomainGetXMLDesc(domain, 0);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_XML_DESC, domain, trace, xml == NULL);
+    if (!xml)
+        return;
+
+    unsigned char uuid[VIR_UUID_BUFLEN] = { 0 };
+    virDomainGetUUID(domain, uuid);
+    const char *name = virDomainGetName(domain);
+
+    const char *end = xml;
+    for (const char *p = strstr(xml, "<interface "); p; p = strstr(end, "<interface ")) {
+        end = strstr(p, "</interface>");
+        if (!end)
+            break;
+
+        char *mac = xml_attr(xml_element(p, end, "<mac "), end, "address");
+        if (!mac)
+            continue;
+
+        const char *source = xml_element(p, end, "<source ");
+        char *source_name = xml_attr(source, end, "network");
+        if (!source_name)
+            source_name = xml_attr(source, end, "bridge");
+
+        cache->vnic = realloc(cache->vnic, (cache->vnic_size + 1) * sizeof(virt_network_vnic));
+        virt_network_vnic *vnic = cache->vnic + cache->vnic_size++;
+        memset(vnic, 0, sizeof(virt_network_vnic));
+        memcpy(vnic->uuid, uuid, VIR_UUID_BUFLEN);
+        vnic->mac       = virt_network_mac_copy(mac);
+        vnic->domain    = copy_str(name ? name : VIRT_DOMAIN_UNKNOWN_DATA);
+        vnic->dev       = xml_attr(xml_element(p, end, "<target "), end, "dev");
+        vnic->source    = source_name;
+        free(mac);
+    }
+    free(xml);
+}
+
+/* List all domains, NULL on failure */
+static virDomainPtr *virt_network_list_domains(virt_data *virt, int *size)
+{
+    virDomainPtr *domains = NULL;
+    unsigned long long trace = virt_trace_begin();
+    *size = virConnectListAllDomains(virt->conn, &domains, 0);
+    virt_trace_end(VIRT_TRACE_API_CONNECT_LIST_ALL_DOMAINS, NULL, trace, *size < 0);
+    if (*size < 0) {
+        virt_health_failed(virt);
+        return NULL;
+    }
+    return domains;
+}
+
+static void virt_network_free_domains(virDomainPtr *domains, int size)
+{
+    for (int i = 0; i != size; ++i)
+        virDomainFree(domains[i]);
+    free(domains);
+}
+
+/* Build the map from the description of every domain, events queued so far are covered */
+static void virt_network_build_map(virt_data *virt, unsigned long long now)
+{
+    virt_network_cache *cache = virt->network;
+
+    int size = 0;
+    virDomainPtr *domains = virt_network_list_domains(virt, &size);
+    if (!domains)
+        return;
+
+    virt_network_free_map(cache);
+    for (int i = 0; i != size; ++i)
+        virt_network_scan_domain(cache, domains[i]);
+    virt_network_free_domains(domains, size);
+
+    qsort(cache->vnic, cache->vnic_size, sizeof(virt_network_vnic), virt_network_vnic_cmp);
+    cache->mapped       = now;
+    cache->pending_size = 0;
+}
+
+/*
+ * Describe again the domains named by events. Domains which are gone lose
+ * their vNICs, vNICs which kept their MAC address and host device keep
+ * their samples.
+ */
+static void virt_network_apply_pending(virt_data *virt)
+{
+    virt_network_cache *cache = virt->network;
+    if (!cache->pending_size)
+        return;
+
+    /* a single listing tells which of the domains still exist */
+    int size = 0;
+    virDomainPtr *domains = virt_network_list_domains(virt, &size);
+    if (!domains)
+        return;
+
+    for (int i = 0; i != cache->pending_size; ++i) {
+        const unsigned char *uuid = cache->pending[i];
+
+        /* move the vNICs of the domain out of the map */
+        virt_network_vnic *old = malloc((cache->vnic_size + 1) * sizeof(virt_network_vnic));
+        int old_size = 0, kept = 0;
+        for (int j = 0; j != cache->vnic_size; ++j) {
+            if (memcmp(cache->vnic[j].uuid, uuid, VIR_UUID_BUFLEN) == 0)
+                old[old_size++] = cache->vnic[j];
+            else
+                cache->vnic[kept++] = cache->vnic[j];
+        }
+        cache->vnic_size = kept;
+
+        for (int j = 0; j != size; ++j) {
+            unsigned char domain_uuid[VIR_UUID_BUFLEN];
+            if (virDomainGetUUID(domains[j], domain_uuid) == 0 &&
+                memcmp(domain_uuid, uuid, VIR_UUID_BUFLEN) == 0) {
+                virt_network_scan_domain(cache, domains[j]);
+                break;
+            }
+        }
+
+        for (int j = kept; j != cache->vnic_size; ++j) {
+            virt_network_vnic *vnic = cache->vnic + j;
+            for (int k = 0; k != old_size; ++k) {
+                if (strcmp(vnic->mac, old[k].mac) == 0 && virt_str_equal(vnic->dev, old[k].dev)) {
+                    vnic->rx_bytes  = old[k].rx_bytes;
+                    vnic->tx_bytes  = old[k].tx_bytes;
+                    vnic->rx_rate   = old[k].rx_rate;
+                    vnic->tx_rate   = old[k].tx_rate;
+                    vnic->sampled   = old[k].sampled;
+                    break;
+                }
+            }
+        }
+
+        for (int k = 0; k != old_size; ++k)
+            virt_network_free_vnic(old + k);
+        free(old);
+    }
+    virt_network_free_domains(domains, size);
+
+    qsort(cache->vnic, cache->vnic_size, sizeof(virt_network_vnic), virt_network_vnic_cmp);
+    cache->pending_size = 0;
+}
+
+/*
+ * Replace the cached networks with the listed ones, leases of networks
+ * listed before are kept. Networks are sorted by name.
+ */
+static int virt_network_sync_nets(virt_data *virt)
+{
+    virt_network_cache *cache = virt->network;
+
+    virNetworkPtr *nets = NULL;
+    unsigned long long trace = virt_trace_begin();
+    int size = virConnectListAllNetworks(virt->conn, &nets, 0);
+    virt_trace_end(VIRT_TRACE_API_CONNECT_LIST_ALL_NETWORKS, NULL, trace, size < 0);
+    if (size < 0) {
+        virt_health_failed(virt);
+        return VIRT_ERROR_FAILURE;
+    }
+
+    virt_network_net *net = calloc(size + 1, sizeof(virt_network_net));
+    for (int i = 0; i != size; ++i) {
+        unsigned char uuid[VIR_UUID_BUFLEN] = { 0 };
+        virNetworkGetUUID(nets[i], uuid);
+
+        /* networks are few, a linear lookup is enough */
+        for (int j = 0; j != cache->net_size; ++j) {
+            if (cache->net[j].name && memcmp(cache->net[j].uuid, uuid, VIR_UUID_BUFLEN) == 0) {
+                net[i] = cache->net[j];
+                memset(cache->net + j, 0, sizeof(virt_network_net));
+                break;
+            }
+        }
+
+        if (net[i].net)
+            virNetworkFree(net[i].net);
+        free(net[i].name);
+        free(net[i].bridge);
+        memcpy(net[i].uuid, uuid, VIR_UUID_BUFLEN);
+        net[i].net      = nets[i];
+        net[i].name     = copy_str(virNetworkGetName(nets[i]));
+        if (!net[i].name)
+            net[i].name = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+        /* networks forwarding without a bridge, e.g. macvtap, report an error */
+        trace = virt_trace_begin();
+        net[i].bridge = virNetworkGetBridgeName(nets[i]);
+        virt_trace_end(VIRT_TRACE_API_NETWORK_GET_BRIDGE_NAME, NULL, trace, !net[i].bridge);
+
+        trace = virt_trace_begin();
+        int active = virNetworkIsActive(nets[i]);
+        virt_trace_end(VIRT_TRACE_API_NETWORK_IS_ACTIVE, NULL, trace, active < 0);
+        net[i].active = active == 1;
+        if (!net[i].active)
+            virt_network_free_leases(net + i);
+    }
+    free(nets);
+
+    /* networks which are gone */
+    for (int j = 0; j != cache->net_size; ++j)
+        virt_network_free_net(cache->net + j);
+    free(cache->net);
+
+    qsort(net, size, sizeof(virt_network_net), virt_network_net_cmp);
+    cache->net      = net;
+    cache->net_size = size;
+    return VIRT_ERROR_SUCCESS;
+}
+
+/* Fetch the leases of an active network, sorted by MAC address */
+static void virt_network_fetch_leases(virt_network_net *net, unsigned long long now)
+{
+    virNetworkDHCPLeasePtr *leases = NULL;
+    unsigned long long trace = virt_trace_begin();
+    int size = virNetworkGetDHCPLeases(net->net, NULL, &leases, 0);
+    virt_trace_end(VIRT_TRACE_API_NETWORK_GET_DHCP_LEASES, NULL, trace, size < 0);
+    if (size < 0)
+        return;
+
+    virt_network_free_leases(net);
+    net->lease = calloc(size + 1, sizeof(virt_network_lease));
+    for (int i = 0; i != size; ++i) {
+        net->lease[i].mac       = virt_network_mac_copy(leases[i]->mac ? leases[i]->mac : VIRT_DOMAIN_UNKNOWN_DATA);
+        net->lease[i].ip        = copy_str(leases[i]->ipaddr ? leases[i]->ipaddr : VIRT_DOMAIN_UNKNOWN_DATA);
+        net->lease[i].prefix    = leases[i]->prefix;
+        net->lease[i].hostname  = leases[i]->hostname ? copy_str(leases[i]->hostname) : NULL;
+        net->lease[i].expiry    = leases[i]->expirytime;
+        virNetworkDHCPLeaseFree(leases[i]);
+    }
+    free(leases);
+
+    qsort(net->lease, size, sizeof(virt_network_lease), virt_network_lease_cmp);
+    net->lease_size = size;
+    net->leased     = now;
+}
+
+/*
+ * Sample the interface counters of all running domains in one call and
+ * derive the rates of the vNICs. Interface statistics are read on the host
+ * and do not wait for the guest, hung domains do not hold the call up.
+ */
+static void virt_network_sample(virt_data *virt, unsigned long long now)
+{
+    virt_network_cache *cache = virt->network;
+
+    virDomainStatsRecordPtr *stats = NULL;
+    unsigned long long trace = virt_trace_begin();
+    int count = virConnectGetAllDomainStats(virt->conn, VIR_DOMAIN_STATS_INTERFACE, &stats,
+                                            VIR_CONNECT_GET_ALL_DOMAINS_STATS_ACTIVE);
+    virt_trace_end(VIRT_TRACE_API_CONNECT_GET_ALL_DOMAIN_STATS, NULL, trace, count < 0);
+    if (count < 0)
+        return;
+
+    /* statistics name the host device, vNICs are looked up by domain and device */
+    virt_network_vnic **by_dev = malloc((cache->vnic_size + 1) * sizeof(virt_network_vnic *));
+    int by_dev_size = 0;
+    for (int i = 0; i != cache->vnic_size; ++i)
+        if (cache->vnic[i].dev)
+            by_dev[by_dev_size++] = cache->vnic + i;
+    qsort(by_dev, by_dev_size, sizeof(virt_network_vnic *), virt_network_vnic_dev_cmp);
+
+    for (int i = 0; i < count; ++i) {
+        virTypedParameterPtr params = stats[i]->params;
+        int nparams = stats[i]->nparams;
+
+        virt_network_vnic key;
+        virt_network_vnic *key_ptr = &key;
+        if (virDomainGetUUID(stats[i]->dom, key.uuid) < 0)
+            continue;
+
+        unsigned int nets = 0;
+        virTypedParamsGetUInt(params, nparams, "net.count", &nets);
+        for (unsigned int j = 0; j != nets; ++j) {
+            char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+            const char *dev = NULL;
+            snprintf(field, sizeof(field), "net.%u.name", j);
+            if (virTypedParamsGetString(params, nparams, field, &dev) != 1 || !dev)
+                continue;
+
+            key.dev = (char *)dev;
+            virt_network_vnic **found = by_dev_size ?
+                bsearch(&key_ptr, by_dev, by_dev_size, sizeof(virt_network_vnic *),
+                        virt_network_vnic_dev_cmp) : NULL;
+            if (!found)
+                continue;
+
+            unsigned long long rx = 0, tx = 0;
+            snprintf(field, sizeof(field), "net.%u.rx.bytes", j);
+            virTypedParamsGetULLong(params, nparams, field, &rx);
+            snprintf(field, sizeof(field), "net.%u.tx.bytes", j);
+            virTypedParamsGetULLong(params, nparams, field, &tx);
+
+            virt_network_vnic *vnic = *found;
+            unsigned long long elapsed = vnic->sampled ? now - vnic->sampled : 0;
+            vnic->rx_rate   = virt_domain_rate(rx, vnic->rx_bytes, elapsed);
+            vnic->tx_rate   = virt_domain_rate(tx, vnic->tx_bytes, elapsed);
+            vnic->rx_bytes  = rx;
+            vnic->tx_bytes  = tx;
+            vnic->sampled   = now;
+        }
+    }
+    free(by_dev);
+    virDomainStatsRecordListFree(stats);
+}
+
+/* Bring the networks, leases and the map up to date and sample the vNICs */
+static void virt_network_refresh(virt_data *virt)
+{
+    if (!virt_health_connected(virt))
+        return;
+
+    virt_network_cache *cache = virt->network;
+    unsigned long long now = time_monotonic_us();
+
+    /* callbacks go first, so nothing is missed between the building of the map and the first event */
+    if (cache->conn != virt->conn) {
+        virt_network_unwatch(cache);
+        virt_network_watch(cache, virt->conn);
+    }
+    int watching = virt_network_watching(cache);
+
+    if (!cache->mapped || (!watching &&
+        now - cache->mapped >= (unsigned long long)(VIRT_NETWORK_REBUILD_PERIOD * 1000000.0)))
+        virt_network_build_map(virt, now);
+    else
+        virt_network_apply_pending(virt);
+
+    /* without network events the networks are listed on every refresh */
+    int dirty = cache->net_dirty || !watching;
+    if (dirty && virt_network_sync_nets(virt) != VIRT_ERROR_SUCCESS)
+        return;
+    cache->net_dirty = 0;
+
+    for (int i = 0; i != cache->net_size; ++i) {
+        virt_network_net *net = cache->net + i;
+        if (net->active && (dirty || !net->leased ||
+            now - net->leased >= (unsigned long long)(VIRT_NETWORK_LEASE_PERIOD * 1000000.0)))
+            virt_network_fetch_leases(net, now);
+    }
+
+    virt_network_sample(virt, now);
+}
+
+/* Check whether the vNIC is attached to the network, by its name or bridge */
+static int virt_network_attached(const virt_network_vnic *vnic, const virt_network_net *net)
+{
+    return vnic->source && (strcmp(vnic->source, net->name) == 0 ||
+                            (net->bridge && strcmp(vnic->source, net->bridge) == 0));
+}
+
+/* Find the first lease of the MAC address, NULL if there is none */
+static const virt_network_lease *virt_network_find_lease(const virt_network_net *net, const char *mac)
+{
+    virt_network_lease key = { .mac = (char *)mac };
+    const virt_network_lease *found = net->lease_size ?
+        bsearch(&key, net->lease, net->lease_size, sizeof(virt_network_lease), virt_network_lease_cmp) : NULL;
+    while (found && found != net->lease && strcmp(found[-1].mac, mac) == 0)
+        --found;
+    return found;
+}
+
+/* Format an indented row name */
+static char *virt_network_indent_str(const char *name)
+{
+    size_t indent = strlen(VIRT_NETWORK_ROW_INDENT);
+    size_t len    = strlen(name);
+    char *str = malloc(indent + len + 1);
+    memcpy(str, VIRT_NETWORK_ROW_INDENT, indent);
+    memcpy(str + indent, name, len + 1);
+    return str;
+}
+
+/* Format the address of the lease with its prefix, e.g. "192.168.122.10/24" */
+static char *virt_network_ip_str(const virt_network_lease *lease)
+{
+    if (!lease)
+        return virt_network_indent_str(VIRT_DOMAIN_UNKNOWN_DATA);
+
+    char buf[80];
+    snprintf(buf, sizeof(buf), "%.63s/%u", lease->ip, lease->prefix);
+    return virt_network_indent_str(buf);
+}
+
+/* Format when the lease expires, e.g. "42m10s" */
+static char *virt_network_expires_str(const virt_network_lease *lease, time_t now)
+{
+    if (!lease)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    if (!lease->expiry)
+        return copy_str("never");
+
+    char buf[32];
+    long long seconds = lease->expiry > now ? lease->expiry - now : 0;
+    if (seconds >= 86400)
+        snprintf(buf, sizeof(buf), "%lldd%02lldh", seconds / 86400, seconds % 86400 / 3600);
+    else if (seconds >= 3600)
+        snprintf(buf, sizeof(buf), "%lldh%02lldm", seconds / 3600, seconds % 3600 / 60);
+    else
+        snprintf(buf, sizeof(buf), "%lldm%02llds", seconds / 60, seconds % 60);
+    return copy_str(buf);
+}
+
+/* Format a rate in KiB per second */
+static char *virt_network_rate_str(double rate, int sampled, int stale)
+{
+    if (!sampled)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    return virt_domain_stale_str(double_to_str(rate / 1024.0), stale);
+}
+
+static void virt_network_render_net(virt_network_data *data, size_t row, const virt_network_cache *cache,
+                                    const virt_network_net *net, int stale)
+{
+    double rx = 0, tx = 0;
+    int sampled = 0;
+    for (int i = 0; i != cache->vnic_size; ++i) {
+        const virt_network_vnic *vnic = cache->vnic + i;
+        if (vnic->dev && vnic->sampled && virt_network_attached(vnic, net)) {
+            rx += vnic->rx_rate;
+            tx += vnic->tx_rate;
+            sampled = 1;
+        }
+    }
+
+    data->network_data[VIRT_NETWORK_DATA_TYPE_NAME][row]        = copy_str(net->name);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_STATE][row]       = virt_domain_stale_str(copy_str(net->active ? "active" : "inactive"), stale);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_ADDRESS][row]     = copy_str(net->bridge ? net->bridge : VIRT_DOMAIN_UNKNOWN_DATA);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_DOMAIN][row]      = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_VNIC][row]        = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_RX][row]          = virt_network_rate_str(rx, sampled, stale);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_TX][row]          = virt_network_rate_str(tx, sampled, stale);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_HOSTNAME][row]    = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_EXPIRES][row]     = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+}
+
+/* Render a lease, a vNIC or both, a vNIC without a lease or a lease of an unknown MAC address */
+static void virt_network_render_lease(virt_network_data *data, size_t row, const virt_network_vnic *vnic,
+                                      const virt_network_lease *lease, int stale, time_t now)
+{
+    const char *state = !vnic ? "foreign" : !vnic->dev ? "down" : lease ? "leased" : "no lease";
+    int sampled = vnic && vnic->dev && vnic->sampled;
+
+    data->network_data[VIRT_NETWORK_DATA_TYPE_NAME][row]        = virt_network_ip_str(lease);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_STATE][row]       = virt_domain_stale_str(copy_str(state), stale);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_ADDRESS][row]     = copy_str(vnic ? vnic->mac : lease->mac);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_DOMAIN][row]      = copy_str(vnic ? vnic->domain : VIRT_DOMAIN_UNKNOWN_DATA);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_VNIC][row]        = copy_str(vnic && vnic->dev ? vnic->dev : VIRT_DOMAIN_UNKNOWN_DATA);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_RX][row]          = virt_network_rate_str(sampled ? vnic->rx_rate : 0, sampled, stale);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_TX][row]          = virt_network_rate_str(sampled ? vnic->tx_rate : 0, sampled, stale);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_HOSTNAME][row]    = copy_str(lease && lease->hostname ? lease->hostname : VIRT_DOMAIN_UNKNOWN_DATA);
+    data->network_data[VIRT_NETWORK_DATA_TYPE_EXPIRES][row]     = virt_network_expires_str(lease, now);
+}
+
+int virt_network_row(virt_data *virt, int index)
+{
+    return -1;
+}
+
+/*
+ * Render the rows of every network, the network itself, its vNICs with one
+ * row per lease and the leases no attached vNIC has. Rows are only counted
+ * if data is NULL.
+ * @return number of rows
+ */
+static size_t virt_network_render(virt_network_data *data, const virt_network_cache *cache,
+                                  int stale, time_t now)
+{
+    size_t row = 0;
+    for (int i = 0; i != cache->net_size; ++i) {
+        const virt_network_net *net = cache->net + i;
+        if (data)
+            virt_network_render_net(data, row, cache, net, stale);
+        ++row;
+
+        for (int j = 0; j != cache->vnic_size; ++j) {
+            const virt_network_vnic *vnic = cache->vnic + j;
+            if (!virt_network_attached(vnic, net))
+                continue;
+
+            const virt_network_lease *lease = virt_network_find_lease(net, vnic->mac);
+            if (!lease) {
+                if (data)
+                    virt_network_render_lease(data, row, vnic, NULL, stale, now);
+                ++row;
+            }
+            for (; lease && lease != net->lease + net->lease_size && strcmp(lease->mac, vnic->mac) == 0; ++lease) {
+                if (data)
+                    virt_network_render_lease(data, row, vnic, lease, stale, now);
+                ++row;
+            }
+        }
+
+        /* leases of MAC addresses no domain has, or of vNICs attached elsewhere */
+        for (int j = 0; j != net->lease_size; ++j) {
+            const virt_network_lease *lease = net->lease + j;
+            virt_network_vnic key = { .mac = lease->mac };
+            const virt_network_vnic *vnic = cache->vnic_size ?
+                bsearch(&key, cache->vnic, cache->vnic_size, sizeof(virt_network_vnic), virt_network_vnic_cmp) : NULL;
+            if (vnic && virt_network_attached(vnic, net))
+                continue;
+            if (data)
+                virt_network_render_lease(data, row, NULL, lease, stale, now);
+            ++row;
+        }
+    }
+    return row;
+}
+
+void *virt_get_network_data(virt_data *virt)
+{
+    virt_network_refresh(virt);
+
+    virt_network_cache *cache = virt->network;
+    int stale = !virt_health_connected(virt);
+    time_t now = time(NULL);
+
+    size_t size = virt_network_render(NULL, cache, stale, now);
+
+    virt_network_data *data = malloc(sizeof(virt_network_data));
+    data->network_size = size;
+    /* last item counts as NULL */
+    for (int i = 0; i != VIRT_NETWORK_DATA_TYPE_SIZE; ++i)
+        data->network_data[i] = calloc(size + 1, sizeof(char *));
+
+    virt_network_render(data, cache, stale, now);
+    ++data->network_size;
+
+    return data;
+}
+
+void virt_network_no_command(virt_data *virt, int index)
+{
+}
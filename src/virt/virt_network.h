@@ -0,0 +1,166 @@
+/* This file contains the network mode, virtual networks, their leases and vNICs
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_network.h
+ * This file contains the network mode. Virtual networks are listed with
+ * their bridges, each followed by the vNICs attached to it and the DHCP
+ * leases it handed out. Leases are mapped back to domains by MAC address
+ * through a map of all vNICs, which is built once from the domain XML and
+ * then kept up to date from domain and network events, only the domains
+ * an event names are described again.
+ */
+#ifndef VIRT_NETWORK_H
+#define VIRT_NETWORK_H
+#include "virt.h"
+/** Number of possible network data types */
+#define VIRT_NETWORK_DATA_TYPE_SIZE (9)
+/** Seconds after which the leases of a network are fetched again, leases are renewed without events */
+#define VIRT_NETWORK_LEASE_PERIOD (10.0)
+/** Seconds after which the vNIC map is built again if events could not be registered */
+#define VIRT_NETWORK_REBUILD_PERIOD (60.0)
+/** Number of event callbacks registered by the network mode */
+#define VIRT_NETWORK_CALLBACK_SIZE (4)
+/** Indent of vNIC and lease rows under their network */
+#define VIRT_NETWORK_ROW_INDENT ("  ")
+
+/**
+ * Indecies of the virt_network_data array.
+ * @see virt_network_data
+ */
+typedef enum {
+    VIRT_NETWORK_DATA_TYPE_NAME,
+    VIRT_NETWORK_DATA_TYPE_STATE,
+    VIRT_NETWORK_DATA_TYPE_ADDRESS,
+    VIRT_NETWORK_DATA_TYPE_DOMAIN,
+    VIRT_NETWORK_DATA_TYPE_VNIC,
+    VIRT_NETWORK_DATA_TYPE_RX,
+    VIRT_NETWORK_DATA_TYPE_TX,
+    VIRT_NETWORK_DATA_TYPE_HOSTNAME,
+    VIRT_NETWORK_DATA_TYPE_EXPIRES
+} virt_network_data_type_enum;
+
+/** @see virt_network_data_type_enum */
+typedef virt_network_data_type_enum network_type;
+
+/** Structure holding data of all network rows */
+typedef struct {
+    /** Arrays containing various network data */
+    char **network_data[VIRT_NETWORK_DATA_TYPE_SIZE];
+    /** Number of network rows */
+    size_t network_size;
+} virt_network_data;
+
+/** DHCP lease copied out of virNetworkGetDHCPLeases. */
+typedef struct {
+    char                *mac;           /** Key of the vNIC map */
+    char                *ip;
+    unsigned int        prefix;
+    char                *hostname;      /** NULL if the client sent none */
+    long long           expiry;         /** Seconds since the epoch, 0 if the lease never expires */
+} virt_network_lease;
+
+/** Cached virtual network with its leases. */
+typedef struct {
+    unsigned char       uuid[VIR_UUID_BUFLEN];  /** Key of the network */
+    char                *name;
+    char                *bridge;                /** NULL if the network has no bridge */
+    int                 active;
+    virNetworkPtr       net;
+    virt_network_lease  *lease;                 /** Leases sorted by IP address */
+    int                 lease_size;
+    unsigned long long  leased;                 /** Monotonic time the leases were fetched, 0 if never */
+} virt_network_net;
+
+/** vNIC of a domain, an entry of the map by MAC address. */
+typedef struct {
+    char                *mac;                   /** Key of the map, lower case */
+    unsigned char       uuid[VIR_UUID_BUFLEN];  /** Domain the vNIC belongs to */
+    char                *domain;                /** Name of the domain */
+    char                *dev;                   /** Host side device, NULL while the domain is not running */
+    char                *source;                /** Network or bridge the vNIC is attached to, NULL if neither */
+    unsigned long long  rx_bytes;               /** Counters of the last sample */
+    unsigned long long  tx_bytes;
+    double              rx_rate;                /** Bytes per second */
+    double              tx_rate;
+    unsigned long long  sampled;                /** Monotonic time of the last sample, 0 if never sampled */
+} virt_network_vnic;
+
+/** Networks and the vNIC map cached across refreshes. */
+typedef struct virt_network_cache {
+    virt_network_net    *net;               /** Networks sorted by name */
+    int                 net_size;
+    int                 net_dirty;          /** A network event came, networks and leases are fetched again */
+    virt_network_vnic   *vnic;              /** vNIC map sorted by MAC address */
+    int                 vnic_size;
+    unsigned long long  mapped;             /** Monotonic time the map was built, 0 if never */
+    unsigned char       (*pending)[VIR_UUID_BUFLEN];    /** Domains named by events since the last refresh */
+    int                 pending_size;
+    virConnectPtr       conn;               /** Connection the callbacks are registered on, NULL if none */
+    int                 callback[VIRT_NETWORK_CALLBACK_SIZE];   /** Callback identifiers, -1 if not registered */
+} virt_network_cache;
+
+/**
+ * Set the cache to default state, nothing is listed or mapped yet.
+ * @param cache - cache to be initialized
+ */
+void virt_init_network_cache(virt_network_cache *cache);
+
+/**
+ * Release the cache with all networks, leases and the vNIC map.
+ * The callbacks must have been deregistered by virt_network_unwatch.
+ * @param cache - cache to be freed
+ */
+void virt_deinit_network_cache(virt_network_cache *cache);
+
+/**
+ * Drop networks and the vNIC map of the previous connection, the map is built again.
+ * @param cache - cache to be invalidated
+ */
+void virt_network_invalidate(virt_network_cache *cache);
+
+/**
+ * Deregister the event callbacks, must be called before their connection is closed.
+ * @param cache - cache whose callbacks are deregistered
+ */
+void virt_network_unwatch(virt_network_cache *cache);
+
+/**
+ * Network rows have no domain.
+ * @param virt  - pointer with virt data
+ * @param index - network row
+ * @return -1
+ */
+int virt_network_row(virt_data *virt, int index);
+
+/**
+ * Bring the networks, leases and the vNIC map up to date, sample the vNICs
+ * and render the network rows.
+ * @param virt - Handler to the libvirt connection
+ * @return object filled with network data
+ */
+void *virt_get_network_data(virt_data *virt);
+
+/*
+ * Lifecycle commands do not apply to network rows, used by every command table.
+ * @param virt  - pointer with virt data
+ * @param index - network row
+ */
+void virt_network_no_command(virt_data *virt, int index);
+
+#endif /* VIRT_NETWORK_H */
@@ -19,6 +19,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "virt_node.h"
+#include "virt_trace.h"
+#include "virt_health.h"
+#include "virt_domain.h"
+#include "virt_command.h"
 #include "utils.h"
 
 void virt_init_node_data(void *vdata)
@@ -29,6 +33,7 @@ void virt_init_node_data(void *vdata)
         data->node_data[i] = NULL;
         data->node_type[i] = i;
     }
+    data->cache = NULL;
 }
 
 void virt_deinit_node_data(void *vdata)
@@ -45,18 +50,460 @@ void virt_reset_node_data(void *vdata)
     virt_deinit_node_data(vdata);
 }
 
+/* Deep copy of node data */
+static void virt_copy_node_data(virt_node_data *dst, const virt_node_data *src)
+{
+    for (int i = 0; i != VIRT_NODE_DATA_TYPE_SIZE; ++i) {
+        dst->node_data[i] = src->node_data[i] ? copy_str(src->node_data[i]) : NULL;
+        dst->node_type[i] = src->node_type[i];
+    }
+    /* the meters are live, a copy never shows them */
+    dst->cache = NULL;
+}
+
+/* Append the status to the URI, e.g. "qemu:///system (monitoring only)" */
+static void virt_mark_node_uri(virt_node_data *data, const char *fallback, const char *status)
+{
+    const char *uri = data->node_data[VIRT_NODE_DATA_TYPE_URI] ? data->node_data[VIRT_NODE_DATA_TYPE_URI] :
+                      fallback ? fallback : VIRT_DOMAIN_UNKNOWN_DATA;
+    size_t size = strlen(uri) + strlen(status) + 4;
+    char *marked = malloc(size);
+    snprintf(marked, size, "%s (%s)", uri, status);
+    free(data->node_data[VIRT_NODE_DATA_TYPE_URI]);
+    data->node_data[VIRT_NODE_DATA_TYPE_URI] = marked;
+}
+
+/* Describe the command connection, empty if there is nothing to say */
+static void virt_command_status(char *buf, size_t size)
+{
+    size_t pending = virt_command_pending();
+    if (!virt_command_available())
+        snprintf(buf, size, "monitoring only");
+    else if (pending)
+        snprintf(buf, size, "%zu command%s running", pending, pending > 1 ? "s" : "");
+    else
+        buf[0] = '\0';
+}
+
+/* Last node data with the connection state appended to the URI */
+static virt_node_data virt_get_offline_node_data(virt_data *virt)
+{
+    virt_node_data data;
+    virt_copy_node_data(&data, &virt->health->node);
+
+    char status[VIRT_HEALTH_STATUS_BUFFER_SIZE];
+    virt_health_status(virt, status);
+    virt_mark_node_uri(&data, virt->health->uri, status);
+
+    /* the panel prints every field */
+    for (int i = 0; i != VIRT_NODE_DATA_TYPE_SIZE; ++i)
+        if (!data.node_data[i])
+            data.node_data[i] = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+
+    return data;
+}
+
+void virt_init_node_cache(virt_node_cache *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+}
+
+void virt_deinit_node_cache(virt_node_cache *cache)
+{
+    free(cache->hostname);
+    free(cache->uri);
+    free(cache->cpu);
+    free(cache->params);
+    free(cache->cpu_cell);
+    free(cache->cell);
+    free(cache->cells_free);
+    free(cache->pages_free);
+}
+
+void virt_node_invalidate(virt_node_cache *cache)
+{
+    /* the pane stays as the user left it */
+    int numa = cache->numa;
+    virt_deinit_node_cache(cache);
+    virt_init_node_cache(cache);
+    cache->numa = numa;
+}
+
+/* Read an unsigned attribute of the element starting at tag, e.g. id='3' */
+static int virt_node_xml_attr(const char *tag, const char *end, const char *name, unsigned long long *value)
+{
+    const char *close = strchr(tag, '>');
+    size_t len = strlen(name);
+    for (const char *p = tag; p && close && p < close && p < end; ++p) {
+        if (strncmp(p, name, len) == 0 && p[len] == '=' && (p[len + 1] == '\'' || p[len + 1] == '"')) {
+            *value = strtoull(p + len + 2, NULL, 10);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Remember a page size, returns its index or -1 if there is no room left */
+static int virt_node_page_index(virt_node_cache *cache, unsigned int size)
+{
+    for (int i = 0; i != cache->page_size_count; ++i)
+        if (cache->page_size[i] == size)
+            return i;
+    if (cache->page_size_count == VIRT_NODE_PAGES_SIZE)
+        return -1;
+    cache->page_size[cache->page_size_count] = size;
+    return cache->page_size_count++;
+}
+
+/*
+ * Read the NUMA topology from the capabilities XML: the memory and the pages of
+ * every cell and the cell of every host CPU. The cells are sized by the first pass.
+ */
+static void virt_node_parse_topology(virt_node_cache *cache, const char *xml)
+{
+    const char *topology = strstr(xml, "<topology>");
+    const char *topology_end = topology ? strstr(topology, "</topology>") : NULL;
+    if (!topology_end)
+        return;
+
+    unsigned long long id = 0;
+    int cell_size = 0;
+    for (const char *p = strstr(topology, "<cell "); p && p < topology_end; p = strstr(p + 1, "<cell "))
+        if (virt_node_xml_attr(p, topology_end, "id", &id) && id < 64 && (int)id + 1 > cell_size)
+            cell_size = (int)id + 1;
+    if (!cell_size)
+        return;
+
+    cache->cell     = calloc(cell_size, sizeof(virt_node_cell));
+    cache->cpu_cell = malloc(cache->cpu_size * sizeof(int));
+    if (!cache->cell || !cache->cpu_cell)
+        return;
+    cache->cell_size = cell_size;
+    for (int i = 0; i != cache->cpu_size; ++i)
+        cache->cpu_cell[i] = -1;
+
+    for (const char *p = strstr(topology, "<cell "); p && p < topology_end; p = strstr(p + 1, "<cell ")) {
+        const char *cell_end = strstr(p, "</cell>");
+        if (!cell_end || !virt_node_xml_attr(p, topology_end, "id", &id) || id >= 64)
+            continue;
+
+        virt_node_cell *cell = cache->cell + id;
+        cell->present = 1;
+
+        const char *memory = strstr(p, "<memory ");
+        if (memory && memory < cell_end) {
+            memory = strchr(memory, '>');
+            cell->memory = memory ? strtoull(memory + 1, NULL, 10) : 0;
+        }
+
+        for (const char *pages = strstr(p, "<pages "); pages && pages < cell_end; pages = strstr(pages + 1, "<pages ")) {
+            unsigned long long size = 0;
+            const char *count = strchr(pages, '>');
+            int index = virt_node_xml_attr(pages, cell_end, "size", &size) ? virt_node_page_index(cache, size) : -1;
+            if (index >= 0 && count)
+                cell->pages[index] = strtoull(count + 1, NULL, 10);
+        }
+
+        unsigned long long cpu = 0;
+        for (const char *c = strstr(p, "<cpu "); c && c < cell_end; c = strstr(c + 1, "<cpu "))
+            if (virt_node_xml_attr(c, cell_end, "id", &cpu) && cpu < cache->cpu_size)
+                cache->cpu_cell[cpu] = (int)id;
+    }
+
+    /* the buffers are sized once and reused by every sample of the cells */
+    cache->cells_free = calloc(cache->cell_size, sizeof(unsigned long long));
+    if (cache->page_size_count)
+        cache->pages_free = calloc(cache->cell_size * cache->page_size_count, sizeof(unsigned long long));
+}
+
+/* Sample free memory and free pages of every cell */
+static void virt_node_sample_cells(virt_data *virt)
+{
+    virt_node_cache *cache = virt->node;
+    if (!cache->cells_free)
+        return;
+
+    unsigned long long trace = virt_trace_begin();
+    int cells = virNodeGetCellsFreeMemory(virt->conn, cache->cells_free, 0, cache->cell_size);
+    virt_trace_end(VIRT_TRACE_API_NODE_GET_CELLS_FREE_MEMORY, NULL, trace, cells < 0);
+    for (int i = 0; i < cells; ++i)
+        cache->cell[i].free = cache->cells_free[i];
+    cache->numa_sampled = cells > 0;
+
+    if (!cache->pages_free)
+        return;
+
+    trace = virt_trace_begin();
+    int res = virNodeGetFreePages(virt->conn, cache->page_size_count, cache->page_size, 0,
+                                  cache->cell_size, cache->pages_free, 0);
+    virt_trace_end(VIRT_TRACE_API_NODE_GET_FREE_PAGES, NULL, trace, res < 0);
+    for (int i = 0; i < res / cache->page_size_count && i < cache->cell_size; ++i)
+        memcpy(cache->cell[i].pages_free, cache->pages_free + i * cache->page_size_count,
+               cache->page_size_count * sizeof(unsigned long long));
+}
+
+/* Fetch what does not change while connected and size the CPU meters */
+static void virt_node_fetch_static(virt_data *virt)
+{
+    virt_node_cache *cache = virt->node;
+    unsigned long long trace = 0;
+    int res = 0;
+
+    trace = virt_trace_begin();
+    res = virNodeGetInfo(virt->conn, &cache->info);
+    virt_trace_end(VIRT_TRACE_API_NODE_GET_INFO, NULL, trace, res < 0);
+    if (res < 0)
+        return;
+
+    trace = virt_trace_begin();
+    res = virConnectGetLibVersion(virt->conn, &cache->lib_version);
+    virt_trace_end(VIRT_TRACE_API_CONNECT_GET_LIB_VERSION, NULL, trace, res < 0);
+
+    trace = virt_trace_begin();
+    cache->hostname = virConnectGetHostname(virt->conn);
+    virt_trace_end(VIRT_TRACE_API_CONNECT_GET_HOSTNAME, NULL, trace, !cache->hostname);
+
+    trace = virt_trace_begin();
+    cache->uri = virConnectGetURI(virt->conn);
+    virt_trace_end(VIRT_TRACE_API_CONNECT_GET_URI, NULL, trace, !cache->uri);
+
+    /* present CPUs, only the online ones are sampled */
+    unsigned char *cpumap = NULL;
+    trace = virt_trace_begin();
+    int present = virNodeGetCPUMap(virt->conn, &cpumap, NULL, 0);
+    virt_trace_end(VIRT_TRACE_API_NODE_GET_CPU_MAP, NULL, trace, present < 0);
+    if (present < 0)
+        present = cache->info.cpus;
+
+    cache->cpu      = calloc(present, sizeof(virt_node_cpu));
+    cache->cpu_size = cache->cpu ? present : 0;
+    for (int i = 0; i != cache->cpu_size; ++i)
+        cache->cpu[i].online = cpumap ? VIR_CPU_USED(cpumap, i) != 0 : 1;
+    free(cpumap);
+
+    /* the parameter buffer is sized once and reused by every sample */
+    int nparams = 0;
+    trace = virt_trace_begin();
+    res = virNodeGetCPUStats(virt->conn, VIR_NODE_CPU_STATS_ALL_CPUS, NULL, &nparams, 0);
+    virt_trace_end(VIRT_TRACE_API_NODE_GET_CPU_STATS, NULL, trace, res < 0);
+    if (res == 0 && nparams > 0) {
+        cache->params   = calloc(nparams, sizeof(virNodeCPUStats));
+        cache->nparams  = cache->params ? nparams : 0;
+    }
+
+    /* the NUMA topology, the cell of each CPU and the pages of each cell */
+    trace = virt_trace_begin();
+    char *capabilities = virConnectGetCapabilities(virt->conn);
+    virt_trace_end(VIRT_TRACE_API_CONNECT_GET_CAPABILITIES, NULL, trace, !capabilities);
+    if (capabilities)
+        virt_node_parse_topology(cache, capabilities);
+    free(capabilities);
+
+    cache->valid = 1;
+}
+
+/* Read the cumulative times of a CPU, returns TRUE (1) on success */
+static int virt_node_read_cpu(virt_data *virt, int cpu, virt_node_cpu *sample)
+{
+    virt_node_cache *cache = virt->node;
+    int nparams = cache->nparams;
+
+    unsigned long long trace = virt_trace_begin();
+    int res = virNodeGetCPUStats(virt->conn, cpu, cache->params, &nparams, 0);
+    virt_trace_end(VIRT_TRACE_API_NODE_GET_CPU_STATS, NULL, trace, res < 0);
+    if (res < 0)
+        return 0;
+
+    for (int i = 0; i != nparams; ++i) {
+        const virNodeCPUStats *param = cache->params + i;
+        if (strcmp(param->field, VIR_NODE_CPU_STATS_USER) == 0)
+            sample->user    = param->value;
+        else if (strcmp(param->field, VIR_NODE_CPU_STATS_KERNEL) == 0)
+            sample->kernel  = param->value;
+        else if (strcmp(param->field, VIR_NODE_CPU_STATS_IDLE) == 0)
+            sample->idle    = param->value;
+        else if (strcmp(param->field, VIR_NODE_CPU_STATS_IOWAIT) == 0)
+            sample->iowait  = param->value;
+    }
+    return 1;
+}
+
+/* Turn the times elapsed since the previous sample into shares of the interval */
+static void virt_node_update_cpu(virt_node_cpu *cpu, const virt_node_cpu *sample)
+{
+    /* counters start over when a CPU goes offline and back */
+    if (sample->user < cpu->user || sample->kernel < cpu->kernel ||
+        sample->idle < cpu->idle || sample->iowait < cpu->iowait)
+        cpu->samples = 0;
+
+    if (cpu->samples) {
+        unsigned long long user     = sample->user   - cpu->user;
+        unsigned long long kernel   = sample->kernel - cpu->kernel;
+        unsigned long long iowait   = sample->iowait - cpu->iowait;
+        unsigned long long total    = user + kernel + iowait + sample->idle - cpu->idle;
+        if (total) {
+            cpu->user_prc   = 100.0 * user   / total;
+            cpu->kernel_prc = 100.0 * kernel / total;
+            cpu->iowait_prc = 100.0 * iowait / total;
+        }
+    }
+
+    cpu->user   = sample->user;
+    cpu->kernel = sample->kernel;
+    cpu->idle   = sample->idle;
+    cpu->iowait = sample->iowait;
+    ++cpu->samples;
+}
+
+/* Sample every online CPU, the aggregate is the sum of their times */
+static void virt_node_sample_cpu(virt_data *virt)
+{
+    virt_node_cache *cache = virt->node;
+    if (!cache->params)
+        return;
+
+    virt_node_cpu total = { 0 };
+    int online = 0, failed = 0;
+    for (int i = 0; i != cache->cpu_size; ++i) {
+        virt_node_cpu *cpu = cache->cpu + i;
+        if (!cpu->online)
+            continue;
+
+        virt_node_cpu sample = { 0 };
+        if (!virt_node_read_cpu(virt, i, &sample)) {
+            cpu->samples = 0;
+            ++failed;
+            continue;
+        }
+        virt_node_update_cpu(cpu, &sample);
+
+        total.user      += sample.user;
+        total.kernel    += sample.kernel;
+        total.idle      += sample.idle;
+        total.iowait    += sample.iowait;
+        ++online;
+    }
+
+    /* a missing CPU would show up as a drop of the aggregate */
+    if (failed)
+        cache->total.samples = 0;
+    virt_node_update_cpu(&cache->total, &total);
+
+    if (cache->total.samples > 1)
+        snprintf(cache->summary, sizeof(cache->summary),
+                 "%.1f%% (user %.1f%%, kernel %.1f%%, iowait %.1f%%), %d/%d online",
+                 cache->total.user_prc + cache->total.kernel_prc, cache->total.user_prc,
+                 cache->total.kernel_prc, cache->total.iowait_prc, online, cache->cpu_size);
+    else
+        snprintf(cache->summary, sizeof(cache->summary), "measuring, %d/%d online",
+                 online, cache->cpu_size);
+}
+
+/* Copy of a cached string, the panel prints every field */
+static char *virt_node_copy_cached(const char *str)
+{
+    return copy_str(str ? str : VIRT_DOMAIN_UNKNOWN_DATA);
+}
+
+void virt_node_cpumap_str(const unsigned char *cpumap, int cpus, char *buf, size_t size)
+{
+    size_t len = 0;
+    buf[0] = '\0';
+    if (cpus > VIRT_NODE_CPUMAP_LEN * 8)
+        cpus = VIRT_NODE_CPUMAP_LEN * 8;
+
+    for (int cpu = 0; cpu < cpus && len < size; ++cpu) {
+        if (!VIR_CPU_USED(cpumap, cpu))
+            continue;
+        int last = cpu;
+        while (last + 1 < cpus && VIR_CPU_USED(cpumap, last + 1))
+            ++last;
+        if (last == cpu)
+            len += snprintf(buf + len, size - len, "%s%d", len ? "," : "", cpu);
+        else
+            len += snprintf(buf + len, size - len, "%s%d-%d", len ? "," : "", cpu, last);
+        cpu = last;
+    }
+}
+
+int virt_node_cpumap_parse(const char *list, int cpus, unsigned char *cpumap)
+{
+    memset(cpumap, 0, VIRT_NODE_CPUMAP_LEN);
+    if (cpus > VIRT_NODE_CPUMAP_LEN * 8)
+        cpus = VIRT_NODE_CPUMAP_LEN * 8;
+
+    int used = 0;
+    while (list && *list) {
+        char *end = NULL;
+        long first = strtol(list, &end, 10);
+        if (end == list || first < 0)
+            return VIRT_ERROR_FAILURE;
+        long last = first;
+        if (*end == '-') {
+            const char *from = end + 1;
+            last = strtol(from, &end, 10);
+            if (end == from || last < first)
+                return VIRT_ERROR_FAILURE;
+        }
+        if (*end != ',' && *end != '\0')
+            return VIRT_ERROR_FAILURE;
+        if (last >= cpus)
+            return VIRT_ERROR_FAILURE;
+
+        for (long cpu = first; cpu <= last; ++cpu)
+            VIR_USE_CPU(cpumap, cpu);
+        used = 1;
+        list = *end == ',' ? end + 1 : end;
+    }
+    return used ? VIRT_ERROR_SUCCESS : VIRT_ERROR_FAILURE;
+}
+
+unsigned long long virt_node_cpumap_cells(const virt_node_cache *cache, const unsigned char *cpumap)
+{
+    unsigned long long cells = 0;
+    if (!cache->cpu_cell)
+        return cells;
+
+    for (int cpu = 0; cpu != cache->cpu_size && cpu < VIRT_NODE_CPUMAP_LEN * 8; ++cpu)
+        if (VIR_CPU_USED(cpumap, cpu) && cache->cpu_cell[cpu] >= 0 && cache->cpu_cell[cpu] < 64)
+            cells |= 1ULL << cache->cpu_cell[cpu];
+    return cells;
+}
+
+void virt_node_cells_str(unsigned long long cells, char *buf, size_t size)
+{
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int cell = 0; cell < 64 && len < size; ++cell) {
+        if (!(cells & (1ULL << cell)))
+            continue;
+        int last = cell;
+        while (last < 63 && (cells & (1ULL << (last + 1))))
+            ++last;
+        if (last == cell)
+            len += snprintf(buf + len, size - len, "%s%d", len ? "," : "", cell);
+        else
+            len += snprintf(buf + len, size - len, "%s%d-%d", len ? "," : "", cell, last);
+        cell = last;
+    }
+}
+
 virt_node_data virt_get_node_data(virt_data *virt)
 {
+    if (!virt_health_connected(virt))
+        return virt_get_offline_node_data(virt);
+
+    virt_node_cache *cache = virt->node;
+    if (!cache->valid)
+        virt_node_fetch_static(virt);
+    virt_node_sample_cpu(virt);
+    if (cache->numa)
+        virt_node_sample_cells(virt);
+
     virt_node_data data;
     virt_init_node_data(&data);
 
     size_t type = 0;
-    unsigned long lib_version = 0;
-
-    virNodeInfoPtr info = malloc(sizeof(virNodeInfo));
-    virNodeGetInfo(virt->conn, info);
-
-    virConnectGetLibVersion(virt->conn, &lib_version);
 
     /* set up indices */
     data.node_type[type++]  = VIRT_NODE_DATA_TYPE_HOSTNAME;
@@ -65,17 +512,29 @@ virt_node_data virt_get_node_data(virt_data *virt)
     data.node_type[type++]  = VIRT_NODE_DATA_TYPE_TOTAL_MEMORY;
     data.node_type[type++]  = VIRT_NODE_DATA_TYPE_DOMAIN_MEMORY;
 
-    /* fetch the data */
-    unsigned long long memory       = info->memory/1024;
-    unsigned long long allocated    = memory - virNodeGetFreeMemory(virt->conn)/1024/1024;
+    /* fetch the data, only free memory changes between the refreshes */
+    unsigned long long trace = virt_trace_begin();
+    unsigned long long free_memory  = virNodeGetFreeMemory(virt->conn);
+    virt_trace_end(VIRT_TRACE_API_NODE_GET_FREE_MEMORY, NULL, trace, free_memory == 0);
+
+    unsigned long long memory       = cache->info.memory/1024;
+    unsigned long long allocated    = memory - free_memory/1024/1024;
 
-    data.node_data[VIRT_NODE_DATA_TYPE_HOSTNAME]       = virConnectGetHostname(virt->conn);
-    data.node_data[VIRT_NODE_DATA_TYPE_URI]            = virConnectGetURI(virt->conn);
-    data.node_data[VIRT_NODE_DATA_TYPE_LIB_VERSION]    = double_to_str(LIB_VERSION(lib_version));
+    data.node_data[VIRT_NODE_DATA_TYPE_HOSTNAME]       = virt_node_copy_cached(cache->hostname);
+    data.node_data[VIRT_NODE_DATA_TYPE_URI]            = virt_node_copy_cached(cache->uri);
+    data.node_data[VIRT_NODE_DATA_TYPE_LIB_VERSION]    = double_to_str(LIB_VERSION(cache->lib_version));
     data.node_data[VIRT_NODE_DATA_TYPE_TOTAL_MEMORY]   = ull_to_str(memory);
     data.node_data[VIRT_NODE_DATA_TYPE_DOMAIN_MEMORY]  = ull_to_str(allocated);
 
-    free(info);
+    /* keep a copy to show while disconnected */
+    virt_deinit_node_data(&virt->health->node);
+    virt_copy_node_data(&virt->health->node, &data);
+
+    char status[VIRT_HEALTH_STATUS_BUFFER_SIZE];
+    virt_command_status(status, sizeof(status));
+    if (status[0])
+        virt_mark_node_uri(&data, virt->health->uri, status);
 
+    data.cache = cache;
     return data;
 }
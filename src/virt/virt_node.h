@@ -23,6 +23,12 @@
 #include "virt.h"
 /** Number of possible node data types */
 #define VIRT_NODE_DATA_TYPE_SIZE (5)
+/** Bytes of a host CPU bitmap, enough for 1024 CPUs */
+#define VIRT_NODE_CPUMAP_LEN (128)
+/** Most page sizes tracked per NUMA cell */
+#define VIRT_NODE_PAGES_SIZE (4)
+/** Size of the buffer holding the aggregate CPU usage line */
+#define VIRT_NODE_CPU_SUMMARY_SIZE (128)
 
 /**
  * Indecies of the virt_node_data array.
@@ -39,12 +45,65 @@ typedef enum {
 /** @see virt_node_data_enum */
 typedef virt_node_data_enum node_type;
 
+/** Usage of a host CPU between its two last samples. */
+typedef struct {
+    int                 online;     /** CPU is online and its statistics can be read */
+    int                 samples;    /** Consecutive samples taken, shares are known from the second one */
+    unsigned long long  user;       /** Cumulative user time of the last sample in nanoseconds */
+    unsigned long long  kernel;     /** Cumulative kernel time of the last sample in nanoseconds */
+    unsigned long long  idle;       /** Cumulative idle time of the last sample in nanoseconds */
+    unsigned long long  iowait;     /** Cumulative iowait time of the last sample in nanoseconds */
+    double              user_prc;   /** User share of the last interval in % */
+    double              kernel_prc; /** Kernel share of the last interval in % */
+    double              iowait_prc; /** Iowait share of the last interval in % */
+} virt_node_cpu;
+
+/** Memory of a NUMA cell. */
+typedef struct {
+    int                 present;        /** Cell is listed in the host topology */
+    unsigned long long  memory;         /** Total memory in KiB */
+    unsigned long long  free;           /** Free memory of the last sample in bytes */
+    unsigned long long  pages[VIRT_NODE_PAGES_SIZE];        /** Total pages of each page size */
+    unsigned long long  pages_free[VIRT_NODE_PAGES_SIZE];   /** Free pages of the last sample */
+} virt_node_cell;
+
+/**
+ * Static node information, fetched once per connection, and the host CPU
+ * meters. Buffers are allocated with the static information and reused by
+ * every refresh.
+ */
+typedef struct virt_node_cache {
+    int                 valid;          /** Static fields were fetched for the current connection */
+    char                *hostname;      /** Hostname of the node */
+    char                *uri;           /** Canonical URI of the connection */
+    unsigned long       lib_version;    /** Version of libvirt on the node */
+    virNodeInfo         info;           /** Node hardware */
+    virt_node_cpu       *cpu;           /** Meter of each present host CPU */
+    int                 cpu_size;       /** Number of present host CPUs */
+    virt_node_cpu       total;          /** Meter of all online CPUs together */
+    virNodeCPUStatsPtr  params;         /** Parameters of virNodeGetCPUStats, nparams elements */
+    int                 nparams;        /** Number of parameters reported for a CPU */
+    char                summary[VIRT_NODE_CPU_SUMMARY_SIZE]; /** Aggregate usage, formatted in place */
+
+    int                 *cpu_cell;      /** NUMA cell of each present host CPU, -1 if unknown */
+    virt_node_cell      *cell;          /** NUMA cells indexed by their ID */
+    int                 cell_size;      /** Highest cell ID plus one */
+    unsigned int        page_size[VIRT_NODE_PAGES_SIZE];    /** Page sizes in KiB, in the order of the capabilities */
+    int                 page_size_count;                    /** Number of known page sizes */
+    unsigned long long  *cells_free;    /** Buffer of virNodeGetCellsFreeMemory, cell_size elements */
+    unsigned long long  *pages_free;    /** Buffer of virNodeGetFreePages, cell_size * page_size_count elements */
+    int                 numa;           /** Cells are sampled by every refresh, the NUMA pane is shown */
+    int                 numa_sampled;   /** Free memory of the cells is known */
+} virt_node_cache;
+
 /** Structure representing current node data. */
 typedef struct {
     /** Array containing node's data */
     char        *node_data[VIRT_NODE_DATA_TYPE_SIZE];
     /** Array containing current node data indecies */
     node_type   node_type[VIRT_NODE_DATA_TYPE_SIZE];
+    /** Host CPU meters, NULL while they are not sampled */
+    const virt_node_cache *cache;
 } virt_node_data;
 
 /**
@@ -68,6 +127,59 @@ void virt_deinit_node_data(void *vdata);
  */
 void virt_reset_node_data(void *vdata);
 
+/**
+ * Set node cache object to default state, nothing is fetched yet.
+ * @param cache - object to be initialized
+ */
+void virt_init_node_cache(virt_node_cache *cache);
+
+/**
+ * Release the node cache object.
+ * @param cache - object to be released
+ */
+void virt_deinit_node_cache(virt_node_cache *cache);
+
+/**
+ * Drop everything fetched for the previous connection, the next
+ * virt_get_node_data fetches the static fields again.
+ * @param cache - object to be invalidated
+ */
+void virt_node_invalidate(virt_node_cache *cache);
+
+/**
+ * Print the host CPUs of a cpumap as a list of ranges, e.g. "0-3,8".
+ * @param cpumap - map of VIRT_NODE_CPUMAP_LEN bytes, one bit per host CPU
+ * @param cpus   - number of host CPUs to look at
+ * @param buf    - filled with the list, empty if no CPU is set
+ * @param size   - size of buf
+ */
+void virt_node_cpumap_str(const unsigned char *cpumap, int cpus, char *buf, size_t size);
+
+/**
+ * Parse a list of host CPU ranges, e.g. "0-3,8", into a cpumap.
+ * @param list   - list to be parsed
+ * @param cpus   - number of host CPUs, CPUs beyond it are rejected
+ * @param cpumap - map of VIRT_NODE_CPUMAP_LEN bytes, filled with the CPUs of the list
+ * @return VIRT_ERROR_SUCCESS if at least one CPU was listed, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_node_cpumap_parse(const char *list, int cpus, unsigned char *cpumap);
+
+/**
+ * Find the NUMA cells of the host CPUs of a cpumap.
+ * @param cache  - node cache with the host topology
+ * @param cpumap - map of VIRT_NODE_CPUMAP_LEN bytes, one bit per host CPU
+ * @return mask of the cells, bit N for cell N, cells above 63 are left out
+ */
+unsigned long long virt_node_cpumap_cells(const virt_node_cache *cache, const unsigned char *cpumap);
+
+/**
+ * Print a mask of NUMA cells as a nodeset, e.g. "0-1,3".
+ * @param cells - mask of the cells, bit N for cell N
+ * @param buf   - filled with the nodeset, empty if no cell is set
+ * @param size  - size of buf
+ */
+void virt_node_cells_str(unsigned long long cells, char *buf, size_t size);
+
 /**
  * This function deinitializes the object and then sets it to default parameters.
  * @param vdata - data to be deinitialized and initialized again.
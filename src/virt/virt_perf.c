@@ -0,0 +1,125 @@
+/* This file contains the hardware perf events of the domains
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_perf.h"
+#include "virt_trace.h"
+#include "virt_command.h"
+#include "virt_domain.h"
+#include "utils.h"
+
+const char *virt_perf_event_name[VIRT_PERF_EVENT_SIZE] = {
+    VIR_PERF_PARAM_CACHE_MISSES,
+    VIR_PERF_PARAM_CPU_CYCLES,
+    VIR_PERF_PARAM_INSTRUCTIONS,
+    VIR_PERF_PARAM_CMT,
+    VIR_PERF_PARAM_MBMT,
+    VIR_PERF_PARAM_MBML
+};
+
+/*
+ * Set the events of one kind, the whole call fails if any of them is not supported.
+ * @param domain - domain to be changed
+ * @param begin  - first event
+ * @param end    - one past the last event
+ * @param enable - TRUE (1) to enable, FALSE (0) to disable
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+static int virt_perf_set_events(virDomainPtr domain, int begin, int end, int enable)
+{
+    virTypedParameterPtr params = NULL;
+    int nparams = 0, maxparams = 0;
+    for (int i = begin; i != end; ++i)
+        virTypedParamsAddBoolean(&params, &nparams, &maxparams, virt_perf_event_name[i], enable);
+
+    unsigned long long trace = virt_trace_begin();
+    int res = virDomainSetPerfEvents(domain, params, nparams, VIR_DOMAIN_AFFECT_LIVE);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_SET_PERF_EVENTS, domain, trace, res < 0);
+
+    virTypedParamsFree(params, nparams);
+    return res < 0 ? VIRT_ERROR_FAILURE : VIRT_ERROR_SUCCESS;
+}
+
+/* Set the perf events of a domain, run on the command connection */
+static int virt_perf_set_run(virDomainPtr domain, const void *arg)
+{
+    const int *enable = arg;
+
+    /* hosts without resource director technology reject cmt and mbm, the counters still work */
+    int core = virt_perf_set_events(domain, 0, VIRT_PERF_EVENT_RDT, *enable);
+    int rdt  = virt_perf_set_events(domain, VIRT_PERF_EVENT_RDT, VIRT_PERF_EVENT_SIZE, *enable);
+    return core == VIRT_ERROR_SUCCESS || rdt == VIRT_ERROR_SUCCESS ? VIRT_ERROR_SUCCESS : VIRT_ERROR_FAILURE;
+}
+
+int virt_perf_toggle(virt_data *virt, int index)
+{
+    virt_record_data *records = virt->records;
+    if (index < 0 || (size_t)index >= records->record_size || !virt_command_available())
+        return VIRT_ERROR_FAILURE;
+
+    virt_domain_record *record = records->record + index;
+    if (record->id < 0)
+        return VIRT_ERROR_FAILURE;
+
+    /* events enabled in the domain definition are turned off just the same */
+    int enable = !record->perf_enabled && !record->perf_events;
+    if (virt_command_submit_arg(record->uuid, virt_perf_set_run, &enable, sizeof(enable)) != VIRT_ERROR_SUCCESS)
+        return VIRT_ERROR_FAILURE;
+
+    record->perf_enabled = enable;
+    return VIRT_ERROR_SUCCESS;
+}
+
+/* Counter increase per second, -1 unless both samples reported the event */
+static double virt_perf_rate(const virt_domain_record *record, unsigned int prev_events,
+                             const unsigned long long *value, int event, unsigned long long elapsed_us)
+{
+    unsigned int bit = VIRT_PERF_EVENT_BIT(event);
+    if (!(prev_events & bit) || value[event] < record->perf_value[event])
+        return -1.0;
+    return virt_domain_rate(value[event], record->perf_value[event], elapsed_us);
+}
+
+void virt_perf_merge_stats(virt_domain_record *record, virTypedParameterPtr params,
+                           int nparams, unsigned long long now)
+{
+    unsigned int events = 0;
+    unsigned long long value[VIRT_PERF_EVENT_SIZE] = { 0 };
+    for (int i = 0; i != VIRT_PERF_EVENT_SIZE; ++i) {
+        char field[64];
+        snprintf(field, sizeof(field), "perf.%s", virt_perf_event_name[i]);
+        if (virTypedParamsGetULLong(params, nparams, field, value + i) == 1)
+            events |= VIRT_PERF_EVENT_BIT(i);
+    }
+
+    /* the events of a stopped domain are gone, they are asked for again after the next start */
+    if (record->id < 0)
+        record->perf_enabled = 0;
+
+    unsigned int prev = record->updated[VIRT_GROUP_PERF] ? record->perf_events & events : 0;
+    unsigned long long elapsed = now - record->updated[VIRT_GROUP_PERF];
+
+    double cycles       = virt_perf_rate(record, prev, value, VIRT_PERF_EVENT_CPU_CYCLES, elapsed);
+    double instructions = virt_perf_rate(record, prev, value, VIRT_PERF_EVENT_INSTRUCTIONS, elapsed);
+    record->perf_ipc        = cycles > 0.0 && instructions >= 0.0 ? instructions / cycles : -1.0;
+    record->perf_miss_rate  = virt_perf_rate(record, prev, value, VIRT_PERF_EVENT_CACHE_MISSES, elapsed);
+
+    memcpy(record->perf_value, value, sizeof(value));
+    record->perf_events = events;
+    record->updated[VIRT_GROUP_PERF] = now;
+}
@@ -0,0 +1,76 @@
+/* This file contains the hardware perf events of the domains
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_perf.h
+ * This file contains the hardware perf events of the domains. Events are
+ * enabled per domain with virDomainSetPerfEvents on the command connection
+ * and read with the perf group of the bulk statistics. Cycles, instructions
+ * and cache misses are counters, instructions per cycle and the miss rate
+ * are derived from consecutive samples. L3 occupancy and memory bandwidth
+ * come from resource director technology, hosts without it report only the
+ * counters and the other columns stay unknown.
+ */
+#ifndef VIRT_PERF_H
+#define VIRT_PERF_H
+#include "virt.h"
+#include "virt_record.h"
+
+/**
+ * Perf events collected per domain, indecies of virt_domain_record.perf_value.
+ * @see virt_perf_event_name
+ */
+typedef enum {
+    VIRT_PERF_EVENT_CACHE_MISSES,   /** Counter of last level cache misses */
+    VIRT_PERF_EVENT_CPU_CYCLES,     /** Counter of CPU cycles */
+    VIRT_PERF_EVENT_INSTRUCTIONS,   /** Counter of retired instructions */
+    VIRT_PERF_EVENT_CMT,            /** L3 cache occupancy in bytes */
+    VIRT_PERF_EVENT_MBMT,           /** Total memory bandwidth in bytes per second */
+    VIRT_PERF_EVENT_MBML            /** Local memory bandwidth in bytes per second */
+} virt_perf_event_enum;
+
+/** @see virt_perf_event_enum */
+typedef virt_perf_event_enum virt_perf_event;
+
+/** First event which needs resource director technology */
+#define VIRT_PERF_EVENT_RDT (VIRT_PERF_EVENT_CMT)
+
+/** Event names as accepted by virDomainSetPerfEvents, perf.<name> in the statistics */
+const char *virt_perf_event_name[VIRT_PERF_EVENT_SIZE];
+
+/**
+ * Enable the perf events of a running domain, or disable them if the
+ * domain already reports any.
+ * @param virt  - pointer with virt data
+ * @param index - domain row
+ * @return VIRT_ERROR_SUCCESS if queued, VIRT_ERROR_FAILURE if inactive or read-only
+ */
+int virt_perf_toggle(virt_data *virt, int index);
+
+/**
+ * Merge the perf group of the bulk statistics, events the domain does not
+ * report are left unknown.
+ * @param record  - domain record
+ * @param params  - typed parameters returned by libvirt
+ * @param nparams - number of parameters
+ * @param now     - monotonic time of the sample
+ */
+void virt_perf_merge_stats(virt_domain_record *record, virTypedParameterPtr params,
+                           int nparams, unsigned long long now);
+
+#endif /* VIRT_PERF_H */
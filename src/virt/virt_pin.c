@@ -0,0 +1,234 @@
+/* This file contains the vCPU, emulator and iothread pinning editor
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_pin.h"
+#include "virt_record.h"
+#include "virt_watchdog.h"
+#include "virt_command.h"
+#include "virt_trace.h"
+#include "utils.h"
+#include <stdio.h>
+
+/** Arguments of a queued pinning command */
+typedef struct {
+    virt_pin_target target;
+    unsigned int    id;
+    int             maplen;
+    unsigned char   cpumap[VIRT_NODE_CPUMAP_LEN];
+} virt_pin_command;
+
+/* Re-pin a single thread, run by the command thread */
+static int virt_pin_run(virDomainPtr domain, const void *arg)
+{
+    const virt_pin_command *cmd = arg;
+    /* the copy is writable, libvirt does not take const maps */
+    unsigned char cpumap[VIRT_NODE_CPUMAP_LEN];
+    memcpy(cpumap, cmd->cpumap, VIRT_NODE_CPUMAP_LEN);
+
+    int res = -1;
+    unsigned long long trace = virt_trace_begin();
+    switch (cmd->target) {
+        case VIRT_PIN_TARGET_VCPU:
+            res = virDomainPinVcpuFlags(domain, cmd->id, cpumap, cmd->maplen, VIR_DOMAIN_AFFECT_CURRENT);
+            virt_trace_end(VIRT_TRACE_API_DOMAIN_PIN_VCPU_FLAGS, domain, trace, res < 0);
+            break;
+        case VIRT_PIN_TARGET_EMULATOR:
+            res = virDomainPinEmulator(domain, cpumap, cmd->maplen, VIR_DOMAIN_AFFECT_CURRENT);
+            virt_trace_end(VIRT_TRACE_API_DOMAIN_PIN_EMULATOR, domain, trace, res < 0);
+            break;
+        case VIRT_PIN_TARGET_IOTHREAD:
+            res = virDomainPinIOThread(domain, cmd->id, cpumap, cmd->maplen, VIR_DOMAIN_AFFECT_CURRENT);
+            virt_trace_end(VIRT_TRACE_API_DOMAIN_PIN_IOTHREAD, domain, trace, res < 0);
+            break;
+    }
+    return res < 0 ? VIRT_ERROR_FAILURE : VIRT_ERROR_SUCCESS;
+}
+
+/* Append an entry with the current pinning */
+static void virt_pin_add(virt_pin_editor *editor, virt_pin_target target, unsigned int id,
+                         const unsigned char *cpumap, int maplen)
+{
+    virt_pin_entry *entry = editor->entry + editor->entry_size++;
+    entry->target = target;
+    entry->id     = id;
+    memcpy(entry->cpumap, cpumap, maplen < VIRT_NODE_CPUMAP_LEN ? maplen : VIRT_NODE_CPUMAP_LEN);
+    memcpy(entry->staged, entry->cpumap, VIRT_NODE_CPUMAP_LEN);
+}
+
+int virt_pin_open(virt_data *virt, int row, virt_pin_editor *editor)
+{
+    memset(editor, 0, sizeof(virt_pin_editor));
+    if (row < 0 || row >= virt->records->record_size)
+        return VIRT_ERROR_FAILURE;
+
+    virt_domain_record *record = virt->records->record + row;
+    unsigned long long now = time_monotonic_us();
+    if (!record->domain || !virt_record_responsive(record, now))
+        return VIRT_ERROR_FAILURE;
+
+    virt_watchdog_job *job = virt_watchdog_submit(record->domain, VIRT_WATCHDOG_CALL_PINNING);
+    if (!job)
+        return VIRT_ERROR_FAILURE;
+    virt_watchdog_wait(&job, 1, virt_watchdog_deadline());
+
+    switch (job->outcome) {
+        case VIRT_WATCHDOG_OUTCOME_DONE:
+            virt_record_responded(record);
+            break;
+        case VIRT_WATCHDOG_OUTCOME_DROPPED:
+            virt_watchdog_release(job);
+            return VIRT_ERROR_FAILURE;
+        case VIRT_WATCHDOG_OUTCOME_HUNG:
+            virt_record_hung(record, job, time_monotonic_us());
+            return VIRT_ERROR_FAILURE;
+    }
+    if (job->res < 0) {
+        virt_watchdog_release(job);
+        return VIRT_ERROR_FAILURE;
+    }
+
+    memcpy(editor->uuid, record->uuid, VIR_UUID_BUFLEN);
+    editor->name = copy_str(record->name);
+    editor->cpus = virt->node->cpu_size > 0 ? virt->node->cpu_size : (int)virt->node->info.cpus;
+    if (editor->cpus > VIRT_NODE_CPUMAP_LEN * 8)
+        editor->cpus = VIRT_NODE_CPUMAP_LEN * 8;
+
+    editor->entry = calloc(job->vcpu_size + 1 + job->iothread_size, sizeof(virt_pin_entry));
+    for (int i = 0; i != job->vcpu_size; ++i)
+        virt_pin_add(editor, VIRT_PIN_TARGET_VCPU, i, job->vcpu_pin + i * VIRT_NODE_CPUMAP_LEN,
+                     VIRT_NODE_CPUMAP_LEN);
+    virt_pin_add(editor, VIRT_PIN_TARGET_EMULATOR, 0, job->cpumap, VIRT_NODE_CPUMAP_LEN);
+    for (int i = 0; i != job->iothread_size; ++i)
+        virt_pin_add(editor, VIRT_PIN_TARGET_IOTHREAD, job->iothread[i]->iothread_id,
+                     job->iothread[i]->cpumap, job->iothread[i]->cpumaplen);
+
+    virt_watchdog_release(job);
+    return VIRT_ERROR_SUCCESS;
+}
+
+void virt_pin_close(virt_pin_editor *editor)
+{
+    free(editor->name);
+    free(editor->entry);
+    memset(editor, 0, sizeof(virt_pin_editor));
+}
+
+int virt_pin_stage(virt_pin_editor *editor, const virt_node_cache *cache, int index, const char *list)
+{
+    if (index < 0 || index >= editor->entry_size || !list)
+        return VIRT_ERROR_FAILURE;
+
+    unsigned char cpumap[VIRT_NODE_CPUMAP_LEN] = { 0 };
+    size_t prefix = strlen(VIRT_PIN_NODE_PREFIX);
+    if (strncmp(list, VIRT_PIN_NODE_PREFIX, prefix) == 0) {
+        /* every host CPU of the cell */
+        char *end = NULL;
+        long cell = strtol(list + prefix, &end, 10);
+        if (end == list + prefix || *end != '\0' || !cache->cpu_cell)
+            return VIRT_ERROR_FAILURE;
+
+        int used = 0;
+        for (int cpu = 0; cpu != editor->cpus && cpu < cache->cpu_size; ++cpu)
+            if (cache->cpu_cell[cpu] == cell) {
+                VIR_USE_CPU(cpumap, cpu);
+                used = 1;
+            }
+        if (!used)
+            return VIRT_ERROR_FAILURE;
+    } else if (virt_node_cpumap_parse(list, editor->cpus, cpumap) != VIRT_ERROR_SUCCESS) {
+        return VIRT_ERROR_FAILURE;
+    }
+
+    virt_pin_entry *entry = editor->entry + index;
+    memcpy(entry->staged, cpumap, VIRT_NODE_CPUMAP_LEN);
+    entry->changed = memcmp(entry->staged, entry->cpumap, VIRT_NODE_CPUMAP_LEN) != 0;
+    return VIRT_ERROR_SUCCESS;
+}
+
+void virt_pin_unstage(virt_pin_editor *editor, int index)
+{
+    if (index < 0 || index >= editor->entry_size)
+        return;
+
+    virt_pin_entry *entry = editor->entry + index;
+    memcpy(entry->staged, entry->cpumap, VIRT_NODE_CPUMAP_LEN);
+    entry->changed = 0;
+}
+
+/* Count the bits of a mask of cells */
+static int virt_pin_cell_count(unsigned long long cells)
+{
+    int count = 0;
+    for (; cells; cells &= cells - 1)
+        ++count;
+    return count;
+}
+
+void virt_pin_summarize(const virt_pin_editor *editor, const virt_node_cache *cache,
+                        int staged, virt_pin_summary *summary)
+{
+    memset(summary, 0, sizeof(virt_pin_summary));
+
+    for (int i = 0; i != editor->entry_size; ++i) {
+        const virt_pin_entry *entry = editor->entry + i;
+        if (entry->target != VIRT_PIN_TARGET_VCPU)
+            continue;
+        unsigned long long cells = virt_node_cpumap_cells(cache, staged ? entry->staged : entry->cpumap);
+        if (virt_pin_cell_count(cells) > 1)
+            ++summary->cross_vcpu;
+        summary->vcpu_cells |= cells;
+    }
+
+    /* the emulator and iothreads touch guest memory on behalf of the vCPUs */
+    for (int i = 0; i != editor->entry_size; ++i) {
+        const virt_pin_entry *entry = editor->entry + i;
+        if (entry->target == VIRT_PIN_TARGET_VCPU)
+            continue;
+        unsigned long long cells = virt_node_cpumap_cells(cache, staged ? entry->staged : entry->cpumap);
+        if (cells & ~summary->vcpu_cells)
+            ++summary->remote_threads;
+    }
+}
+
+int virt_pin_apply(virt_pin_editor *editor)
+{
+    if (!virt_command_available())
+        return VIRT_ERROR_FAILURE;
+
+    int queued = 0;
+    for (int i = 0; i != editor->entry_size; ++i) {
+        virt_pin_entry *entry = editor->entry + i;
+        if (!entry->changed)
+            continue;
+
+        virt_pin_command cmd = {
+            .target = entry->target,
+            .id     = entry->id,
+            .maplen = VIR_CPU_MAPLEN(editor->cpus)
+        };
+        memcpy(cmd.cpumap, entry->staged, VIRT_NODE_CPUMAP_LEN);
+        if (virt_command_submit_arg(editor->uuid, virt_pin_run, &cmd, sizeof(cmd)) != VIRT_ERROR_SUCCESS)
+            continue;
+
+        memcpy(entry->cpumap, entry->staged, VIRT_NODE_CPUMAP_LEN);
+        entry->changed = 0;
+        ++queued;
+    }
+    return queued;
+}
@@ -0,0 +1,118 @@
+/* This file contains the vCPU, emulator and iothread pinning editor
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_pin.h
+ * This file contains the pinning editor of a single domain. The current
+ * pinning of the vCPUs, the emulator thread and the iothreads is read once
+ * when the editor opens, edits are staged and compared against it, and only
+ * the changed threads are re-pinned, over the read-write connection.
+ */
+#ifndef VIRT_PIN_H
+#define VIRT_PIN_H
+#include "virt.h"
+#include "virt_node.h"
+/** Prefix selecting all host CPUs of a NUMA cell, e.g. "node1" */
+#define VIRT_PIN_NODE_PREFIX ("node")
+
+/** Threads of a domain which can be pinned */
+typedef enum {
+    VIRT_PIN_TARGET_VCPU,       /** virDomainPinVcpuFlags */
+    VIRT_PIN_TARGET_EMULATOR,   /** virDomainPinEmulator */
+    VIRT_PIN_TARGET_IOTHREAD    /** virDomainPinIOThread */
+} virt_pin_target_enum;
+
+/** @see virt_pin_target_enum */
+typedef virt_pin_target_enum virt_pin_target;
+
+/** Pinning of a single thread. */
+typedef struct {
+    virt_pin_target target;
+    unsigned int    id;                             /** vCPU number or iothread ID */
+    unsigned char   cpumap[VIRT_NODE_CPUMAP_LEN];   /** Pinning read when the editor opened or last applied */
+    unsigned char   staged[VIRT_NODE_CPUMAP_LEN];   /** Pinning after the edits */
+    int             changed;                        /** Staged pinning differs from cpumap */
+} virt_pin_entry;
+
+/** Pinning of a domain being edited. */
+typedef struct {
+    unsigned char   uuid[VIR_UUID_BUFLEN];          /** Domain, looked up again when applying */
+    char            *name;
+    int             cpus;                           /** Number of host CPUs */
+    virt_pin_entry  *entry;                         /** vCPUs first, then the emulator and the iothreads */
+    int             entry_size;
+} virt_pin_editor;
+
+/** Placement of the threads of a domain relevant to memory latency. */
+typedef struct {
+    int                 cross_vcpu;     /** vCPUs allowed on host CPUs of more than one cell */
+    unsigned long long  vcpu_cells;     /** Cells the vCPUs may run on */
+    int                 remote_threads; /** Emulator and iothreads allowed outside of vcpu_cells */
+} virt_pin_summary;
+
+/**
+ * Read the pinning of the domain, the call runs under the watchdog deadline.
+ * @param virt   - virt data with the records and the host topology
+ * @param row    - row of the record of the domain
+ * @param editor - filled with the pinning, released with virt_pin_close
+ * @return VIRT_ERROR_SUCCESS if the pinning was read, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_pin_open(virt_data *virt, int row, virt_pin_editor *editor);
+
+/**
+ * Release the editor.
+ * @param editor - editor filled by virt_pin_open
+ */
+void virt_pin_close(virt_pin_editor *editor);
+
+/**
+ * Stage a new pinning of an entry.
+ * @param editor - editor of the domain
+ * @param cache  - node cache with the host topology
+ * @param index  - entry to be edited
+ * @param list   - host CPUs, e.g. "0-3,8", or VIRT_PIN_NODE_PREFIX and a cell for all its CPUs
+ * @return VIRT_ERROR_SUCCESS if staged, VIRT_ERROR_FAILURE if the list selects no host CPU
+ */
+int virt_pin_stage(virt_pin_editor *editor, const virt_node_cache *cache, int index, const char *list);
+
+/**
+ * Drop the staged pinning of an entry.
+ * @param editor - editor of the domain
+ * @param index  - entry to be restored
+ */
+void virt_pin_unstage(virt_pin_editor *editor, int index);
+
+/**
+ * Summarize the placement of the domain.
+ * @param editor  - editor of the domain
+ * @param cache   - node cache with the host topology
+ * @param staged  - TRUE (1) for the staged pinning, FALSE (0) for the current one
+ * @param summary - filled with the summary
+ */
+void virt_pin_summarize(const virt_pin_editor *editor, const virt_node_cache *cache,
+                        int staged, virt_pin_summary *summary);
+
+/**
+ * Queue the staged pinning of the changed entries on the read-write connection.
+ * Applied entries become the current pinning, failures are reported as libvirt errors.
+ * @param editor - editor of the domain
+ * @return number of queued commands, VIRT_ERROR_FAILURE in monitoring only sessions
+ */
+int virt_pin_apply(virt_pin_editor *editor);
+
+#endif /* VIRT_PIN_H */
@@ -0,0 +1,117 @@
+/* This file contains the fetch planner deciding what the virt layer collects
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_plan.h"
+
+unsigned int virt_plan_type_groups[VIRT_DOMAIN_DATA_TYPE_SIZE] = {
+    0,                                      /* ID comes with the listing */
+    VIRT_GROUP_BIT(VIRT_GROUP_STATIC),      /* NAME */
+    VIRT_GROUP_BIT(VIRT_GROUP_STATE),       /* STATE */
+    VIRT_GROUP_BIT(VIRT_GROUP_STATIC),      /* AUTOSTART */
+    VIRT_GROUP_BIT(VIRT_GROUP_MEMORY),      /* MEMORY_PRC */
+    VIRT_GROUP_BIT(VIRT_GROUP_CPU),         /* CPU_PRC */
+    VIRT_GROUP_BIT(VIRT_GROUP_IO),          /* BLOCK_RD */
+    VIRT_GROUP_BIT(VIRT_GROUP_IO),          /* BLOCK_WR */
+    VIRT_GROUP_BIT(VIRT_GROUP_IO),          /* NET_RX */
+    VIRT_GROUP_BIT(VIRT_GROUP_IO),          /* NET_TX */
+    VIRT_GROUP_BIT(VIRT_GROUP_NUMA),        /* NUMA */
+    VIRT_GROUP_BIT(VIRT_GROUP_AGENT),       /* GUEST_OS */
+    VIRT_GROUP_BIT(VIRT_GROUP_STATE),       /* REASON */
+    VIRT_GROUP_BIT(VIRT_GROUP_MEMORY),      /* SWAP_IN */
+    VIRT_GROUP_BIT(VIRT_GROUP_MEMORY),      /* SWAP_OUT */
+    VIRT_GROUP_BIT(VIRT_GROUP_MEMORY),      /* MAJOR_FAULT */
+    VIRT_GROUP_BIT(VIRT_GROUP_MEMORY),      /* MINOR_FAULT */
+    VIRT_GROUP_BIT(VIRT_GROUP_MEMORY),      /* MEMORY_UNUSED */
+    VIRT_GROUP_BIT(VIRT_GROUP_MEMORY),      /* MEMORY_AVAILABLE */
+    VIRT_GROUP_BIT(VIRT_GROUP_MEMORY),      /* MEMORY_USABLE */
+    VIRT_GROUP_BIT(VIRT_GROUP_MEMORY),      /* MEMORY_AGE */
+    0,                                      /* DIRTY_RATE is measured on demand */
+    VIRT_GROUP_BIT(VIRT_GROUP_MEMORY),      /* MIGRATE_TIME */
+    VIRT_GROUP_BIT(VIRT_GROUP_PERF),        /* PERF_IPC */
+    VIRT_GROUP_BIT(VIRT_GROUP_PERF),        /* PERF_MISS_RATE */
+    VIRT_GROUP_BIT(VIRT_GROUP_PERF),        /* PERF_CACHE */
+    VIRT_GROUP_BIT(VIRT_GROUP_PERF),        /* PERF_BANDWIDTH */
+    VIRT_GROUP_BIT(VIRT_GROUP_PERF)         /* PERF_LOCAL */
+};
+
+void virt_init_plan(virt_plan_data *plan)
+{
+    plan->groups    = VIRT_GROUP_ALL;
+    plan->row_begin = 0;
+    plan->row_end   = 0;
+    plan->viewport  = 0;
+}
+
+void virt_plan_clear_columns(virt_plan_data *plan)
+{
+    plan->groups = VIRT_PLAN_REQUIRED_GROUPS;
+}
+
+void virt_plan_add_column(virt_plan_data *plan, domain_type type)
+{
+    if (type >= 0 && type < VIRT_DOMAIN_DATA_TYPE_SIZE)
+        plan->groups |= virt_plan_type_groups[type];
+}
+
+void virt_plan_add_groups(virt_plan_data *plan, unsigned int groups)
+{
+    plan->groups |= groups & VIRT_GROUP_ALL;
+}
+
+void virt_plan_set_viewport(virt_plan_data *plan, size_t top, size_t rows)
+{
+    plan->row_begin = top > VIRT_PLAN_PREFETCH_ROWS ? top - VIRT_PLAN_PREFETCH_ROWS : 0;
+    plan->row_end   = top + rows + VIRT_PLAN_PREFETCH_ROWS;
+    plan->viewport  = 1;
+}
+
+int virt_plan_in_window(const virt_plan_data *plan, size_t row)
+{
+    return !plan->viewport || (row >= plan->row_begin && row < plan->row_end);
+}
+
+int virt_plan_needs(const virt_plan_data *plan, const virt_record_data *records,
+                    size_t row, virt_group group, unsigned int due)
+{
+    if (!(plan->groups & VIRT_GROUP_BIT(group)))
+        return 0;
+
+    const virt_domain_record *record = records->record + row;
+
+    /* rows scrolled into the window catch up on what they missed */
+    if (virt_plan_in_window(plan, row))
+        return virt_record_needs(record, group, due) || virt_plan_stale(records, row, group);
+
+    /* the state of every row stays current, it costs nothing extra in the bulk call */
+    if (VIRT_PLAN_REQUIRED_GROUPS & VIRT_GROUP_BIT(group))
+        return virt_record_needs(record, group, due);
+
+    if (VIRT_PLAN_PER_DOMAIN_GROUPS & VIRT_GROUP_BIT(group))
+        return 0;
+
+    return (due & VIRT_GROUP_BIT(group)) &&
+           (record->updated[group] == 0 ||
+            records->fetched[group] - record->updated[group] >= VIRT_PLAN_OFFSCREEN_PERIOD * 1000000.0);
+}
+
+int virt_plan_stale(const virt_record_data *records, size_t row, virt_group group)
+{
+    unsigned long long updated = records->record[row].updated[group];
+    return updated != 0 && updated < records->fetched[group];
+}
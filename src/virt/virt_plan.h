@@ -0,0 +1,123 @@
+/* This file contains the fetch planner deciding what the virt layer collects
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_plan.h
+ * This file contains the fetch planner. The planner is filled from what the
+ * screen shows: the visible columns select the metric groups and the rows of
+ * the viewport, plus a prefetch margin, select the domains for which per-domain
+ * calls are made. Rows outside of the window keep coarser data, refreshed
+ * less often and only through the bulk statistics call.
+ */
+#ifndef VIRT_PLAN_H
+#define VIRT_PLAN_H
+#include "virt.h"
+#include "virt_domain.h"
+#include "virt_record.h"
+/** Rows above and below the viewport fetched as if they were visible */
+#define VIRT_PLAN_PREFETCH_ROWS (10)
+/** Refresh period in seconds of bulk groups of the rows outside of the window */
+#define VIRT_PLAN_OFFSCREEN_PERIOD (10.0)
+/** Groups fetched with a per-domain call, only ever fetched inside the window */
+#define VIRT_PLAN_PER_DOMAIN_GROUPS (VIRT_GROUP_BIT(VIRT_GROUP_STATIC) | \
+                                     VIRT_GROUP_BIT(VIRT_GROUP_MEMORY) | \
+                                     VIRT_GROUP_BIT(VIRT_GROUP_AGENT) | \
+                                     VIRT_GROUP_BIT(VIRT_GROUP_NUMA) | \
+                                     VIRT_GROUP_BIT(VIRT_GROUP_PLACEMENT))
+/** Groups fetched regardless of visible columns, the state drives commands and agent calls */
+#define VIRT_PLAN_REQUIRED_GROUPS (VIRT_GROUP_BIT(VIRT_GROUP_STATE))
+
+/** Metric groups each domain data type is rendered from */
+unsigned int virt_plan_type_groups[VIRT_DOMAIN_DATA_TYPE_SIZE];
+
+/** What the next refresh has to collect. */
+typedef struct virt_plan_data {
+    unsigned int    groups;         /** Mask of groups needed by the visible columns */
+    size_t          row_begin;      /** First row of the window, viewport plus margin */
+    size_t          row_end;        /** One past the last row of the window */
+    int             viewport;       /** FALSE (0) until the viewport is known, all rows are in the window */
+} virt_plan_data;
+
+/**
+ * Set plan to default state, all groups of all rows are collected.
+ * @param plan - plan to be initialized
+ */
+void virt_init_plan(virt_plan_data *plan);
+
+/**
+ * Forget visible columns, only VIRT_PLAN_REQUIRED_GROUPS stay planned.
+ * @param plan - plan to be changed
+ */
+void virt_plan_clear_columns(virt_plan_data *plan);
+
+/**
+ * Plan groups needed to render a visible column.
+ * @param plan - plan to be changed
+ * @param type - domain data type shown by the column
+ */
+void virt_plan_add_column(virt_plan_data *plan, domain_type type);
+
+/**
+ * Plan groups needed by columns which are not domain columns, e.g. vCPU columns.
+ * @param plan   - plan to be changed
+ * @param groups - mask of VIRT_GROUP_BIT values
+ */
+void virt_plan_add_groups(virt_plan_data *plan, unsigned int groups);
+
+/**
+ * Set rows shown on the screen, the window extends them by VIRT_PLAN_PREFETCH_ROWS.
+ * @param plan - plan to be changed
+ * @param top  - first visible row
+ * @param rows - number of visible rows
+ */
+void virt_plan_set_viewport(virt_plan_data *plan, size_t top, size_t rows);
+
+/**
+ * Check whether the row is inside of the window.
+ * @param plan - fetch plan
+ * @param row  - row of the domain record
+ * @return TRUE (1) if inside, FALSE (0) otherwise
+ */
+int virt_plan_in_window(const virt_plan_data *plan, size_t row);
+
+/**
+ * Check whether the group of the record should be fetched by this refresh.
+ * Groups of hidden columns are never fetched. Inside of the window a group is
+ * fetched when due or stale, outside of it only bulk groups are fetched,
+ * at most every VIRT_PLAN_OFFSCREEN_PERIOD seconds.
+ * @param plan    - fetch plan
+ * @param records - domain records
+ * @param row     - row of the domain record
+ * @param group   - metric group
+ * @param due     - mask of due metric groups
+ * @return TRUE (1) if the group should be fetched, FALSE (0) otherwise
+ */
+int virt_plan_needs(const virt_plan_data *plan, const virt_record_data *records,
+                    size_t row, virt_group group, unsigned int due);
+
+/**
+ * Check whether the group of the record missed its last refresh,
+ * the displayed value then carries VIRT_DOMAIN_STALE_MARK.
+ * @param records - domain records
+ * @param row     - row of the domain record
+ * @param group   - metric group
+ * @return TRUE (1) if stale, FALSE (0) otherwise
+ */
+int virt_plan_stale(const virt_record_data *records, size_t row, virt_group group);
+
+#endif /* VIRT_PLAN_H */
@@ -0,0 +1,220 @@
+/* This file contains the persistent per-domain records and their refresh tiers
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_record.h"
+#include "virt_watchdog.h"
+#include "virt_local.h"
+#include "utils.h"
+#include "scheduler.h"
+
+const char *virt_group_name[VIRT_GROUP_SIZE] = {
+    "static",
+    "state",
+    "memory",
+    "cpu",
+    "io",
+    "agent",
+    "numa",
+    "vcpu",
+    "placement",
+    "perf"
+};
+
+double virt_group_period[VIRT_GROUP_SIZE] = {
+    30.0,   /* names and autostart hardly ever change */
+    1.0,    /* state changes occasionally */
+    5.0,    /* guests update balloon statistics every few seconds */
+    0.0,
+    0.0,
+    60.0,   /* guest agent round trips are expensive */
+    30.0,   /* placement changes only on numatune or vcpupin */
+    0.0,
+    2.0,    /* the scheduler moves vCPUs all the time, one call per domain though */
+    0.0
+};
+
+void virt_init_records(virt_record_data *data)
+{
+    data->record        = NULL;
+    data->record_size   = 0;
+
+    for (int i = 0; i != VIRT_GROUP_SIZE; ++i)
+        data->fetched[i] = 0;
+}
+
+static void virt_deinit_record(virt_domain_record *record)
+{
+    if (record->domain)
+        virDomainFree(record->domain);
+    free(record->name);
+    free(record->guest_os);
+    free(record->numa_nodeset);
+    free(record->vcpu);
+    virt_watchdog_release(record->stuck);
+    virt_local_release(record->local);
+}
+
+void virt_deinit_records(virt_record_data *data)
+{
+    for (size_t i = 0; i != data->record_size; ++i)
+        virt_deinit_record(data->record + i);
+    free(data->record);
+}
+
+static int virt_record_compare(const void *lhs, const void *rhs)
+{
+    return memcmp(((const virt_domain_record *)lhs)->uuid,
+                  ((const virt_domain_record *)rhs)->uuid, VIR_UUID_BUFLEN);
+}
+
+static int virt_record_compare_key(const void *key, const void *record)
+{
+    return memcmp(key, ((const virt_domain_record *)record)->uuid, VIR_UUID_BUFLEN);
+}
+
+void virt_sync_records(virt_record_data *data, virDomainPtr *domain, size_t size)
+{
+    /* index previous records by UUID */
+    qsort(data->record, data->record_size, sizeof(virt_domain_record), virt_record_compare);
+    char *moved = calloc(data->record_size + 1, sizeof(char));
+
+    virt_domain_record *record = calloc(size + 1, sizeof(virt_domain_record));
+
+    for (size_t i = 0; i != size; ++i) {
+        unsigned char uuid[VIR_UUID_BUFLEN];
+        virDomainGetUUID(domain[i], uuid);
+
+        virt_domain_record *old = bsearch(uuid, data->record, data->record_size,
+                                          sizeof(virt_domain_record), virt_record_compare_key);
+        if (old && !moved[old - data->record]) {
+            record[i] = *old;
+            moved[old - data->record] = 1;
+            virDomainFree(record[i].domain);
+        } else {
+            memcpy(record[i].uuid, uuid, VIR_UUID_BUFLEN);
+            record[i].state = VIR_DOMAIN_NOSTATE;
+        }
+
+        /* the handle of the listing carries the current ID, reading it is free */
+        virDomainRef(domain[i]);
+        record[i].domain    = domain[i];
+        record[i].id        = (int)virDomainGetID(domain[i]);
+    }
+
+    /* free records of domains which are gone */
+    for (size_t i = 0; i != data->record_size; ++i)
+        if (!moved[i])
+            virt_deinit_record(data->record + i);
+
+    free(moved);
+    free(data->record);
+    data->record        = record;
+    data->record_size   = size;
+}
+
+unsigned int virt_records_due(virt_record_data *data, unsigned long long now)
+{
+    unsigned int due = 0;
+    for (int i = 0; i != VIRT_GROUP_SIZE; ++i) {
+        unsigned long long period = (unsigned long long)(virt_group_period[i] * 1000000.0 *
+                                                         (1.0 - VIRT_GROUP_PERIOD_SLACK));
+        if (data->fetched[i] == 0 || now - data->fetched[i] >= period) {
+            due |= VIRT_GROUP_BIT(i);
+            data->fetched[i] = now;
+        }
+    }
+    return due;
+}
+
+int virt_record_needs(const virt_domain_record *record, virt_group group, unsigned int due)
+{
+    return (due & VIRT_GROUP_BIT(group)) || record->updated[group] == 0;
+}
+
+int virt_record_responsive(virt_domain_record *record, unsigned long long now)
+{
+    if (record->stuck && virt_watchdog_finished(record->stuck)) {
+        virt_watchdog_release(record->stuck);
+        record->stuck = NULL;
+    }
+
+    /* never pile up calls on a domain which did not answer the last one */
+    return !record->hung_since || (!record->stuck && now >= record->retry_at);
+}
+
+void virt_record_hung(virt_domain_record *record, virt_watchdog_job *job, unsigned long long now)
+{
+    if (!record->hung_since) {
+        record->hung_since  = now;
+        record->retry_delay = VIRT_RECORD_RETRY_MIN;
+    } else if (record->retry_delay * 2.0 < VIRT_RECORD_RETRY_MAX)
+        record->retry_delay *= 2.0;
+    else
+        record->retry_delay = VIRT_RECORD_RETRY_MAX;
+    record->retry_at = now + (unsigned long long)(record->retry_delay * 1000000.0);
+
+    virt_watchdog_release(record->stuck);
+    record->stuck = job;
+}
+
+void virt_record_responded(virt_domain_record *record)
+{
+    record->hung_since  = 0;
+    record->retry_at    = 0;
+    record->retry_delay = 0;
+}
+
+int virt_parse_group_periods(const char *str)
+{
+    if (!str)
+        return VIRT_ERROR_FAILURE;
+
+    char *copy = copy_str(str);
+    char *save = NULL;
+    int res = VIRT_ERROR_SUCCESS;
+
+    for (char *pair = strtok_r(copy, VIRT_GROUP_PERIOD_SEPARATOR, &save);
+         pair && res == VIRT_ERROR_SUCCESS;
+         pair = strtok_r(NULL, VIRT_GROUP_PERIOD_SEPARATOR, &save)) {
+        char *value = strchr(pair, '=');
+        if (!value) {
+            res = VIRT_ERROR_FAILURE;
+            break;
+        }
+        *value++ = '\0';
+
+        char *end = NULL;
+        double period = strtod(value, &end);
+        /* periods end up in integer microseconds, which must not overflow */
+        if (end == value || *end != '\0' || !(period >= 0.0 && period <= SCHEDULER_MAX_INTERVAL)) {
+            res = VIRT_ERROR_FAILURE;
+            break;
+        }
+
+        res = VIRT_ERROR_FAILURE;
+        for (int i = 0; i != VIRT_GROUP_SIZE; ++i)
+            if (strcmp(pair, virt_group_name[i]) == 0) {
+                virt_group_period[i] = period;
+                res = VIRT_ERROR_SUCCESS;
+            }
+    }
+
+    free(copy);
+    return res;
+}
@@ -0,0 +1,249 @@
+/* This file contains the persistent per-domain records and their refresh tiers
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_record.h
+ * This file contains the persistent per-domain records and their refresh tiers.
+ * Domain metrics are split into groups, each refreshed with its own period.
+ * A refresh fetches only the groups that are due and merges them into the
+ * record of each domain, the rest of the record keeps its last known values.
+ */
+#ifndef VIRT_RECORD_H
+#define VIRT_RECORD_H
+#include "virt.h"
+#include "virt_node.h"
+/** Number of metric groups */
+#define VIRT_GROUP_SIZE (10)
+/** Fraction of the period by which a group may be refreshed early, absorbs tick jitter */
+#define VIRT_GROUP_PERIOD_SLACK (0.1)
+/** Separator of group=period pairs in the --period argument */
+#define VIRT_GROUP_PERIOD_SEPARATOR (",")
+/** First retry delay of a domain which stopped answering, in seconds */
+#define VIRT_RECORD_RETRY_MIN (5.0)
+/** Longest retry delay of a domain which stopped answering, in seconds */
+#define VIRT_RECORD_RETRY_MAX (60.0)
+
+/** Forward declaration of virt_watchdog_job */
+typedef struct virt_watchdog_job virt_watchdog_job;
+
+/** Forward declaration of virt_local_entry */
+typedef struct virt_local_entry virt_local_entry;
+
+/**
+ * Metric groups with independent refresh periods.
+ * @see virt_group_period
+ */
+typedef enum {
+    VIRT_GROUP_STATIC,      /** Name and autostart */
+    VIRT_GROUP_STATE,       /** State and its reason */
+    VIRT_GROUP_MEMORY,      /** Balloon memory statistics */
+    VIRT_GROUP_CPU,         /** CPU time */
+    VIRT_GROUP_IO,          /** Block and interface counters */
+    VIRT_GROUP_AGENT,       /** Data reported by the guest agent */
+    VIRT_GROUP_NUMA,        /** Memory nodes and vCPU pinning */
+    VIRT_GROUP_VCPU,        /** Time, wait and halted state of every vCPU */
+    VIRT_GROUP_PLACEMENT,   /** Host CPU and pinning of every vCPU */
+    VIRT_GROUP_PERF         /** Hardware perf event counters */
+} virt_group_enum;
+
+/** @see virt_group_enum */
+typedef virt_group_enum virt_group;
+
+/** Bit of the group in a group mask */
+#define VIRT_GROUP_BIT(group) (1u << (group))
+/** Bit of a virDomainMemoryStatTags value in virt_domain_record.memory_tags */
+#define VIRT_MEMORY_TAG_BIT(tag) (1u << (tag))
+/** Number of perf events collected per domain */
+#define VIRT_PERF_EVENT_SIZE (6)
+/** Bit of a virt_perf_event value in virt_domain_record.perf_events */
+#define VIRT_PERF_EVENT_BIT(event) (1u << (event))
+/** Mask with all the groups set */
+#define VIRT_GROUP_ALL ((1u << VIRT_GROUP_SIZE) - 1)
+
+/** Names of the groups as accepted by the --period argument */
+const char *virt_group_name[VIRT_GROUP_SIZE];
+
+/** Refresh period of each group in seconds, 0 refreshes the group on every tick */
+double virt_group_period[VIRT_GROUP_SIZE];
+
+/** Last sample of a single vCPU, part of the domain record. */
+typedef struct {
+    int                 state;                      /** VIRT_GROUP_VCPU, VIR_VCPU_* state */
+    int                 halted;                     /** VIRT_GROUP_VCPU, halted in the guest, -1 if not reported */
+    unsigned long long  time;                       /** VIRT_GROUP_VCPU, CPU time in nanoseconds */
+    unsigned long long  wait;                       /** VIRT_GROUP_VCPU, nanoseconds spent waiting for a host CPU */
+    double              time_prc;                   /** VIRT_GROUP_VCPU, CPU time since the last sample */
+    double              wait_prc;                   /** VIRT_GROUP_VCPU, wait time since the last sample, -1 if not reported */
+    int                 cpu;                        /** VIRT_GROUP_PLACEMENT, host CPU the vCPU ran on last, -1 if unknown */
+    unsigned char       pin[VIRT_NODE_CPUMAP_LEN];  /** VIRT_GROUP_PLACEMENT, host CPUs the vCPU may run on */
+} virt_vcpu_record;
+
+/** Persistent record of a single domain, kept across refreshes. */
+typedef struct {
+    virDomainPtr        domain;                     /** Handle from the most recent listing */
+    unsigned char       uuid[VIR_UUID_BUFLEN];      /** Key of the record */
+    int                 id;                         /** Domain ID, -1 if inactive */
+
+    char                *name;                      /** VIRT_GROUP_STATIC */
+    int                 autostart;                  /** VIRT_GROUP_STATIC */
+
+    int                 state;                      /** VIRT_GROUP_STATE */
+    int                 reason;                     /** VIRT_GROUP_STATE */
+
+    unsigned long long  memory_actual;              /** VIRT_GROUP_MEMORY, balloon size in KiB */
+    unsigned long long  memory_rss;                 /** VIRT_GROUP_MEMORY, resident size in KiB */
+    unsigned int        memory_tags;                /** VIRT_GROUP_MEMORY, VIRT_MEMORY_TAG_BIT of each reported stat */
+    unsigned long long  memory_swap_in;             /** VIRT_GROUP_MEMORY, KiB swapped in since guest boot */
+    unsigned long long  memory_swap_out;            /** VIRT_GROUP_MEMORY, KiB swapped out since guest boot */
+    unsigned long long  memory_major_fault;         /** VIRT_GROUP_MEMORY, major page faults since guest boot */
+    unsigned long long  memory_minor_fault;         /** VIRT_GROUP_MEMORY, minor page faults since guest boot */
+    unsigned long long  memory_unused;              /** VIRT_GROUP_MEMORY, KiB left unused by the guest */
+    unsigned long long  memory_available;           /** VIRT_GROUP_MEMORY, KiB seen by the guest */
+    unsigned long long  memory_usable;              /** VIRT_GROUP_MEMORY, KiB the guest can use without swapping */
+    unsigned long long  memory_last_update;         /** VIRT_GROUP_MEMORY, guest time of the guest stats in seconds */
+    double              memory_swap_in_rate;        /** VIRT_GROUP_MEMORY, KiB per second */
+    double              memory_swap_out_rate;       /** VIRT_GROUP_MEMORY, KiB per second */
+    double              memory_major_fault_rate;    /** VIRT_GROUP_MEMORY, faults per second */
+    double              memory_minor_fault_rate;    /** VIRT_GROUP_MEMORY, faults per second */
+    int                 memory_period_set;          /** Stats period was requested since the domain started */
+
+    unsigned int        perf_events;                /** VIRT_GROUP_PERF, VIRT_PERF_EVENT_BIT of each reported event */
+    unsigned long long  perf_value[VIRT_PERF_EVENT_SIZE]; /** VIRT_GROUP_PERF, counters and gauges by virt_perf_event */
+    double              perf_ipc;                   /** VIRT_GROUP_PERF, instructions per cycle, -1 if unknown */
+    double              perf_miss_rate;             /** VIRT_GROUP_PERF, cache misses per second, -1 if unknown */
+    int                 perf_enabled;               /** Perf events were enabled since the domain started */
+
+    unsigned long long  cpu_time;                   /** VIRT_GROUP_CPU, nanoseconds */
+    double              cpu_prc;                    /** VIRT_GROUP_CPU, usage since the last sample */
+
+    unsigned long long  block_rd_bytes;             /** VIRT_GROUP_IO, sum over all disks */
+    unsigned long long  block_wr_bytes;             /** VIRT_GROUP_IO, sum over all disks */
+    unsigned long long  net_rx_bytes;               /** VIRT_GROUP_IO, sum over all interfaces */
+    unsigned long long  net_tx_bytes;               /** VIRT_GROUP_IO, sum over all interfaces */
+    double              block_rd_rate;              /** VIRT_GROUP_IO, bytes per second */
+    double              block_wr_rate;              /** VIRT_GROUP_IO, bytes per second */
+    double              net_rx_rate;                /** VIRT_GROUP_IO, bytes per second */
+    double              net_tx_rate;                /** VIRT_GROUP_IO, bytes per second */
+
+    char                *guest_os;                  /** VIRT_GROUP_AGENT */
+
+    char                *numa_nodeset;              /** VIRT_GROUP_NUMA, memory nodes of numatune, NULL if not set */
+    unsigned char       numa_cpumap[VIRT_NODE_CPUMAP_LEN]; /** VIRT_GROUP_NUMA, host CPUs any vCPU may run on */
+
+    int                 dirty_state;                /** VIRT_DIRTY_STATE_* of the requested measurement */
+    unsigned long long  dirty_started;              /** Monotonic time the running measurement was submitted */
+    long long           dirty_rate;                 /** MiB dirtied per second by the last measurement */
+    long long           dirty_calc_start;           /** Start time libvirt reported for the last measurement */
+    long long           dirty_measured;             /** Wall-clock time the last measurement was read, 0 if never */
+
+    virt_vcpu_record    *vcpu;                      /** VIRT_GROUP_VCPU, one sample per possible vCPU */
+    int                 vcpu_size;                  /** VIRT_GROUP_VCPU, number of possible vCPUs */
+    int                 vcpu_current;               /** VIRT_GROUP_VCPU, number of online vCPUs */
+
+    /** Monotonic time of the last successful fetch of each group, 0 if never fetched */
+    unsigned long long  updated[VIRT_GROUP_SIZE];
+
+    unsigned long long  hung_since;                 /** Monotonic time a call first missed its deadline, 0 if responsive */
+    unsigned long long  retry_at;                   /** Monotonic time the hung domain is asked again */
+    double              retry_delay;                /** Current retry delay in seconds, doubles on every miss */
+    virt_watchdog_job   *stuck;                     /** Call which missed its deadline and has not returned yet */
+
+    virt_local_entry    *local;                     /** Open counter files of the local fast path, NULL if not mapped */
+} virt_domain_record;
+
+/** Records of all domains in listing order, together with group schedule. */
+typedef struct virt_record_data {
+    virt_domain_record  *record;                    /** Records, one per listed domain */
+    size_t              record_size;                /** Number of records */
+    unsigned long long  fetched[VIRT_GROUP_SIZE];   /** Monotonic time each group was last due */
+} virt_record_data;
+
+/**
+ * Set records object to default state.
+ * @param data - records to be initialized
+ */
+void virt_init_records(virt_record_data *data);
+
+/**
+ * Release all records.
+ * @param data - records to be freed
+ */
+void virt_deinit_records(virt_record_data *data);
+
+/**
+ * Synchronize records with the current domain listing.
+ * Records of domains that are still defined are kept and get the new domain
+ * handle, new domains get an empty record and records of vanished domains are freed.
+ * @param data   - records to be synchronized
+ * @param domain - current domain listing
+ * @param size   - number of domains in the listing
+ */
+void virt_sync_records(virt_record_data *data, virDomainPtr *domain, size_t size);
+
+/**
+ * Return mask of groups due at given time and mark them as fetched.
+ * @param data - records
+ * @param now  - monotonic time in microseconds
+ * @return mask of VIRT_GROUP_BIT values
+ */
+unsigned int virt_records_due(virt_record_data *data, unsigned long long now);
+
+/**
+ * Check whether the record needs the group refreshed: the group is due,
+ * or it has never been fetched for this record.
+ * @param record - domain record
+ * @param group  - metric group
+ * @param due    - mask of due groups
+ * @return TRUE (1) if the group should be fetched, FALSE (0) otherwise
+ */
+int virt_record_needs(const virt_domain_record *record, virt_group group, unsigned int due);
+
+/**
+ * Check whether per-domain calls may be made for the record.
+ * A hung domain is asked again only after its retry delay passed
+ * and the call which missed the deadline returned.
+ * @param record - domain record
+ * @param now    - monotonic time in microseconds
+ * @return TRUE (1) if the domain may be called, FALSE (0) otherwise
+ */
+int virt_record_responsive(virt_domain_record *record, unsigned long long now);
+
+/**
+ * Mark the domain as hung and schedule the next retry with exponential backoff.
+ * @param record - domain record
+ * @param job    - call which missed its deadline, the record takes its reference
+ * @param now    - monotonic time in microseconds
+ */
+void virt_record_hung(virt_domain_record *record, virt_watchdog_job *job, unsigned long long now);
+
+/**
+ * Mark the domain as responsive after a call finished in time.
+ * @param record - domain record
+ */
+void virt_record_responded(virt_domain_record *record);
+
+/**
+ * Parse list of group=seconds pairs, e.g. "memory=5,static=60",
+ * and update virt_group_period accordingly.
+ * @param str - pairs separated by VIRT_GROUP_PERIOD_SEPARATOR, seconds up to
+ *              SCHEDULER_MAX_INTERVAL
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_parse_group_periods(const char *str);
+
+#endif /* VIRT_RECORD_H */
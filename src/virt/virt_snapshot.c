@@ -0,0 +1,226 @@
+/* This file contains the snapshots shared by a collector with its viewers
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_snapshot.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+void virt_init_snapshot(virt_snapshot_segment *segment)
+{
+    segment->name   = NULL;
+    segment->table  = NULL;
+    segment->owner  = 0;
+}
+
+void virt_deinit_snapshot(virt_snapshot_segment *segment)
+{
+    if (segment->table)
+        munmap(segment->table, sizeof(virt_snapshot_table));
+    if (segment->owner && segment->name)
+        shm_unlink(segment->name);
+    free(segment->name);
+    virt_init_snapshot(segment);
+}
+
+/* POSIX names start with a slash, which the option may leave out */
+static char *virt_snapshot_name(const char *name)
+{
+    char buffer[VIRT_SNAPSHOT_NODE_SIZE];
+    snprintf(buffer, sizeof(buffer), "%s%s", name[0] == '/' ? "" : "/", name);
+    return copy_str(buffer);
+}
+
+int virt_snapshot_create(virt_snapshot_segment *segment, const char *name)
+{
+    segment->name = virt_snapshot_name(name);
+    int fd = shm_open(segment->name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        virt_deinit_snapshot(segment);
+        return VIRT_ERROR_FAILURE;
+    }
+    segment->owner = 1;
+
+    /* pages of rows which are never used are never backed */
+    void *table = MAP_FAILED;
+    if (ftruncate(fd, sizeof(virt_snapshot_table)) == 0)
+        table = mmap(NULL, sizeof(virt_snapshot_table), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (table == MAP_FAILED) {
+        virt_deinit_snapshot(segment);
+        return VIRT_ERROR_FAILURE;
+    }
+    segment->table = table;
+
+    /* a segment taken over may be read right now, it stays consistent */
+    unsigned int sequence = __atomic_load_n(&segment->table->sequence, __ATOMIC_RELAXED) & ~1U;
+    __atomic_store_n(&segment->table->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    segment->table->magic       = VIRT_SNAPSHOT_MAGIC;
+    segment->table->version     = VIRT_SNAPSHOT_VERSION;
+    segment->table->domain_size = 0;
+    segment->table->published   = 0;
+    __atomic_store_n(&segment->table->sequence, sequence + 2, __ATOMIC_RELEASE);
+    return VIRT_ERROR_SUCCESS;
+}
+
+int virt_snapshot_attach(virt_snapshot_segment *segment, const char *name)
+{
+    segment->name = virt_snapshot_name(name);
+    int fd = shm_open(segment->name, O_RDONLY, 0);
+    if (fd < 0) {
+        virt_deinit_snapshot(segment);
+        return VIRT_ERROR_FAILURE;
+    }
+
+    /* a collector between shm_open and ftruncate, or of an older build, has a
+     * shorter segment, pages beyond its end would raise SIGBUS */
+    struct stat st;
+    void *table = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(virt_snapshot_table))
+        table = mmap(NULL, sizeof(virt_snapshot_table), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (table == MAP_FAILED) {
+        virt_deinit_snapshot(segment);
+        return VIRT_ERROR_FAILURE;
+    }
+    segment->table = table;
+
+    if (segment->table->magic != VIRT_SNAPSHOT_MAGIC || segment->table->version != VIRT_SNAPSHOT_VERSION) {
+        virt_deinit_snapshot(segment);
+        return VIRT_ERROR_FAILURE;
+    }
+    return VIRT_ERROR_SUCCESS;
+}
+
+/* Copy a string into a cell, cut to its size */
+static void virt_snapshot_cell(char *cell, size_t size, const char *str)
+{
+    snprintf(cell, size, "%s", str ? str : "");
+}
+
+void virt_snapshot_fill(virt_snapshot_table *table, const virt_domain_data *data, const virt_node_data *node)
+{
+    for (int i = 0; i != VIRT_NODE_DATA_TYPE_SIZE; ++i)
+        virt_snapshot_cell(table->node[i], VIRT_SNAPSHOT_NODE_SIZE, node->node_data[node->node_type[i]]);
+
+    /* the last row counts as NULL */
+    size_t size = data->domain_size ? data->domain_size - 1 : 0;
+    if (size > VIRT_SNAPSHOT_DOMAIN_CAPACITY) {
+        syslog(LOG_WARNING, "Snapshot holds %d of %zu domains", VIRT_SNAPSHOT_DOMAIN_CAPACITY, size);
+        size = VIRT_SNAPSHOT_DOMAIN_CAPACITY;
+    }
+
+    for (size_t i = 0; i != size; ++i)
+        for (int j = 0; j != VIRT_DOMAIN_DATA_TYPE_SIZE; ++j)
+            virt_snapshot_cell(table->cell[i][j], VIRT_SNAPSHOT_CELL_SIZE, data->domain_data[j][i]);
+    table->domain_size  = size;
+    table->published    = time_monotonic_us();
+}
+
+/* Copy the payload of a table, only the rows in use */
+static void virt_snapshot_copy(virt_snapshot_table *dst, const virt_snapshot_table *src, unsigned int size)
+{
+    memcpy(dst->node, src->node, sizeof(src->node));
+    memcpy(dst->cell, src->cell, size * sizeof(src->cell[0]));
+    dst->domain_size    = size;
+    dst->published      = src->published;
+}
+
+void virt_snapshot_publish(virt_snapshot_segment *segment, const virt_snapshot_table *table)
+{
+    virt_snapshot_table *shared = segment->table;
+    unsigned int sequence = shared->sequence;
+
+    /* odd while writing, viewers which saw the even value before drop their copy */
+    __atomic_store_n(&shared->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    virt_snapshot_copy(shared, table, table->domain_size);
+    __atomic_store_n(&shared->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+int virt_snapshot_read(virt_snapshot_segment *segment, virt_snapshot_table *table)
+{
+    const virt_snapshot_table *shared = segment->table;
+
+    for (int i = 0; i != VIRT_SNAPSHOT_READ_RETRY; ++i) {
+        unsigned int sequence = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+        if (sequence & 1U)
+            continue;
+
+        /* the size may be torn as well, it is checked like the rest */
+        unsigned int size = shared->domain_size;
+        if (size > VIRT_SNAPSHOT_DOMAIN_CAPACITY)
+            size = VIRT_SNAPSHOT_DOMAIN_CAPACITY;
+        virt_snapshot_copy(table, shared, size);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shared->sequence, __ATOMIC_RELAXED) == sequence)
+            return VIRT_ERROR_SUCCESS;
+    }
+    return VIRT_ERROR_FAILURE;
+}
+
+double virt_snapshot_age(const virt_snapshot_table *table)
+{
+    if (!table->published)
+        return -1.0;
+    return (time_monotonic_us() - table->published) / 1000000.0;
+}
+
+void *virt_snapshot_domain_data(const virt_snapshot_table *table)
+{
+    virt_domain_data *data = malloc(sizeof(virt_domain_data));
+    virt_init_domain_data(data);
+
+    /* last item counts as NULL */
+    data->domain_size = table->domain_size + 1;
+    for (int i = 0; i != VIRT_DOMAIN_DATA_TYPE_SIZE; ++i) {
+        data->domain_data[i] = calloc(data->domain_size, sizeof(char *));
+        for (size_t j = 0; j != table->domain_size; ++j)
+            data->domain_data[i][j] = copy_str(table->cell[j][i]);
+    }
+    return data;
+}
+
+virt_node_data virt_snapshot_node_data(const virt_snapshot_table *table, const char *uri)
+{
+    virt_node_data data;
+    virt_init_node_data(&data);
+
+    for (int i = 0; i != VIRT_NODE_DATA_TYPE_SIZE; ++i)
+        data.node_data[i] = copy_str(table->node[i]);
+
+    /* tell whose data this is, and whether its collector still runs */
+    char buffer[2 * VIRT_SNAPSHOT_NODE_SIZE];
+    double age = virt_snapshot_age(table);
+    if (age < 0.0)
+        snprintf(buffer, sizeof(buffer), "%s (waiting for the collector)", uri);
+    else if (age > VIRT_SNAPSHOT_STALE_AGE)
+        snprintf(buffer, sizeof(buffer), "%s via %s (collector gone for %.0fs)",
+                 table->node[VIRT_NODE_DATA_TYPE_URI], uri, age);
+    else
+        snprintf(buffer, sizeof(buffer), "%s via %s", table->node[VIRT_NODE_DATA_TYPE_URI], uri);
+    free(data.node_data[VIRT_NODE_DATA_TYPE_URI]);
+    data.node_data[VIRT_NODE_DATA_TYPE_URI] = copy_str(buffer);
+    return data;
+}
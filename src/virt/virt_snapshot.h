@@ -0,0 +1,144 @@
+/* This file contains the snapshots shared by a collector with its viewers
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_snapshot.h
+ * This file contains the snapshots shared by a collector with its viewers.
+ * A collector renders the domain table on its own schedule and publishes it
+ * into a POSIX shared memory segment. Viewers map the segment read-only and
+ * show the table without a libvirt connection of their own, so any number of
+ * them costs libvirtd as much as one. The segment is guarded by a seqlock:
+ * the sequence is odd while the collector writes, a viewer copies the rows
+ * and keeps the copy only if the sequence did not change meanwhile.
+ */
+#ifndef VIRT_SNAPSHOT_H
+#define VIRT_SNAPSHOT_H
+#include "virt.h"
+#include "virt_domain.h"
+#include "virt_node.h"
+/** Scheme of the connection URI of a viewer, virt-htop+shm:///<NAME> */
+#define VIRT_SNAPSHOT_SHM_SCHEME ("virt-htop+shm://")
+/** Identifies a segment of virt-htop, "vhs1" */
+#define VIRT_SNAPSHOT_MAGIC (0x76687331)
+/** Layout of the segment, viewers refuse other versions */
+#define VIRT_SNAPSHOT_VERSION (1)
+/** Most domains of a snapshot, rows over it are not published */
+#define VIRT_SNAPSHOT_DOMAIN_CAPACITY (4096)
+/** Size of a domain cell including the terminating NUL, longer strings are cut */
+#define VIRT_SNAPSHOT_CELL_SIZE (64)
+/** Size of a node cell including the terminating NUL */
+#define VIRT_SNAPSHOT_NODE_SIZE (256)
+/** Attempts to copy a consistent snapshot before the previous one is kept */
+#define VIRT_SNAPSHOT_READ_RETRY (100)
+/** Seconds without a new snapshot after which the collector is considered gone */
+#define VIRT_SNAPSHOT_STALE_AGE (5.0)
+
+/** Published table, fixed size so that it can live in shared memory. */
+typedef struct {
+    unsigned int        magic;          /** VIRT_SNAPSHOT_MAGIC */
+    unsigned int        version;        /** VIRT_SNAPSHOT_VERSION */
+    unsigned int        sequence;       /** Seqlock, odd while the collector writes */
+    unsigned int        domain_size;    /** Rows of the snapshot */
+    unsigned long long  published;      /** Monotonic time of the snapshot, the clock is shared by all processes */
+    char                node[VIRT_NODE_DATA_TYPE_SIZE][VIRT_SNAPSHOT_NODE_SIZE];
+    /** Rendered domain data by row and virt_domain_data_type_enum */
+    char                cell[VIRT_SNAPSHOT_DOMAIN_CAPACITY][VIRT_DOMAIN_DATA_TYPE_SIZE][VIRT_SNAPSHOT_CELL_SIZE];
+} virt_snapshot_table;
+
+/** Shared memory segment of a collector or a viewer. */
+typedef struct {
+    char                *name;          /** Name of the segment, NULL if none is open */
+    virt_snapshot_table *table;         /** Mapping of the segment, read-only for viewers */
+    int                 owner;          /** The segment was created by this process and is removed with it */
+} virt_snapshot_segment;
+
+/**
+ * Set the segment to default state, nothing is mapped.
+ * @param segment - segment to be initialized
+ */
+void virt_init_snapshot(virt_snapshot_segment *segment);
+
+/**
+ * Unmap the segment, a collector also removes it.
+ * @param segment - segment to be released
+ */
+void virt_deinit_snapshot(virt_snapshot_segment *segment);
+
+/**
+ * Create the segment of a collector, an existing one is taken over.
+ * @param segment - closed segment
+ * @param name    - name of the segment, e.g. virt-htop
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_snapshot_create(virt_snapshot_segment *segment, const char *name);
+
+/**
+ * Map the segment of a collector read-only.
+ * @param segment - closed segment
+ * @param name    - name of the segment
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE if there is no such segment,
+ *         it is not fully sized yet or of another layout
+ */
+int virt_snapshot_attach(virt_snapshot_segment *segment, const char *name);
+
+/**
+ * Write the rendered table into the table of a snapshot.
+ * @param table - table to be filled
+ * @param data  - rendered domain data, its last row counts as NULL
+ * @param node  - rendered node data
+ */
+void virt_snapshot_fill(virt_snapshot_table *table, const virt_domain_data *data, const virt_node_data *node);
+
+/**
+ * Publish a table into the segment of a collector.
+ * @param segment - created segment
+ * @param table   - filled table
+ */
+void virt_snapshot_publish(virt_snapshot_segment *segment, const virt_snapshot_table *table);
+
+/**
+ * Copy a consistent snapshot out of the segment of a viewer.
+ * @param segment - attached segment
+ * @param table   - filled with the snapshot, undefined on failure
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE if the collector kept writing
+ */
+int virt_snapshot_read(virt_snapshot_segment *segment, virt_snapshot_table *table);
+
+/**
+ * Age of a snapshot.
+ * @param table - table of the snapshot
+ * @return seconds since the snapshot was published, a negative value if it never was
+ */
+double virt_snapshot_age(const virt_snapshot_table *table);
+
+/**
+ * Turn a snapshot back into domain data, as the domain mode renders it.
+ * @param table - table of the snapshot
+ * @return object filled with domain data
+ */
+void *virt_snapshot_domain_data(const virt_snapshot_table *table);
+
+/**
+ * Turn a snapshot back into node data, host CPU meters are not shared.
+ * @param table - table of the snapshot
+ * @param uri   - connection URI of the viewer, shown after the URI of the collector
+ * @return node data
+ */
+virt_node_data virt_snapshot_node_data(const virt_snapshot_table *table, const char *uri);
+
+#endif /* VIRT_SNAPSHOT_H */
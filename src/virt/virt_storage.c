@@ -0,0 +1,422 @@
+/* This file contains the storage mode, pools and their volumes
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_storage.h"
+#include "virt_domain.h"
+#include "virt_health.h"
+#include "virt_trace.h"
+#include "utils.h"
+#include <stdio.h>
+
+/** Pool states, indexed by VIR_STORAGE_POOL_* */
+static const char *virt_storage_pool_state_text[] = {
+    "inactive",
+    "building",
+    "running",
+    "degraded",
+    "inaccessible"
+};
+
+/** Volume types, indexed by VIR_STORAGE_VOL_* */
+static const char *virt_storage_volume_type_text[] = {
+    "file",
+    "block",
+    "dir",
+    "network",
+    "netdir",
+    "ploop"
+};
+
+static void virt_storage_free_volume(virt_storage_volume *volume)
+{
+    free(volume->name);
+    if (volume->vol)
+        virStorageVolFree(volume->vol);
+}
+
+static void virt_storage_free_volumes(virt_storage_pool *pool)
+{
+    for (int i = 0; i != pool->volume_size; ++i)
+        virt_storage_free_volume(pool->volume + i);
+    free(pool->volume);
+    pool->volume        = NULL;
+    pool->volume_size   = 0;
+    pool->listed        = 0;
+    pool->cursor        = 0;
+}
+
+static void virt_storage_free_pool(virt_storage_pool *pool)
+{
+    virt_storage_free_volumes(pool);
+    free(pool->name);
+    if (pool->pool)
+        virStoragePoolFree(pool->pool);
+}
+
+void virt_init_storage_cache(virt_storage_cache *cache)
+{
+    cache->pool         = NULL;
+    cache->pool_size    = 0;
+}
+
+void virt_deinit_storage_cache(virt_storage_cache *cache)
+{
+    for (int i = 0; i != cache->pool_size; ++i)
+        virt_storage_free_pool(cache->pool + i);
+    free(cache->pool);
+}
+
+void virt_storage_invalidate(virt_storage_cache *cache)
+{
+    virt_deinit_storage_cache(cache);
+    virt_init_storage_cache(cache);
+}
+
+static int virt_storage_pool_cmp(const void *a, const void *b)
+{
+    return strcmp(((const virt_storage_pool *)a)->name, ((const virt_storage_pool *)b)->name);
+}
+
+static int virt_storage_volume_cmp(const void *a, const void *b)
+{
+    return strcmp(((const virt_storage_volume *)a)->name, ((const virt_storage_volume *)b)->name);
+}
+
+/* Take a sample of the allocation, the rate is smoothed over VIRT_STORAGE_GROWTH_WINDOW */
+static void virt_storage_grow(virt_storage_growth *growth, unsigned long long allocation,
+                              unsigned long long now)
+{
+    if (growth->sampled && now > growth->sampled) {
+        double elapsed  = (now - growth->sampled) / 1e6;
+        double rate     = ((double)allocation - (double)growth->allocation) / elapsed;
+        /* the first rate is taken as it is */
+        double weight   = growth->known ? elapsed / (elapsed + VIRT_STORAGE_GROWTH_WINDOW) : 1.0;
+        growth->rate    += (rate - growth->rate) * weight;
+        growth->known   = 1;
+    }
+    growth->allocation  = allocation;
+    growth->sampled     = now;
+}
+
+/*
+ * Replace the cached pools with the listed ones, samples of pools listed
+ * before are kept. Pools are sorted by name.
+ */
+static int virt_storage_sync_pools(virt_data *virt)
+{
+    virt_storage_cache *cache = virt->storage;
+
+    virStoragePoolPtr *pools = NULL;
+    unsigned long long trace = virt_trace_begin();
+    int size = virConnectListAllStoragePools(virt->conn, &pools, 0);
+    virt_trace_end(VIRT_TRACE_API_CONNECT_LIST_ALL_STORAGE_POOLS, NULL, trace, size < 0);
+    if (size < 0) {
+        virt_health_failed(virt);
+        return VIRT_ERROR_FAILURE;
+    }
+
+    virt_storage_pool *pool = calloc(size + 1, sizeof(virt_storage_pool));
+    for (int i = 0; i != size; ++i) {
+        unsigned char uuid[VIR_UUID_BUFLEN] = { 0 };
+        virStoragePoolGetUUID(pools[i], uuid);
+
+        /* pools are few, a linear lookup is enough */
+        for (int j = 0; j != cache->pool_size; ++j) {
+            if (cache->pool[j].name && memcmp(cache->pool[j].uuid, uuid, VIR_UUID_BUFLEN) == 0) {
+                pool[i] = cache->pool[j];
+                memset(cache->pool + j, 0, sizeof(virt_storage_pool));
+                break;
+            }
+        }
+
+        if (pool[i].pool)
+            virStoragePoolFree(pool[i].pool);
+        free(pool[i].name);
+        memcpy(pool[i].uuid, uuid, VIR_UUID_BUFLEN);
+        pool[i].pool = pools[i];
+        pool[i].name = copy_str(virStoragePoolGetName(pools[i]));
+        if (!pool[i].name)
+            pool[i].name = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    }
+    free(pools);
+
+    /* pools which are gone */
+    for (int j = 0; j != cache->pool_size; ++j)
+        virt_storage_free_pool(cache->pool + j);
+    free(cache->pool);
+
+    qsort(pool, size, sizeof(virt_storage_pool), virt_storage_pool_cmp);
+    cache->pool         = pool;
+    cache->pool_size    = size;
+    return VIRT_ERROR_SUCCESS;
+}
+
+/*
+ * List the volumes of the pool again if their number changed or the list is
+ * older than VIRT_STORAGE_LIST_PERIOD, samples of volumes listed before are kept.
+ */
+static void virt_storage_list_volumes(virt_storage_pool *pool, unsigned long long now)
+{
+    /* counting is cheap compared to listing */
+    unsigned long long trace = virt_trace_begin();
+    int count = virStoragePoolNumOfVolumes(pool->pool);
+    virt_trace_end(VIRT_TRACE_API_STORAGE_POOL_NUM_OF_VOLUMES, NULL, trace, count < 0);
+    if (count < 0)
+        return;
+
+    if (pool->listed && count == pool->volume_size &&
+        now - pool->listed < (unsigned long long)(VIRT_STORAGE_LIST_PERIOD * 1000000.0))
+        return;
+
+    virStorageVolPtr *vols = NULL;
+    trace = virt_trace_begin();
+    int size = virStoragePoolListAllVolumes(pool->pool, &vols, 0);
+    virt_trace_end(VIRT_TRACE_API_STORAGE_POOL_LIST_ALL_VOLUMES, NULL, trace, size < 0);
+    if (size < 0)
+        return;
+
+    virt_storage_volume *volume = calloc(size + 1, sizeof(virt_storage_volume));
+    for (int i = 0; i != size; ++i) {
+        const char *name = virStorageVolGetName(vols[i]);
+        virt_storage_volume key = { .name = (char *)(name ? name : VIRT_DOMAIN_UNKNOWN_DATA) };
+
+        /* the cached volumes are sorted by name */
+        virt_storage_volume *found = pool->volume_size ?
+            bsearch(&key, pool->volume, pool->volume_size, sizeof(virt_storage_volume),
+                    virt_storage_volume_cmp) : NULL;
+        if (found && found->vol) {
+            /* keep the samples, the handle comes from the new listing and the
+             * cached name stays in place for the lookups still to come */
+            volume[i] = *found;
+            volume[i].name = copy_str(key.name);
+            virStorageVolFree(found->vol);
+            found->vol = NULL;
+        } else {
+            volume[i].name = copy_str(key.name);
+        }
+        volume[i].vol = vols[i];
+    }
+    free(vols);
+
+    virt_storage_free_volumes(pool);
+    qsort(volume, size, sizeof(virt_storage_volume), virt_storage_volume_cmp);
+    pool->volume        = volume;
+    pool->volume_size   = size;
+    pool->listed        = now;
+}
+
+/* Sample up to budget volumes of the pool, continuing where the last refresh stopped */
+static void virt_storage_sample_volumes(virt_storage_pool *pool, int budget, unsigned long long now)
+{
+    if (budget > pool->volume_size)
+        budget = pool->volume_size;
+
+    for (int i = 0; i != budget; ++i) {
+        if (pool->cursor >= pool->volume_size)
+            pool->cursor = 0;
+        virt_storage_volume *volume = pool->volume + pool->cursor++;
+
+        virStorageVolInfo info;
+        unsigned long long trace = virt_trace_begin();
+        int res = virStorageVolGetInfo(volume->vol, &info);
+        virt_trace_end(VIRT_TRACE_API_STORAGE_VOL_GET_INFO, NULL, trace, res < 0);
+        if (res < 0)
+            continue;
+
+        volume->info = info;
+        virt_storage_grow(&volume->growth, info.allocation, now);
+    }
+}
+
+/* Refresh the pools, list their volumes when due and sample a share of them */
+static void virt_storage_refresh(virt_data *virt)
+{
+    if (!virt_health_connected(virt) || virt_storage_sync_pools(virt) != VIRT_ERROR_SUCCESS)
+        return;
+
+    virt_storage_cache *cache = virt->storage;
+    unsigned long long now = time_monotonic_us();
+
+    int listed = 0;
+    for (int i = 0; i != cache->pool_size; ++i) {
+        virt_storage_pool *pool = cache->pool + i;
+
+        virStoragePoolInfo info;
+        unsigned long long trace = virt_trace_begin();
+        int res = virStoragePoolGetInfo(pool->pool, &info);
+        virt_trace_end(VIRT_TRACE_API_STORAGE_POOL_GET_INFO, NULL, trace, res < 0);
+        if (res < 0)
+            continue;
+
+        pool->info = info;
+        /* an inactive pool has no volumes to list */
+        if (info.state != VIR_STORAGE_POOL_RUNNING && info.state != VIR_STORAGE_POOL_DEGRADED) {
+            virt_storage_free_volumes(pool);
+            continue;
+        }
+        virt_storage_grow(&pool->growth, info.allocation, now);
+        virt_storage_list_volumes(pool, now);
+        listed += pool->volume_size > 0;
+    }
+
+    /* every pool gets its share of the budget, small pools are sampled whole */
+    int share = listed ? VIRT_STORAGE_INFO_BUDGET / listed : 0;
+    if (share < VIRT_STORAGE_INFO_MIN_SHARE)
+        share = VIRT_STORAGE_INFO_MIN_SHARE;
+    for (int i = 0; i != cache->pool_size; ++i)
+        virt_storage_sample_volumes(cache->pool + i, share, now);
+}
+
+/* Format bytes as MiB */
+static char *virt_storage_mb_str(unsigned long long bytes)
+{
+    return ull_to_str(bytes / 1024 / 1024);
+}
+
+/* Format the growth rate in MiB per hour */
+static char *virt_storage_growth_str(const virt_storage_growth *growth)
+{
+    if (!growth->known)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    return double_to_str(growth->rate * 3600.0 / 1024.0 / 1024.0);
+}
+
+/* Estimate when the free space runs out at the current growth, e.g. "3h05m" */
+static char *virt_storage_full_str(const virt_storage_growth *growth, unsigned long long free_bytes)
+{
+    if (!growth->known || growth->rate <= 0)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+
+    char buf[32];
+    unsigned long long seconds = (unsigned long long)(free_bytes / growth->rate);
+    if (seconds >= 1000ULL * 86400)
+        snprintf(buf, sizeof(buf), ">999d");
+    else if (seconds >= 86400)
+        snprintf(buf, sizeof(buf), "%llud%02lluh", seconds / 86400, seconds % 86400 / 3600);
+    else if (seconds >= 3600)
+        snprintf(buf, sizeof(buf), "%lluh%02llum", seconds / 3600, seconds % 3600 / 60);
+    else
+        snprintf(buf, sizeof(buf), "%llum%02llus", seconds / 60, seconds % 60);
+    return copy_str(buf);
+}
+
+/* Format the share of the capacity in use */
+static char *virt_storage_used_str(unsigned long long allocation, unsigned long long capacity)
+{
+    if (!capacity)
+        return copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    return double_to_str((double)allocation / (double)capacity * 100.0);
+}
+
+static void virt_storage_render_pool(virt_storage_data *data, size_t row,
+                                     const virt_storage_pool *pool, int stale)
+{
+    int sampled = pool->growth.sampled != 0;
+    int state   = pool->info.state;
+
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_NAME][row]        = copy_str(pool->name);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_STATE][row]       = virt_domain_stale_str(copy_str(
+                                                                  state >= 0 && state <= VIR_STORAGE_POOL_INACCESSIBLE ?
+                                                                  virt_storage_pool_state_text[state] : VIRT_DOMAIN_UNKNOWN_DATA), stale);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_CAPACITY][row]    = sampled ?
+                                                                  virt_domain_stale_str(virt_storage_mb_str(pool->info.capacity), stale) :
+                                                                  copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_ALLOCATION][row]  = sampled ?
+                                                                  virt_domain_stale_str(virt_storage_mb_str(pool->info.allocation), stale) :
+                                                                  copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_AVAILABLE][row]   = sampled ?
+                                                                  virt_domain_stale_str(virt_storage_mb_str(pool->info.available), stale) :
+                                                                  copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_USED_PRC][row]    = sampled ?
+                                                                  virt_domain_stale_str(virt_storage_used_str(pool->info.allocation, pool->info.capacity), stale) :
+                                                                  copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_GROWTH][row]      = virt_storage_growth_str(&pool->growth);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_FULL_IN][row]     = virt_storage_full_str(&pool->growth, pool->info.available);
+}
+
+static void virt_storage_render_volume(virt_storage_data *data, size_t row,
+                                       const virt_storage_volume *volume, int stale)
+{
+    int sampled = volume->growth.sampled != 0;
+    int type    = volume->info.type;
+    unsigned long long free_bytes = volume->info.capacity > volume->info.allocation ?
+                                    volume->info.capacity - volume->info.allocation : 0;
+
+    size_t indent = strlen(VIRT_STORAGE_VOLUME_INDENT);
+    size_t len    = strlen(volume->name);
+    char *name = malloc(indent + len + 1);
+    memcpy(name, VIRT_STORAGE_VOLUME_INDENT, indent);
+    memcpy(name + indent, volume->name, len + 1);
+
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_NAME][row]        = name;
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_STATE][row]       = copy_str(sampled && type >= 0 && type < (int)(sizeof(virt_storage_volume_type_text) / sizeof(char *)) ?
+                                                                  virt_storage_volume_type_text[type] : VIRT_DOMAIN_UNKNOWN_DATA);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_CAPACITY][row]    = sampled ?
+                                                                  virt_domain_stale_str(virt_storage_mb_str(volume->info.capacity), stale) :
+                                                                  copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_ALLOCATION][row]  = sampled ?
+                                                                  virt_domain_stale_str(virt_storage_mb_str(volume->info.allocation), stale) :
+                                                                  copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_AVAILABLE][row]   = sampled ?
+                                                                  virt_domain_stale_str(virt_storage_mb_str(free_bytes), stale) :
+                                                                  copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_USED_PRC][row]    = sampled ?
+                                                                  virt_domain_stale_str(virt_storage_used_str(volume->info.allocation, volume->info.capacity), stale) :
+                                                                  copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_GROWTH][row]      = virt_storage_growth_str(&volume->growth);
+    data->storage_data[VIRT_STORAGE_DATA_TYPE_FULL_IN][row]     = virt_storage_full_str(&volume->growth, free_bytes);
+}
+
+int virt_storage_row(virt_data *virt, int index)
+{
+    return -1;
+}
+
+void *virt_get_storage_data(virt_data *virt)
+{
+    virt_storage_refresh(virt);
+
+    virt_storage_cache *cache = virt->storage;
+    int stale = !virt_health_connected(virt);
+
+    size_t size = cache->pool_size;
+    for (int i = 0; i != cache->pool_size; ++i)
+        size += cache->pool[i].volume_size;
+
+    virt_storage_data *data = malloc(sizeof(virt_storage_data));
+    data->storage_size = size;
+    /* last item counts as NULL */
+    for (int i = 0; i != VIRT_STORAGE_DATA_TYPE_SIZE; ++i)
+        data->storage_data[i] = calloc(size + 1, sizeof(char *));
+
+    size_t row = 0;
+    for (int i = 0; i != cache->pool_size; ++i) {
+        const virt_storage_pool *pool = cache->pool + i;
+        virt_storage_render_pool(data, row++, pool, stale);
+        for (int j = 0; j != pool->volume_size; ++j, ++row)
+            virt_storage_render_volume(data, row, pool->volume + j, stale);
+    }
+    ++data->storage_size;
+
+    return data;
+}
+
+void virt_storage_no_command(virt_data *virt, int index)
+{
+}
@@ -0,0 +1,145 @@
+/* This file contains the storage mode, pools and their volumes
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_storage.h
+ * This file contains the storage mode. Pools are listed on every refresh,
+ * each followed by its volumes. Volume lists are cached per pool and listed
+ * again only when the number of volumes changes or the list gets old, and
+ * only a limited number of volumes is sampled per refresh, so pools with
+ * thousands of volumes do not stall the screen. Growth rate and time to full
+ * are derived from the allocation of consecutive samples.
+ */
+#ifndef VIRT_STORAGE_H
+#define VIRT_STORAGE_H
+#include "virt.h"
+/** Number of possible storage data types */
+#define VIRT_STORAGE_DATA_TYPE_SIZE (8)
+/** Seconds after which the volumes of an unchanged pool are listed again */
+#define VIRT_STORAGE_LIST_PERIOD (60.0)
+/** Most volumes sampled with virStorageVolGetInfo per refresh, shared by the pools */
+#define VIRT_STORAGE_INFO_BUDGET (256)
+/** Fewest volumes of a pool sampled per refresh */
+#define VIRT_STORAGE_INFO_MIN_SHARE (16)
+/** Seconds over which the growth rate is smoothed */
+#define VIRT_STORAGE_GROWTH_WINDOW (300.0)
+/** Indent of volume names under their pool */
+#define VIRT_STORAGE_VOLUME_INDENT ("  ")
+
+/**
+ * Indecies of the virt_storage_data array.
+ * @see virt_storage_data
+ */
+typedef enum {
+    VIRT_STORAGE_DATA_TYPE_NAME,
+    VIRT_STORAGE_DATA_TYPE_STATE,
+    VIRT_STORAGE_DATA_TYPE_CAPACITY,
+    VIRT_STORAGE_DATA_TYPE_ALLOCATION,
+    VIRT_STORAGE_DATA_TYPE_AVAILABLE,
+    VIRT_STORAGE_DATA_TYPE_USED_PRC,
+    VIRT_STORAGE_DATA_TYPE_GROWTH,
+    VIRT_STORAGE_DATA_TYPE_FULL_IN
+} virt_storage_data_type_enum;
+
+/** @see virt_storage_data_type_enum */
+typedef virt_storage_data_type_enum storage_type;
+
+/** Structure holding data of all storage rows */
+typedef struct {
+    /** Arrays containing various storage data */
+    char **storage_data[VIRT_STORAGE_DATA_TYPE_SIZE];
+    /** Number of storage rows */
+    size_t storage_size;
+} virt_storage_data;
+
+/** Allocation growth derived from consecutive samples. */
+typedef struct {
+    int                 known;          /** Rate is known, two samples were taken */
+    double              rate;           /** Smoothed growth in bytes per second, negative if shrinking */
+    unsigned long long  allocation;     /** Allocation of the last sample in bytes */
+    unsigned long long  sampled;        /** Monotonic time of the last sample, 0 if never sampled */
+} virt_storage_growth;
+
+/** Cached volume of a pool. */
+typedef struct {
+    char                *name;          /** Key within the pool */
+    virStorageVolPtr    vol;
+    virStorageVolInfo   info;           /** Last sample, valid if growth.sampled is set */
+    virt_storage_growth growth;
+} virt_storage_volume;
+
+/** Cached pool with its volumes. */
+typedef struct {
+    unsigned char       uuid[VIR_UUID_BUFLEN];  /** Key of the pool */
+    char                *name;
+    virStoragePoolPtr   pool;
+    virStoragePoolInfo  info;                   /** Last sample, valid if growth.sampled is set */
+    virt_storage_growth growth;
+    virt_storage_volume *volume;                /** Volumes sorted by name */
+    int                 volume_size;
+    unsigned long long  listed;                 /** Monotonic time the volumes were listed, 0 if never */
+    int                 cursor;                 /** Next volume to be sampled */
+} virt_storage_pool;
+
+/** Storage pools cached across refreshes. */
+typedef struct virt_storage_cache {
+    virt_storage_pool   *pool;          /** Pools sorted by name */
+    int                 pool_size;
+} virt_storage_cache;
+
+/**
+ * Set the cache to default state, nothing is listed yet.
+ * @param cache - cache to be initialized
+ */
+void virt_init_storage_cache(virt_storage_cache *cache);
+
+/**
+ * Release the cache with all pools and volumes.
+ * @param cache - cache to be freed
+ */
+void virt_deinit_storage_cache(virt_storage_cache *cache);
+
+/**
+ * Drop pools and volumes of the previous connection, growth starts over.
+ * @param cache - cache to be invalidated
+ */
+void virt_storage_invalidate(virt_storage_cache *cache);
+
+/**
+ * Storage rows have no domain.
+ * @param virt  - pointer with virt data
+ * @param index - storage row
+ * @return -1
+ */
+int virt_storage_row(virt_data *virt, int index);
+
+/**
+ * List the pools, their due volumes, sample them and render the storage rows.
+ * @param virt - Handler to the libvirt connection
+ * @return object filled with storage data
+ */
+void *virt_get_storage_data(virt_data *virt);
+
+/*
+ * Lifecycle commands do not apply to storage rows, used by every command table.
+ * @param virt  - pointer with virt data
+ * @param index - storage row
+ */
+void virt_storage_no_command(virt_data *virt, int index);
+
+#endif /* VIRT_STORAGE_H */
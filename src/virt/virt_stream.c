@@ -0,0 +1,684 @@
+/* This file contains the snapshot stream of a collector over a Unix socket
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_stream.h"
+#include "utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/** Reader of the payload of a frame, ok turns FALSE (0) once it runs past the end. */
+typedef struct {
+    const unsigned char *data;
+    const unsigned char *end;
+    int                 ok;
+} virt_stream_cursor;
+
+/** Row of a table by its name, to match rows after a reorder. */
+typedef struct {
+    const char  *name;
+    size_t      index;
+} virt_stream_key;
+
+/*
+ * Make room for more bytes at the end of a buffer, consumed bytes are dropped
+ * first. A buffer which could not grow stays failed, the bytes written to it
+ * afterwards are lost and the connection is closed on its next flush.
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE if out of memory
+ */
+static int virt_stream_reserve(virt_stream_buffer *buffer, size_t more)
+{
+    if (buffer->failed)
+        return VIRT_ERROR_FAILURE;
+    if (buffer->offset) {
+        memmove(buffer->data, buffer->data + buffer->offset, buffer->size - buffer->offset);
+        buffer->size    -= buffer->offset;
+        buffer->offset  = 0;
+    }
+    if (buffer->size + more <= buffer->capacity)
+        return VIRT_ERROR_SUCCESS;
+
+    size_t capacity = buffer->capacity ? buffer->capacity : VIRT_STREAM_READ_SIZE;
+    while (capacity < buffer->size + more)
+        capacity *= 2;
+    char *data = realloc(buffer->data, capacity);
+    if (!data) {
+        buffer->failed = 1;
+        return VIRT_ERROR_FAILURE;
+    }
+    buffer->data        = data;
+    buffer->capacity    = capacity;
+    return VIRT_ERROR_SUCCESS;
+}
+
+static void virt_stream_put(virt_stream_buffer *buffer, const void *data, size_t size)
+{
+    if (virt_stream_reserve(buffer, size) != VIRT_ERROR_SUCCESS)
+        return;
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void virt_stream_put_u8(virt_stream_buffer *buffer, unsigned char value)
+{
+    virt_stream_put(buffer, &value, 1);
+}
+
+static void virt_stream_put_u32(virt_stream_buffer *buffer, unsigned int value)
+{
+    uint32_t net = htonl(value);
+    virt_stream_put(buffer, &net, sizeof(net));
+}
+
+/* Strings are cut to the cell they came from and to what a length byte holds */
+static void virt_stream_put_str(virt_stream_buffer *buffer, const char *str, size_t size)
+{
+    size_t length = strnlen(str, size - 1 < UCHAR_MAX ? size - 1 : UCHAR_MAX);
+    virt_stream_put_u8(buffer, (unsigned char)length);
+    virt_stream_put(buffer, str, length);
+}
+
+/* Start a frame, the length is filled in by virt_stream_end */
+static size_t virt_stream_begin(virt_stream_buffer *buffer, virt_stream_frame_enum type)
+{
+    virt_stream_reserve(buffer, VIRT_STREAM_HEADER_SIZE);
+    size_t start = buffer->size;
+    virt_stream_put_u32(buffer, 0);
+    virt_stream_put_u8(buffer, (unsigned char)type);
+    return start;
+}
+
+static void virt_stream_end(virt_stream_buffer *buffer, size_t start)
+{
+    if (buffer->failed)
+        return;
+    uint32_t net = htonl((uint32_t)(buffer->size - start - sizeof(uint32_t)));
+    memcpy(buffer->data + start, &net, sizeof(net));
+}
+
+static unsigned int virt_stream_get_u32(virt_stream_cursor *cursor)
+{
+    uint32_t net = 0;
+    if (cursor->end - cursor->data < (long)sizeof(net)) {
+        cursor->ok = 0;
+        return 0;
+    }
+    memcpy(&net, cursor->data, sizeof(net));
+    cursor->data += sizeof(net);
+    return ntohl(net);
+}
+
+/* Read a string into a cell, cut to its size */
+static void virt_stream_get_str(virt_stream_cursor *cursor, char *str, size_t size)
+{
+    if (cursor->data >= cursor->end || cursor->end - cursor->data - 1 < cursor->data[0]) {
+        cursor->ok = 0;
+        str[0] = '\0';
+        return;
+    }
+    size_t length = cursor->data[0];
+    size_t copied = length < size ? length : size - 1;
+    memcpy(str, cursor->data + 1, copied);
+    str[copied] = '\0';
+    cursor->data += 1 + length;
+}
+
+static void virt_stream_free_buffer(virt_stream_buffer *buffer)
+{
+    free(buffer->data);
+    buffer->data        = NULL;
+    buffer->size        = 0;
+    buffer->capacity    = 0;
+    buffer->offset      = 0;
+    buffer->failed      = 0;
+}
+
+static int virt_stream_key_compare(const void *lhs, const void *rhs)
+{
+    const virt_stream_key *l = lhs, *r = rhs;
+    int res = strcmp(l->name, r->name);
+    if (res)
+        return res;
+    return l->index < r->index ? -1 : l->index > r->index;
+}
+
+/*
+ * Put the rows of a table into a new order, each keeps its cells by name and
+ * the first row of a name wins. Cells of a new name are unknown until a ROW
+ * fills them, empty cells cannot be shown. Both ends run this on ORDER, so
+ * their tables stay the same.
+ * @param table - table to be reordered
+ * @param name  - names of the rows in the new order
+ * @param size  - number of rows in the new order
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE if out of memory,
+ *         the table is left as it was
+ */
+static int virt_stream_reorder(virt_snapshot_table *table, const char (*name)[VIRT_SNAPSHOT_CELL_SIZE], size_t size)
+{
+    size_t old_size = table->domain_size;
+    size_t row_size = sizeof(table->cell[0]);
+    char *old = malloc(old_size * row_size + 1);
+    virt_stream_key *key = calloc(old_size + 1, sizeof(virt_stream_key));
+    if (!old || !key) {
+        free(key);
+        free(old);
+        return VIRT_ERROR_FAILURE;
+    }
+    memcpy(old, table->cell, old_size * row_size);
+
+    for (size_t i = 0; i != old_size; ++i) {
+        key[i].name     = old + i * row_size + VIRT_DOMAIN_DATA_TYPE_NAME * VIRT_SNAPSHOT_CELL_SIZE;
+        key[i].index    = i;
+    }
+    qsort(key, old_size, sizeof(virt_stream_key), virt_stream_key_compare);
+
+    for (size_t i = 0; i != size; ++i) {
+        /* first key not less than the name */
+        size_t begin = 0, end = old_size;
+        while (begin < end) {
+            size_t middle = begin + (end - begin) / 2;
+            if (strcmp(key[middle].name, name[i]) < 0)
+                begin = middle + 1;
+            else
+                end = middle;
+        }
+
+        if (begin < old_size && !strcmp(key[begin].name, name[i])) {
+            memcpy(table->cell[i], old + key[begin].index * row_size, row_size);
+        } else {
+            for (int j = 0; j != VIRT_DOMAIN_DATA_TYPE_SIZE; ++j)
+                snprintf(table->cell[i][j], VIRT_SNAPSHOT_CELL_SIZE, "%s", VIRT_DOMAIN_UNKNOWN_DATA);
+            snprintf(table->cell[i][VIRT_DOMAIN_DATA_TYPE_NAME], VIRT_SNAPSHOT_CELL_SIZE, "%s", name[i]);
+        }
+    }
+    table->domain_size = size;
+
+    free(key);
+    free(old);
+    return VIRT_ERROR_SUCCESS;
+}
+
+/* Forget what the client holds, the next update sends everything */
+static int virt_stream_reset(virt_stream_client *client)
+{
+    if (!client->table)
+        client->table = calloc(1, sizeof(virt_snapshot_table));
+    if (!client->table)
+        return VIRT_ERROR_FAILURE;
+    memset(client->table->node, 0, sizeof(client->table->node));
+    client->table->domain_size  = 0;
+    client->table->published    = 0;
+    return VIRT_ERROR_SUCCESS;
+}
+
+void virt_init_stream_client(virt_stream_client *client)
+{
+    memset(client, 0, sizeof(virt_stream_client));
+    client->fd = -1;
+}
+
+void virt_deinit_stream_client(virt_stream_client *client, event_data *ev)
+{
+    if (client->fd >= 0) {
+        event_unwatch(ev, client->fd);
+        close(client->fd);
+    }
+    virt_stream_free_buffer(&client->in);
+    virt_stream_free_buffer(&client->out);
+    free(client->table);
+    virt_init_stream_client(client);
+}
+
+/*
+ * Send as much of the queue as the socket takes, the rest waits for POLLOUT.
+ * @param client - connected client
+ * @param ev     - event sources the socket is watched by
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE if the connection is gone
+ */
+static int virt_stream_flush(virt_stream_client *client, event_data *ev)
+{
+    virt_stream_buffer *out = &client->out;
+    if (out->failed)
+        return VIRT_ERROR_FAILURE;
+    while (out->offset != out->size) {
+        ssize_t sent = send(client->fd, out->data + out->offset, out->size - out->offset,
+                            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return VIRT_ERROR_FAILURE;
+        out->offset += sent;
+    }
+
+    if (out->offset == out->size) {
+        out->offset = out->size = 0;
+        event_watch(ev, client->fd, POLLIN);
+    } else if (out->size - out->offset > VIRT_STREAM_QUEUE_MAX) {
+        return VIRT_ERROR_FAILURE;
+    } else {
+        event_watch(ev, client->fd, POLLIN | POLLOUT);
+    }
+    return VIRT_ERROR_SUCCESS;
+}
+
+/*
+ * Read what is available on the socket.
+ * @param client - connected client
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE if the connection is gone
+ *         or there is no memory for the bytes
+ */
+static int virt_stream_read(virt_stream_client *client)
+{
+    for (;;) {
+        if (virt_stream_reserve(&client->in, VIRT_STREAM_READ_SIZE) != VIRT_ERROR_SUCCESS)
+            return VIRT_ERROR_FAILURE;
+        ssize_t size = recv(client->fd, client->in.data + client->in.size, VIRT_STREAM_READ_SIZE, MSG_DONTWAIT);
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return VIRT_ERROR_SUCCESS;
+        if (size < 0 && errno == EINTR)
+            continue;
+        if (size <= 0)
+            return VIRT_ERROR_FAILURE;
+        client->in.size += size;
+    }
+}
+
+/*
+ * Take the next complete frame out of the received bytes.
+ * @param client - connected client
+ * @param type   - filled with the type of the frame
+ * @param cursor - filled with the payload of the frame
+ * @return TRUE (1) if a frame was taken, FALSE (0) if it is incomplete,
+ *         VIRT_ERROR_FAILURE if its length is not acceptable
+ */
+static int virt_stream_next(virt_stream_client *client, int *type, virt_stream_cursor *cursor)
+{
+    virt_stream_buffer *in = &client->in;
+    if (in->size - in->offset < VIRT_STREAM_HEADER_SIZE)
+        return 0;
+
+    uint32_t net = 0;
+    memcpy(&net, in->data + in->offset, sizeof(net));
+    size_t length = ntohl(net);
+    if (length < 1 || length > VIRT_STREAM_FRAME_MAX)
+        return VIRT_ERROR_FAILURE;
+    if (in->size - in->offset < sizeof(net) + length)
+        return 0;
+
+    const unsigned char *frame = (const unsigned char *)in->data + in->offset + sizeof(net);
+    *type           = frame[0];
+    cursor->data    = frame + 1;
+    cursor->end     = frame + length;
+    cursor->ok      = 1;
+    in->offset      += sizeof(net) + length;
+    return 1;
+}
+
+/*
+ * Queue the changes of a snapshot as the client subscribed to them.
+ * @param client - subscribed client
+ * @param table  - new snapshot
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE if out of memory
+ */
+static int virt_stream_update(virt_stream_client *client, const virt_snapshot_table *table)
+{
+    virt_snapshot_table *held = client->table;
+    virt_stream_buffer *out = &client->out;
+
+    /* rows passing the filter, in the order of the snapshot */
+    size_t *row = calloc(table->domain_size + 1, sizeof(size_t));
+    if (!row)
+        return VIRT_ERROR_FAILURE;
+    size_t size = 0;
+    for (size_t i = 0; i != table->domain_size; ++i)
+        if (!client->filter[0] || strstr(table->cell[i][VIRT_DOMAIN_DATA_TYPE_NAME], client->filter))
+            row[size++] = i;
+
+    if (memcmp(held->node, table->node, sizeof(table->node))) {
+        size_t start = virt_stream_begin(out, VIRT_STREAM_FRAME_NODE);
+        for (int i = 0; i != VIRT_NODE_DATA_TYPE_SIZE; ++i)
+            virt_stream_put_str(out, table->node[i], sizeof(table->node[i]));
+        virt_stream_end(out, start);
+        memcpy(held->node, table->node, sizeof(table->node));
+    }
+
+    /* the order is sent only when a row came, went or moved */
+    int moved = size != held->domain_size;
+    for (size_t i = 0; i != size && !moved; ++i)
+        moved = strcmp(held->cell[i][VIRT_DOMAIN_DATA_TYPE_NAME], table->cell[row[i]][VIRT_DOMAIN_DATA_TYPE_NAME]) != 0;
+    if (moved) {
+        char (*name)[VIRT_SNAPSHOT_CELL_SIZE] = calloc(size + 1, VIRT_SNAPSHOT_CELL_SIZE);
+        if (!name) {
+            free(row);
+            return VIRT_ERROR_FAILURE;
+        }
+        size_t start = virt_stream_begin(out, VIRT_STREAM_FRAME_ORDER);
+        virt_stream_put_u32(out, size);
+        for (size_t i = 0; i != size; ++i) {
+            memcpy(name[i], table->cell[row[i]][VIRT_DOMAIN_DATA_TYPE_NAME], VIRT_SNAPSHOT_CELL_SIZE);
+            virt_stream_put_str(out, name[i], sizeof(name[i]));
+        }
+        virt_stream_end(out, start);
+        int res = virt_stream_reorder(held, (const char (*)[VIRT_SNAPSHOT_CELL_SIZE])name, size);
+        free(name);
+        if (res != VIRT_ERROR_SUCCESS) {
+            free(row);
+            return VIRT_ERROR_FAILURE;
+        }
+    }
+
+    for (size_t i = 0; i != size; ++i) {
+        unsigned int changed = 0;
+        for (int j = 0; j != VIRT_DOMAIN_DATA_TYPE_SIZE; ++j)
+            if ((client->columns & VIRT_STREAM_COLUMN_BIT(j)) && strcmp(held->cell[i][j], table->cell[row[i]][j]))
+                changed |= VIRT_STREAM_COLUMN_BIT(j);
+        if (!changed)
+            continue;
+
+        size_t start = virt_stream_begin(out, VIRT_STREAM_FRAME_ROW);
+        virt_stream_put_u32(out, i);
+        virt_stream_put_u32(out, changed);
+        for (int j = 0; j != VIRT_DOMAIN_DATA_TYPE_SIZE; ++j) {
+            if (changed & VIRT_STREAM_COLUMN_BIT(j)) {
+                virt_stream_put_str(out, table->cell[row[i]][j], sizeof(table->cell[row[i]][j]));
+                memcpy(held->cell[i][j], table->cell[row[i]][j], VIRT_SNAPSHOT_CELL_SIZE);
+            }
+        }
+        virt_stream_end(out, start);
+    }
+
+    virt_stream_end(out, virt_stream_begin(out, VIRT_STREAM_FRAME_COMMIT));
+    free(row);
+    return out->failed ? VIRT_ERROR_FAILURE : VIRT_ERROR_SUCCESS;
+}
+
+void virt_init_stream_server(virt_stream_server *server)
+{
+    server->fd          = -1;
+    server->path        = NULL;
+    server->client      = NULL;
+    server->client_size = 0;
+    server->table       = NULL;
+}
+
+void virt_deinit_stream_server(virt_stream_server *server, event_data *ev)
+{
+    for (size_t i = 0; i != server->client_size; ++i)
+        virt_deinit_stream_client(server->client + i, ev);
+    free(server->client);
+
+    if (server->fd >= 0) {
+        event_unwatch(ev, server->fd);
+        close(server->fd);
+        unlink(server->path);
+    }
+    free(server->path);
+    virt_init_stream_server(server);
+}
+
+/* Fill a socket address, the path must fit */
+static int virt_stream_address(struct sockaddr_un *address, const char *path)
+{
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path))
+        return VIRT_ERROR_FAILURE;
+    strcpy(address->sun_path, path);
+    return VIRT_ERROR_SUCCESS;
+}
+
+int virt_stream_listen(virt_stream_server *server, const char *path, event_data *ev)
+{
+    struct sockaddr_un address;
+    if (virt_stream_address(&address, path) != VIRT_ERROR_SUCCESS)
+        return VIRT_ERROR_FAILURE;
+
+    server->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->fd < 0)
+        return VIRT_ERROR_FAILURE;
+
+    /* a socket left behind by a collector which did not stop cleanly */
+    unlink(path);
+    if (bind(server->fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(server->fd, VIRT_STREAM_BACKLOG) < 0) {
+        close(server->fd);
+        server->fd = -1;
+        return VIRT_ERROR_FAILURE;
+    }
+    server->path = copy_str(path);
+    if (!server->path) {
+        close(server->fd);
+        server->fd = -1;
+        unlink(path);
+        return VIRT_ERROR_FAILURE;
+    }
+    event_watch(ev, server->fd, POLLIN);
+    return VIRT_ERROR_SUCCESS;
+}
+
+/* Handle the frames a client sent, it only ever subscribes */
+static int virt_stream_handle(virt_stream_server *server, virt_stream_client *client)
+{
+    int type = 0, res = 0;
+    virt_stream_cursor cursor;
+    while ((res = virt_stream_next(client, &type, &cursor)) == 1) {
+        if (type != VIRT_STREAM_FRAME_SUBSCRIBE)
+            return VIRT_ERROR_FAILURE;
+
+        client->columns = virt_stream_get_u32(&cursor) | VIRT_STREAM_REQUIRED_COLUMNS;
+        virt_stream_get_str(&cursor, client->filter, sizeof(client->filter));
+        if (!cursor.ok)
+            return VIRT_ERROR_FAILURE;
+
+        /* the first snapshot goes out right away, whole, after the answer */
+        client->subscribed = 1;
+        if (virt_stream_reset(client) != VIRT_ERROR_SUCCESS)
+            return VIRT_ERROR_FAILURE;
+        virt_stream_end(&client->out, virt_stream_begin(&client->out, VIRT_STREAM_FRAME_RESET));
+        if (server->table && virt_stream_update(client, server->table) != VIRT_ERROR_SUCCESS)
+            return VIRT_ERROR_FAILURE;
+    }
+    return res < 0 ? VIRT_ERROR_FAILURE : VIRT_ERROR_SUCCESS;
+}
+
+void virt_stream_serve(virt_stream_server *server, event_data *ev)
+{
+    if (server->fd < 0)
+        return;
+
+    if (event_ready(ev, server->fd) & POLLIN) {
+        int fd = -1;
+        while ((fd = accept(server->fd, NULL, NULL)) >= 0) {
+            if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+                close(fd);
+                continue;
+            }
+            /* the collector goes on without a client it has no room for */
+            virt_stream_client *client = realloc(server->client, (server->client_size + 1) * sizeof(virt_stream_client));
+            if (!client) {
+                close(fd);
+                continue;
+            }
+            server->client  = client;
+            client          = server->client + server->client_size++;
+            virt_init_stream_client(client);
+            client->fd = fd;
+            event_watch(ev, fd, POLLIN);
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i != server->client_size; ++i) {
+        virt_stream_client *client = server->client + i;
+        short revents = event_ready(ev, client->fd);
+        int res = VIRT_ERROR_SUCCESS;
+        if (revents & (POLLIN | POLLHUP | POLLERR))
+            res = virt_stream_read(client);
+        if (res == VIRT_ERROR_SUCCESS)
+            res = virt_stream_handle(server, client);
+        if (res == VIRT_ERROR_SUCCESS)
+            res = virt_stream_flush(client, ev);
+
+        if (res != VIRT_ERROR_SUCCESS)
+            virt_deinit_stream_client(client, ev);
+        else
+            server->client[kept++] = *client;
+    }
+    server->client_size = kept;
+}
+
+void virt_stream_publish(virt_stream_server *server, const virt_snapshot_table *table, event_data *ev)
+{
+    server->table = table;
+
+    size_t kept = 0;
+    for (size_t i = 0; i != server->client_size; ++i) {
+        virt_stream_client *client = server->client + i;
+        int res = VIRT_ERROR_SUCCESS;
+        if (client->subscribed)
+            res = virt_stream_update(client, table);
+        if (res == VIRT_ERROR_SUCCESS)
+            res = virt_stream_flush(client, ev);
+
+        if (res != VIRT_ERROR_SUCCESS)
+            virt_deinit_stream_client(client, ev);
+        else
+            server->client[kept++] = *client;
+    }
+    server->client_size = kept;
+}
+
+int virt_stream_connect(virt_stream_client *client, const char *path, event_data *ev)
+{
+    struct sockaddr_un address;
+    if (virt_stream_address(&address, path) != VIRT_ERROR_SUCCESS)
+        return VIRT_ERROR_FAILURE;
+
+    client->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (client->fd < 0)
+        return VIRT_ERROR_FAILURE;
+    /* a local connect does not block, the socket is non-blocking afterwards */
+    if (connect(client->fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        fcntl(client->fd, F_SETFL, O_NONBLOCK) < 0) {
+        close(client->fd);
+        client->fd = -1;
+        return VIRT_ERROR_FAILURE;
+    }
+    event_watch(ev, client->fd, POLLIN);
+    return VIRT_ERROR_SUCCESS;
+}
+
+int virt_stream_subscribe(virt_stream_client *client, unsigned int columns, const char *filter, event_data *ev)
+{
+    client->columns = columns | VIRT_STREAM_REQUIRED_COLUMNS;
+    snprintf(client->filter, sizeof(client->filter), "%s", filter);
+    client->subscribed = 1;
+    /* the table is kept on the screen until the collector answers */
+    ++client->pending;
+
+    size_t start = virt_stream_begin(&client->out, VIRT_STREAM_FRAME_SUBSCRIBE);
+    virt_stream_put_u32(&client->out, client->columns);
+    virt_stream_put_str(&client->out, client->filter, sizeof(client->filter));
+    virt_stream_end(&client->out, start);
+    return virt_stream_flush(client, ev);
+}
+
+/* Apply one frame of the collector to the table */
+static int virt_stream_apply(virt_stream_client *client, int type, virt_stream_cursor *cursor)
+{
+    virt_snapshot_table *table = client->table;
+    switch (type) {
+        case VIRT_STREAM_FRAME_NODE: {
+            for (int i = 0; i != VIRT_NODE_DATA_TYPE_SIZE; ++i)
+                virt_stream_get_str(cursor, table->node[i], VIRT_SNAPSHOT_NODE_SIZE);
+            break;
+        }
+        case VIRT_STREAM_FRAME_ORDER: {
+            size_t size = virt_stream_get_u32(cursor);
+            if (size > VIRT_SNAPSHOT_DOMAIN_CAPACITY)
+                return VIRT_ERROR_FAILURE;
+            char (*name)[VIRT_SNAPSHOT_CELL_SIZE] = calloc(size + 1, VIRT_SNAPSHOT_CELL_SIZE);
+            if (!name)
+                return VIRT_ERROR_FAILURE;
+            for (size_t i = 0; i != size; ++i)
+                virt_stream_get_str(cursor, name[i], VIRT_SNAPSHOT_CELL_SIZE);
+            int res = cursor->ok ? virt_stream_reorder(table, (const char (*)[VIRT_SNAPSHOT_CELL_SIZE])name, size)
+                                 : VIRT_ERROR_SUCCESS;
+            free(name);
+            if (res != VIRT_ERROR_SUCCESS)
+                return VIRT_ERROR_FAILURE;
+            break;
+        }
+        case VIRT_STREAM_FRAME_ROW: {
+            size_t row = virt_stream_get_u32(cursor);
+            unsigned int changed = virt_stream_get_u32(cursor);
+            if (row >= table->domain_size)
+                return VIRT_ERROR_FAILURE;
+            for (int j = 0; j != VIRT_DOMAIN_DATA_TYPE_SIZE; ++j)
+                if (changed & VIRT_STREAM_COLUMN_BIT(j))
+                    virt_stream_get_str(cursor, table->cell[row][j], VIRT_SNAPSHOT_CELL_SIZE);
+            break;
+        }
+        case VIRT_STREAM_FRAME_COMMIT: {
+            table->published = time_monotonic_us();
+            return 1;
+        }
+        default:
+            return VIRT_ERROR_FAILURE;
+    }
+    return cursor->ok ? 0 : VIRT_ERROR_FAILURE;
+}
+
+int virt_stream_receive(virt_stream_client *client, event_data *ev)
+{
+    short revents = event_ready(ev, client->fd);
+    if ((revents & POLLOUT) && virt_stream_flush(client, ev) != VIRT_ERROR_SUCCESS)
+        return VIRT_ERROR_FAILURE;
+    if ((revents & (POLLIN | POLLHUP | POLLERR)) && virt_stream_read(client) != VIRT_ERROR_SUCCESS)
+        return VIRT_ERROR_FAILURE;
+
+    int committed = 0, type = 0, res = 0;
+    virt_stream_cursor cursor;
+    while ((res = virt_stream_next(client, &type, &cursor)) == 1) {
+        /* frames of an earlier subscription are skipped until the last one is answered */
+        if (type == VIRT_STREAM_FRAME_RESET) {
+            if (!client->pending)
+                return VIRT_ERROR_FAILURE;
+            if (--client->pending == 0 && virt_stream_reset(client) != VIRT_ERROR_SUCCESS)
+                return VIRT_ERROR_FAILURE;
+            continue;
+        }
+        if (client->pending)
+            continue;
+        /* the collector sends nothing else before it answers */
+        if (!client->table)
+            return VIRT_ERROR_FAILURE;
+        int applied = virt_stream_apply(client, type, &cursor);
+        if (applied < 0)
+            return VIRT_ERROR_FAILURE;
+        committed |= applied;
+    }
+    return res < 0 ? VIRT_ERROR_FAILURE : committed;
+}
@@ -0,0 +1,185 @@
+/* This file contains the snapshot stream of a collector over a Unix socket
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_stream.h
+ * This file contains the snapshot stream of a collector over a Unix socket,
+ * for viewers which cannot map its shared memory, e.g. in other containers.
+ * A client subscribes to a set of columns and a filter on the domain name.
+ * Both ends keep the same copy of the filtered table: the first snapshot
+ * is sent whole, afterwards only the cells which changed, so the traffic
+ * follows the amount of change rather than the number of domains.
+ *
+ * Every frame is a 32-bit length of what follows, a type byte and its
+ * payload. Integers are in network byte order and strings are a length byte
+ * followed by the bytes, without a terminating NUL.
+ *   SUBSCRIBE  client, u32 column mask, filter
+ *   NODE       server, one string per node data type
+ *   ORDER      server, u32 count, name of every row, sent if the rows changed
+ *   ROW        server, u32 row, u32 column mask, one string per set bit
+ *   COMMIT     server, empty, the snapshot is complete
+ *   RESET      server, empty, answers a SUBSCRIBE, the table is sent whole next
+ * Rows are matched by name on ORDER, cells of a name which is new are empty.
+ * Frames of an earlier subscription may still be on their way when a client
+ * subscribes again, it skips them until the RESET of its last SUBSCRIBE.
+ */
+#ifndef VIRT_STREAM_H
+#define VIRT_STREAM_H
+#include "virt.h"
+#include "virt_snapshot.h"
+#include "event.h"
+/** Scheme of the connection URI of a viewer, virt-htop+unix:///<PATH>[?filter=<TEXT>] */
+#define VIRT_STREAM_UNIX_SCHEME ("virt-htop+unix://")
+/** Query parameter of the URI with the filter on the domain name */
+#define VIRT_STREAM_FILTER_PARAM ("?filter=")
+/** Connections waiting to be accepted */
+#define VIRT_STREAM_BACKLOG (16)
+/** Largest frame accepted, anything bigger is a broken peer */
+#define VIRT_STREAM_FRAME_MAX (16 * 1024 * 1024)
+/** Most bytes queued for a client which does not read, it is dropped beyond */
+#define VIRT_STREAM_QUEUE_MAX (64 * 1024 * 1024)
+/** Bytes read from a socket at once */
+#define VIRT_STREAM_READ_SIZE (65536)
+/** Bytes of the length and the type of a frame */
+#define VIRT_STREAM_HEADER_SIZE (5)
+/** Bit of a domain data type in a column mask */
+#define VIRT_STREAM_COLUMN_BIT(type) (1U << (type))
+/** Columns of every subscription, the name identifies the rows */
+#define VIRT_STREAM_REQUIRED_COLUMNS (VIRT_STREAM_COLUMN_BIT(VIRT_DOMAIN_DATA_TYPE_NAME))
+
+/** Types of the frames. */
+typedef enum {
+    VIRT_STREAM_FRAME_SUBSCRIBE = 1,
+    VIRT_STREAM_FRAME_NODE,
+    VIRT_STREAM_FRAME_ORDER,
+    VIRT_STREAM_FRAME_ROW,
+    VIRT_STREAM_FRAME_COMMIT,
+    VIRT_STREAM_FRAME_RESET
+} virt_stream_frame_enum;
+
+/** Growable byte buffer of a connection. */
+typedef struct {
+    char    *data;
+    size_t  size;           /** Bytes in use */
+    size_t  capacity;       /** Bytes allocated */
+    size_t  offset;         /** Bytes already consumed from the front */
+    int     failed;         /** It could not grow, the connection is closed */
+} virt_stream_buffer;
+
+/** Connection of a client, on either end. */
+typedef struct {
+    int                 fd;             /** Socket, -1 if closed */
+    int                 subscribed;     /** A subscription was sent or received */
+    unsigned int        pending;        /** Subscriptions sent and not answered by a RESET yet */
+    unsigned int        columns;        /** Column mask of the subscription */
+    char                filter[VIRT_SNAPSHOT_CELL_SIZE]; /** Substring of the domain names, empty for all */
+    virt_snapshot_table *table;         /** Filtered table as the client holds it */
+    virt_stream_buffer  in;             /** Received bytes of incomplete frames */
+    virt_stream_buffer  out;            /** Bytes waiting to be sent */
+} virt_stream_client;
+
+/** Listening socket of a collector with its clients. */
+typedef struct {
+    int                 fd;             /** Listening socket, -1 if not listening */
+    char                *path;          /** Path of the socket, removed with the server */
+    virt_stream_client  *client;
+    size_t              client_size;
+    const virt_snapshot_table *table;   /** Last published snapshot, sent to new subscribers */
+} virt_stream_server;
+
+/**
+ * Set the server to default state, nothing is listening.
+ * @param server - server to be initialized
+ */
+void virt_init_stream_server(virt_stream_server *server);
+
+/**
+ * Close all connections and remove the socket.
+ * @param server - server to be released
+ * @param ev     - event sources the sockets are watched by
+ */
+void virt_deinit_stream_server(virt_stream_server *server, event_data *ev);
+
+/**
+ * Listen on a Unix socket, a stale socket of the same path is replaced.
+ * @param server - closed server
+ * @param path   - path of the socket
+ * @param ev     - event sources the sockets are watched by
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_stream_listen(virt_stream_server *server, const char *path, event_data *ev);
+
+/**
+ * Accept clients, read their subscriptions and send what is queued,
+ * called whenever a watched socket is ready.
+ * @param server - listening server
+ * @param ev     - event sources after event_wait
+ */
+void virt_stream_serve(virt_stream_server *server, event_data *ev);
+
+/**
+ * Queue the changes since the previous snapshot to every subscribed client.
+ * @param server - listening server
+ * @param table  - new snapshot
+ * @param ev     - event sources the sockets are watched by
+ */
+void virt_stream_publish(virt_stream_server *server, const virt_snapshot_table *table, event_data *ev);
+
+/**
+ * Set the client to default state, nothing is connected.
+ * @param client - client to be initialized
+ */
+void virt_init_stream_client(virt_stream_client *client);
+
+/**
+ * Close the connection and release the table.
+ * @param client - client to be released
+ * @param ev     - event sources the socket is watched by
+ */
+void virt_deinit_stream_client(virt_stream_client *client, event_data *ev);
+
+/**
+ * Connect to the socket of a collector.
+ * @param client - closed client
+ * @param path   - path of the socket
+ * @param ev     - event sources the socket is watched by
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_stream_connect(virt_stream_client *client, const char *path, event_data *ev);
+
+/**
+ * Subscribe to columns, the table is emptied and sent again whole once the
+ * collector answers with a RESET.
+ * @param client  - connected client
+ * @param columns - column mask, VIRT_STREAM_REQUIRED_COLUMNS are added
+ * @param filter  - substring of the domain names, empty for all
+ * @param ev      - event sources the socket is watched by
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE if the connection is gone
+ */
+int virt_stream_subscribe(virt_stream_client *client, unsigned int columns, const char *filter, event_data *ev);
+
+/**
+ * Read what the collector sent and apply complete frames to the table.
+ * @param client - connected client
+ * @param ev     - event sources after event_wait
+ * @return TRUE (1) if a snapshot was completed, FALSE (0) if not,
+ *         VIRT_ERROR_FAILURE if the connection is gone or broken
+ */
+int virt_stream_receive(virt_stream_client *client, event_data *ev);
+
+#endif /* VIRT_STREAM_H */
@@ -0,0 +1,492 @@
+/* This file contains the tracing layer wrapped around libvirt API calls
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_trace.h"
+#include "virt_errors.h"
+#include "utils.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+/** Initial number of slots in the per domain hash table */
+#define VIRT_TRACE_DOMAIN_INITIAL_SIZE (64)
+/** Suffix of the summary table file */
+#define VIRT_TRACE_SUMMARY_SUFFIX (".summary")
+
+const char *virt_trace_api_name[VIRT_TRACE_API_SIZE] = {
+    "virConnectOpen",
+    "virConnectListAllDomains",
+    "virConnectGetHostname",
+    "virConnectGetURI",
+    "virConnectGetLibVersion",
+    "virNodeGetInfo",
+    "virNodeGetFreeMemory",
+    "virDomainGetState",
+    "virDomainMemoryStats",
+    "virDomainGetAutostart",
+    "virDomainSetAutostart",
+    "virDomainCreate",
+    "virDomainResume",
+    "virDomainSuspend",
+    "virDomainReboot",
+    "virDomainDestroy",
+    "virDomainListGetStats",
+    "virDomainGetGuestInfo",
+    "virDomainLookupByUUID",
+    "virNodeGetCPUMap",
+    "virNodeGetCPUStats",
+    "virConnectGetCapabilities",
+    "virNodeGetCellsFreeMemory",
+    "virNodeGetFreePages",
+    "virDomainGetNumaParameters",
+    "virDomainGetVcpuPinInfo",
+    "virDomainGetVcpus",
+    "virDomainGetEmulatorPinInfo",
+    "virDomainGetIOThreadInfo",
+    "virDomainPinVcpuFlags",
+    "virDomainPinEmulator",
+    "virDomainPinIOThread",
+    "virConnectListAllStoragePools",
+    "virStoragePoolGetInfo",
+    "virStoragePoolNumOfVolumes",
+    "virStoragePoolListAllVolumes",
+    "virStorageVolGetInfo",
+    "virConnectListAllNetworks",
+    "virNetworkGetDHCPLeases",
+    "virDomainGetXMLDesc",
+    "virConnectGetAllDomainStats",
+    "virDomainSetMemoryStatsPeriod",
+    "virDomainGetJobInfo",
+    "virDomainGetJobStats",
+    "virDomainGetBlockJobInfo",
+    "virDomainBlockJobSetSpeed",
+    "virDomainStartDirtyRateCalc",
+    "virDomainSetPerfEvents",
+    "virDomainGetVcpusFlags",
+    "virNetworkGetBridgeName",
+    "virNetworkIsActive"
+};
+
+/** Histograms of a single domain, allocated on the first call of each API */
+typedef struct {
+    char                    *name;
+    virt_trace_histogram    *histogram[VIRT_TRACE_API_SIZE];
+} virt_trace_domain;
+
+/** Kinds of events kept for the trace-event timeline */
+typedef enum {
+    VIRT_TRACE_EVENT_CALL,
+    VIRT_TRACE_EVENT_TICK
+} virt_trace_event_enum;
+
+/** Single call or refresh tick kept for the trace-event timeline */
+typedef struct {
+    virt_trace_event_enum type;     /** Call or tick */
+    unsigned long long  begin;      /** Start of the event relative to trace origin */
+    unsigned long long  duration;   /** Latency of the call, duration of the tick */
+    const char          *domain;    /** Interned domain name, NULL for node calls */
+    virt_trace_api      api;        /** Called API */
+    int                 tid;        /** Calling thread */
+    int                 failed;     /** Non zero if the call failed or the tick overran */
+    long long           jitter;     /** Lateness of the tick */
+    unsigned long long  interval;   /** Refresh interval in use during the tick */
+} virt_trace_event;
+
+/** Row of the per domain summary table */
+typedef struct {
+    const char                  *domain;
+    virt_trace_api              api;
+    const virt_trace_histogram  *histogram;
+} virt_trace_row;
+
+/** State of the tracing layer */
+static struct {
+    int                     enabled;
+    unsigned long long      origin;
+    virt_trace_histogram    api[VIRT_TRACE_API_SIZE];
+    virt_trace_histogram    tick_jitter;
+    virt_trace_histogram    tick_duration;
+    virt_trace_domain       *domain;
+    size_t                  domain_capacity;
+    size_t                  domain_size;
+    virt_trace_event        *event;
+    unsigned long long      event_total;
+} trace;
+
+/** Guards recording, calls are traced from watchdog workers as well */
+static pthread_mutex_t virt_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+size_t virt_trace_histogram_bucket(unsigned long long value)
+{
+    if (value < VIRT_TRACE_HISTOGRAM_SUB_SIZE)
+        return value;
+
+    int msb = 63 - __builtin_clzll(value);
+    if (msb > VIRT_TRACE_HISTOGRAM_MAX_BITS)
+        return VIRT_TRACE_HISTOGRAM_SIZE - 1;
+
+    return (msb - VIRT_TRACE_HISTOGRAM_SUB_BITS + 1) * VIRT_TRACE_HISTOGRAM_SUB_SIZE +
+           ((value >> (msb - VIRT_TRACE_HISTOGRAM_SUB_BITS)) & (VIRT_TRACE_HISTOGRAM_SUB_SIZE - 1));
+}
+
+unsigned long long virt_trace_histogram_value(size_t bucket)
+{
+    if (bucket < VIRT_TRACE_HISTOGRAM_SUB_SIZE)
+        return bucket;
+
+    size_t range = bucket / VIRT_TRACE_HISTOGRAM_SUB_SIZE - 1;
+    size_t sub   = bucket % VIRT_TRACE_HISTOGRAM_SUB_SIZE;
+
+    return (unsigned long long)(VIRT_TRACE_HISTOGRAM_SUB_SIZE + sub) << range;
+}
+
+unsigned long long virt_trace_histogram_percentile(const virt_trace_histogram *histogram, double percentile)
+{
+    if (histogram->count == 0)
+        return 0;
+
+    unsigned long long target = (unsigned long long)(histogram->count * percentile / 100.0 + 0.5);
+    if (target == 0)
+        target = 1;
+
+    unsigned long long seen = 0;
+    for (size_t i = 0; i != VIRT_TRACE_HISTOGRAM_SIZE; ++i) {
+        seen += histogram->bucket[i];
+        if (seen >= target) {
+            /* report the highest value of the bucket, but never above max */
+            unsigned long long value = virt_trace_histogram_value(i + 1) - 1;
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+static void virt_trace_histogram_record(virt_trace_histogram *histogram, unsigned long long value, int failed)
+{
+    ++histogram->bucket[virt_trace_histogram_bucket(value)];
+    if (histogram->count == 0 || value < histogram->min)
+        histogram->min = value;
+    if (value > histogram->max)
+        histogram->max = value;
+    histogram->sum += value;
+    ++histogram->count;
+    if (failed)
+        ++histogram->failed;
+}
+
+/* FNV-1a string hash */
+static size_t virt_trace_hash(const char *str)
+{
+    size_t hash = 2166136261u;
+    for (; *str; ++str)
+        hash = (hash ^ (unsigned char)*str) * 16777619u;
+    return hash;
+}
+
+static virt_trace_domain *virt_trace_domain_slot(virt_trace_domain *table, size_t capacity, const char *name)
+{
+    size_t index = virt_trace_hash(name) & (capacity - 1);
+    while (table[index].name && strcmp(table[index].name, name) != 0)
+        index = (index + 1) & (capacity - 1);
+    return table + index;
+}
+
+static int virt_trace_domain_grow()
+{
+    size_t capacity = trace.domain_capacity * 2;
+    virt_trace_domain *table = calloc(capacity, sizeof(virt_trace_domain));
+    if (!table)
+        return VIRT_ERROR_FAILURE;
+
+    for (size_t i = 0; i != trace.domain_capacity; ++i)
+        if (trace.domain[i].name)
+            *virt_trace_domain_slot(table, capacity, trace.domain[i].name) = trace.domain[i];
+
+    free(trace.domain);
+    trace.domain            = table;
+    trace.domain_capacity   = capacity;
+    return VIRT_ERROR_SUCCESS;
+}
+
+static virt_trace_domain *virt_trace_domain_find(const char *name)
+{
+    /* keep the load factor of the table below one half */
+    if ((trace.domain_size + 1) * 2 > trace.domain_capacity)
+        if (virt_trace_domain_grow() != VIRT_ERROR_SUCCESS)
+            return NULL;
+
+    virt_trace_domain *slot = virt_trace_domain_slot(trace.domain, trace.domain_capacity, name);
+    if (!slot->name) {
+        slot->name = copy_str(name);
+        ++trace.domain_size;
+    }
+    return slot;
+}
+
+int virt_trace_init()
+{
+    memset(&trace, 0, sizeof(trace));
+
+    trace.domain_capacity   = VIRT_TRACE_DOMAIN_INITIAL_SIZE;
+    trace.domain            = calloc(trace.domain_capacity, sizeof(virt_trace_domain));
+    trace.event             = calloc(VIRT_TRACE_EVENTS_SIZE, sizeof(virt_trace_event));
+    if (!trace.domain || !trace.event) {
+        virt_trace_deinit();
+        return VIRT_ERROR_FAILURE;
+    }
+
+    trace.origin    = time_monotonic_us();
+    trace.enabled   = 1;
+    return VIRT_ERROR_SUCCESS;
+}
+
+void virt_trace_deinit()
+{
+    pthread_mutex_lock(&virt_trace_lock);
+    for (size_t i = 0; i != trace.domain_capacity; ++i) {
+        if (!trace.domain[i].name)
+            continue;
+        for (int j = 0; j != VIRT_TRACE_API_SIZE; ++j)
+            free(trace.domain[i].histogram[j]);
+        free(trace.domain[i].name);
+    }
+    free(trace.domain);
+    free(trace.event);
+    memset(&trace, 0, sizeof(trace));
+    pthread_mutex_unlock(&virt_trace_lock);
+}
+
+int virt_trace_enabled()
+{
+    return trace.enabled;
+}
+
+unsigned long long virt_trace_begin()
+{
+    virt_errors_enter();
+    return trace.enabled ? time_monotonic_us() : 0;
+}
+
+void virt_trace_end(virt_trace_api api, virDomainPtr domain, unsigned long long begin, int failed)
+{
+    /* errors are aggregated whether tracing is enabled or not */
+    virt_errors_leave(api, domain, failed);
+    if (!trace.enabled)
+        return;
+
+    unsigned long long duration = time_monotonic_us() - begin;
+
+    pthread_mutex_lock(&virt_trace_lock);
+    if (!trace.enabled) {
+        pthread_mutex_unlock(&virt_trace_lock);
+        return;
+    }
+    virt_trace_histogram_record(trace.api + api, duration, failed);
+
+    /* virDomainGetName does not make a remote call */
+    const char *name = NULL;
+    if (domain) {
+        virt_trace_domain *entry = virt_trace_domain_find(virDomainGetName(domain));
+        if (entry) {
+            if (!entry->histogram[api])
+                entry->histogram[api] = calloc(1, sizeof(virt_trace_histogram));
+            if (entry->histogram[api])
+                virt_trace_histogram_record(entry->histogram[api], duration, failed);
+            name = entry->name;
+        }
+    }
+
+    virt_trace_event *event = trace.event + (trace.event_total++ % VIRT_TRACE_EVENTS_SIZE);
+    event->type     = VIRT_TRACE_EVENT_CALL;
+    event->begin    = begin - trace.origin;
+    event->duration = duration;
+    event->domain   = name;
+    event->api      = api;
+    event->tid      = (int)syscall(SYS_gettid);
+    event->failed   = failed;
+    pthread_mutex_unlock(&virt_trace_lock);
+}
+
+void virt_trace_tick(unsigned long long begin, unsigned long long duration,
+                     long long jitter, unsigned long long interval, int overrun)
+{
+    if (!trace.enabled)
+        return;
+
+    pthread_mutex_lock(&virt_trace_lock);
+    /* early ticks only happen on clock adjustments, count them as punctual */
+    virt_trace_histogram_record(&trace.tick_jitter, jitter > 0 ? jitter : 0, overrun);
+    virt_trace_histogram_record(&trace.tick_duration, duration, overrun);
+
+    virt_trace_event *event = trace.event + (trace.event_total++ % VIRT_TRACE_EVENTS_SIZE);
+    event->type     = VIRT_TRACE_EVENT_TICK;
+    event->begin    = begin - trace.origin;
+    event->duration = duration;
+    event->domain   = NULL;
+    event->tid      = (int)syscall(SYS_gettid);
+    event->failed   = overrun;
+    event->jitter   = jitter;
+    event->interval = interval;
+    pthread_mutex_unlock(&virt_trace_lock);
+}
+
+static void virt_trace_write_json_string(FILE *file, const char *str)
+{
+    fputc('"', file);
+    for (; *str; ++str) {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\')
+            fprintf(file, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(file, "\\u%04x", c);
+        else
+            fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+static int virt_trace_write_json(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+        return VIRT_ERROR_FAILURE;
+
+    int pid = (int)getpid();
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"virt-htop\"}}", pid);
+
+    /* the ring buffer keeps only the most recent events, start from the oldest */
+    unsigned long long first = trace.event_total > VIRT_TRACE_EVENTS_SIZE ?
+                               trace.event_total - VIRT_TRACE_EVENTS_SIZE : 0;
+    for (unsigned long long i = first; i != trace.event_total; ++i) {
+        const virt_trace_event *event = trace.event + (i % VIRT_TRACE_EVENTS_SIZE);
+        if (event->type == VIRT_TRACE_EVENT_TICK) {
+            fprintf(file, ",\n{\"name\":\"tick\",\"cat\":\"scheduler\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,"
+                          "\"pid\":%d,\"tid\":%d,\"args\":{\"jitter\":%lld,\"interval\":%llu,\"overrun\":%s}}",
+                    event->begin, event->duration, pid, event->tid,
+                    event->jitter, event->interval, event->failed ? "true" : "false");
+            continue;
+        }
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"libvirt\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,"
+                      "\"pid\":%d,\"tid\":%d,\"args\":{\"failed\":%s",
+                virt_trace_api_name[event->api], event->begin, event->duration,
+                pid, event->tid, event->failed ? "true" : "false");
+        if (event->domain) {
+            fprintf(file, ",\"domain\":");
+            virt_trace_write_json_string(file, event->domain);
+        }
+        fprintf(file, "}}");
+    }
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0 ? VIRT_ERROR_SUCCESS : VIRT_ERROR_FAILURE;
+}
+
+static void virt_trace_write_histogram(FILE *file, const virt_trace_histogram *histogram)
+{
+    fprintf(file, "%10llu %8llu %10llu %10llu %10llu %10llu %10llu\n",
+            histogram->count, histogram->failed,
+            histogram->sum / histogram->count,
+            virt_trace_histogram_percentile(histogram, 50.0),
+            virt_trace_histogram_percentile(histogram, 90.0),
+            virt_trace_histogram_percentile(histogram, 99.0),
+            histogram->max);
+}
+
+/* slowest calls first */
+static int virt_trace_row_compare(const void *lhs, const void *rhs)
+{
+    const virt_trace_row *a = lhs;
+    const virt_trace_row *b = rhs;
+    if (a->histogram->max != b->histogram->max)
+        return a->histogram->max < b->histogram->max ? 1 : -1;
+    return 0;
+}
+
+static int virt_trace_write_summary(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+        return VIRT_ERROR_FAILURE;
+
+    fprintf(file, "Latency of libvirt calls in microseconds\n\n");
+    fprintf(file, "%-28s %10s %8s %10s %10s %10s %10s %10s\n",
+            "API", "CALLS", "FAILED", "MEAN", "P50", "P90", "P99", "MAX");
+    for (int i = 0; i != VIRT_TRACE_API_SIZE; ++i) {
+        if (trace.api[i].count == 0)
+            continue;
+        fprintf(file, "%-28s ", virt_trace_api_name[i]);
+        virt_trace_write_histogram(file, trace.api + i);
+    }
+
+    if (trace.tick_duration.count > 0) {
+        fprintf(file, "\n%-28s %10s %8s %10s %10s %10s %10s %10s\n",
+                "REFRESH", "TICKS", "OVERRUN", "MEAN", "P50", "P90", "P99", "MAX");
+        fprintf(file, "%-28s ", "tick jitter");
+        virt_trace_write_histogram(file, &trace.tick_jitter);
+        fprintf(file, "%-28s ", "tick duration");
+        virt_trace_write_histogram(file, &trace.tick_duration);
+    }
+
+    /* gather per domain histograms and sort them by the slowest call */
+    size_t row_size = 0;
+    virt_trace_row *row = calloc(trace.domain_size * VIRT_TRACE_API_SIZE + 1, sizeof(virt_trace_row));
+    if (row) {
+        for (size_t i = 0; i != trace.domain_capacity; ++i)
+            for (int j = 0; trace.domain[i].name && j != VIRT_TRACE_API_SIZE; ++j)
+                if (trace.domain[i].histogram[j]) {
+                    row[row_size].domain    = trace.domain[i].name;
+                    row[row_size].api       = j;
+                    row[row_size].histogram = trace.domain[i].histogram[j];
+                    ++row_size;
+                }
+        qsort(row, row_size, sizeof(virt_trace_row), virt_trace_row_compare);
+
+        fprintf(file, "\n%-24s %-28s %10s %8s %10s %10s %10s %10s %10s\n",
+                "DOMAIN", "API", "CALLS", "FAILED", "MEAN", "P50", "P90", "P99", "MAX");
+        for (size_t i = 0; i != row_size; ++i) {
+            fprintf(file, "%-24s %-28s ", row[i].domain, virt_trace_api_name[row[i].api]);
+            virt_trace_write_histogram(file, row[i].histogram);
+        }
+        free(row);
+    }
+
+    return fclose(file) == 0 ? VIRT_ERROR_SUCCESS : VIRT_ERROR_FAILURE;
+}
+
+int virt_trace_write(const char *path)
+{
+    if (!trace.enabled || !path)
+        return VIRT_ERROR_FAILURE;
+
+    char *summary = malloc(strlen(path) + sizeof(VIRT_TRACE_SUMMARY_SUFFIX));
+    if (!summary)
+        return VIRT_ERROR_FAILURE;
+    strcpy(summary, path);
+    strcat(summary, VIRT_TRACE_SUMMARY_SUFFIX);
+
+    /* workers left behind in hung calls may still record */
+    pthread_mutex_lock(&virt_trace_lock);
+    int res = virt_trace_write_json(path);
+    if (virt_trace_write_summary(summary) != VIRT_ERROR_SUCCESS)
+        res = VIRT_ERROR_FAILURE;
+    pthread_mutex_unlock(&virt_trace_lock);
+
+    free(summary);
+    return res;
+}
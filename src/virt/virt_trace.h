@@ -0,0 +1,193 @@
+/* This file contains the tracing layer wrapped around libvirt API calls
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_trace.h
+ * This file contains the tracing layer wrapped around libvirt API calls.
+ * Every traced call is counted and its latency is stored in a log-linear
+ * (HDR-style) histogram, once per API and once per (API, domain) pair.
+ * Refresh ticks of the main loop are recorded as well, to expose jitter
+ * and overruns of the schedule.
+ */
+#ifndef VIRT_TRACE_H
+#define VIRT_TRACE_H
+#include "virt.h"
+/** Number of traced libvirt entry points */
+#define VIRT_TRACE_API_SIZE (51)
+/** log2 of the number of linear sub-buckets within each power of two */
+#define VIRT_TRACE_HISTOGRAM_SUB_BITS (3)
+/** Number of linear sub-buckets within each power of two */
+#define VIRT_TRACE_HISTOGRAM_SUB_SIZE (1 << VIRT_TRACE_HISTOGRAM_SUB_BITS)
+/** Highest power of two tracked by a histogram, 2^36us is roughly 19 hours */
+#define VIRT_TRACE_HISTOGRAM_MAX_BITS (36)
+/** Number of buckets in a histogram */
+#define VIRT_TRACE_HISTOGRAM_SIZE \
+    ((VIRT_TRACE_HISTOGRAM_MAX_BITS - VIRT_TRACE_HISTOGRAM_SUB_BITS + 2) * VIRT_TRACE_HISTOGRAM_SUB_SIZE)
+/** Number of most recent calls kept for the trace-event timeline */
+#define VIRT_TRACE_EVENTS_SIZE (1 << 16)
+
+/**
+ * Traced libvirt entry points.
+ * @see virt_trace_api_name
+ */
+typedef enum {
+    VIRT_TRACE_API_CONNECT_OPEN,
+    VIRT_TRACE_API_CONNECT_LIST_ALL_DOMAINS,
+    VIRT_TRACE_API_CONNECT_GET_HOSTNAME,
+    VIRT_TRACE_API_CONNECT_GET_URI,
+    VIRT_TRACE_API_CONNECT_GET_LIB_VERSION,
+    VIRT_TRACE_API_NODE_GET_INFO,
+    VIRT_TRACE_API_NODE_GET_FREE_MEMORY,
+    VIRT_TRACE_API_DOMAIN_GET_STATE,
+    VIRT_TRACE_API_DOMAIN_MEMORY_STATS,
+    VIRT_TRACE_API_DOMAIN_GET_AUTOSTART,
+    VIRT_TRACE_API_DOMAIN_SET_AUTOSTART,
+    VIRT_TRACE_API_DOMAIN_CREATE,
+    VIRT_TRACE_API_DOMAIN_RESUME,
+    VIRT_TRACE_API_DOMAIN_SUSPEND,
+    VIRT_TRACE_API_DOMAIN_REBOOT,
+    VIRT_TRACE_API_DOMAIN_DESTROY,
+    VIRT_TRACE_API_DOMAIN_LIST_GET_STATS,
+    VIRT_TRACE_API_DOMAIN_GET_GUEST_INFO,
+    VIRT_TRACE_API_DOMAIN_LOOKUP_BY_UUID,
+    VIRT_TRACE_API_NODE_GET_CPU_MAP,
+    VIRT_TRACE_API_NODE_GET_CPU_STATS,
+    VIRT_TRACE_API_CONNECT_GET_CAPABILITIES,
+    VIRT_TRACE_API_NODE_GET_CELLS_FREE_MEMORY,
+    VIRT_TRACE_API_NODE_GET_FREE_PAGES,
+    VIRT_TRACE_API_DOMAIN_GET_NUMA_PARAMETERS,
+    VIRT_TRACE_API_DOMAIN_GET_VCPU_PIN_INFO,
+    VIRT_TRACE_API_DOMAIN_GET_VCPUS,
+    VIRT_TRACE_API_DOMAIN_GET_EMULATOR_PIN_INFO,
+    VIRT_TRACE_API_DOMAIN_GET_IOTHREAD_INFO,
+    VIRT_TRACE_API_DOMAIN_PIN_VCPU_FLAGS,
+    VIRT_TRACE_API_DOMAIN_PIN_EMULATOR,
+    VIRT_TRACE_API_DOMAIN_PIN_IOTHREAD,
+    VIRT_TRACE_API_CONNECT_LIST_ALL_STORAGE_POOLS,
+    VIRT_TRACE_API_STORAGE_POOL_GET_INFO,
+    VIRT_TRACE_API_STORAGE_POOL_NUM_OF_VOLUMES,
+    VIRT_TRACE_API_STORAGE_POOL_LIST_ALL_VOLUMES,
+    VIRT_TRACE_API_STORAGE_VOL_GET_INFO,
+    VIRT_TRACE_API_CONNECT_LIST_ALL_NETWORKS,
+    VIRT_TRACE_API_NETWORK_GET_DHCP_LEASES,
+    VIRT_TRACE_API_DOMAIN_GET_XML_DESC,
+    VIRT_TRACE_API_CONNECT_GET_ALL_DOMAIN_STATS,
+    VIRT_TRACE_API_DOMAIN_SET_MEMORY_STATS_PERIOD,
+    VIRT_TRACE_API_DOMAIN_GET_JOB_INFO,
+    VIRT_TRACE_API_DOMAIN_GET_JOB_STATS,
+    VIRT_TRACE_API_DOMAIN_GET_BLOCK_JOB_INFO,
+    VIRT_TRACE_API_DOMAIN_BLOCK_JOB_SET_SPEED,
+    VIRT_TRACE_API_DOMAIN_START_DIRTY_RATE_CALC,
+    VIRT_TRACE_API_DOMAIN_SET_PERF_EVENTS,
+    VIRT_TRACE_API_DOMAIN_GET_VCPUS_FLAGS,
+    VIRT_TRACE_API_NETWORK_GET_BRIDGE_NAME,
+    VIRT_TRACE_API_NETWORK_IS_ACTIVE
+} virt_trace_api_enum;
+
+/** @see virt_trace_api_enum */
+typedef virt_trace_api_enum virt_trace_api;
+
+/** Names of the traced libvirt entry points, as printed in the reports */
+const char *virt_trace_api_name[VIRT_TRACE_API_SIZE];
+
+/** Log-linear latency histogram, values are stored in microseconds. */
+typedef struct {
+    unsigned int        bucket[VIRT_TRACE_HISTOGRAM_SIZE];  /** Number of calls per bucket */
+    unsigned long long  count;                              /** Number of recorded calls */
+    unsigned long long  failed;                             /** Number of calls that returned an error */
+    unsigned long long  sum;                                /** Sum of all latencies */
+    unsigned long long  min;                                /** Fastest call */
+    unsigned long long  max;                                /** Slowest call */
+} virt_trace_histogram;
+
+/**
+ * Return index of the histogram bucket that holds value.
+ * @param value - latency in microseconds
+ * @return bucket index
+ */
+size_t virt_trace_histogram_bucket(unsigned long long value);
+
+/**
+ * Return the lowest value that falls into given bucket.
+ * @param bucket - bucket index
+ * @return latency in microseconds
+ */
+unsigned long long virt_trace_histogram_value(size_t bucket);
+
+/**
+ * Return the latency below which the given percentage of calls fall.
+ * @param histogram - histogram to be queried
+ * @param percentile - percentile in range [0, 100]
+ * @return latency in microseconds
+ */
+unsigned long long virt_trace_histogram_percentile(const virt_trace_histogram *histogram, double percentile);
+
+/**
+ * Enable the tracing layer. Without this call virt_trace_begin and
+ * virt_trace_end only pass failed calls to the error aggregation.
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_trace_init();
+
+/** Release all the data gathered by the tracing layer. */
+void virt_trace_deinit();
+
+/**
+ * Check whether the tracing layer is enabled.
+ * @return TRUE (1) if enabled, FALSE (0) otherwise
+ */
+int virt_trace_enabled();
+
+/**
+ * Mark the beginning of a libvirt call.
+ * @return opaque timestamp to be passed to virt_trace_end
+ * @see virt_trace_end
+ */
+unsigned long long virt_trace_begin();
+
+/**
+ * Mark the end of a libvirt call and record its latency,
+ * the error of a failed call is aggregated as well.
+ * @param api    - traced libvirt entry point
+ * @param domain - domain the call was made for, NULL for node calls
+ * @param begin  - value returned by virt_trace_begin
+ * @param failed - non zero if the call returned an error
+ * @see virt_trace_begin
+ */
+void virt_trace_end(virt_trace_api api, virDomainPtr domain, unsigned long long begin, int failed);
+
+/**
+ * Record a refresh tick of the main loop.
+ * @param begin    - monotonic time the tick started, in microseconds
+ * @param duration - time the tick took, in microseconds
+ * @param jitter   - lateness of the tick relative to its deadline, in microseconds
+ * @param interval - refresh interval in use, in microseconds
+ * @param overrun  - non zero if the tick missed the following deadline
+ */
+void virt_trace_tick(unsigned long long begin, unsigned long long duration,
+                     long long jitter, unsigned long long interval, int overrun);
+
+/**
+ * Write the recorded calls as a Chrome trace-event JSON timeline into path
+ * and the per API, per domain summary table into path.summary.
+ * @param path - output file
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_trace_write(const char *path);
+
+#endif /* VIRT_TRACE_H */
@@ -0,0 +1,271 @@
+/* This file contains the vCPU mode, domains expanded into per-vCPU rows
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_vcpu.h"
+#include "virt_domain.h"
+#include "virt_node.h"
+#include "virt_plan.h"
+#include "virt_health.h"
+#include "utils.h"
+#include <stdio.h>
+
+unsigned int virt_vcpu_type_groups[VIRT_VCPU_DATA_TYPE_SIZE] = {
+    VIRT_GROUP_BIT(VIRT_GROUP_STATIC),      /* DOMAIN */
+    VIRT_GROUP_BIT(VIRT_GROUP_VCPU),        /* VCPU */
+    VIRT_GROUP_BIT(VIRT_GROUP_VCPU),        /* STATE */
+    VIRT_GROUP_BIT(VIRT_GROUP_PLACEMENT),   /* CPU */
+    VIRT_GROUP_BIT(VIRT_GROUP_VCPU),        /* TIME_PRC */
+    VIRT_GROUP_BIT(VIRT_GROUP_VCPU),        /* WAIT_PRC */
+    VIRT_GROUP_BIT(VIRT_GROUP_VCPU),        /* HALTED */
+    VIRT_GROUP_BIT(VIRT_GROUP_PLACEMENT)    /* PINNING */
+};
+
+/** vCPU states of the bulk statistics, indexed by VIR_VCPU_* */
+static const char *virt_vcpu_state_text[] = {
+    "offline",
+    "running",
+    "blocked"
+};
+
+void virt_init_vcpu_view(virt_vcpu_view *view)
+{
+    view->all       = 0;
+    memset(view->uuid, 0, VIR_UUID_BUFLEN);
+    view->row       = NULL;
+    view->row_size  = 0;
+}
+
+void virt_deinit_vcpu_view(virt_vcpu_view *view)
+{
+    free(view->row);
+}
+
+void virt_vcpu_expand(virt_data *virt, int index, int all)
+{
+    virt->vcpu->all = all;
+    if (!all && index >= 0 && index < virt->records->record_size)
+        memcpy(virt->vcpu->uuid, virt->records->record[index].uuid, VIR_UUID_BUFLEN);
+}
+
+int virt_vcpu_shows(const virt_vcpu_view *view, const virt_domain_record *record)
+{
+    if (view->all)
+        return record->id >= 0;
+    return memcmp(view->uuid, record->uuid, VIR_UUID_BUFLEN) == 0;
+}
+
+void virt_vcpu_reserve(virt_domain_record *record, int size)
+{
+    if (size <= record->vcpu_size)
+        return;
+
+    virt_vcpu_record *vcpu = realloc(record->vcpu, size * sizeof(virt_vcpu_record));
+    if (!vcpu)
+        return;
+
+    for (int i = record->vcpu_size; i != size; ++i) {
+        memset(vcpu + i, 0, sizeof(virt_vcpu_record));
+        vcpu[i].halted      = -1;
+        vcpu[i].wait_prc    = -1;
+        vcpu[i].cpu         = -1;
+    }
+    record->vcpu        = vcpu;
+    record->vcpu_size   = size;
+}
+
+void virt_vcpu_merge_stats(virt_domain_record *record, virTypedParameterPtr params,
+                           int nparams, unsigned long long now)
+{
+    unsigned int current = 0, maximum = 0;
+    virTypedParamsGetUInt(params, nparams, "vcpu.current", &current);
+    virTypedParamsGetUInt(params, nparams, "vcpu.maximum", &maximum);
+    virt_vcpu_reserve(record, maximum > current ? maximum : current);
+
+    /* vCPUs which were online at the previous sample have a rate */
+    int previous = record->updated[VIRT_GROUP_VCPU] ? record->vcpu_current : 0;
+    unsigned long long elapsed = now - record->updated[VIRT_GROUP_VCPU];
+
+    for (int i = 0; i < record->vcpu_size; ++i) {
+        record->vcpu[i].halted      = -1;
+        record->vcpu[i].wait_prc    = -1;
+    }
+
+    /* a single pass, looking every field up by name would scan the list once per vCPU */
+    for (int i = 0; i != nparams; ++i) {
+        if (strncmp(params[i].field, "vcpu.", 5) != 0)
+            continue;
+
+        char *field = NULL;
+        long n = strtol(params[i].field + 5, &field, 10);
+        if (field == params[i].field + 5 || *field != '.' || n < 0 || n >= record->vcpu_size)
+            continue;
+        ++field;
+
+        virt_vcpu_record *vcpu = record->vcpu + n;
+        if (strcmp(field, "state") == 0 && params[i].type == VIR_TYPED_PARAM_INT) {
+            vcpu->state = params[i].value.i;
+        } else if (strcmp(field, "time") == 0 && params[i].type == VIR_TYPED_PARAM_ULLONG) {
+            vcpu->time_prc = n < previous ?
+                             virt_domain_rate(params[i].value.ul, vcpu->time, elapsed) / 1e9 * 100.0 : 0;
+            vcpu->time = params[i].value.ul;
+        } else if (strcmp(field, "wait") == 0 && params[i].type == VIR_TYPED_PARAM_ULLONG) {
+            vcpu->wait_prc = n < previous && vcpu->wait ?
+                             virt_domain_rate(params[i].value.ul, vcpu->wait, elapsed) / 1e9 * 100.0 : 0;
+            vcpu->wait = params[i].value.ul;
+        } else if (strcmp(field, "halted") == 0 && params[i].type == VIR_TYPED_PARAM_BOOLEAN) {
+            vcpu->halted = params[i].value.b != 0;
+        }
+    }
+
+    record->vcpu_current = (int)current < record->vcpu_size ? (int)current : record->vcpu_size;
+    record->updated[VIRT_GROUP_VCPU] = now;
+}
+
+int virt_vcpu_row(virt_data *virt, int index)
+{
+    if (index < 0 || index >= virt->vcpu->row_size)
+        return -1;
+    return (int)virt->vcpu->row[index];
+}
+
+/* Number of rows of the expanded record, a domain with unknown vCPUs still gets one */
+static int virt_vcpu_rows(const virt_domain_record *record)
+{
+    return record->vcpu_current > 0 && record->id >= 0 ? record->vcpu_current : 1;
+}
+
+/* Describe the host CPUs the vCPU may run on, VIRT_VCPU_UNPINNED if it is not pinned */
+static char *virt_vcpu_pin_str(const virt_vcpu_record *vcpu, const virt_node_cache *cache)
+{
+    int unpinned = cache->cpu_size > 0;
+    for (int cpu = 0; cpu != cache->cpu_size && cpu < VIRT_NODE_CPUMAP_LEN * 8 && unpinned; ++cpu)
+        unpinned = VIR_CPU_USED(vcpu->pin, cpu) != 0;
+    if (unpinned)
+        return copy_str(VIRT_VCPU_UNPINNED);
+
+    char buf[256];
+    virt_node_cpumap_str(vcpu->pin, cache->cpu_size ? cache->cpu_size : VIRT_NODE_CPUMAP_LEN * 8,
+                         buf, sizeof(buf));
+    return copy_str(buf[0] ? buf : VIRT_DOMAIN_UNKNOWN_DATA);
+}
+
+/* Render a single vCPU row, vcpu is NULL for a domain whose vCPUs are not known yet */
+static void virt_vcpu_render_row(virt_data *virt, virt_vcpu_data *data, size_t row,
+                                 size_t record_row, const virt_vcpu_record *vcpu, int number)
+{
+    virt_record_data *records = virt->records;
+    const virt_domain_record *record = records->record + record_row;
+
+    /* the last snapshot stays on the screen while disconnected, all of it is stale */
+    int offline         = !virt_health_connected(virt);
+    int stale_vcpu      = offline || virt_plan_stale(records, record_row, VIRT_GROUP_VCPU);
+    int stale_placement = offline || virt_plan_stale(records, record_row, VIRT_GROUP_PLACEMENT);
+    int placed          = vcpu && record->updated[VIRT_GROUP_PLACEMENT];
+
+    data->vcpu_data[VIRT_VCPU_DATA_TYPE_DOMAIN][row]    = copy_str(record->name ? record->name :
+                                                                   VIRT_DOMAIN_UNKNOWN_DATA);
+    if (!vcpu) {
+        for (int i = VIRT_VCPU_DATA_TYPE_VCPU; i != VIRT_VCPU_DATA_TYPE_SIZE; ++i)
+            data->vcpu_data[i][row] = copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+        return;
+    }
+
+    data->vcpu_data[VIRT_VCPU_DATA_TYPE_VCPU][row]      = int_to_str(number);
+    data->vcpu_data[VIRT_VCPU_DATA_TYPE_STATE][row]     = virt_domain_stale_str(copy_str(
+                                                          vcpu->state >= VIR_VCPU_OFFLINE && vcpu->state <= VIR_VCPU_BLOCKED ?
+                                                          virt_vcpu_state_text[vcpu->state] : VIRT_DOMAIN_UNKNOWN_DATA), stale_vcpu);
+    data->vcpu_data[VIRT_VCPU_DATA_TYPE_TIME_PRC][row]  = virt_domain_stale_str(double_to_str(vcpu->time_prc), stale_vcpu);
+    data->vcpu_data[VIRT_VCPU_DATA_TYPE_WAIT_PRC][row]  = vcpu->wait_prc >= 0 ?
+                                                          virt_domain_stale_str(double_to_str(vcpu->wait_prc), stale_vcpu) :
+                                                          copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->vcpu_data[VIRT_VCPU_DATA_TYPE_HALTED][row]    = vcpu->halted >= 0 ?
+                                                          virt_domain_stale_str(copy_str(vcpu->halted ? "yes" : "no"), stale_vcpu) :
+                                                          copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->vcpu_data[VIRT_VCPU_DATA_TYPE_CPU][row]       = placed && vcpu->cpu >= 0 ?
+                                                          virt_domain_stale_str(int_to_str(vcpu->cpu), stale_placement) :
+                                                          copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+    data->vcpu_data[VIRT_VCPU_DATA_TYPE_PINNING][row]   = placed ?
+                                                          virt_domain_stale_str(virt_vcpu_pin_str(vcpu, virt->node), stale_placement) :
+                                                          copy_str(VIRT_DOMAIN_UNKNOWN_DATA);
+}
+
+void *virt_get_vcpu_data(virt_data *virt)
+{
+    virt_refresh_domain_records(virt);
+
+    virt_record_data *records = virt->records;
+    virt_vcpu_view *view = virt->vcpu;
+
+    size_t size = 0;
+    for (size_t i = 0; i != records->record_size; ++i)
+        if (virt_vcpu_shows(view, records->record + i))
+            size += virt_vcpu_rows(records->record + i);
+
+    virt_vcpu_data *data = malloc(sizeof(virt_vcpu_data));
+    data->vcpu_size = size;
+    /* last item counts as NULL */
+    for (int i = 0; i != VIRT_VCPU_DATA_TYPE_SIZE; ++i)
+        data->vcpu_data[i] = calloc(size + 1, sizeof(char *));
+
+    free(view->row);
+    view->row       = calloc(size + 1, sizeof(size_t));
+    view->row_size  = size;
+
+    size_t row = 0;
+    for (size_t i = 0; i != records->record_size; ++i) {
+        virt_domain_record *record = records->record + i;
+        if (!virt_vcpu_shows(view, record))
+            continue;
+
+        int rows = virt_vcpu_rows(record);
+        for (int j = 0; j != rows; ++j, ++row) {
+            view->row[row] = i;
+            virt_vcpu_render_row(virt, data, row, i,
+                                 record->vcpu_current > 0 && record->id >= 0 ? record->vcpu + j : NULL, j);
+        }
+    }
+    ++data->vcpu_size;
+
+    return data;
+}
+
+void virt_vcpu_autostart_wrapper(virt_data *virt, int index)
+{
+    virt_domain_autostart_wrapper(virt, virt_vcpu_row(virt, index));
+}
+
+void virt_vcpu_create_wrapper(virt_data *virt, int index)
+{
+    virt_domain_create_wrapper(virt, virt_vcpu_row(virt, index));
+}
+
+void virt_vcpu_pause_wrapper(virt_data *virt, int index)
+{
+    virt_domain_pause_wrapper(virt, virt_vcpu_row(virt, index));
+}
+
+void virt_vcpu_reboot_wrapper(virt_data *virt, int index)
+{
+    virt_domain_reboot_wrapper(virt, virt_vcpu_row(virt, index));
+}
+
+void virt_vcpu_destroy_wrapper(virt_data *virt, int index)
+{
+    virt_domain_destroy_wrapper(virt, virt_vcpu_row(virt, index));
+}
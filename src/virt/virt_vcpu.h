@@ -0,0 +1,168 @@
+/* This file contains the vCPU mode, domains expanded into per-vCPU rows
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_vcpu.h
+ * This file contains the vCPU mode. The selected domain, or every active
+ * domain, is expanded into one row per vCPU. Time, wait and halted state of
+ * the vCPUs come with the bulk statistics call, the host CPU and the pinning
+ * are fetched per domain, for the expanded domains only.
+ */
+#ifndef VIRT_VCPU_H
+#define VIRT_VCPU_H
+#include "virt.h"
+#include "virt_record.h"
+/** Number of possible vCPU data types */
+#define VIRT_VCPU_DATA_TYPE_SIZE (8)
+/** Pinning shown for vCPUs which may run on every host CPU */
+#define VIRT_VCPU_UNPINNED ("all")
+
+/**
+ * Indecies of the virt_vcpu_data array.
+ * @see virt_vcpu_data
+ */
+typedef enum {
+    VIRT_VCPU_DATA_TYPE_DOMAIN,
+    VIRT_VCPU_DATA_TYPE_VCPU,
+    VIRT_VCPU_DATA_TYPE_STATE,
+    VIRT_VCPU_DATA_TYPE_CPU,
+    VIRT_VCPU_DATA_TYPE_TIME_PRC,
+    VIRT_VCPU_DATA_TYPE_WAIT_PRC,
+    VIRT_VCPU_DATA_TYPE_HALTED,
+    VIRT_VCPU_DATA_TYPE_PINNING
+} virt_vcpu_data_type_enum;
+
+/** @see virt_vcpu_data_type_enum */
+typedef virt_vcpu_data_type_enum vcpu_type;
+
+/** Metric groups each vCPU data type is rendered from */
+unsigned int virt_vcpu_type_groups[VIRT_VCPU_DATA_TYPE_SIZE];
+
+/** Structure holding data of all vCPU rows */
+typedef struct {
+    /** Arrays containing various vCPU data */
+    char **vcpu_data[VIRT_VCPU_DATA_TYPE_SIZE];
+    /** Number of vCPU rows */
+    size_t vcpu_size;
+} virt_vcpu_data;
+
+/** Domains expanded by the vCPU mode and the rows of the last rendering. */
+typedef struct virt_vcpu_view {
+    int             all;                        /** Every active domain is expanded */
+    unsigned char   uuid[VIR_UUID_BUFLEN];      /** Expanded domain unless all are */
+    size_t          *row;                       /** Domain row of each vCPU row */
+    size_t          row_size;                   /** Number of vCPU rows */
+} virt_vcpu_view;
+
+/**
+ * Set the view to default state, nothing is expanded.
+ * @param view - view to be initialized
+ */
+void virt_init_vcpu_view(virt_vcpu_view *view);
+
+/**
+ * Release the view.
+ * @param view - view to be freed
+ */
+void virt_deinit_vcpu_view(virt_vcpu_view *view);
+
+/**
+ * Expand the domain of the row, or every active domain.
+ * @param virt  - pointer with virt data
+ * @param index - domain row, ignored if all is set
+ * @param all   - TRUE (1) to expand every active domain
+ */
+void virt_vcpu_expand(virt_data *virt, int index, int all);
+
+/**
+ * Check whether the vCPUs of the record are shown.
+ * @param view   - vCPU view
+ * @param record - domain record
+ * @return TRUE (1) if expanded, FALSE (0) otherwise
+ */
+int virt_vcpu_shows(const virt_vcpu_view *view, const virt_domain_record *record);
+
+/**
+ * Merge the vCPU part of one record of bulk statistics into the domain record.
+ * @param record  - domain record to be updated
+ * @param params  - typed parameters returned by virDomainListGetStats
+ * @param nparams - number of parameters
+ * @param now     - monotonic time of the sample
+ */
+void virt_vcpu_merge_stats(virt_domain_record *record, virTypedParameterPtr params,
+                           int nparams, unsigned long long now);
+
+/**
+ * Make room for the samples of size vCPUs in the record.
+ * @param record - domain record
+ * @param size   - number of possible vCPUs
+ */
+void virt_vcpu_reserve(virt_domain_record *record, int size);
+
+/**
+ * Map a vCPU row to the row of its domain.
+ * @param virt  - pointer with virt data
+ * @param index - vCPU row
+ * @return domain row, -1 if there is none
+ */
+int virt_vcpu_row(virt_data *virt, int index);
+
+/**
+ * Refresh the domain records and render the vCPU rows of the expanded domains.
+ * @param virt - Handler to the libvirt connection
+ * @return object filled with vCPU data
+ * @see virt_refresh_domain_records
+ */
+void *virt_get_vcpu_data(virt_data *virt);
+
+/*
+ * Call the virt_autostart_domain function for the domain of the vCPU row
+ * @param virt  - pointer with virt data
+ * @param index - vCPU row
+ */
+void virt_vcpu_autostart_wrapper(virt_data *virt, int index);
+
+/*
+ * Call the virt_create_domain function for the domain of the vCPU row
+ * @param virt  - pointer with virt data
+ * @param index - vCPU row
+ */
+void virt_vcpu_create_wrapper(virt_data *virt, int index);
+
+/*
+ * Call the virt_pause_domain function for the domain of the vCPU row
+ * @param virt  - pointer with virt data
+ * @param index - vCPU row
+ */
+void virt_vcpu_pause_wrapper(virt_data *virt, int index);
+
+/*
+ * Call the virt_reboot_domain function for the domain of the vCPU row
+ * @param virt  - pointer with virt data
+ * @param index - vCPU row
+ */
+void virt_vcpu_reboot_wrapper(virt_data *virt, int index);
+
+/*
+ * Call the virt_destroy_domain function for the domain of the vCPU row
+ * @param virt  - pointer with virt data
+ * @param index - vCPU row
+ */
+void virt_vcpu_destroy_wrapper(virt_data *virt, int index);
+
+#endif /* VIRT_VCPU_H */
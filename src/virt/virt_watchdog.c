@@ -0,0 +1,508 @@
+/* This file contains the watchdog running per-domain libvirt calls under a deadline
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virt_watchdog.h"
+#include "virt_trace.h"
+#include "virt_command.h"
+#include "utils.h"
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+/** Life cycle of a job */
+typedef enum {
+    VIRT_WATCHDOG_JOB_QUEUED,
+    VIRT_WATCHDOG_JOB_RUNNING,
+    VIRT_WATCHDOG_JOB_FINISHED
+} virt_watchdog_job_state;
+
+/** State of the worker pool, guarded by lock */
+static struct {
+    pthread_mutex_t     lock;
+    pthread_cond_t      work;       /** Signaled when a job is queued or the pool stops */
+    pthread_cond_t      done;       /** Signaled when a job finishes or a worker exits, monotonic clock */
+    virt_watchdog_job   *head;      /** Queued jobs, oldest first */
+    virt_watchdog_job   *tail;
+    int                 workers;    /** Running worker threads, including lost ones */
+    int                 lost;       /** Workers stuck in abandoned calls */
+    int                 started;
+    int                 stop;
+    unsigned long long  timeout;    /** Deadline of a call in microseconds */
+} watchdog = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER
+};
+
+/* Read the memory nodes of numatune and the host CPUs the vCPUs are pinned to */
+static void virt_watchdog_run_numa(virt_watchdog_job *job)
+{
+    unsigned long long trace = virt_trace_begin();
+    int nparams = 0;
+    job->res = virDomainGetNumaParameters(job->domain, NULL, &nparams, 0);
+    if (job->res == 0 && nparams > 0) {
+        job->params = calloc(nparams, sizeof(virTypedParameter));
+        job->res = virDomainGetNumaParameters(job->domain, job->params, &nparams, 0);
+        job->nparams = nparams;
+    }
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_NUMA_PARAMETERS, job->domain, trace, job->res < 0);
+    if (job->res < 0)
+        return;
+
+    /* the live pinning of a running domain, the configured one otherwise */
+    trace = virt_trace_begin();
+    int vcpus = virDomainGetVcpusFlags(job->domain, VIR_DOMAIN_VCPU_MAXIMUM);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_VCPUS_FLAGS, job->domain, trace, vcpus < 0);
+    if (vcpus <= 0)
+        return;
+
+    unsigned char *cpumaps = calloc(vcpus, VIRT_NODE_CPUMAP_LEN);
+    trace = virt_trace_begin();
+    int pinned = virDomainGetVcpuPinInfo(job->domain, vcpus, cpumaps, VIRT_NODE_CPUMAP_LEN, 0);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_VCPU_PIN_INFO, job->domain, trace, pinned < 0);
+
+    for (int i = 0; i < pinned; ++i)
+        for (int j = 0; j != VIRT_NODE_CPUMAP_LEN; ++j)
+            job->cpumap[j] |= cpumaps[i * VIRT_NODE_CPUMAP_LEN + j];
+    free(cpumaps);
+    job->res = pinned < 0 ? pinned : 0;
+}
+
+/* Read the host CPU every vCPU ran on last and the host CPUs it is pinned to */
+static void virt_watchdog_run_placement(virt_watchdog_job *job)
+{
+    unsigned long long trace = virt_trace_begin();
+    job->res = virDomainGetVcpusFlags(job->domain, VIR_DOMAIN_VCPU_MAXIMUM);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_VCPUS_FLAGS, job->domain, trace, job->res < 0);
+    if (job->res <= 0)
+        return;
+
+    job->vcpu_size  = job->res;
+    job->vcpu_cpu   = malloc(job->vcpu_size * sizeof(int));
+    job->vcpu_pin   = calloc(job->vcpu_size, VIRT_NODE_CPUMAP_LEN);
+    for (int i = 0; i != job->vcpu_size; ++i)
+        job->vcpu_cpu[i] = -1;
+
+    /* offline vCPUs are left out of the answer */
+    virVcpuInfoPtr info = calloc(job->vcpu_size, sizeof(virVcpuInfo));
+    trace = virt_trace_begin();
+    int online = virDomainGetVcpus(job->domain, info, job->vcpu_size, NULL, 0);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_VCPUS, job->domain, trace, online < 0);
+    for (int i = 0; i < online; ++i)
+        if (info[i].number < job->vcpu_size)
+            job->vcpu_cpu[info[i].number] = info[i].cpu;
+    free(info);
+
+    trace = virt_trace_begin();
+    job->res = virDomainGetVcpuPinInfo(job->domain, job->vcpu_size, job->vcpu_pin, VIRT_NODE_CPUMAP_LEN, 0);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_VCPU_PIN_INFO, job->domain, trace, job->res < 0);
+}
+
+/* Read the host CPUs every vCPU, the emulator and every iothread are pinned to */
+static void virt_watchdog_run_pinning(virt_watchdog_job *job)
+{
+    unsigned long long trace = virt_trace_begin();
+    job->res = virDomainGetVcpusFlags(job->domain, VIR_DOMAIN_VCPU_MAXIMUM);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_VCPUS_FLAGS, job->domain, trace, job->res < 0);
+    if (job->res <= 0)
+        return;
+
+    job->vcpu_size  = job->res;
+    job->vcpu_pin   = calloc(job->vcpu_size, VIRT_NODE_CPUMAP_LEN);
+    trace = virt_trace_begin();
+    job->res = virDomainGetVcpuPinInfo(job->domain, job->vcpu_size, job->vcpu_pin, VIRT_NODE_CPUMAP_LEN, 0);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_VCPU_PIN_INFO, job->domain, trace, job->res < 0);
+    if (job->res < 0)
+        return;
+
+    trace = virt_trace_begin();
+    job->res = virDomainGetEmulatorPinInfo(job->domain, job->cpumap, VIRT_NODE_CPUMAP_LEN, 0);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_EMULATOR_PIN_INFO, job->domain, trace, job->res < 0);
+    if (job->res < 0)
+        return;
+
+    /* domains without iothreads report none, drivers without them an error that is not fatal */
+    trace = virt_trace_begin();
+    int iothreads = virDomainGetIOThreadInfo(job->domain, &job->iothread, 0);
+    virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_IOTHREAD_INFO, job->domain, trace, iothreads < 0);
+    job->iothread_size = iothreads > 0 ? iothreads : 0;
+    job->res = 0;
+}
+
+/* Ask every disk of the job for its block job, bandwidth in bytes per second */
+static void virt_watchdog_run_block_jobs(virt_watchdog_job *job)
+{
+    job->block_job  = calloc(job->disk_size + 1, sizeof(virDomainBlockJobInfo));
+    job->block_res  = calloc(job->disk_size + 1, sizeof(int));
+    job->res        = 0;
+    for (int i = 0; i != job->disk_size; ++i) {
+        unsigned long long trace = virt_trace_begin();
+        job->block_res[i] = virDomainGetBlockJobInfo(job->domain, job->disk[i], job->block_job + i,
+                                                     VIR_DOMAIN_BLOCK_JOB_INFO_BANDWIDTH_BYTES);
+        virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_BLOCK_JOB_INFO, job->domain, trace, job->block_res[i] < 0);
+    }
+}
+
+/* Run the call of the job, no lock is held, every call traces its own libvirt calls */
+static void virt_watchdog_run(virt_watchdog_job *job)
+{
+    unsigned long long trace = 0;
+    switch (job->call) {
+        case VIRT_WATCHDOG_CALL_AUTOSTART:
+            trace = virt_trace_begin();
+            job->res = virDomainGetAutostart(job->domain, &job->autostart);
+            virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_AUTOSTART, job->domain, trace, job->res < 0);
+            break;
+        case VIRT_WATCHDOG_CALL_MEMORY_STATS:
+            trace = virt_trace_begin();
+            job->res = virDomainMemoryStats(job->domain, job->memory, VIR_DOMAIN_MEMORY_STAT_NR, 0);
+            virt_trace_end(VIRT_TRACE_API_DOMAIN_MEMORY_STATS, job->domain, trace, job->res < 0);
+            break;
+        case VIRT_WATCHDOG_CALL_GUEST_INFO: {
+            /* libvirt refuses agent queries on read-only connections */
+            virDomainPtr domain = virt_command_lookup(job->domain);
+            if (!domain) {
+                job->res = -1;
+                break;
+            }
+            trace = virt_trace_begin();
+            job->res = virDomainGetGuestInfo(domain, VIR_DOMAIN_GUEST_INFO_OS,
+                                             &job->params, &job->nparams, 0);
+            virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_GUEST_INFO, job->domain, trace, job->res < 0);
+            virDomainFree(domain);
+            break;
+        }
+        case VIRT_WATCHDOG_CALL_NUMA:
+            virt_watchdog_run_numa(job);
+            break;
+        case VIRT_WATCHDOG_CALL_PLACEMENT:
+            virt_watchdog_run_placement(job);
+            break;
+        case VIRT_WATCHDOG_CALL_PINNING:
+            virt_watchdog_run_pinning(job);
+            break;
+        case VIRT_WATCHDOG_CALL_JOB_INFO:
+            trace = virt_trace_begin();
+            job->res = virDomainGetJobInfo(job->domain, &job->job_info);
+            virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_JOB_INFO, job->domain, trace, job->res < 0);
+            break;
+        case VIRT_WATCHDOG_CALL_JOB_STATS:
+            trace = virt_trace_begin();
+            job->res = virDomainGetJobStats(job->domain, &job->job_type, &job->params, &job->nparams, 0);
+            virt_trace_end(VIRT_TRACE_API_DOMAIN_GET_JOB_STATS, job->domain, trace, job->res < 0);
+            break;
+        case VIRT_WATCHDOG_CALL_BLOCK_JOB_INFO:
+            virt_watchdog_run_block_jobs(job);
+            break;
+    }
+}
+
+/* Drop a reference of the job, called with the lock held */
+static void virt_watchdog_unref(virt_watchdog_job *job)
+{
+    if (--job->refs)
+        return;
+
+    if (job->params)
+        virTypedParamsFree(job->params, job->nparams);
+    free(job->vcpu_cpu);
+    free(job->vcpu_pin);
+    for (int i = 0; i != job->iothread_size; ++i)
+        virDomainIOThreadInfoFree(job->iothread[i]);
+    free(job->iothread);
+    for (int i = 0; i != job->disk_size; ++i)
+        free(job->disk[i]);
+    free(job->disk);
+    free(job->block_job);
+    free(job->block_res);
+    virDomainFree(job->domain);
+    free(job);
+}
+
+/* Check whether there are more usable workers than needed, called with the lock held */
+static int virt_watchdog_surplus()
+{
+    return watchdog.workers - watchdog.lost > VIRT_WATCHDOG_WORKERS;
+}
+
+static void *virt_watchdog_worker(void *arg)
+{
+    pthread_mutex_lock(&watchdog.lock);
+    for (;;) {
+        while (!watchdog.stop && !watchdog.head && !virt_watchdog_surplus())
+            pthread_cond_wait(&watchdog.work, &watchdog.lock);
+        /* a worker back from a hung call leaves if its replacement took over */
+        if (watchdog.stop || virt_watchdog_surplus())
+            break;
+
+        virt_watchdog_job *job = watchdog.head;
+        watchdog.head = job->next;
+        if (!watchdog.head)
+            watchdog.tail = NULL;
+        job->state      = VIRT_WATCHDOG_JOB_RUNNING;
+        job->started    = time_monotonic_us();
+        pthread_mutex_unlock(&watchdog.lock);
+
+        virt_watchdog_run(job);
+
+        pthread_mutex_lock(&watchdog.lock);
+        job->state = VIRT_WATCHDOG_JOB_FINISHED;
+        if (job->abandoned)
+            --watchdog.lost;
+        virt_watchdog_unref(job);
+        pthread_cond_broadcast(&watchdog.done);
+    }
+
+    --watchdog.workers;
+    pthread_cond_broadcast(&watchdog.done);
+    pthread_mutex_unlock(&watchdog.lock);
+    return NULL;
+}
+
+/* Start workers until enough of them are usable, called with the lock held */
+static void virt_watchdog_spawn()
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    /* lost workers can never be joined */
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    while (watchdog.workers - watchdog.lost < VIRT_WATCHDOG_WORKERS &&
+           watchdog.lost <= VIRT_WATCHDOG_MAX_LOST) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, virt_watchdog_worker, NULL) != 0)
+            break;
+        ++watchdog.workers;
+    }
+
+    pthread_attr_destroy(&attr);
+}
+
+int virt_watchdog_init(double timeout)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int res = pthread_cond_init(&watchdog.done, &attr);
+    pthread_condattr_destroy(&attr);
+    if (res != 0)
+        return VIRT_ERROR_FAILURE;
+
+    pthread_mutex_lock(&watchdog.lock);
+    watchdog.timeout    = (unsigned long long)(timeout * 1000000.0);
+    watchdog.stop       = 0;
+    watchdog.started    = 1;
+    virt_watchdog_spawn();
+    res = watchdog.workers > 0 ? VIRT_ERROR_SUCCESS : VIRT_ERROR_FAILURE;
+    pthread_mutex_unlock(&watchdog.lock);
+
+    return res;
+}
+
+void virt_watchdog_deinit()
+{
+    pthread_mutex_lock(&watchdog.lock);
+    if (!watchdog.started) {
+        pthread_mutex_unlock(&watchdog.lock);
+        return;
+    }
+
+    watchdog.stop       = 1;
+    watchdog.started    = 0;
+    while (watchdog.head) {
+        virt_watchdog_job *job = watchdog.head;
+        watchdog.head = job->next;
+        job->state = VIRT_WATCHDOG_JOB_FINISHED;
+        virt_watchdog_unref(job);
+    }
+    watchdog.tail = NULL;
+    pthread_cond_broadcast(&watchdog.work);
+
+    /* lost workers keep the pool state, it is never destroyed */
+    while (watchdog.workers > watchdog.lost)
+        pthread_cond_wait(&watchdog.done, &watchdog.lock);
+    pthread_mutex_unlock(&watchdog.lock);
+}
+
+unsigned long long virt_watchdog_deadline()
+{
+    return time_monotonic_us() + VIRT_WATCHDOG_BATCH_TIMEOUTS * watchdog.timeout;
+}
+
+/* Queue the job, released if the watchdog is not running */
+static virt_watchdog_job *virt_watchdog_queue(virt_watchdog_job *job)
+{
+    pthread_mutex_lock(&watchdog.lock);
+    if (!watchdog.started) {
+        pthread_mutex_unlock(&watchdog.lock);
+        job->refs = 1;
+        virt_watchdog_unref(job);
+        return NULL;
+    }
+
+    if (watchdog.tail)
+        watchdog.tail->next = job;
+    else
+        watchdog.head = job;
+    watchdog.tail = job;
+    pthread_cond_signal(&watchdog.work);
+    pthread_mutex_unlock(&watchdog.lock);
+    return job;
+}
+
+/* Create the job of the call, not queued yet */
+static virt_watchdog_job *virt_watchdog_create(virDomainPtr domain, virt_watchdog_call call)
+{
+    virt_watchdog_job *job = calloc(1, sizeof(virt_watchdog_job));
+    if (!job)
+        return NULL;
+
+    virDomainRef(domain);
+    job->domain = domain;
+    job->call   = call;
+    job->state  = VIRT_WATCHDOG_JOB_QUEUED;
+    job->refs   = 2;
+    return job;
+}
+
+virt_watchdog_job *virt_watchdog_submit(virDomainPtr domain, virt_watchdog_call call)
+{
+    virt_watchdog_job *job = virt_watchdog_create(domain, call);
+    return job ? virt_watchdog_queue(job) : NULL;
+}
+
+virt_watchdog_job *virt_watchdog_submit_disks(virDomainPtr domain, virt_watchdog_call call,
+                                              char *const *disk, int disk_size)
+{
+    virt_watchdog_job *job = virt_watchdog_create(domain, call);
+    if (!job)
+        return NULL;
+
+    job->disk = calloc(disk_size + 1, sizeof(char *));
+    for (int i = 0; i != disk_size; ++i)
+        job->disk[i] = copy_str(disk[i]);
+    job->disk_size = disk_size;
+    return virt_watchdog_queue(job);
+}
+
+/* Remove a queued job from the queue, called with the lock held */
+static void virt_watchdog_dequeue(virt_watchdog_job *job)
+{
+    virt_watchdog_job *prev = NULL;
+    for (virt_watchdog_job *iter = watchdog.head; iter; prev = iter, iter = iter->next) {
+        if (iter != job)
+            continue;
+
+        if (prev)
+            prev->next = job->next;
+        else
+            watchdog.head = job->next;
+        if (watchdog.tail == job)
+            watchdog.tail = prev;
+        job->next = NULL;
+        return;
+    }
+}
+
+/* Give up on a running job, its worker is replaced, called with the lock held */
+static void virt_watchdog_abandon(virt_watchdog_job *job)
+{
+    job->abandoned  = 1;
+    job->outcome    = VIRT_WATCHDOG_OUTCOME_HUNG;
+    ++watchdog.lost;
+}
+
+void virt_watchdog_wait(virt_watchdog_job **job, size_t size, unsigned long long deadline)
+{
+    pthread_mutex_lock(&watchdog.lock);
+    for (;;) {
+        unsigned long long now = time_monotonic_us();
+        unsigned long long wake = deadline;
+        size_t pending = 0, hung = 0;
+        for (size_t i = 0; i != size; ++i) {
+            if (!job[i] || job[i]->abandoned || job[i]->state == VIRT_WATCHDOG_JOB_FINISHED)
+                continue;
+
+            /* the deadline of a call starts when a worker picks it up */
+            if (job[i]->state == VIRT_WATCHDOG_JOB_RUNNING) {
+                unsigned long long expires = job[i]->started + watchdog.timeout;
+                if (now >= expires) {
+                    virt_watchdog_abandon(job[i]);
+                    ++hung;
+                    continue;
+                }
+                if (expires < wake)
+                    wake = expires;
+            }
+            ++pending;
+        }
+
+        /* replace workers left behind in hung calls, the queue keeps moving */
+        if (hung)
+            virt_watchdog_spawn();
+        if (!pending || now >= deadline || watchdog.workers - watchdog.lost <= 0)
+            break;
+
+        struct timespec until;
+        until.tv_sec    = wake / 1000000;
+        until.tv_nsec   = (wake % 1000000) * 1000;
+        pthread_cond_timedwait(&watchdog.done, &watchdog.lock, &until);
+    }
+
+    for (size_t i = 0; i != size; ++i) {
+        if (!job[i] || job[i]->abandoned)
+            continue;
+
+        switch (job[i]->state) {
+            case VIRT_WATCHDOG_JOB_FINISHED:
+                job[i]->outcome = VIRT_WATCHDOG_OUTCOME_DONE;
+                break;
+            case VIRT_WATCHDOG_JOB_QUEUED:
+                /* the queue drains again next tick, nothing is wrong with the domain */
+                virt_watchdog_dequeue(job[i]);
+                job[i]->state   = VIRT_WATCHDOG_JOB_FINISHED;
+                job[i]->outcome = VIRT_WATCHDOG_OUTCOME_DROPPED;
+                virt_watchdog_unref(job[i]);
+                break;
+            case VIRT_WATCHDOG_JOB_RUNNING:
+                virt_watchdog_abandon(job[i]);
+                break;
+        }
+    }
+
+    virt_watchdog_spawn();
+    pthread_mutex_unlock(&watchdog.lock);
+}
+
+int virt_watchdog_finished(virt_watchdog_job *job)
+{
+    pthread_mutex_lock(&watchdog.lock);
+    int finished = job->state == VIRT_WATCHDOG_JOB_FINISHED;
+    pthread_mutex_unlock(&watchdog.lock);
+    return finished;
+}
+
+void virt_watchdog_release(virt_watchdog_job *job)
+{
+    if (!job)
+        return;
+
+    pthread_mutex_lock(&watchdog.lock);
+    virt_watchdog_unref(job);
+    pthread_mutex_unlock(&watchdog.lock);
+}
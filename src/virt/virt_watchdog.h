@@ -0,0 +1,168 @@
+/* This file contains the watchdog running per-domain libvirt calls under a deadline
+ * Copyright (C) 2017 Atomi
+ * Author: Sebastian Bialobrzecki <sbb@openmailbox.org>
+ *
+ * This file is part of virt-htop.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file virt_watchdog.h
+ * This file contains the watchdog running per-domain libvirt calls under a
+ * deadline. Calls are handed to a small pool of worker threads, and each call
+ * gets its own deadline from the moment a worker picks it up. A call still
+ * running at its deadline is abandoned, its worker is replaced right away and
+ * the domain is reported as hung, so a guest with a wedged monitor cannot
+ * stall the refresh of the rest.
+ */
+#ifndef VIRT_WATCHDOG_H
+#define VIRT_WATCHDOG_H
+#include "virt.h"
+#include "virt_node.h"
+/** Number of workers serving calls */
+#define VIRT_WATCHDOG_WORKERS (4)
+/** Maximum number of workers left behind in hung calls, no replacements are started beyond it */
+#define VIRT_WATCHDOG_MAX_LOST (16)
+/** Default deadline of a call in seconds */
+#define VIRT_WATCHDOG_TIMEOUT (1.0)
+/** Call deadlines a whole batch may take, calls still queued beyond are dropped */
+#define VIRT_WATCHDOG_BATCH_TIMEOUTS (4)
+/** Number of per-domain calls run by the watchdog */
+#define VIRT_WATCHDOG_CALL_SIZE (9)
+
+/** Per-domain calls run by the watchdog */
+typedef enum {
+    VIRT_WATCHDOG_CALL_AUTOSTART,       /** virDomainGetAutostart */
+    VIRT_WATCHDOG_CALL_MEMORY_STATS,    /** virDomainMemoryStats */
+    VIRT_WATCHDOG_CALL_GUEST_INFO,      /** virDomainGetGuestInfo, operating system only, on the command connection */
+    VIRT_WATCHDOG_CALL_NUMA,            /** virDomainGetNumaParameters and virDomainGetVcpuPinInfo */
+    VIRT_WATCHDOG_CALL_PLACEMENT,       /** virDomainGetVcpus and virDomainGetVcpuPinInfo of every vCPU */
+    VIRT_WATCHDOG_CALL_PINNING,         /** virDomainGetVcpuPinInfo, virDomainGetEmulatorPinInfo and virDomainGetIOThreadInfo */
+    VIRT_WATCHDOG_CALL_JOB_INFO,        /** virDomainGetJobInfo, answered by the daemon for domains without a job */
+    VIRT_WATCHDOG_CALL_JOB_STATS,       /** virDomainGetJobStats */
+    VIRT_WATCHDOG_CALL_BLOCK_JOB_INFO   /** virDomainGetBlockJobInfo of every disk of the job */
+} virt_watchdog_call_enum;
+
+/** @see virt_watchdog_call_enum */
+typedef virt_watchdog_call_enum virt_watchdog_call;
+
+/** Outcome of a job once virt_watchdog_wait returned */
+typedef enum {
+    VIRT_WATCHDOG_OUTCOME_DONE,         /** Call finished in time, results are valid */
+    VIRT_WATCHDOG_OUTCOME_DROPPED,      /** No worker was free before the deadline, the call never ran */
+    VIRT_WATCHDOG_OUTCOME_HUNG          /** Call was still running at the deadline */
+} virt_watchdog_outcome_enum;
+
+/** @see virt_watchdog_outcome_enum */
+typedef virt_watchdog_outcome_enum virt_watchdog_outcome;
+
+/** Single call, shared by the caller and the worker running it. */
+typedef struct virt_watchdog_job {
+    struct virt_watchdog_job    *next;          /** Next job in the queue */
+    virDomainPtr                domain;         /** Referenced for the lifetime of the job */
+    virt_watchdog_call          call;           /** What to call */
+    int                         state;          /** Queued, running or finished, guarded by the watchdog */
+    int                         abandoned;      /** Caller gave up waiting, guarded by the watchdog */
+    int                         refs;           /** Caller and worker references, guarded by the watchdog */
+    unsigned long long          started;        /** Monotonic time a worker picked it up, guarded by the watchdog */
+    virt_watchdog_outcome       outcome;        /** Set by virt_watchdog_wait, read by the caller only */
+
+    int                         res;            /** Return value of the call */
+    int                         autostart;      /** VIRT_WATCHDOG_CALL_AUTOSTART */
+    virDomainMemoryStatStruct   memory[VIR_DOMAIN_MEMORY_STAT_NR]; /** VIRT_WATCHDOG_CALL_MEMORY_STATS */
+    virTypedParameterPtr        params;         /** VIRT_WATCHDOG_CALL_GUEST_INFO, VIRT_WATCHDOG_CALL_NUMA,
+                                                    VIRT_WATCHDOG_CALL_JOB_STATS */
+    int                         nparams;        /** VIRT_WATCHDOG_CALL_GUEST_INFO, VIRT_WATCHDOG_CALL_NUMA,
+                                                    VIRT_WATCHDOG_CALL_JOB_STATS */
+    unsigned char               cpumap[VIRT_NODE_CPUMAP_LEN]; /** VIRT_WATCHDOG_CALL_NUMA, union of the vCPU pinning,
+                                                                   VIRT_WATCHDOG_CALL_PINNING, emulator pinning */
+    int                         *vcpu_cpu;      /** VIRT_WATCHDOG_CALL_PLACEMENT, host CPU of each vCPU, -1 if offline */
+    unsigned char               *vcpu_pin;      /** VIRT_WATCHDOG_CALL_PLACEMENT, VIRT_WATCHDOG_CALL_PINNING,
+                                                    VIRT_NODE_CPUMAP_LEN bytes per vCPU */
+    int                         vcpu_size;      /** VIRT_WATCHDOG_CALL_PLACEMENT, VIRT_WATCHDOG_CALL_PINNING,
+                                                    number of possible vCPUs */
+    virDomainIOThreadInfoPtr    *iothread;      /** VIRT_WATCHDOG_CALL_PINNING, iothreads and their pinning */
+    int                         iothread_size;  /** VIRT_WATCHDOG_CALL_PINNING, number of iothreads */
+    virDomainJobInfo            job_info;       /** VIRT_WATCHDOG_CALL_JOB_INFO */
+    int                         job_type;       /** VIRT_WATCHDOG_CALL_JOB_STATS, virDomainJobType */
+    char                        **disk;         /** VIRT_WATCHDOG_CALL_BLOCK_JOB_INFO, disks to be asked, owned */
+    int                         disk_size;      /** VIRT_WATCHDOG_CALL_BLOCK_JOB_INFO, number of disks */
+    virDomainBlockJobInfo       *block_job;     /** VIRT_WATCHDOG_CALL_BLOCK_JOB_INFO, job of each disk */
+    int                         *block_res;     /** VIRT_WATCHDOG_CALL_BLOCK_JOB_INFO, 1 if the disk has a job,
+                                                    0 if not, -1 on failure */
+} virt_watchdog_job;
+
+/**
+ * Start the workers.
+ * @param timeout - deadline of a call in seconds
+ * @return VIRT_ERROR_SUCCESS on success, VIRT_ERROR_FAILURE otherwise
+ */
+int virt_watchdog_init(double timeout);
+
+/**
+ * Stop idle workers and drop queued jobs.
+ * Workers stuck in hung calls cannot be stopped, they exit once the call returns.
+ */
+void virt_watchdog_deinit();
+
+/**
+ * Return deadline of a batch of calls submitted now, each call has its own
+ * deadline within it.
+ * @return monotonic time in microseconds
+ */
+unsigned long long virt_watchdog_deadline();
+
+/**
+ * Queue a call for the domain.
+ * @param domain - target domain, referenced by the job
+ * @param call   - call to be run
+ * @return job to be waited for and released, NULL on failure
+ */
+virt_watchdog_job *virt_watchdog_submit(virDomainPtr domain, virt_watchdog_call call);
+
+/**
+ * Queue a call asking about disks of the domain.
+ * @param domain    - target domain, referenced by the job
+ * @param call      - call to be run, VIRT_WATCHDOG_CALL_BLOCK_JOB_INFO
+ * @param disk      - target names of the disks, copied into the job
+ * @param disk_size - number of disks
+ * @return job to be waited for and released, NULL on failure
+ */
+virt_watchdog_job *virt_watchdog_submit_disks(virDomainPtr domain, virt_watchdog_call call,
+                                              char *const *disk, int disk_size);
+
+/**
+ * Wait until all jobs finish or hang and set their outcome. A job hangs once it
+ * ran longer than the deadline of a call, it is abandoned and its worker
+ * replaced at once. When the deadline of the batch passes, or no worker is
+ * left to run them, queued jobs are dropped and running jobs are abandoned.
+ * @param job      - jobs returned by virt_watchdog_submit, NULL entries are skipped
+ * @param size     - number of jobs
+ * @param deadline - deadline of the batch, monotonic time in microseconds
+ */
+void virt_watchdog_wait(virt_watchdog_job **job, size_t size, unsigned long long deadline);
+
+/**
+ * Check whether an abandoned call has returned since.
+ * @param job - job with VIRT_WATCHDOG_OUTCOME_HUNG outcome
+ * @return TRUE (1) if the call returned, FALSE (0) otherwise
+ */
+int virt_watchdog_finished(virt_watchdog_job *job);
+
+/**
+ * Release caller's reference of the job.
+ * @param job - job returned by virt_watchdog_submit
+ */
+void virt_watchdog_release(virt_watchdog_job *job);
+
+#endif /* VIRT_WATCHDOG_H */